@@ -0,0 +1,9 @@
+#!/bin/bash
+
+# select based network events may be used with NETWORK_EVENTS=
+NETWORK_EVENTS=${NETWORK_EVENTS--DIP_NETWORK_EPOLL}
+
+gcc -std=gnu99 $@ -D_DEFAULT_SOURCE=__STRICT_ANSI__ -DIP_NETWORK_LEGACY $NETWORK_EVENTS -Isrc -Isrc/ip_network/ \
+    src/robrehab_client.c src/axis_packets.c src/ip_network/ip_network.c src/ip_network/async_ip_network.c \
+    src/threads/thread_safe_data.c src/threads/threads_unix.c src/time/timing_unix.c \
+    -fPIC -shared -o libRobRehabClient.so -lrt -lpthread
@@ -1,7 +1,16 @@
 #!/bin/bash
 
+# System V shared memory backend may be selected with SHM_SOURCE=src/shared_memory/shm_unix.c
+SHM_SOURCE=${SHM_SOURCE:-src/shared_memory/shm_posix.c}
+# select based network events may be used with NETWORK_EVENTS=
+NETWORK_EVENTS=${NETWORK_EVENTS--DIP_NETWORK_EPOLL}
+# fixed length messages (for clients without length prefixed framing) may be used with NETWORK_FRAMING=-DNETWORK_LEGACY_FRAMING
+NETWORK_FRAMING=${NETWORK_FRAMING-}
+# axis measures multicast group may be changed with NETWORK_MULTICAST='-DNETWORK_MULTICAST_GROUP="239.1.1.1"' (or "" to disable publishing)
+NETWORK_MULTICAST=${NETWORK_MULTICAST-}
+
 gcc -std=gnu99 $@ -DROBREHAB_SERVER -D__USE_POSIX199309 -D_DEFAULT_SOURCE=__STRICT_ANSI__ \
-    -D_SVID_SOURCE -DIP_NETWORK_LEGACY -DDEBUG -Isrc -Isrc/ip_network/ src/robrehab_system.c \
-    src/robrehab_network.c src/ip_network/ip_network.c src/ip_network/async_ip_network.c \
-    src/threads/thread_safe_data.c src/shm_control.c src/shared_memory/shm_unix.c \
+    -D_SVID_SOURCE -DIP_NETWORK_LEGACY $NETWORK_EVENTS $NETWORK_FRAMING $NETWORK_MULTICAST -DDEBUG -Isrc -Isrc/ip_network/ src/robrehab_system.c \
+    src/robrehab_network.c src/axis_packets.c src/ip_network/ip_network.c src/ip_network/async_ip_network.c \
+    src/threads/thread_safe_data.c src/shm_control.c $SHM_SOURCE \
     src/threads/threads_unix.c src/time/timing_unix.c -o RobRehabServer -lrt -lpthread
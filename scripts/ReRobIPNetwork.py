@@ -3,20 +3,150 @@
 from socket import *
 
 import sys
+import time
+import struct
 #import json
 
 DEFAULT_ADDRESS = 'localhost'
 
 BUFFER_SIZE = 512
 
+# Messages preceded by their length (2 bytes, network order), several of them possibly in one datagram.
+# Set to False for servers built with NETWORK_LEGACY_FRAMING (fixed length messages)
+LENGTH_PREFIXED_MESSAGES = True
+FRAME_HEADER_SIZE = 2
+DATAGRAM_SIZE = 1472
+
 FLOAT_SIZE = 4
 
 AXIS_VARS_NUMBER = 7
-AXIS_DATA_SIZE = 7 * FLOAT_SIZE
+# Axis values are followed by a stamp: setpoints tag, timestamp, actuation time and sequence number (native order, no padding)
+AXIS_STAMP_FORMAT = '=IQQQ'
+AXIS_DATA_SIZE = 7 * FLOAT_SIZE + struct.calcsize( AXIS_STAMP_FORMAT )
+# Axis messages starting with this code are latency probes (client time) and their replies (plus server read/send times)
+AXIS_PROBE_REQUEST = 0xFF
+
+# Compact axis packets (see src/axis_packets.h): subscribed fields only, optionally quantized and delta encoded
+AXIS_PACKETS_SUBSCRIBE_REQUEST = 0xFE
+AXIS_PACKETS_ACKNOWLEDGE_REQUEST = 0xFD
+AXIS_FIELDS_NUMBER = AXIS_VARS_NUMBER + 4
+AXIS_FIELDS_ALL = ( 1 << AXIS_FIELDS_NUMBER ) - 1
+AXIS_QUANTIZATION_NONE, AXIS_QUANTIZATION_HALF, AXIS_QUANTIZATION_FIXED = range( 3 )
+AXIS_PACKETS_HISTORY_LENGTH = 16
 
 JOINT_VARS_NUMBER = 8
 JOINT_DATA_SIZE = 8 * FLOAT_SIZE
 
+# Measures of all axes, published by the server on each update (server built with NETWORK_MULTICAST_GROUP)
+MULTICAST_GROUP = '226.1.1.1'
+MULTICAST_PORT = 50004
+SEQUENCE_SIZE = 4
+
+def FrameMessage( messageBuffer ):
+  messageBuffer = bytes( messageBuffer )
+  if LENGTH_PREFIXED_MESSAGES:
+    return struct.pack( '>H', len( messageBuffer ) ) + messageBuffer
+  return messageBuffer
+
+def ReceiveStreamData( streamSocket, dataSize ):
+  data = b''
+  while len( data ) < dataSize:
+    dataChunk = streamSocket.recv( dataSize - len( data ) )
+    if not dataChunk: raise ConnectionError( 'connection closed' )
+    data += dataChunk
+  return data
+
+# Single message from a TCP socket (reassembled from partial reads)
+def ReceiveStreamMessage( streamSocket ):
+  if not LENGTH_PREFIXED_MESSAGES:
+    return streamSocket.recv( BUFFER_SIZE )
+  messageSize = struct.unpack( '>H', ReceiveStreamData( streamSocket, FRAME_HEADER_SIZE ) )[ 0 ]
+  return ReceiveStreamData( streamSocket, messageSize )
+
+# All messages of a UDP datagram, oldest first
+def ReceiveDatagramMessages( datagramSocket ):
+  if not LENGTH_PREFIXED_MESSAGES:
+    return [ datagramSocket.recv( BUFFER_SIZE ) ]
+  datagram = datagramSocket.recv( DATAGRAM_SIZE )
+  messagesList = []
+  frameOffset = 0
+  while frameOffset + FRAME_HEADER_SIZE <= len( datagram ):
+    messageSize = struct.unpack_from( '>H', datagram, frameOffset )[ 0 ]
+    frameOffset += FRAME_HEADER_SIZE
+    if frameOffset + messageSize > len( datagram ): break
+    messagesList.append( datagram[ frameOffset:frameOffset + messageSize ] )
+    frameOffset += messageSize
+  return messagesList
+
+# Mirror of the server packets coder: keeps decoded frames (quantized values) as bases for the following delta frames
+class AxisPacketsDecoder:
+
+  def __init__( self, axesList, fieldsMask, quantization, fixedResolution ):
+    self.axesList = list( axesList )
+    self.fieldsMask = fieldsMask & AXIS_FIELDS_ALL
+    self.quantization = quantization
+    self.fixedResolution = fixedResolution
+    self.framesList = {}
+    self.lastFrameNumber = 0
+
+  def GetFieldWidth( self, fieldIndex ):
+    if fieldIndex < AXIS_VARS_NUMBER: return 2 if self.quantization == AXIS_QUANTIZATION_HALF else 4
+    return 4 if fieldIndex == AXIS_VARS_NUMBER else 8
+
+  def IsDifferenceField( self, fieldIndex ):
+    return fieldIndex >= AXIS_VARS_NUMBER or self.quantization == AXIS_QUANTIZATION_FIXED
+
+  def Dequantize( self, fieldIndex, value ):
+    if fieldIndex >= AXIS_VARS_NUMBER: return value
+    if self.quantization == AXIS_QUANTIZATION_HALF: return struct.unpack( '<e', struct.pack( '<H', value & 0xFFFF ) )[ 0 ]
+    if self.quantization == AXIS_QUANTIZATION_FIXED: return struct.unpack( '<i', struct.pack( '<I', value & 0xFFFFFFFF ) )[ 0 ] * self.fixedResolution
+    return struct.unpack( '<f', struct.pack( '<I', value & 0xFFFFFFFF ) )[ 0 ]
+
+  # Returns the frame number (to be acknowledged) and the values ( floats list, stamp tuple ) of each axis, or ( 0, {} )
+  def Decode( self, packet ):
+    frameNumber, baseFrameNumber, blocksNumber = struct.unpack_from( '<IIB', packet, 1 )
+    if self.lastFrameNumber != 0 and ( ( frameNumber - self.lastFrameNumber ) & 0xFFFFFFFF ) >= 0x80000000: return ( 0, {} )
+    baseFrame = {}
+    if baseFrameNumber != frameNumber:
+      if baseFrameNumber not in self.framesList: return ( 0, {} )
+      baseFrame = self.framesList[ baseFrameNumber ]
+    frame = { axisID: list( values ) for axisID, values in baseFrame.items() }
+    offset = 10
+    try:
+      for blockIndex in range( blocksNumber ):
+        axisID, fieldsMask = struct.unpack_from( '<BH', packet, offset )
+        offset += 3
+        if axisID not in self.axesList: return ( 0, {} )
+        isBaseAxis = axisID in baseFrame
+        values = frame.setdefault( axisID, [ 0 ] * AXIS_FIELDS_NUMBER )
+        for fieldIndex in range( AXIS_FIELDS_NUMBER ):
+          if not fieldsMask & ( 1 << fieldIndex ): continue
+          if isBaseAxis and self.IsDifferenceField( fieldIndex ):
+            code, shift = 0, 0
+            while True:
+              codeByte = packet[ offset ]
+              offset += 1
+              code |= ( codeByte & 0x7F ) << shift
+              shift += 7
+              if not codeByte & 0x80: break
+            difference = ( code >> 1 ) ^ -( code & 1 )
+            values[ fieldIndex ] = ( values[ fieldIndex ] + difference ) & 0xFFFFFFFFFFFFFFFF
+          else:
+            width = self.GetFieldWidth( fieldIndex )
+            if len( packet ) < offset + width: return ( 0, {} )
+            values[ fieldIndex ] = int.from_bytes( packet[ offset:offset + width ], 'little' )
+            offset += width
+    except IndexError:
+      return ( 0, {} )
+    self.framesList[ frameNumber ] = frame
+    self.framesList.pop( ( frameNumber - AXIS_PACKETS_HISTORY_LENGTH ) & 0xFFFFFFFF, None )
+    self.lastFrameNumber = frameNumber
+    axesValues = {}
+    for axisID, values in frame.items():
+      axisValues = [ self.Dequantize( fieldIndex, values[ fieldIndex ] ) for fieldIndex in range( AXIS_FIELDS_NUMBER ) ]
+      axesValues[ axisID ] = ( axisValues[ :AXIS_VARS_NUMBER ], tuple( axisValues[ AXIS_VARS_NUMBER: ] ) )
+    return ( frameNumber, axesValues )
+
 class ClientConnection:
 
   def __init__( self ):
@@ -26,6 +156,13 @@ class ClientConnection:
 
     self.isConnected = False
 
+    self.setpointsCount = 0
+    self.setpointsSendTimes = {}
+    self.axisStamps = {}
+    self.clockOffset = 0
+    self.packetsDecoder = None
+    self.axesMeasures = {}
+
   def __del__( self ):
     if self.isConnected:
       self.eventSocket.close()
@@ -47,10 +184,9 @@ class ClientConnection:
   def RefreshInfo( self ):
     robotsInfo = {}
     if self.isConnected:
-      messageBuffer = ' ' #bytearray( 1 )
-      messageBuffer[ 0 ] = 0
-      self.eventSocket.send( messageBuffer )
-      robotsInfoString = self.eventSocket.recv( BUFFER_SIZE )
+      messageBuffer = bytearray( 1 )
+      self.eventSocket.sendall( FrameMessage( messageBuffer ) )
+      robotsInfoString = ReceiveStreamMessage( self.eventSocket )
       robotsInfo = {}#json.loads( robotsInfoString.decode() )
 
     robotsList = robotsInfo.get( 'robots', [] )
@@ -65,36 +201,103 @@ class ClientConnection:
       messageBuffer[ 0 ] = 1
       messageBuffer[ 1 ] = targetIndex
       messageBuffer[ 2 ] = commandNumber
-      self.eventSocket.send( messageBuffer )
+      self.eventSocket.sendall( FrameMessage( messageBuffer ) )
 
   def CheckState( self, eventNumber ):
     return false
     #return self.eventSocket.recv( BUFFER_SIZE )
 
+  # Setpoints are tagged with their count, so that their actuation time can be matched to the sending time
   def SendAxisData( self, axisID, position, velocity, stiffness ):
     if self.isConnected:
-      messageBuffer = '   ' #bytearray( 3 )
+      messageBuffer = bytearray( 3 )
       messageBuffer[ 0 ] = 1
       messageBuffer[ 1 ] = axisID
       messageBuffer[ 2 ] = int( '00010011', 2 )
       for setpoint in [ position, velocity, 0.0, 0.0, stiffness, 0.0, 0.0 ]:
         messageBuffer += struct.pack( 'f', setpoint )
-      self.axisSocket.send( messageBuffer )
+      self.setpointsCount = ( self.setpointsCount + 1 ) & 0xFFFFFFFF
+      sendTime = time.monotonic_ns()
+      self.setpointsSendTimes[ self.setpointsCount ] = sendTime
+      if len( self.setpointsSendTimes ) > 1000: del self.setpointsSendTimes[ min( self.setpointsSendTimes ) ]
+      messageBuffer += struct.pack( AXIS_STAMP_FORMAT, self.setpointsCount, sendTime, 0, 0 )
+      self.axisSocket.send( FrameMessage( messageBuffer ) )
+
+  # Compact packets of the given axes (instead of full blocks of the controlled ones). Fields mask bits follow axis
+  # values order, then setpoints tag, timestamp, actuation time and sequence number. Keyframe interval 0 disables delta encoding
+  def SubscribeAxes( self, axesList, fieldsMask=AXIS_FIELDS_ALL, quantization=AXIS_QUANTIZATION_NONE, fixedResolution=0.0, keyframeInterval=50 ):
+    if self.isConnected:
+      messageBuffer = struct.pack( '<BHBfBB', AXIS_PACKETS_SUBSCRIBE_REQUEST, fieldsMask, quantization, fixedResolution, keyframeInterval, len( axesList ) )
+      messageBuffer += bytes( axesList )
+      self.axisSocket.send( FrameMessage( messageBuffer ) )
+      self.packetsDecoder = AxisPacketsDecoder( axesList, fieldsMask, quantization, fixedResolution ) if len( axesList ) > 0 else None
 
   def ReceiveAxisData( self, axisID ):
-    measures = [ 0.0 for var in range( AXIS_VARS_NUMBER ) ]
+    measures = self.axesMeasures.get( axisID, [ 0.0 for var in range( AXIS_VARS_NUMBER ) ] )
     if self.isConnected:
-      messageBuffer = self.axisSocket.recv( BUFFER_SIZE )
-      axesNumber = messageBuffer[ 0 ]
-      for axisIndex in range( axesNumber ):
-        axisDataOffset = axisIndex * AXIS_DATA_SIZE + 1
-        if messageBuffer[ axisDataOffset ] == axisID:
-          for measureIndex in range( AXIS_VARS_NUMBER ):
-            axisMeasureOffset = axisDataOffset + measureIndex * FLOAT_SIZE
-            measures[ measureIndex ] = struct.unpack_from( 'f', messageBuffer, axisMeasureOffset )[ 0 ]
+      for messageBuffer in ReceiveDatagramMessages( self.axisSocket ):
+        if len( messageBuffer ) == 0 or messageBuffer[ 0 ] == AXIS_PROBE_REQUEST: continue
+        if messageBuffer[ 0 ] == AXIS_PACKETS_SUBSCRIBE_REQUEST:
+          if self.packetsDecoder is None: continue
+          frameNumber, axesValues = self.packetsDecoder.Decode( messageBuffer )
+          if frameNumber == 0: continue
+          self.axisSocket.send( FrameMessage( struct.pack( '<BI', AXIS_PACKETS_ACKNOWLEDGE_REQUEST, frameNumber ) ) )
+          for packetAxisID, ( axisMeasures, axisStamp ) in axesValues.items():
+            self.axesMeasures[ packetAxisID ] = axisMeasures
+            self.axisStamps[ packetAxisID ] = axisStamp
+          measures = self.axesMeasures.get( axisID, measures )
+          continue
+        axesNumber = messageBuffer[ 0 ]
+        axisDataOffset = 1
+        for axisIndex in range( axesNumber ):
+          if axisDataOffset + 1 + AXIS_DATA_SIZE > len( messageBuffer ): break
+          if messageBuffer[ axisDataOffset ] == axisID:
+            measures = list( struct.unpack_from( '%df' % AXIS_VARS_NUMBER, messageBuffer, axisDataOffset + 1 ) )
+            self.axisStamps[ axisID ] = struct.unpack_from( AXIS_STAMP_FORMAT, messageBuffer, axisDataOffset + 1 + AXIS_VARS_NUMBER * FLOAT_SIZE )
+          axisDataOffset += 1 + AXIS_DATA_SIZE
 
     return measures
 
+  # Round trip time and server clock offset (nanoseconds), from the best of several probes. Measures received meanwhile are dropped
+  def ProbeLatency( self, probesNumber=10, probeTimeout=1.0 ):
+    bestRoundTrip = None
+    if self.isConnected:
+      self.axisSocket.settimeout( probeTimeout )
+      try:
+        for probeIndex in range( probesNumber ):
+          sendTime = time.monotonic_ns()
+          self.axisSocket.send( FrameMessage( struct.pack( '=BQ', AXIS_PROBE_REQUEST, sendTime ) ) )
+          isReplied = False
+          while not isReplied:
+            for messageBuffer in ReceiveDatagramMessages( self.axisSocket ):
+              if len( messageBuffer ) < 25 or messageBuffer[ 0 ] != AXIS_PROBE_REQUEST: continue
+              clientTime, serverReadTime, serverSendTime = struct.unpack_from( '=QQQ', messageBuffer, 1 )
+              if clientTime != sendTime: continue
+              receiveTime = time.monotonic_ns()
+              roundTrip = ( receiveTime - sendTime ) - ( serverSendTime - serverReadTime )
+              if bestRoundTrip is None or roundTrip < bestRoundTrip:
+                bestRoundTrip = roundTrip
+                self.clockOffset = ( ( serverReadTime - sendTime ) + ( serverSendTime - receiveTime ) ) // 2
+              isReplied = True
+      except timeout:
+        pass
+      finally:
+        self.axisSocket.settimeout( None )
+
+    return ( bestRoundTrip, self.clockOffset )
+
+  # Latest measures stamp of the axis: ( measures age, setpoints sending to actuation time ), in nanoseconds
+  # (client clock, corrected by the offset of the last probe)
+  def GetAxisLatencies( self, axisID ):
+    stamp = self.axisStamps.get( axisID )
+    if stamp is None: return ( None, None )
+    setpointsTag, captureTime, actuationTime, sequenceNumber = stamp
+    measuresAge = time.monotonic_ns() - ( captureTime - self.clockOffset )
+    setpointsLatency = None
+    if setpointsTag in self.setpointsSendTimes and actuationTime > 0:
+      setpointsLatency = ( actuationTime - self.clockOffset ) - self.setpointsSendTimes[ setpointsTag ]
+    return ( measuresAge, setpointsLatency )
+
   def SendJointData( self, jointID, position, stiffness ):
     if self.isConnected:
       messageBuffer = bytearray( 3 )
@@ -103,18 +306,52 @@ class ClientConnection:
       messageBuffer[ 2 ] = int( '00000101', 2 )
       for setpoint in [ position, 0.0, stiffness, 0.0, 0.0, 0.0, 0.0 ]:
         messageBuffer += struct.pack( 'f', setpoint )
-      self.jointSocket.send( messageBuffer )
+      self.jointSocket.send( FrameMessage( messageBuffer ) )
 
   def ReceiveJointData( self, jointID ):
     measures = [ 0.0 for var in range( JOINT_VARS_NUMBER ) ]
     if self.isConnected:
-      messageBuffer = self.jointSocket.recv( BUFFER_SIZE )
-      jointsNumber = messageBuffer[ 0 ]
-      for jointIndex in range( jointsNumber ):
-        jointDataOffset = jointIndex * JOINT_DATA_SIZE + 1
-        if messageBuffer[ jointDataOffset ] == jointID:
-          for measureIndex in range( JOINT_VARS_NUMBER ):
-            jointMeasureOffset = jointDataOffset + measureIndex * FLOAT_SIZE
-            measures[ measureIndex ] = struct.unpack_from( 'f', messageBuffer, jointMeasureOffset )[ 0 ]
+      for messageBuffer in ReceiveDatagramMessages( self.jointSocket ):
+        jointsNumber = messageBuffer[ 0 ]
+        for jointIndex in range( jointsNumber ):
+          jointDataOffset = jointIndex * JOINT_DATA_SIZE + 1
+          if messageBuffer[ jointDataOffset ] == jointID:
+            for measureIndex in range( JOINT_VARS_NUMBER ):
+              jointMeasureOffset = jointDataOffset + measureIndex * FLOAT_SIZE
+              measures[ measureIndex ] = struct.unpack_from( 'f', messageBuffer, jointMeasureOffset )[ 0 ]
 
     return measures
+
+# Observer of the measures of all axes, published by the server on a multicast group
+class MeasuresSubscriber:
+
+  def __init__( self, group=MULTICAST_GROUP, port=MULTICAST_PORT ):
+    self.measuresSocket = socket( AF_INET, SOCK_DGRAM )
+    self.measuresSocket.setsockopt( SOL_SOCKET, SO_REUSEADDR, 1 )
+    self.measuresSocket.bind( ( '', port ) )
+    membershipRequest = inet_aton( group ) + inet_aton( '0.0.0.0' )
+    self.measuresSocket.setsockopt( IPPROTO_IP, IP_ADD_MEMBERSHIP, membershipRequest )
+
+    self.sequenceNumber = 0
+    self.axesMeasures = {}
+
+  def __del__( self ):
+    self.measuresSocket.close()
+
+  # Latest measures of each published axis, and the update sequence number. Messages from older updates are discarded
+  def ReceiveAxesData( self ):
+    for messageBuffer in ReceiveDatagramMessages( self.measuresSocket ):
+      if len( messageBuffer ) < SEQUENCE_SIZE + 1: continue
+      sequenceNumber = struct.unpack_from( 'I', messageBuffer, 0 )[ 0 ]
+      # Sequence may wrap around
+      if ( ( sequenceNumber - self.sequenceNumber ) & 0xFFFFFFFF ) >= 0x80000000: continue
+      self.sequenceNumber = sequenceNumber
+      axesNumber = messageBuffer[ SEQUENCE_SIZE ]
+      axisDataOffset = SEQUENCE_SIZE + 1
+      for axisIndex in range( axesNumber ):
+        if axisDataOffset + 1 + AXIS_DATA_SIZE > len( messageBuffer ): break
+        axisID = messageBuffer[ axisDataOffset ]
+        self.axesMeasures[ axisID ] = list( struct.unpack_from( '%df' % AXIS_VARS_NUMBER, messageBuffer, axisDataOffset + 1 ) )
+        axisDataOffset += 1 + AXIS_DATA_SIZE
+
+    return ( self.sequenceNumber, self.axesMeasures )
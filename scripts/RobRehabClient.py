@@ -0,0 +1,129 @@
+#-*-coding:cp1252-*-
+
+# Bindings of the native client library (libRobRehabClient, see src/robrehab_client.h). Connect waits for the server
+# connection (up to 5 s). Other calls don't block: messages are queued for the library network threads, and measures
+# callbacks run on its dispatch thread
+
+from ctypes import *
+
+import os
+import sys
+
+DEFAULT_PORT = 50000
+
+AXIS_VARS_NUMBER = 7
+AXIS_FIELDS_ALL = ( 1 << ( AXIS_VARS_NUMBER + 4 ) ) - 1
+AXIS_QUANTIZATION_NONE, AXIS_QUANTIZATION_HALF, AXIS_QUANTIZATION_FIXED = range( 3 )
+
+INFO_MAX_LENGTH = 512
+
+class AxisBlock( Structure ):
+  _pack_ = 1
+  _fields_ = [ ( 'valuesList', c_float * AXIS_VARS_NUMBER ), ( 'setpointsTag', c_uint32 ), ( 'timestamp', c_uint64 ),
+               ( 'actuationTime', c_uint64 ), ( 'sequenceNumber', c_uint64 ) ]
+
+class LatencyStats( Structure ):
+  _fields_ = [ ( 'probesCount', c_uint64 ), ( 'repliesCount', c_uint64 ), ( 'lastRoundTrip', c_uint64 ),
+               ( 'minRoundTrip', c_uint64 ), ( 'maxRoundTrip', c_uint64 ), ( 'meanRoundTrip', c_double ),
+               ( 'roundTripJitter', c_double ), ( 'clockOffset', c_int64 ) ]
+
+class AxisLatencies( Structure ):
+  _fields_ = [ ( 'measuresAge', c_uint64 ), ( 'setpointsLatency', c_uint64 ) ]
+
+MeasuresCallback = CFUNCTYPE( None, c_uint, POINTER( AxisBlock ), c_void_p )
+
+def LoadLibrary( libraryPath=None ):
+  if libraryPath is None:
+    libraryName = 'RobRehabClient.dll' if sys.platform == 'win32' else 'libRobRehabClient.so'
+    libraryPath = os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), '..', libraryName )
+  library = CDLL( libraryPath )
+
+  functionsList = [ ( 'Connect', c_void_p, [ c_char_p, c_uint16 ] ),
+                    ( 'Disconnect', None, [ c_void_p ] ),
+                    ( 'SetMeasuresCallback', None, [ c_void_p, MeasuresCallback, c_void_p ] ),
+                    ( 'SubscribeAxes', c_bool, [ c_void_p, POINTER( c_uint8 ), c_size_t, c_uint16, c_uint8, c_float, c_uint8 ] ),
+                    ( 'SetAxisSetpoints', c_bool, [ c_void_p, c_uint, POINTER( c_float ), c_uint8 ] ),
+                    ( 'SendSetpoints', c_bool, [ c_void_p ] ),
+                    ( 'GetAxisMeasures', c_bool, [ c_void_p, c_uint, POINTER( AxisBlock ) ] ),
+                    ( 'GetAxisLatencies', c_bool, [ c_void_p, c_uint, POINTER( AxisLatencies ) ] ),
+                    ( 'ProbeLatency', c_bool, [ c_void_p ] ),
+                    ( 'SetProbeInterval', None, [ c_void_p, c_uint ] ),
+                    ( 'GetLatencyStats', None, [ c_void_p, POINTER( LatencyStats ) ] ),
+                    ( 'RequestInfo', c_bool, [ c_void_p ] ),
+                    ( 'GetInfo', c_size_t, [ c_void_p, c_char_p, c_size_t ] ) ]
+  for functionName, resultType, argumentTypes in functionsList:
+    function = getattr( library, 'RobRehabClient_' + functionName )
+    function.restype = resultType
+    function.argtypes = argumentTypes
+
+  return library
+
+class ClientConnection:
+
+  def __init__( self, library=None ):
+    self.library = library if library is not None else LoadLibrary()
+    self.connection = None
+    # Kept referenced for as long as the library may call it
+    self.measuresCallback = None
+
+  def __del__( self ):
+    self.Disconnect()
+
+  def Connect( self, host, basePort=DEFAULT_PORT ):
+    self.connection = self.library.RobRehabClient_Connect( host.encode(), basePort )
+    return self.connection is not None
+
+  def Disconnect( self ):
+    if self.connection is not None:
+      self.library.RobRehabClient_Disconnect( self.connection )
+      self.connection = None
+
+  # Callback arguments: axis index, measures list and stamp ( setpoints tag, capture time, actuation time, sequence number )
+  def SetMeasuresCallback( self, callback ):
+    def CallbackWrapper( axisIndex, measures, userData ):
+      block = measures.contents
+      callback( axisIndex, list( block.valuesList ), ( block.setpointsTag, block.timestamp, block.actuationTime, block.sequenceNumber ) )
+    self.measuresCallback = MeasuresCallback( CallbackWrapper ) if callback is not None else MeasuresCallback()
+    self.library.RobRehabClient_SetMeasuresCallback( self.connection, self.measuresCallback, None )
+
+  def SubscribeAxes( self, axesList, fieldsMask=AXIS_FIELDS_ALL, quantization=AXIS_QUANTIZATION_NONE, fixedResolution=0.0, keyframeInterval=50 ):
+    axesArray = ( c_uint8 * len( axesList ) )( *axesList )
+    return self.library.RobRehabClient_SubscribeAxes( self.connection, axesArray, len( axesList ), fieldsMask, quantization, fixedResolution, keyframeInterval )
+
+  # Setpoints of several axes go in a single message: stage each one with SetAxisSetpoints, then call SendSetpoints
+  def SetAxisSetpoints( self, axisIndex, setpointsList, mask ):
+    valuesArray = ( c_float * AXIS_VARS_NUMBER )( *( list( setpointsList ) + [ 0.0 ] * AXIS_VARS_NUMBER )[ :AXIS_VARS_NUMBER ] )
+    return self.library.RobRehabClient_SetAxisSetpoints( self.connection, axisIndex, valuesArray, mask )
+
+  def SendSetpoints( self ):
+    return self.library.RobRehabClient_SendSetpoints( self.connection )
+
+  def GetAxisMeasures( self, axisIndex ):
+    block = AxisBlock()
+    if not self.library.RobRehabClient_GetAxisMeasures( self.connection, axisIndex, byref( block ) ): return None
+    return list( block.valuesList )
+
+  # ( measures age, setpoints sending to actuation time ), in nanoseconds (0 if unknown)
+  def GetAxisLatencies( self, axisIndex ):
+    latencies = AxisLatencies()
+    if not self.library.RobRehabClient_GetAxisLatencies( self.connection, axisIndex, byref( latencies ) ): return ( None, None )
+    return ( latencies.measuresAge, latencies.setpointsLatency )
+
+  def ProbeLatency( self ):
+    return self.library.RobRehabClient_ProbeLatency( self.connection )
+
+  def SetProbeInterval( self, intervalMs ):
+    self.library.RobRehabClient_SetProbeInterval( self.connection, intervalMs )
+
+  def GetLatencyStats( self ):
+    stats = LatencyStats()
+    self.library.RobRehabClient_GetLatencyStats( self.connection, byref( stats ) )
+    return { fieldName: getattr( stats, fieldName ) for fieldName, fieldType in LatencyStats._fields_ }
+
+  def RequestInfo( self ):
+    return self.library.RobRehabClient_RequestInfo( self.connection )
+
+  def GetInfo( self ):
+    infoBuffer = create_string_buffer( INFO_MAX_LENGTH )
+    infoLength = self.library.RobRehabClient_GetInfo( self.connection, infoBuffer, INFO_MAX_LENGTH )
+    return infoBuffer.value.decode() if infoLength > 0 else None
@@ -83,8 +83,9 @@ SHMController sharedRobotJointsInfo;
 SHMController sharedRobotAxesData;
 SHMController sharedRobotJointsData;
 
-char robotAxesInfo[ SHM_CONTROL_MAX_DATA_SIZE ] = "";
-char robotJointsInfo[ SHM_CONTROL_MAX_DATA_SIZE ] = "";
+#define ROBOT_INFO_DATA_SIZE ( ROBOT_INFO_BLOCKS_NUMBER * ROBOT_INFO_BLOCK_SIZE )
+char robotAxesInfo[ ROBOT_INFO_DATA_SIZE ] = "";
+char robotJointsInfo[ ROBOT_INFO_DATA_SIZE ] = "";
 
 Thread dataConnectionThreadID = THREAD_INVALID_HANDLE;
 bool isDataUpdateRunning = false;
@@ -136,7 +137,8 @@ static void* UpdateData( void* callbackData )
   const size_t WAIT_SAMPLES = 2;
   const double SETPOINT_UPDATE_INTERVAL = WAIT_SAMPLES * CONTROL_PASS_INTERVAL;
   
-  uint8_t measureData[ SHM_CONTROL_MAX_DATA_SIZE ], setpointData[ SHM_CONTROL_MAX_DATA_SIZE ];
+  SHMAxisBlock axisMeasures;
+  uint8_t jointMeasureData[ JOINT_DATA_BLOCK_SIZE ], setpointData[ AXIS_DATA_BLOCK_SIZE ];
   
   double positionValues[ DISPLAY_POINTS_NUMBER ], velocityValues[ DISPLAY_POINTS_NUMBER ];
   double torqueValues[ DISPLAY_POINTS_NUMBER ], angleValues[ DISPLAY_POINTS_NUMBER ];
@@ -162,9 +164,9 @@ static void* UpdateData( void* callbackData )
       measureTime = 0.0;
     }
 
-    float* measuresList = (float*) measureData;
+    float* measuresList = axisMeasures.valuesList;
     
-    SHMControl.GetData( sharedRobotAxesData, (void*) measureData, 0, SHM_CONTROL_MAX_DATA_SIZE );
+    SHMControl.GetData( sharedRobotAxesData, (void*) &axisMeasures, 0, AXIS_DATA_BLOCK_SIZE );
     
     if( displayPointIndex >= DISPLAY_POINTS_NUMBER )
     {
@@ -216,10 +218,12 @@ static void* UpdateData( void* callbackData )
 
     SetCtrlVal( panel, PANEL_MEASURE_SLIDER, measuresList[ SHM_AXIS_POSITION ] * 360.0 );
     
-    SHMControl.GetData( sharedRobotJointsData, (void*) measureData, 0, SHM_CONTROL_MAX_DATA_SIZE );
+    float* jointMeasuresList = (float*) jointMeasureData;
+    
+    SHMControl.GetData( sharedRobotJointsData, (void*) jointMeasureData, 0, JOINT_DATA_BLOCK_SIZE );
 
-    angleValues[ displayPointIndex ] = measuresList[ SHM_JOINT_POSITION ];
-    torqueValues[ displayPointIndex ] = measuresList[ SHM_JOINT_FORCE ];
+    angleValues[ displayPointIndex ] = jointMeasuresList[ SHM_JOINT_POSITION ];
+    torqueValues[ displayPointIndex ] = jointMeasuresList[ SHM_JOINT_FORCE ];
 
     float* setpointsList = (float*) setpointData;
 
@@ -250,7 +254,7 @@ static void* UpdateData( void* callbackData )
 
       setpointTime = 0.0;
 
-      SHMControl.SetData( sharedRobotAxesData, (void*) setpointData, 0, SHM_CONTROL_MAX_DATA_SIZE );
+      SHMControl.SetData( sharedRobotAxesData, (void*) setpointData, 0, AXIS_DATA_BLOCK_SIZE );
       SHMControl.SetControlByte( sharedRobotAxesData, 0, setpointMask );
     }
 
@@ -293,16 +297,16 @@ int CVICALLBACK ConnectCallback( int panel, int control, int event, void* callba
       
       SetCtrlVal( panel, PANEL_MOTOR_TOGGLE, 1 );
       
-      sharedRobotAxesInfo = SHMControl.InitData( "192.168.0.181:robot_axes_info", SHM_CONTROL_OUT );
-      sharedRobotJointsInfo = SHMControl.InitData( "192.168.0.181:robot_joints_info", SHM_CONTROL_OUT );
-      sharedRobotAxesData = SHMControl.InitData( "192.168.0.181:robot_axes_data", SHM_CONTROL_OUT );
-      sharedRobotJointsData = SHMControl.InitData( "192.168.0.181:robot_joints_data", SHM_CONTROL_OUT );
+      sharedRobotAxesInfo = SHMControl.InitData( "192.168.0.181:robot_axes_info", SHM_CONTROL_OUT, ROBOT_INFO_BLOCKS_NUMBER, ROBOT_INFO_BLOCK_SIZE, 8 );
+      sharedRobotJointsInfo = SHMControl.InitData( "192.168.0.181:robot_joints_info", SHM_CONTROL_OUT, ROBOT_INFO_BLOCKS_NUMBER, ROBOT_INFO_BLOCK_SIZE, 8 );
+      sharedRobotAxesData = SHMControl.InitData( "192.168.0.181:robot_axes_data", SHM_CONTROL_OUT, AXIS_DATA_BLOCKS_NUMBER, AXIS_DATA_BLOCK_SIZE, SHM_AXIS_FLOATS_NUMBER );
+      sharedRobotJointsData = SHMControl.InitData( "192.168.0.181:robot_joints_data", SHM_CONTROL_OUT, JOINT_DATA_BLOCKS_NUMBER, JOINT_DATA_BLOCK_SIZE, SHM_JOINT_FLOATS_NUMBER );
       
       SHMControl.SetControlByte( sharedRobotAxesInfo, 0, ++listRequestsCount );
       
-      SHMControl.GetData( sharedRobotAxesInfo, (void*) robotAxesInfo, 0, SHM_CONTROL_MAX_DATA_SIZE );
+      SHMControl.GetData( sharedRobotAxesInfo, (void*) robotAxesInfo, 0, ROBOT_INFO_DATA_SIZE );
       fprintf( stderr, "Read shared axes info: %s\n", robotAxesInfo );
-      SHMControl.GetData( sharedRobotJointsInfo, (void*) robotJointsInfo, 0, SHM_CONTROL_MAX_DATA_SIZE );
+      SHMControl.GetData( sharedRobotJointsInfo, (void*) robotJointsInfo, 0, ROBOT_INFO_DATA_SIZE );
       fprintf( stderr, "Read shared joints info: %s\n", robotJointsInfo );
       
       if( dataConnectionThreadID == THREAD_INVALID_HANDLE )
@@ -366,10 +370,10 @@ int CVICALLBACK InsertUserNameCallback( int panel, int control, int event, void
     if( control == PANEL_USER_NAME_INPUT )
     {
       // Get the new value
-      char userName[ SHM_CONTROL_MAX_DATA_SIZE ];
+      char userName[ ROBOT_INFO_BLOCK_SIZE ] = "";
       GetCtrlVal( panel, control, userName );
       SHMControl.SetControlByte( sharedRobotJointsInfo, 0, SHM_ROBOT_SET_USER );
-      SHMControl.SetData( sharedRobotJointsInfo, (void*) userName, 0, SHM_CONTROL_MAX_DATA_SIZE );
+      SHMControl.SetData( sharedRobotJointsInfo, (void*) userName, 0, ROBOT_INFO_BLOCK_SIZE );
     }
 	}
 	return 0;
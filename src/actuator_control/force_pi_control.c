@@ -22,7 +22,7 @@ Controller InitController( void )
   return (Controller) newController;
 }
 
-double* RunControlStep( Controller controller, double* measuresList, double* setpointsList, double* ref_error )
+double* RunControlStep( Controller controller, double* measuresList, double* setpointsList, double* ref_error, double timeDelta )
 {
   const double K_P = 370;//1.6527; // 370 * ( F_in_max / V_out_max )
   const double K_I = 3.5;//0.0156; // 3.5 * ( F_in_max / V_out_max )
@@ -32,8 +32,8 @@ double* RunControlStep( Controller controller, double* measuresList, double* set
   controlData->outputsList[ CONTROL_POSITION ] = setpointsList[ CONTROL_POSITION ];
   
   double positionError = measuresList[ CONTROL_POSITION ] - setpointsList[ CONTROL_POSITION ];
-  controlData->positionErrorSum += CONTROL_PASS_INTERVAL * positionError * positionError;
-  controlData->positionSetpointSum += CONTROL_PASS_INTERVAL * setpointsList[ CONTROL_POSITION ] * setpointsList[ CONTROL_POSITION ];
+  controlData->positionErrorSum += timeDelta * positionError * positionError;
+  controlData->positionSetpointSum += timeDelta * setpointsList[ CONTROL_POSITION ] * setpointsList[ CONTROL_POSITION ];
   
   if( ref_error != NULL )
   {
@@ -54,7 +54,7 @@ double* RunControlStep( Controller controller, double* measuresList, double* set
 
   controlData->forceError[ 0 ] = forceSetpoint - measuresList[ CONTROL_FORCE ];
   
-  controlData->velocitySetpoint += K_P * ( controlData->forceError[ 0 ] - controlData->forceError[ 1 ] ) + K_I * CONTROL_PASS_INTERVAL * controlData->forceError[ 0 ];
+  controlData->velocitySetpoint += K_P * ( controlData->forceError[ 0 ] - controlData->forceError[ 1 ] ) + K_I * timeDelta * controlData->forceError[ 0 ];
   controlData->outputsList[ CONTROL_VELOCITY ] = controlData->velocitySetpoint;
   
   //velocitySetpoint[0] = 0.9822 * velocitySetpoint[1] + 0.01407 * velocitySetpoint[2] + 338.6 * forceError[1] - 337.4 * forceError[2]; //5ms
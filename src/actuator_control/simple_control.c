@@ -18,7 +18,7 @@ Controller InitController( void )
   return (Controller) newController;
 }
 
-double* RunControlStep( Controller controller, double* measuresList, double* setpointsList, double* ref_error )
+double* RunControlStep( Controller controller, double* measuresList, double* setpointsList, double* ref_error, double timeDelta )
 { 
   if( controller == NULL ) return NULL;
   
@@ -20,6 +20,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 
+#include <math.h>
+
 #include "configuration.h"
 
 #include "motors.h"
@@ -35,6 +37,8 @@
 
 #include "actuators.h"
 
+// Measured intervals jitter around the control period: filter couplings are only updated on changes bigger than this (relative)
+#define FILTER_TIME_DELTA_TOLERANCE 0.01
 
 struct _ActuatorData
 {
@@ -46,9 +50,12 @@ struct _ActuatorData
   Sensor* sensorsList;
   size_t sensorsNumber;
   KalmanFilter sensorFilter;
+  double filterTimeDelta;
   ControlVariablesList measuresList;
+  Timestamp measuresTime;                      // Sensors read time of the last measures update
   ControlVariablesList setpointsList;
   double controlError;
+  double controlOutput;
   int logID;
 };
 
@@ -56,6 +63,18 @@ DEFINE_NAMESPACE_INTERFACE( Actuators, ACTUATOR_INTERFACE )
 
 
 const char* CONTROL_MODE_NAMES[ CONTROL_MODES_NUMBER ] = { "POSITION", "VELOCITY", "FORCE", "ACCELERATION" };
+// Update kinematic couplings of the measures filter for the given sampling interval
+static void SetFilterTimeDelta( Actuator actuator, double timeDelta )
+{
+  if( fabs( timeDelta - actuator->filterTimeDelta ) <= FILTER_TIME_DELTA_TOLERANCE * actuator->filterTimeDelta ) return;
+  
+  Kalman.SetVariablesCoupling( actuator->sensorFilter, CONTROL_POSITION, CONTROL_VELOCITY, timeDelta );
+  Kalman.SetVariablesCoupling( actuator->sensorFilter, CONTROL_POSITION, CONTROL_ACCELERATION, timeDelta * timeDelta / 2.0 );
+  Kalman.SetVariablesCoupling( actuator->sensorFilter, CONTROL_VELOCITY, CONTROL_ACCELERATION, timeDelta );
+  
+  actuator->filterTimeDelta = timeDelta;
+}
+
 Actuator Actuators_Init( const char* configFileName )
 {
   char filePath[ DATA_IO_MAX_FILE_PATH_LENGTH ];
@@ -76,9 +95,7 @@ Actuator Actuators_Init( const char* configFileName )
     if( (newActuator->sensorsNumber = Configuration.GetIOHandler()->GetListSize( configFileID, "sensors" )) > 0 )
     {
       newActuator->sensorFilter = Kalman.CreateFilter( CONTROL_MODES_NUMBER );
-      Kalman.SetVariablesCoupling( newActuator->sensorFilter, CONTROL_POSITION, CONTROL_VELOCITY, CONTROL_PASS_INTERVAL );
-      Kalman.SetVariablesCoupling( newActuator->sensorFilter, CONTROL_POSITION, CONTROL_ACCELERATION, CONTROL_PASS_INTERVAL * CONTROL_PASS_INTERVAL / 2.0 );
-      Kalman.SetVariablesCoupling( newActuator->sensorFilter, CONTROL_VELOCITY, CONTROL_ACCELERATION, CONTROL_PASS_INTERVAL );
+      SetFilterTimeDelta( newActuator, CONTROL_PASS_INTERVAL );
       
       newActuator->sensorsList = (Sensor*) calloc( newActuator->sensorsNumber, sizeof(Sensor) );
       for( size_t sensorIndex = 0; sensorIndex < newActuator->sensorsNumber; sensorIndex++ )
@@ -228,12 +245,16 @@ double Actuators_SetSetpoint( Actuator actuator, enum ControlVariable variable,
   return actuator->setpointsList[ variable ];
 }
 
-double* Actuators_UpdateMeasures( Actuator actuator, double* measuresBuffer )
+// Read sensors and filter measures sampled after the given time interval (in seconds) since the last update
+double* Actuators_UpdateMeasures( Actuator actuator, double* measuresBuffer, double timeDelta )
 {
   if( actuator == NULL ) return NULL;
   
+  if( actuator->sensorFilter != NULL && timeDelta > 0.0 ) SetFilterTimeDelta( actuator, timeDelta );
+  
   DEBUG_UPDATE( "reading measures from actuator %p", actuator );
   
+  actuator->measuresTime = Timing.GetExecTimeNanoseconds();
   for( size_t sensorIndex = 0; sensorIndex < actuator->sensorsNumber; sensorIndex++ )
   {
     double sensorMeasure = Sensors.Update( actuator->sensorsList[ sensorIndex ], NULL );
@@ -254,7 +275,26 @@ double* Actuators_UpdateMeasures( Actuator actuator, double* measuresBuffer )
   return measuresBuffer;
 }
 
-double Actuators_RunControl( Actuator actuator, double* measuresList, double* setpointsList )
+// Monotonic time of the sensors read for the current measures (TIMESTAMP_INVALID before the first update)
+Timestamp Actuators_GetMeasuresTime( Actuator actuator )
+{
+  if( actuator == NULL ) return TIMESTAMP_INVALID;
+  
+  return actuator->measuresTime;
+}
+
+// Run actuator controller and write its output to the motor
+double Actuators_RunControl( Actuator actuator, double* measuresList, double* setpointsList, double timeDelta )
+{
+  double controlOutput = Actuators_ComputeControl( actuator, measuresList, setpointsList, timeDelta );
+  
+  Actuators_FlushControl( actuator );
+  
+  return controlOutput;
+}
+
+// Run actuator controller, keeping its output for a later (batched) motor write
+double Actuators_ComputeControl( Actuator actuator, double* measuresList, double* setpointsList, double timeDelta )
 {
   if( actuator == NULL ) return 0.0;
   
@@ -266,19 +306,27 @@ double Actuators_RunControl( Actuator actuator, double* measuresList, double* se
   
   //DEBUG_PRINT( "got parameters: %.5f %.5f", actuator->setpoints[ CONTROL_POSITION ], actuator->setpoints[ CONTROL_VELOCITY ] );
   
-  double* controlOutputsList = (double*) actuator->RunControlStep( actuator->controller, measuresList, setpointsList, &(actuator->controlError) );
+  double* controlOutputsList = (double*) actuator->RunControlStep( actuator->controller, measuresList, setpointsList, &(actuator->controlError), timeDelta );
   
   if( actuator->logID != DATA_LOG_INVALID_ID ) 
   {
-    DataLogging.RegisterValues( actuator->logID, 9, Timing.GetExecTimeSeconds(), 
+    DataLogging.RegisterValues( actuator->logID, 9, TIMESTAMP_TO_SECONDS( Timing.GetExecTimeNanoseconds() ), 
                                                     measuresList[ CONTROL_POSITION ], measuresList[ CONTROL_VELOCITY ], measuresList[ CONTROL_FORCE ],
                                                     setpointsList[ CONTROL_POSITION ], setpointsList[ CONTROL_VELOCITY ], setpointsList[ CONTROL_FORCE ],
                                                     actuator->controlError, controlOutputsList[ actuator->controlMode ] );
   }
   
+  actuator->controlOutput = controlOutputsList[ actuator->controlMode ];
+  
+  return actuator->controlOutput;
+}
+
+// Write the last computed control output
+void Actuators_FlushControl( Actuator actuator )
+{
+  if( actuator == NULL ) return;
+  
   // If the motor is being actually controlled, write its control output
   if( Motors.IsEnabled( actuator->motor ) && actuator->controlState != CONTROL_OFFSET ) 
-    Motors.WriteControl( actuator->motor, controlOutputsList[ actuator->controlMode ] );
-  
-  return controlOutputsList[ actuator->controlMode ];
+    Motors.WriteControl( actuator->motor, actuator->controlOutput );
 }
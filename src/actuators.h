@@ -5,6 +5,8 @@
 
 #include "control_definitions.h"
 
+#include "time/timing.h"
+
 
 typedef struct _ActuatorData ActuatorData;
 typedef ActuatorData* Actuator;
@@ -19,8 +21,11 @@ typedef ActuatorData* Actuator;
         INIT_FUNCTION( bool, Namespace, IsEnabled, Actuator ) \
         INIT_FUNCTION( bool, Namespace, HasError, Actuator ) \
         INIT_FUNCTION( double, Namespace, SetSetpoint, Actuator, enum ControlVariable, double ) \
-        INIT_FUNCTION( double*, Namespace, UpdateMeasures, Actuator, double* ) \
-        INIT_FUNCTION( double, Namespace, RunControl, Actuator, double*, double* )
+        INIT_FUNCTION( double*, Namespace, UpdateMeasures, Actuator, double*, double ) \
+        INIT_FUNCTION( Timestamp, Namespace, GetMeasuresTime, Actuator ) \
+        INIT_FUNCTION( double, Namespace, RunControl, Actuator, double*, double*, double ) \
+        INIT_FUNCTION( double, Namespace, ComputeControl, Actuator, double*, double*, double ) \
+        INIT_FUNCTION( void, Namespace, FlushControl, Actuator )
 
 DECLARE_NAMESPACE_INTERFACE( Actuators, ACTUATOR_INTERFACE )
 
@@ -0,0 +1,503 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (c) 2016 Leonardo José Consoni                                  //
+//                                                                            //
+//  This file is part of RobRehabSystem.                                      //
+//                                                                            //
+//  RobRehabSystem is free software: you can redistribute it and/or modify    //
+//  it under the terms of the GNU Lesser General Public License as published  //
+//  by the Free Software Foundation, either version 3 of the License, or      //
+//  (at your option) any later version.                                       //
+//                                                                            //
+//  RobRehabSystem is distributed in the hope that it will be useful,         //
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of            //
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              //
+//  GNU Lesser General Public License for more details.                       //
+//                                                                            //
+//  You should have received a copy of the GNU Lesser General Public License  //
+//  along with RobRehabSystem. If not, see <http://www.gnu.org/licenses/>.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "axis_packets.h"
+
+
+// Quantized values (integers of up to 64 bits) of the subscribed axes fields, in subscription order
+typedef struct _FrameData
+{
+  uint32_t number;
+  uint8_t axesMask;                   // Subscription positions of the axes already sent/received up to this frame
+  uint64_t valuesList[ AXIS_PACKETS_MAX_AXES ][ AXIS_FIELDS_NUMBER ];
+}
+FrameData;
+
+struct _AxisPacketsCoderData
+{
+  AxisPacketsSettings settings;
+  FrameData historyList[ AXIS_PACKETS_HISTORY_LENGTH ];
+  uint32_t lastFrameNumber;
+  uint32_t keyframeNumber;
+  uint32_t acknowledgedFrameNumber;
+};
+
+// Packet bytes cursor. Bounds are checked on every access: running out of space only sets a flag
+typedef struct _PacketCursor
+{
+  uint8_t* data;
+  size_t length;
+  size_t position;
+  bool isOverflowed;
+}
+PacketCursor;
+
+
+DEFINE_NAMESPACE_INTERFACE( AxisPackets, AXIS_PACKETS_INTERFACE )
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////                                 VALUES PACKING                                /////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Multi-byte values are little endian
+static void WriteInteger( PacketCursor* cursor, uint64_t value, size_t bytesNumber )
+{
+  if( cursor->position + bytesNumber > cursor->length ) cursor->isOverflowed = true;
+  if( cursor->isOverflowed ) return;
+
+  for( size_t byteIndex = 0; byteIndex < bytesNumber; byteIndex++ )
+    cursor->data[ cursor->position++ ] = (uint8_t) ( value >> ( 8 * byteIndex ) );
+}
+
+static uint64_t ReadInteger( PacketCursor* cursor, size_t bytesNumber )
+{
+  if( cursor->position + bytesNumber > cursor->length ) cursor->isOverflowed = true;
+  if( cursor->isOverflowed ) return 0;
+
+  uint64_t value = 0;
+  for( size_t byteIndex = 0; byteIndex < bytesNumber; byteIndex++ )
+    value |= ( (uint64_t) cursor->data[ cursor->position++ ] ) << ( 8 * byteIndex );
+
+  return value;
+}
+
+// Signed differences are zigzag mapped (small magnitudes to small codes) and written 7 bits per byte
+static void WriteDifference( PacketCursor* cursor, uint64_t difference )
+{
+  uint64_t code = ( difference << 1 ) ^ (uint64_t) ( ( (int64_t) difference ) >> 63 );
+
+  do
+  {
+    uint8_t codeByte = (uint8_t) ( code & 0x7F );
+    code >>= 7;
+    WriteInteger( cursor, ( code > 0 ) ? ( codeByte | 0x80 ) : codeByte, 1 );
+  } while( code > 0 && !cursor->isOverflowed );
+}
+
+static uint64_t ReadDifference( PacketCursor* cursor )
+{
+  uint64_t code = 0;
+  for( size_t shift = 0; shift < 64 && !cursor->isOverflowed; shift += 7 )
+  {
+    uint8_t codeByte = (uint8_t) ReadInteger( cursor, 1 );
+    code |= ( (uint64_t) ( codeByte & 0x7F ) ) << shift;
+    if( !( codeByte & 0x80 ) ) break;
+  }
+
+  return ( code >> 1 ) ^ ( ~( code & 1 ) + 1 );
+}
+
+static uint16_t FloatToHalf( float value )
+{
+  uint32_t bits;
+  memcpy( &bits, &value, sizeof(float) );
+
+  uint16_t sign = (uint16_t) ( ( bits >> 16 ) & 0x8000 );
+  int32_t floatExponent = (int32_t) ( ( bits >> 23 ) & 0xFF );
+  int32_t exponent = floatExponent - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if( floatExponent == 0xFF ) return sign | 0x7C00 | ( ( mantissa != 0 ) ? 0x200 : 0 );   // Infinity or NaN
+  if( exponent >= 0x1F ) return sign | 0x7C00;                                            // Overflow (infinity)
+  if( exponent <= 0 )                                                                     // Subnormal or zero
+  {
+    if( exponent < -10 ) return sign;
+    mantissa |= 0x800000;
+    uint32_t shift = (uint32_t) ( 14 - exponent );
+    uint16_t halfMantissa = (uint16_t) ( mantissa >> shift );
+    if( ( mantissa >> ( shift - 1 ) ) & 1 ) halfMantissa++;
+    return sign | halfMantissa;
+  }
+
+  // Rounding may carry into the exponent, which is still the correct result
+  uint16_t half = sign | (uint16_t) ( exponent << 10 ) | (uint16_t) ( mantissa >> 13 );
+  if( mantissa & 0x1000 ) half++;
+
+  return half;
+}
+
+static float HalfToFloat( uint16_t half )
+{
+  uint32_t sign = ( (uint32_t) half & 0x8000 ) << 16;
+  uint32_t exponent = ( half >> 10 ) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+
+  if( exponent == 0 )
+  {
+    float value = (float) mantissa / 16777216.0f;     // mantissa * 2^-24
+    return sign ? -value : value;
+  }
+
+  uint32_t bits = sign | ( ( exponent == 0x1F ) ? 0x7F800000 : ( ( exponent - 15 + 127 ) << 23 ) ) | ( mantissa << 13 );
+  float value;
+  memcpy( &value, &bits, sizeof(float) );
+
+  return value;
+}
+
+static inline bool IsFloatField( size_t fieldIndex ) { return ( fieldIndex < SHM_AXIS_FLOATS_NUMBER ); }
+
+// Bytes of fields written with fixed width (keyframe values and delta float values without fixed point quantization)
+static size_t GetFieldWidth( const AxisPacketsSettings* settings, size_t fieldIndex )
+{
+  if( IsFloatField( fieldIndex ) ) return ( settings->quantization == AXIS_QUANTIZATION_HALF ) ? sizeof(uint16_t) : sizeof(float);
+
+  return ( fieldIndex == AXIS_FIELD_SETPOINTS_TAG ) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+// Delta values are differences for integer fields (fixed point and stamps). Other floats have nothing to gain from them
+static inline bool IsDifferenceField( const AxisPacketsSettings* settings, size_t fieldIndex )
+{
+  return ( !IsFloatField( fieldIndex ) || settings->quantization == AXIS_QUANTIZATION_FIXED );
+}
+
+static uint64_t QuantizeField( const AxisPacketsSettings* settings, const SHMAxisBlock* block, size_t fieldIndex )
+{
+  if( fieldIndex == AXIS_FIELD_SETPOINTS_TAG ) return block->setpointsTag;
+  else if( fieldIndex == AXIS_FIELD_TIMESTAMP ) return block->timestamp;
+  else if( fieldIndex == AXIS_FIELD_ACTUATION_TIME ) return block->actuationTime;
+  else if( fieldIndex == AXIS_FIELD_SEQUENCE_NUMBER ) return block->sequenceNumber;
+
+  float value = block->valuesList[ fieldIndex ];
+  if( settings->quantization == AXIS_QUANTIZATION_HALF ) return FloatToHalf( value );
+  else if( settings->quantization == AXIS_QUANTIZATION_FIXED )
+  {
+    double steps = (double) value / settings->fixedResolution;
+    if( steps != steps ) steps = 0.0;                           // NaN
+    if( steps > (double) INT32_MAX ) steps = (double) INT32_MAX;
+    if( steps < (double) INT32_MIN ) steps = (double) INT32_MIN;
+    int32_t fixedValue = (int32_t) ( ( steps >= 0.0 ) ? steps + 0.5 : steps - 0.5 );
+    return (uint64_t) (int64_t) fixedValue;
+  }
+
+  uint32_t bits;
+  memcpy( &bits, &value, sizeof(float) );
+  return bits;
+}
+
+static void DequantizeField( const AxisPacketsSettings* settings, uint64_t value, size_t fieldIndex, SHMAxisBlock* block )
+{
+  if( fieldIndex == AXIS_FIELD_SETPOINTS_TAG ) block->setpointsTag = (uint32_t) value;
+  else if( fieldIndex == AXIS_FIELD_TIMESTAMP ) block->timestamp = value;
+  else if( fieldIndex == AXIS_FIELD_ACTUATION_TIME ) block->actuationTime = value;
+  else if( fieldIndex == AXIS_FIELD_SEQUENCE_NUMBER ) block->sequenceNumber = value;
+  else if( settings->quantization == AXIS_QUANTIZATION_HALF ) block->valuesList[ fieldIndex ] = HalfToFloat( (uint16_t) value );
+  else if( settings->quantization == AXIS_QUANTIZATION_FIXED ) block->valuesList[ fieldIndex ] = (float) ( (int32_t) value * (double) settings->fixedResolution );
+  else
+  {
+    uint32_t bits = (uint32_t) value;
+    memcpy( &(block->valuesList[ fieldIndex ]), &bits, sizeof(float) );
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////                                   SETTINGS                                    /////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+bool AxisPackets_ReadSettings( const uint8_t* message, size_t messageLength, AxisPacketsSettings* settings )
+{
+  const size_t SETTINGS_LENGTH = 1 + sizeof(uint16_t) + 1 + sizeof(float) + 1 + 1;
+
+  if( message == NULL || settings == NULL ) return false;
+  if( messageLength < SETTINGS_LENGTH || message[ 0 ] != AXIS_PACKETS_SUBSCRIBE_REQUEST ) return false;
+
+  PacketCursor cursor = { .data = (uint8_t*) message, .length = messageLength, .position = 1 };
+
+  AxisPacketsSettings newSettings = { 0 };
+  newSettings.fieldsMask = (uint16_t) ReadInteger( &cursor, sizeof(uint16_t) ) & AXIS_FIELDS_ALL;
+  newSettings.quantization = (uint8_t) ReadInteger( &cursor, 1 );
+  uint32_t resolutionBits = (uint32_t) ReadInteger( &cursor, sizeof(float) );
+  memcpy( &(newSettings.fixedResolution), &resolutionBits, sizeof(float) );
+  newSettings.keyframeInterval = (uint8_t) ReadInteger( &cursor, 1 );
+  newSettings.axesNumber = (uint8_t) ReadInteger( &cursor, 1 );
+
+  if( newSettings.quantization >= AXIS_QUANTIZATIONS_NUMBER ) return false;
+  if( newSettings.quantization == AXIS_QUANTIZATION_FIXED && !( newSettings.fixedResolution > 0.0f ) ) return false;
+  if( newSettings.axesNumber > AXIS_PACKETS_MAX_AXES ) return false;
+  if( newSettings.axesNumber > 0 && newSettings.fieldsMask == 0 ) return false;
+
+  for( size_t axisPosition = 0; axisPosition < newSettings.axesNumber; axisPosition++ )
+    newSettings.axesList[ axisPosition ] = (uint8_t) ReadInteger( &cursor, 1 );
+
+  if( cursor.isOverflowed ) return false;
+
+  *settings = newSettings;
+
+  return true;
+}
+
+size_t AxisPackets_WriteSettings( const AxisPacketsSettings* settings, uint8_t* message, size_t messageLength )
+{
+  if( settings == NULL || message == NULL ) return 0;
+
+  PacketCursor cursor = { .data = message, .length = messageLength };
+
+  uint32_t resolutionBits;
+  memcpy( &resolutionBits, &(settings->fixedResolution), sizeof(float) );
+
+  WriteInteger( &cursor, AXIS_PACKETS_SUBSCRIBE_REQUEST, 1 );
+  WriteInteger( &cursor, settings->fieldsMask, sizeof(uint16_t) );
+  WriteInteger( &cursor, settings->quantization, 1 );
+  WriteInteger( &cursor, resolutionBits, sizeof(float) );
+  WriteInteger( &cursor, settings->keyframeInterval, 1 );
+  WriteInteger( &cursor, settings->axesNumber, 1 );
+  for( size_t axisPosition = 0; axisPosition < settings->axesNumber && axisPosition < AXIS_PACKETS_MAX_AXES; axisPosition++ )
+    WriteInteger( &cursor, settings->axesList[ axisPosition ], 1 );
+
+  return cursor.isOverflowed ? 0 : cursor.position;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////                                   CODING                                      /////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+AxisPacketsCoder AxisPackets_CreateCoder( const AxisPacketsSettings* settings )
+{
+  if( settings == NULL ) return NULL;
+  if( settings->axesNumber == 0 || settings->axesNumber > AXIS_PACKETS_MAX_AXES ) return NULL;
+
+  AxisPacketsCoder newCoder = (AxisPacketsCoder) malloc( sizeof(AxisPacketsCoderData) );
+  if( newCoder == NULL ) return NULL;
+  memset( newCoder, 0, sizeof(AxisPacketsCoderData) );
+
+  newCoder->settings = *settings;
+  newCoder->settings.fieldsMask &= AXIS_FIELDS_ALL;
+
+  return newCoder;
+}
+
+void AxisPackets_DiscardCoder( AxisPacketsCoder coder )
+{
+  free( coder );
+}
+
+// Frame numbers only move forward (0 is never used)
+static inline uint32_t GetNextFrameNumber( uint32_t frameNumber ) { return ( frameNumber + 1 == 0 ) ? 1 : frameNumber + 1; }
+
+static FrameData* FindFrame( AxisPacketsCoder coder, uint32_t frameNumber )
+{
+  if( frameNumber == 0 ) return NULL;
+
+  FrameData* frame = &(coder->historyList[ frameNumber % AXIS_PACKETS_HISTORY_LENGTH ]);
+
+  return ( frame->number == frameNumber ) ? frame : NULL;
+}
+
+// Delta frames are based on the last acknowledged one, as long as it is kept and no keyframe is due
+static FrameData* GetEncodingBase( AxisPacketsCoder coder, uint32_t frameNumber )
+{
+  if( coder->settings.keyframeInterval == 0 ) return NULL;
+  if( coder->keyframeNumber == 0 || frameNumber - coder->keyframeNumber >= coder->settings.keyframeInterval ) return NULL;
+
+  FrameData* baseFrame = FindFrame( coder, coder->acknowledgedFrameNumber );
+  // Its history slot is about to be reused by the new frame
+  if( baseFrame != NULL && frameNumber - baseFrame->number >= AXIS_PACKETS_HISTORY_LENGTH ) return NULL;
+
+  return baseFrame;
+}
+
+void AxisPackets_Acknowledge( AxisPacketsCoder coder, uint32_t frameNumber )
+{
+  if( coder == NULL ) return;
+
+  // Late acknowledgements do not replace newer ones
+  if( FindFrame( coder, frameNumber ) == NULL ) return;
+  if( coder->acknowledgedFrameNumber != 0 && (int32_t) ( frameNumber - coder->acknowledgedFrameNumber ) <= 0 ) return;
+
+  coder->acknowledgedFrameNumber = frameNumber;
+}
+
+// Returns the packet length (0 if it did not fit) and its number of blocks
+static size_t WritePacket( const AxisPacketsSettings* settings, const FrameData* frame, const FrameData* baseFrame,
+                           uint8_t* packetData, size_t packetLength, size_t* ref_blocksNumber )
+{
+  PacketCursor cursor = { .data = packetData, .length = packetLength };
+
+  WriteInteger( &cursor, AXIS_PACKETS_SUBSCRIBE_REQUEST, 1 );
+  WriteInteger( &cursor, frame->number, sizeof(uint32_t) );
+  WriteInteger( &cursor, ( baseFrame != NULL ) ? baseFrame->number : frame->number, sizeof(uint32_t) );
+  size_t blocksNumberPosition = cursor.position;
+  WriteInteger( &cursor, 0, 1 );
+
+  uint8_t blocksNumber = 0;
+  for( size_t axisPosition = 0; axisPosition < settings->axesNumber; axisPosition++ )
+  {
+    if( !( frame->axesMask & ( 1 << axisPosition ) ) ) continue;
+
+    const uint64_t* valuesList = frame->valuesList[ axisPosition ];
+    bool isBaseAxis = ( baseFrame != NULL && ( baseFrame->axesMask & ( 1 << axisPosition ) ) );
+
+    uint16_t fieldsMask = settings->fieldsMask;
+    if( isBaseAxis )
+    {
+      for( size_t fieldIndex = 0; fieldIndex < AXIS_FIELDS_NUMBER; fieldIndex++ )
+      {
+        if( valuesList[ fieldIndex ] == baseFrame->valuesList[ axisPosition ][ fieldIndex ] ) fieldsMask &= ~( 1 << fieldIndex );
+      }
+      if( fieldsMask == 0 ) continue;
+    }
+
+    WriteInteger( &cursor, settings->axesList[ axisPosition ], 1 );
+    WriteInteger( &cursor, fieldsMask, sizeof(uint16_t) );
+    for( size_t fieldIndex = 0; fieldIndex < AXIS_FIELDS_NUMBER; fieldIndex++ )
+    {
+      if( !( fieldsMask & ( 1 << fieldIndex ) ) ) continue;
+
+      if( isBaseAxis && IsDifferenceField( settings, fieldIndex ) )
+        WriteDifference( &cursor, valuesList[ fieldIndex ] - baseFrame->valuesList[ axisPosition ][ fieldIndex ] );
+      else
+        WriteInteger( &cursor, valuesList[ fieldIndex ], GetFieldWidth( settings, fieldIndex ) );
+    }
+
+    blocksNumber++;
+  }
+
+  *ref_blocksNumber = blocksNumber;
+  if( cursor.isOverflowed ) return 0;
+
+  packetData[ blocksNumberPosition ] = blocksNumber;
+
+  return cursor.position;
+}
+
+size_t AxisPackets_Encode( AxisPacketsCoder coder, const SHMAxisBlock* blocksList, size_t blocksNumber, uint8_t* packetData, size_t packetLength )
+{
+  if( coder == NULL || blocksList == NULL || packetData == NULL ) return 0;
+
+  const AxisPacketsSettings* settings = &(coder->settings);
+
+  FrameData frame = { .number = GetNextFrameNumber( coder->lastFrameNumber ) };
+  FrameData* baseFrame = GetEncodingBase( coder, frame.number );
+  for( size_t axisPosition = 0; axisPosition < settings->axesNumber; axisPosition++ )
+  {
+    size_t axisIndex = settings->axesList[ axisPosition ];
+    // Axes not shared (anymore) keep their last sent values
+    if( axisIndex >= blocksNumber )
+    {
+      if( baseFrame != NULL && ( baseFrame->axesMask & ( 1 << axisPosition ) ) )
+      {
+        frame.axesMask |= ( 1 << axisPosition );
+        memcpy( frame.valuesList[ axisPosition ], baseFrame->valuesList[ axisPosition ], sizeof(frame.valuesList[ axisPosition ]) );
+      }
+      continue;
+    }
+
+    frame.axesMask |= ( 1 << axisPosition );
+    for( size_t fieldIndex = 0; fieldIndex < AXIS_FIELDS_NUMBER; fieldIndex++ )
+    {
+      if( settings->fieldsMask & ( 1 << fieldIndex ) )
+        frame.valuesList[ axisPosition ][ fieldIndex ] = QuantizeField( settings, &(blocksList[ axisIndex ]), fieldIndex );
+    }
+  }
+
+  size_t encodedLength = 0, packetBlocksNumber = 0;
+  if( baseFrame != NULL )
+  {
+    encodedLength = WritePacket( settings, &frame, baseFrame, packetData, packetLength, &packetBlocksNumber );
+    // Unchanged frames are not sent. Delta frames that do not fit (big differences) are sent as keyframes
+    if( encodedLength > 0 && packetBlocksNumber == 0 ) return 0;
+  }
+
+  if( encodedLength == 0 )
+  {
+    if( (encodedLength = WritePacket( settings, &frame, NULL, packetData, packetLength, &packetBlocksNumber )) == 0 ) return 0;
+    coder->keyframeNumber = frame.number;
+  }
+
+  coder->historyList[ frame.number % AXIS_PACKETS_HISTORY_LENGTH ] = frame;
+  coder->lastFrameNumber = frame.number;
+
+  return encodedLength;
+}
+
+uint32_t AxisPackets_Decode( AxisPacketsCoder coder, const uint8_t* packetData, size_t packetLength, SHMAxisBlock* blocksList, size_t blocksNumber )
+{
+  if( coder == NULL || packetData == NULL || blocksList == NULL ) return 0;
+
+  const AxisPacketsSettings* settings = &(coder->settings);
+
+  PacketCursor cursor = { .data = (uint8_t*) packetData, .length = packetLength };
+
+  if( ReadInteger( &cursor, 1 ) != AXIS_PACKETS_SUBSCRIBE_REQUEST ) return 0;
+  FrameData frame = { .number = (uint32_t) ReadInteger( &cursor, sizeof(uint32_t) ) };
+  uint32_t baseFrameNumber = (uint32_t) ReadInteger( &cursor, sizeof(uint32_t) );
+  uint8_t packetBlocksNumber = (uint8_t) ReadInteger( &cursor, 1 );
+  if( cursor.isOverflowed || frame.number == 0 ) return 0;
+
+  // Late (reordered) frames would bring older values back
+  if( coder->lastFrameNumber != 0 && (int32_t) ( frame.number - coder->lastFrameNumber ) <= 0 ) return 0;
+
+  FrameData* baseFrame = NULL;
+  if( baseFrameNumber != frame.number )
+  {
+    if( (baseFrame = FindFrame( coder, baseFrameNumber )) == NULL ) return 0;
+    frame.axesMask = baseFrame->axesMask;
+    memcpy( frame.valuesList, baseFrame->valuesList, sizeof(frame.valuesList) );
+  }
+
+  for( uint8_t blockIndex = 0; blockIndex < packetBlocksNumber; blockIndex++ )
+  {
+    uint8_t axisIndex = (uint8_t) ReadInteger( &cursor, 1 );
+    uint16_t fieldsMask = (uint16_t) ReadInteger( &cursor, sizeof(uint16_t) );
+
+    size_t axisPosition = 0;
+    while( axisPosition < settings->axesNumber && settings->axesList[ axisPosition ] != axisIndex ) axisPosition++;
+    if( axisPosition >= settings->axesNumber || ( fieldsMask & ~(settings->fieldsMask) ) ) return 0;
+
+    bool isBaseAxis = ( baseFrame != NULL && ( baseFrame->axesMask & ( 1 << axisPosition ) ) );
+
+    uint64_t* valuesList = frame.valuesList[ axisPosition ];
+    for( size_t fieldIndex = 0; fieldIndex < AXIS_FIELDS_NUMBER; fieldIndex++ )
+    {
+      if( !( fieldsMask & ( 1 << fieldIndex ) ) ) continue;
+
+      if( isBaseAxis && IsDifferenceField( settings, fieldIndex ) ) valuesList[ fieldIndex ] += ReadDifference( &cursor );
+      else valuesList[ fieldIndex ] = ReadInteger( &cursor, GetFieldWidth( settings, fieldIndex ) );
+    }
+
+    frame.axesMask |= ( 1 << axisPosition );
+  }
+
+  if( cursor.isOverflowed ) return 0;
+
+  coder->historyList[ frame.number % AXIS_PACKETS_HISTORY_LENGTH ] = frame;
+  coder->lastFrameNumber = frame.number;
+
+  for( size_t axisPosition = 0; axisPosition < settings->axesNumber; axisPosition++ )
+  {
+    size_t axisIndex = settings->axesList[ axisPosition ];
+    if( axisIndex >= blocksNumber || !( frame.axesMask & ( 1 << axisPosition ) ) ) continue;
+
+    for( size_t fieldIndex = 0; fieldIndex < AXIS_FIELDS_NUMBER; fieldIndex++ )
+    {
+      if( settings->fieldsMask & ( 1 << fieldIndex ) )
+        DequantizeField( settings, frame.valuesList[ axisPosition ][ fieldIndex ], fieldIndex, &(blocksList[ axisIndex ]) );
+    }
+  }
+
+  return frame.number;
+}
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+/////  Compact axis measures packets: per client field selection, optional  /////
+/////  float quantization and delta encoding against acknowledged frames   /////
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AXIS_PACKETS_H
+#define AXIS_PACKETS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+#include "shm_axis_control.h"
+
+// Axis block fields, in packing order: float values (SHM_AXIS_* indexes) followed by the stamp fields
+enum { AXIS_FIELD_SETPOINTS_TAG = SHM_AXIS_FLOATS_NUMBER, AXIS_FIELD_TIMESTAMP, AXIS_FIELD_ACTUATION_TIME,
+       AXIS_FIELD_SEQUENCE_NUMBER, AXIS_FIELDS_NUMBER };
+#define AXIS_FIELDS_ALL ( ( 1 << AXIS_FIELDS_NUMBER ) - 1 )
+
+// Float fields quantization: none (4 bytes), IEEE half precision (2 bytes) or fixed point (multiples of a given resolution)
+enum { AXIS_QUANTIZATION_NONE, AXIS_QUANTIZATION_HALF, AXIS_QUANTIZATION_FIXED, AXIS_QUANTIZATIONS_NUMBER };
+
+// Axes of a subscription. A keyframe with all fields of all of them always fits a network message
+#define AXIS_PACKETS_MAX_AXES 8
+// Sent frames kept (per client) as possible delta bases
+#define AXIS_PACKETS_HISTORY_LENGTH 16
+
+// Axis channel codes (first message byte, in place of the blocks number). Subscribe request: code, fields mask (2 bytes),
+// quantization, fixed point resolution (float), keyframe interval (frames, 0 for keyframes only), axes number and axis
+// indexes (no axes to unsubscribe). Acknowledgement: code and last decoded frame number (4 bytes)
+#define AXIS_PACKETS_SUBSCRIBE_REQUEST 0xFE
+#define AXIS_PACKETS_ACKNOWLEDGE_REQUEST 0xFD
+
+// Packets: subscribe code, frame number (4 bytes), base frame number (4 bytes, the same for keyframes), blocks number,
+// followed by each block axis index, fields mask (2 bytes) and the masked fields. Keyframe blocks hold all subscribed
+// fields. Delta blocks hold only fields changed since the base frame, and unchanged blocks are left out. Values are little
+// endian, with quantized floats taking 4 bytes (2 for half precision). On delta blocks, fixed point and stamp fields are
+// written as differences (zigzag varints)
+#define AXIS_PACKETS_HEADER_LENGTH ( 1 + 2 * sizeof(uint32_t) + 1 )
+// Network message length (IP_MAX_MESSAGE_LENGTH). Keyframe blocks take at most 59 bytes each
+#define AXIS_PACKETS_MAX_LENGTH 512
+
+typedef struct _AxisPacketsSettings
+{
+  uint16_t fieldsMask;
+  uint8_t quantization;
+  float fixedResolution;
+  uint8_t keyframeInterval;
+  uint8_t axesNumber;
+  uint8_t axesList[ AXIS_PACKETS_MAX_AXES ];
+}
+AxisPacketsSettings;
+
+// Encoders and decoders keep the history of quantized frames, so both ends must use the same settings
+typedef struct _AxisPacketsCoderData AxisPacketsCoderData;
+typedef AxisPacketsCoderData* AxisPacketsCoder;
+
+// ReadSettings/WriteSettings convert settings from/to subscribe requests. Encode takes the blocks of all shared axes
+// and returns the packet length (0 if nothing changed since the base frame). Decode updates the subscribed blocks of the
+// given list and returns the frame number to be acknowledged (0 if the packet was invalid or its base frame is unknown)
+#define AXIS_PACKETS_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( bool, Namespace, ReadSettings, const uint8_t*, size_t, AxisPacketsSettings* ) \
+        INIT_FUNCTION( size_t, Namespace, WriteSettings, const AxisPacketsSettings*, uint8_t*, size_t ) \
+        INIT_FUNCTION( AxisPacketsCoder, Namespace, CreateCoder, const AxisPacketsSettings* ) \
+        INIT_FUNCTION( void, Namespace, DiscardCoder, AxisPacketsCoder ) \
+        INIT_FUNCTION( void, Namespace, Acknowledge, AxisPacketsCoder, uint32_t ) \
+        INIT_FUNCTION( size_t, Namespace, Encode, AxisPacketsCoder, const SHMAxisBlock*, size_t, uint8_t*, size_t ) \
+        INIT_FUNCTION( uint32_t, Namespace, Decode, AxisPacketsCoder, const uint8_t*, size_t, SHMAxisBlock*, size_t )
+
+DECLARE_NAMESPACE_INTERFACE( AxisPackets, AXIS_PACKETS_INTERFACE )
+
+
+#endif // AXIS_PACKETS_H
@@ -8,6 +8,7 @@
 
 #define CONTROLLER_INVALID_HANDLE NULL
 
+// Default control pass interval (seconds), for robots without a configured control rate
 #define CONTROL_PASS_INTERVAL 0.005
 
 typedef void* Controller;
@@ -0,0 +1,337 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (c) 2016 Leonardo José Consoni                                  //
+//                                                                            //
+//  This file is part of RobRehabSystem.                                      //
+//                                                                            //
+//  RobRehabSystem is free software: you can redistribute it and/or modify    //
+//  it under the terms of the GNU Lesser General Public License as published  //
+//  by the Free Software Foundation, either version 3 of the License, or      //
+//  (at your option) any later version.                                       //
+//                                                                            //
+//  RobRehabSystem is distributed in the hope that it will be useful,         //
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of            //
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              //
+//  GNU Lesser General Public License for more details.                       //
+//                                                                            //
+//  You should have received a copy of the GNU Lesser General Public License  //
+//  along with RobRehabSystem. If not, see <http://www.gnu.org/licenses/>.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "threads/atomic_operations.h"
+
+#include "debug/async_debug.h"
+
+#include "control_executor.h"
+
+
+#define MAX_WORKERS_NUMBER 64
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct _ControlTask
+{
+  ControlTaskFunction Run;
+  void* data;
+  uint64_t periodTicks;
+  uint64_t startTick;
+  bool isActive;
+}
+ControlTask;
+
+// Batch range still to be run by a worker. Any worker may take the next index, so ranges are shared
+// (each on its own cache line, to avoid contention between workers running different ranges)
+typedef struct _WorkerRange
+{
+  size_t nextIndex;
+  size_t endIndex;
+  char padding[ CACHE_LINE_SIZE - 2 * sizeof(size_t) ];
+}
+WorkerRange;
+
+static ControlTask tasksList[ CONTROL_EXECUTOR_MAX_TASKS ];
+static ThreadLock tasksLock = NULL;
+
+static size_t batchList[ CONTROL_EXECUTOR_MAX_TASKS ];
+static WorkerRange workerRangesList[ MAX_WORKERS_NUMBER ];
+
+static Thread workersList[ MAX_WORKERS_NUMBER ];
+static Semaphore workerStartsList[ MAX_WORKERS_NUMBER ];
+static Semaphore workersDone = NULL;
+static size_t workersNumber = 0;
+
+static PeriodicTimer tickTimer = NULL;
+static double tickInterval = 0.0;
+static uint64_t ticksCount = 0;
+
+static volatile bool isRunning = false;
+
+
+DEFINE_NAMESPACE_INTERFACE( ControlExecutor, CONTROL_EXECUTOR_INTERFACE )
+
+
+static void* AsyncLeadWorker( void* );
+static void* AsyncWorker( void* );
+
+// Index of the n-th (cycling) CPU allowed by the affinity mask, or -1 for any CPU
+static int GetWorkerCPU( uint64_t affinityMask, size_t workerIndex )
+{
+  size_t allowedCPUsNumber = 0;
+  for( int cpuIndex = 0; cpuIndex < 64; cpuIndex++ )
+    if( affinityMask & ( 1ULL << cpuIndex ) ) allowedCPUsNumber++;
+
+  if( allowedCPUsNumber == 0 ) return -1;
+
+  size_t allowedCPUIndex = workerIndex % allowedCPUsNumber;
+  for( int cpuIndex = 0; cpuIndex < 64; cpuIndex++ )
+  {
+    if( affinityMask & ( 1ULL << cpuIndex ) )
+    {
+      if( allowedCPUIndex == 0 ) return cpuIndex;
+      allowedCPUIndex--;
+    }
+  }
+
+  return -1;
+}
+
+bool ControlExecutor_Init( size_t newWorkersNumber, double newTickInterval, const ThreadSpec* workerSpec )
+{
+  if( isRunning ) return false;
+
+  if( newWorkersNumber == 0 || newTickInterval <= 0.0 ) return false;
+  if( newWorkersNumber > MAX_WORKERS_NUMBER ) newWorkersNumber = MAX_WORKERS_NUMBER;
+
+  DEBUG_PRINT( "starting control executor with %lu workers (tick: %g s)", newWorkersNumber, newTickInterval );
+
+  memset( tasksList, 0, sizeof(tasksList) );
+  tasksLock = ThreadLocks.Create();
+
+  workersNumber = newWorkersNumber;
+  workersDone = Semaphores.Create( 0, workersNumber );
+  for( size_t workerIndex = 0; workerIndex < workersNumber; workerIndex++ )
+    workerStartsList[ workerIndex ] = Semaphores.Create( 0, 1 );
+
+  tickInterval = newTickInterval;
+  tickTimer = PeriodicTimers.Create( (uint64_t) ( tickInterval * 1000000000 ), TIMER_OVERRUN_SKIP );
+  ticksCount = 0;
+
+  isRunning = true;
+
+  // Each worker is pinned to one of the allowed CPUs (in order), if any is given. Lead worker starts
+  // last, so that no tick is scheduled before all the others are waiting for it
+  ThreadSpec baseSpec = { THREAD_SCHED_DEFAULT, 0, 0, 0, false };
+  if( workerSpec != NULL ) baseSpec = *workerSpec;
+  for( size_t workerIndex = 0; workerIndex < workersNumber; workerIndex++ )
+    workersList[ workerIndex ] = THREAD_INVALID_HANDLE;
+  for( size_t workerCount = 1; workerCount <= workersNumber; workerCount++ )
+  {
+    size_t workerIndex = workerCount % workersNumber;
+    ThreadSpec threadSpec = baseSpec;
+    int workerCPU = GetWorkerCPU( baseSpec.cpuAffinityMask, workerIndex );
+    if( workerCPU >= 0 ) threadSpec.cpuAffinityMask = ( 1ULL << workerCPU );
+
+    AsyncFunction workerFunction = ( workerIndex == 0 ) ? AsyncLeadWorker : AsyncWorker;
+    workersList[ workerIndex ] = Threading.StartThreadSpec( workerFunction, (void*) workerIndex, THREAD_JOINABLE, &threadSpec );
+    if( workersList[ workerIndex ] == THREAD_INVALID_HANDLE )
+    {
+      ERROR_PRINT( "failed to start control executor worker %lu", workerIndex );
+      ControlExecutor_End();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ControlExecutor_End( void )
+{
+  if( tickTimer == NULL ) return;
+
+  DEBUG_PRINT( "ending control executor with %lu workers", workersNumber );
+
+  isRunning = false;
+
+  // Lead worker wakes the others up after its last tick
+  if( workersList[ 0 ] != THREAD_INVALID_HANDLE ) Threading.WaitExit( workersList[ 0 ], 5000 );
+  else
+  {
+    for( size_t workerIndex = 1; workerIndex < workersNumber; workerIndex++ )
+      Semaphores.Increment( workerStartsList[ workerIndex ] );
+  }
+  for( size_t workerIndex = 1; workerIndex < workersNumber; workerIndex++ )
+  {
+    if( workersList[ workerIndex ] != THREAD_INVALID_HANDLE ) Threading.WaitExit( workersList[ workerIndex ], 5000 );
+    workersList[ workerIndex ] = THREAD_INVALID_HANDLE;
+  }
+  workersList[ 0 ] = THREAD_INVALID_HANDLE;
+
+  PeriodicTimerStats tickStats;
+  if( PeriodicTimers.GetStats( tickTimer, &tickStats ) )
+  {
+    DEBUG_PRINT( "control executor: %lu ticks - %lu missed deadlines (worst lateness: %.3f ms)", (unsigned long) tickStats.cyclesCount,
+                 (unsigned long) tickStats.missedDeadlinesCount, tickStats.worstLatenessNanoseconds / 1000000.0 );
+  }
+
+  for( size_t workerIndex = 0; workerIndex < MAX_WORKERS_NUMBER; workerIndex++ )
+  {
+    if( workerStartsList[ workerIndex ] != NULL ) Semaphores.Discard( workerStartsList[ workerIndex ] );
+    workerStartsList[ workerIndex ] = NULL;
+  }
+  Semaphores.Discard( workersDone );
+  workersDone = NULL;
+  workersNumber = 0;
+
+  PeriodicTimers.Discard( tickTimer );
+  tickTimer = NULL;
+
+  ThreadLocks.Discard( tasksLock );
+  tasksLock = NULL;
+}
+
+int ControlExecutor_AddTask( ControlTaskFunction taskFunction, void* taskData, double taskInterval )
+{
+  if( !isRunning || taskFunction == NULL ) return CONTROL_TASK_INVALID_ID;
+
+  uint64_t periodTicks = (uint64_t) round( taskInterval / tickInterval );
+  if( periodTicks == 0 ) periodTicks = 1;
+  if( fabs( periodTicks * tickInterval - taskInterval ) > tickInterval / 100.0 )
+    DEBUG_PRINT( "task interval %g s rounded to %g s (executor tick: %g s)", taskInterval, periodTicks * tickInterval, tickInterval );
+
+  int taskID = CONTROL_TASK_INVALID_ID;
+
+  ThreadLocks.Aquire( tasksLock );
+  for( int taskIndex = 0; taskIndex < CONTROL_EXECUTOR_MAX_TASKS; taskIndex++ )
+  {
+    if( !tasksList[ taskIndex ].isActive )
+    {
+      tasksList[ taskIndex ].Run = taskFunction;
+      tasksList[ taskIndex ].data = taskData;
+      tasksList[ taskIndex ].periodTicks = periodTicks;
+      tasksList[ taskIndex ].startTick = ticksCount;
+      tasksList[ taskIndex ].isActive = true;
+      taskID = taskIndex;
+      break;
+    }
+  }
+  ThreadLocks.Release( tasksLock );
+
+  return taskID;
+}
+
+// Returns only after the task stops being executed (at most at the end of the current tick)
+void ControlExecutor_RemoveTask( int taskID )
+{
+  if( taskID < 0 || taskID >= CONTROL_EXECUTOR_MAX_TASKS ) return;
+  if( tasksLock == NULL ) return;
+
+  ThreadLocks.Aquire( tasksLock );
+  tasksList[ taskID ].isActive = false;
+  ThreadLocks.Release( tasksLock );
+}
+
+bool ControlExecutor_IsRunning( void )
+{
+  return isRunning;
+}
+
+bool ControlExecutor_GetTickStats( PeriodicTimerStats* ref_stats )
+{
+  if( tickTimer == NULL ) return false;
+
+  return PeriodicTimers.GetStats( tickTimer, ref_stats );
+}
+
+
+// Run tasks from the worker own range first, then help the others with what is left of theirs
+static void RunBatchTasks( size_t workerIndex )
+{
+  for( size_t rangeOffset = 0; rangeOffset < workersNumber; rangeOffset++ )
+  {
+    WorkerRange* range = &(workerRangesList[ ( workerIndex + rangeOffset ) % workersNumber ]);
+
+    size_t batchIndex = ATOMIC_FETCH_ADD( &(range->nextIndex), 1 );
+    while( batchIndex < range->endIndex )
+    {
+      ControlTask* task = &(tasksList[ batchList[ batchIndex ] ]);
+      task->Run( task->data );
+      batchIndex = ATOMIC_FETCH_ADD( &(range->nextIndex), 1 );
+    }
+  }
+}
+
+static void* AsyncLeadWorker( void* ref_workerIndex )
+{
+  /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "control executor lead worker running on thread %lx", THREAD_ID );
+
+  PeriodicTimers.Start( tickTimer );
+
+  while( isRunning )
+  {
+    ThreadLocks.Aquire( tasksLock );
+
+    // Due tasks are always batched in the same (slot) order
+    size_t batchLength = 0;
+    for( size_t taskIndex = 0; taskIndex < CONTROL_EXECUTOR_MAX_TASKS; taskIndex++ )
+    {
+      ControlTask* task = &(tasksList[ taskIndex ]);
+      if( task->isActive && ( ticksCount - task->startTick ) % task->periodTicks == 0 ) batchList[ batchLength++ ] = taskIndex;
+    }
+
+    if( batchLength > 0 )
+    {
+      size_t rangeStart = 0;
+      for( size_t workerIndex = 0; workerIndex < workersNumber; workerIndex++ )
+      {
+        size_t rangeLength = batchLength / workersNumber + ( ( workerIndex < batchLength % workersNumber ) ? 1 : 0 );
+        workerRangesList[ workerIndex ].endIndex = rangeStart + rangeLength;
+        ATOMIC_STORE( &(workerRangesList[ workerIndex ].nextIndex), rangeStart );
+        rangeStart += rangeLength;
+      }
+
+      for( size_t workerIndex = 1; workerIndex < workersNumber; workerIndex++ )
+        Semaphores.Increment( workerStartsList[ workerIndex ] );
+
+      RunBatchTasks( 0 );
+
+      for( size_t workerIndex = 1; workerIndex < workersNumber; workerIndex++ )
+        Semaphores.Decrement( workersDone );
+    }
+
+    ticksCount++;
+
+    ThreadLocks.Release( tasksLock );
+
+    (void) PeriodicTimers.WaitNextCycle( tickTimer );
+  }
+
+  for( size_t workerIndex = 1; workerIndex < workersNumber; workerIndex++ )
+    Semaphores.Increment( workerStartsList[ workerIndex ] );
+
+  return NULL;
+}
+
+static void* AsyncWorker( void* ref_workerIndex )
+{
+  size_t workerIndex = (size_t) ref_workerIndex;
+
+  /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "control executor worker %lu running on thread %lx", workerIndex, THREAD_ID );
+
+  while( true )
+  {
+    Semaphores.Decrement( workerStartsList[ workerIndex ] );
+
+    if( !isRunning ) break;
+
+    RunBatchTasks( workerIndex );
+
+    Semaphores.Increment( workersDone );
+  }
+
+  return NULL;
+}
@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////////////////////////////
+/////  Shared pool of pinned worker threads running periodic control tasks  /////
+/////  (e.g. robot control passes) in batches synchronized to a base tick   /////
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CONTROL_EXECUTOR_H
+#define CONTROL_EXECUTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+#include "threads/threading.h"
+#include "time/timing.h"
+
+#define CONTROL_TASK_INVALID_ID -1
+
+// Maximum number of tasks registered at the same time
+#define CONTROL_EXECUTOR_MAX_TASKS 64
+
+typedef void (*ControlTaskFunction)( void* );
+
+// Tasks run every N ticks (N = task interval / tick interval, rounded). On each tick, due tasks are batched
+// in registration slot order and split in contiguous ranges between workers. Workers that finish their range
+// take the remaining tasks of the others, so robots with uneven control costs are balanced inside the tick.
+// The tick only ends when all batched tasks are done, so each task runs once per period, never overlapping itself
+#define CONTROL_EXECUTOR_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( bool, Namespace, Init, size_t, double, const ThreadSpec* ) \
+        INIT_FUNCTION( void, Namespace, End, void ) \
+        INIT_FUNCTION( int, Namespace, AddTask, ControlTaskFunction, void*, double ) \
+        INIT_FUNCTION( void, Namespace, RemoveTask, int ) \
+        INIT_FUNCTION( bool, Namespace, IsRunning, void ) \
+        INIT_FUNCTION( bool, Namespace, GetTickStats, PeriodicTimerStats* )
+
+DECLARE_NAMESPACE_INTERFACE( ControlExecutor, CONTROL_EXECUTOR_INTERFACE )
+
+
+#endif // CONTROL_EXECUTOR_H
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (c) 2016 Leonardo José Consoni                                  //
+//                                                                            //
+//  This file is part of RobRehabSystem.                                      //
+//                                                                            //
+//  RobRehabSystem is free software: you can redistribute it and/or modify    //
+//  it under the terms of the GNU Lesser General Public License as published  //
+//  by the Free Software Foundation, either version 3 of the License, or      //
+//  (at your option) any later version.                                       //
+//                                                                            //
+//  RobRehabSystem is distributed in the hope that it will be useful,         //
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of            //
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              //
+//  GNU Lesser General Public License for more details.                       //
+//                                                                            //
+//  You should have received a copy of the GNU Lesser General Public License  //
+//  along with RobRehabSystem. If not, see <http://www.gnu.org/licenses/>.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "debug/latency_histograms.h"
+
+
+DEFINE_NAMESPACE_INTERFACE( LatencyHistograms, LATENCY_HISTOGRAMS_INTERFACE )
+
+
+// Index of the most significant set bit (value must be non zero)
+static inline int GetMostSignificantBit( uint64_t value )
+{
+#ifdef __GNUC__
+  return 63 - __builtin_clzll( value );
+#else
+  int bitIndex = 0;
+  while( value >>= 1 ) bitIndex++;
+  return bitIndex;
+#endif
+}
+
+static inline size_t GetBucketIndex( uint64_t value )
+{
+  if( value < LATENCY_SUB_BUCKETS_NUMBER ) return (size_t) value;
+
+  int mostSignificantBit = GetMostSignificantBit( value );
+  if( mostSignificantBit >= LATENCY_MAX_VALUE_BITS ) return LATENCY_BUCKETS_NUMBER - 1;
+
+  int subBucketShift = mostSignificantBit - ( LATENCY_SUB_BUCKET_BITS - 1 );
+  size_t subBucketIndex = (size_t) ( value >> subBucketShift ) - LATENCY_HALF_SUB_BUCKETS_NUMBER;
+
+  return LATENCY_SUB_BUCKETS_NUMBER + ( mostSignificantBit - LATENCY_SUB_BUCKET_BITS ) * LATENCY_HALF_SUB_BUCKETS_NUMBER + subBucketIndex;
+}
+
+void LatencyHistograms_Reset( LatencyHistogram* histogram )
+{
+  if( histogram == NULL ) return;
+
+  memset( histogram, 0, sizeof(LatencyHistogram) );
+  histogram->minValue = UINT64_MAX;
+}
+
+void LatencyHistograms_Record( LatencyHistogram* histogram, uint64_t value )
+{
+  if( histogram == NULL ) return;
+
+  histogram->countsList[ GetBucketIndex( value ) ]++;
+  histogram->totalCount++;
+
+  if( value < histogram->minValue ) histogram->minValue = value;
+  if( value > histogram->maxValue ) histogram->maxValue = value;
+}
+
+// Highest value that falls into the given bucket
+uint64_t LatencyHistograms_GetBucketValue( size_t bucketIndex )
+{
+  if( bucketIndex < LATENCY_SUB_BUCKETS_NUMBER ) return (uint64_t) bucketIndex;
+
+  if( bucketIndex >= LATENCY_BUCKETS_NUMBER ) bucketIndex = LATENCY_BUCKETS_NUMBER - 1;
+
+  size_t logBucketIndex = bucketIndex - LATENCY_SUB_BUCKETS_NUMBER;
+  int subBucketShift = (int) ( logBucketIndex / LATENCY_HALF_SUB_BUCKETS_NUMBER ) + 1;
+  uint64_t subBucketIndex = (uint64_t) ( logBucketIndex % LATENCY_HALF_SUB_BUCKETS_NUMBER ) + LATENCY_HALF_SUB_BUCKETS_NUMBER;
+
+  return ( ( subBucketIndex + 1 ) << subBucketShift ) - 1;
+}
+
+uint64_t LatencyHistograms_GetValueAtPercentile( LatencyHistogram* histogram, double percentile )
+{
+  if( histogram == NULL ) return 0;
+  if( histogram->totalCount == 0 ) return 0;
+
+  if( percentile > 100.0 ) percentile = 100.0;
+  uint64_t targetCount = (uint64_t) ( percentile / 100.0 * histogram->totalCount + 0.5 );
+  if( targetCount == 0 ) targetCount = 1;
+
+  uint64_t accumulatedCount = 0;
+  for( size_t bucketIndex = 0; bucketIndex < LATENCY_BUCKETS_NUMBER; bucketIndex++ )
+  {
+    accumulatedCount += histogram->countsList[ bucketIndex ];
+    if( accumulatedCount >= targetCount )
+    {
+      uint64_t bucketValue = LatencyHistograms_GetBucketValue( bucketIndex );
+      return ( bucketValue < histogram->maxValue ) ? bucketValue : histogram->maxValue;
+    }
+  }
+
+  return histogram->maxValue;
+}
+
+bool LatencyHistograms_GetStats( LatencyHistogram* histogram, LatencyStats* ref_stats )
+{
+  if( histogram == NULL || ref_stats == NULL ) return false;
+
+  ref_stats->count = histogram->totalCount;
+  ref_stats->minValue = ( histogram->totalCount > 0 ) ? histogram->minValue : 0;
+  ref_stats->medianValue = LatencyHistograms_GetValueAtPercentile( histogram, 50.0 );
+  ref_stats->percentile99Value = LatencyHistograms_GetValueAtPercentile( histogram, 99.0 );
+  ref_stats->percentile999Value = LatencyHistograms_GetValueAtPercentile( histogram, 99.9 );
+  ref_stats->maxValue = histogram->maxValue;
+
+  return true;
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+/////  Fixed size log-linear (HDR style) histograms for durations recorded  /////
+/////  on real-time paths, without allocation or locking                  /////
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LATENCY_HISTOGRAMS_H
+#define LATENCY_HISTOGRAMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+// Each power of 2 range is split in 16 linear sub-buckets (worst relative error: 1/16)
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS_NUMBER ( 1 << LATENCY_SUB_BUCKET_BITS )
+#define LATENCY_HALF_SUB_BUCKETS_NUMBER ( LATENCY_SUB_BUCKETS_NUMBER / 2 )
+// Values up to 2^36 ns (~68 s) are resolved. Bigger ones are counted on the last bucket
+#define LATENCY_MAX_VALUE_BITS 36
+#define LATENCY_BUCKETS_NUMBER ( LATENCY_SUB_BUCKETS_NUMBER + ( LATENCY_MAX_VALUE_BITS - LATENCY_SUB_BUCKET_BITS ) * LATENCY_HALF_SUB_BUCKETS_NUMBER )
+
+// Counts may be read by other threads while recording: summaries are approximate, but never corrupted
+typedef struct _LatencyHistogram
+{
+  uint32_t countsList[ LATENCY_BUCKETS_NUMBER ];
+  uint64_t totalCount;
+  uint64_t minValue;
+  uint64_t maxValue;
+}
+LatencyHistogram;
+
+typedef struct _LatencyStats
+{
+  uint64_t count;
+  uint64_t minValue;
+  uint64_t medianValue;
+  uint64_t percentile99Value;
+  uint64_t percentile999Value;
+  uint64_t maxValue;
+}
+LatencyStats;
+
+#define LATENCY_HISTOGRAMS_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( void, Namespace, Reset, LatencyHistogram* ) \
+        INIT_FUNCTION( void, Namespace, Record, LatencyHistogram*, uint64_t ) \
+        INIT_FUNCTION( uint64_t, Namespace, GetValueAtPercentile, LatencyHistogram*, double ) \
+        INIT_FUNCTION( uint64_t, Namespace, GetBucketValue, size_t ) \
+        INIT_FUNCTION( bool, Namespace, GetStats, LatencyHistogram*, LatencyStats* )
+
+DECLARE_NAMESPACE_INTERFACE( LatencyHistograms, LATENCY_HISTOGRAMS_INTERFACE )
+
+
+#endif // LATENCY_HISTOGRAMS_H
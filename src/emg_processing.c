@@ -173,7 +173,7 @@ double EMGProcessing_GetJointTorque( int jointID, double jointAngle, double join
     //jointTorque += GetMuscleTorque( joint->musclesList[ muscleIndex ], normalizedSignalsList[ muscleIndex ], jointAngle );
   }
   
-  double samplingTime = Timing.GetExecTimeSeconds();
+  double samplingTime = TIMESTAMP_TO_SECONDS( Timing.GetExecTimeNanoseconds() );
   
   if( joint->currentLogID != DATA_LOG_INVALID_ID )
   {
@@ -21,6 +21,7 @@
 
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "ip_network/async_ip_network.h"
 
@@ -28,20 +29,47 @@
 
 #include "time/timing.h"
 #include "threads/thread_safe_data.h"
+#include "threads/atomic_operations.h"
 
   
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                      DATA STRUCTURES                                            /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
   
-const size_t QUEUE_MAX_ITEMS = 10;
-  
+// Lock-free ring queues: single producer (reading thread) for read queues, any caller thread for write queues
+#define QUEUE_MAX_ITEMS 16
+
+// Write thread wakes on queued messages (process private event). Waiting only times out to retry connections with full
+// socket buffers
+const uint64_t WRITE_RETRY_INTERVAL_NS = 1000000;
+const uint64_t WRITE_IDLE_TIMEOUT_NS = 100000000;
+// Direct sends spin this many times on a busy sending owner before yielding the processor
+#define SENDING_MAX_SPINS 100
+// Read thread waits for events for at most this time. Dispatching holds a lock, so connections are not closed meanwhile,
+// but the wait itself does not (where supported), so closings do not wait for it
+const unsigned int DISPATCH_TIMEOUT_MS = 100;
+  
+// Write queue item: only the message length is sent, on connections with prefixed framing
+typedef struct _QueuedMessage
+{
+  uint16_t length;
+  char data[ IP_MAX_MESSAGE_LENGTH ];
+}
+QueuedMessage;
+
 // Structure that stores read and write message queues for a IPConnection struct used asyncronously
 struct _AsyncIPConnectionData
 {
+  unsigned long id;
   IPConnection baseConnection;
-  ThreadSafeQueue readQueue;
-  ThreadSafeQueue writeQueue;
+  RingQueue readQueue;
+  RingQueue writeQueue;
+  QueuedMessage outgoingMessagesList[ QUEUE_MAX_ITEMS ];   // Dequeued messages, kept while they do not fit the socket buffer
+  size_t outgoingIndex, outgoingNumber;
+  bool isWriteBlocked;
+  bool isSending;                                          // Socket sending (and outgoing messages) ownership
+  bool hasPendingWrites;                                   // Queued messages left by a thread that found sending busy
+  bool hasFailed;                                          // Sending error: not written anymore, and closed by the write thread
 };
 
 // Thread for asyncronous connections update
@@ -49,8 +77,23 @@ static Thread globalReadThread = THREAD_INVALID_HANDLE;
 static Thread globalWriteThread = THREAD_INVALID_HANDLE;
 static volatile bool isNetworkRunning = false;
 
-// Internal (private) list of asyncronous connections created (accessible only by index)
-static ThreadSafeMap globalConnectionsList = NULL;
+// Signaled when new messages or clients are queued for reading
+static WakeEvent readEvent = NULL;
+// Signaled when new messages are queued for writing
+static WakeEvent writeEvent = NULL;
+static size_t blockedWritesCount = 0;
+
+static ThreadLock dispatchLock = NULL;
+static size_t closingRequestsCount = 0;
+
+// Connections that failed sending, to be closed by the write thread (later calls with their IDs just fail)
+static size_t failedConnectionsCount = 0;
+static unsigned long failedConnectionIDsList[ QUEUE_MAX_ITEMS ];
+static size_t failedConnectionIDsNumber = 0;
+
+// Internal (private) list of asyncronous connections created (accessible only by index). Lookups and iterations
+// never block: connections are only freed (on closing) after all threads using them are done
+static SnapshotMap globalConnectionsList = NULL;
 
 DEFINE_NAMESPACE_INTERFACE( AsyncIPNetwork, ASYNC_IP_NETWORK_INTERFACE )
 
@@ -62,26 +105,18 @@ DEFINE_NAMESPACE_INTERFACE( AsyncIPNetwork, ASYNC_IP_NETWORK_INTERFACE )
 // Returns the number of asyncronous connections created (method for encapsulation purposes)
 size_t AsyncIPNetwork_GetActivesNumber()
 {
-  static size_t activeConnectionsNumber = 0;
-  
-  size_t globalConnectionsListSize = ThreadSafeMaps.GetItemsCount( globalConnectionsList );
-  for( size_t connectionIndex = 0; connectionIndex < globalConnectionsListSize; connectionIndex++ )
-  {
-    if( ThreadSafeMaps.GetItem( globalConnectionsList, connectionIndex, NULL ) ) activeConnectionsNumber++;
-  }
-  
-  return activeConnectionsNumber;
+  return SnapshotMaps.GetItemsCount( globalConnectionsList );
 }
 
 // Returns number of clients for the server connection of given index
 size_t AsyncIPNetwork_GetClientsNumber( unsigned long serverID )
 {
-  AsyncIPConnection connection = (AsyncIPConnection) ThreadSafeMaps.AquireItem( globalConnectionsList, serverID );
+  AsyncIPConnection connection = (AsyncIPConnection) SnapshotMaps.AquireItem( globalConnectionsList, serverID );
   if( connection == NULL ) return 0;
   
   size_t clientsNumber = IPNetwork.GetClientsNumber( connection->baseConnection );
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, serverID );
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
 
   return clientsNumber;
 }
@@ -89,12 +124,14 @@ size_t AsyncIPNetwork_GetClientsNumber( unsigned long serverID )
 // Returns address string (host and port) for the connection of given index
 char* AsyncIPNetwork_GetAddress( unsigned long connectionID )
 {
-  AsyncIPConnection connection = (AsyncIPConnection) ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
-  if( connection == NULL ) return 0;
+  AsyncIPConnection connection = (AsyncIPConnection) SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
+  if( connection == NULL ) return NULL;
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
+  char* addressString = IPNetwork.GetAddress( connection->baseConnection );
   
-  return IPNetwork.GetAddress( connection->baseConnection );
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+  
+  return addressString;
 }
 
 
@@ -105,13 +142,16 @@ char* AsyncIPNetwork_GetAddress( unsigned long connectionID )
 // Forward definition
 static void* AsyncReadQueues( void* );
 static void* AsyncWriteQueues( void* );
+static bool HandleConnectionEvents( IPConnection, uint8_t, void* );
 
 // Create new AsyncIPConnection structure (from a given IPConnection structure) and add it to the internal list
 static unsigned long AddAsyncConnection( IPConnection baseConnection )
 {
   if( globalConnectionsList == NULL ) 
   {
-    globalConnectionsList = ThreadSafeMaps.Create( TSMAP_INT, sizeof(AsyncIPConnectionData) );
+    globalConnectionsList = SnapshotMaps.Create( sizeof(AsyncIPConnectionData) );
+    writeEvent = WakeEvents.Create( NULL );
+    dispatchLock = ThreadLocks.Create();
     globalReadThread = Threading.StartThread( AsyncReadQueues, (void*) globalConnectionsList, THREAD_JOINABLE );
     globalWriteThread = Threading.StartThread( AsyncWriteQueues, (void*) globalConnectionsList, THREAD_JOINABLE );
   }
@@ -121,10 +161,15 @@ static unsigned long AddAsyncConnection( IPConnection baseConnection )
   AsyncIPConnectionData connectionData = { .baseConnection = baseConnection };
   
   size_t readQueueItemSize = ( !IPNetwork.IsServer( baseConnection ) ) ? IP_MAX_MESSAGE_LENGTH : sizeof(unsigned long);
-  connectionData.readQueue = ThreadSafeQueues.Create( QUEUE_MAX_ITEMS, readQueueItemSize );  
-  connectionData.writeQueue = ThreadSafeQueues.Create( QUEUE_MAX_ITEMS, IP_MAX_MESSAGE_LENGTH );
+  connectionData.readQueue = RingQueues.Create( RING_QUEUE_SPSC, QUEUE_MAX_ITEMS, readQueueItemSize );  
+  connectionData.writeQueue = RingQueues.Create( RING_QUEUE_MPSC, QUEUE_MAX_ITEMS, sizeof(QueuedMessage) );
+  
+  unsigned long connectionID = SnapshotMaps.AddItem( globalConnectionsList, &connectionData );  
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
+  connection->id = connectionID;
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
   
-  unsigned long connectionID = ThreadSafeMaps.SetItem( globalConnectionsList, baseConnection, &connectionData );  
+  IPNetwork.SetEventCallback( baseConnection, HandleConnectionEvents, (void*) (uintptr_t) connectionID );
   
   /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "last connection: %p (ID %lu)", baseConnection, connectionID );
   
@@ -147,31 +192,70 @@ unsigned long AsyncIPNetwork_OpenConnection( uint8_t connectionType, const char*
 
 size_t AsyncIPNetwork_SetMessageLength( unsigned long connectionID, size_t messageLength )
 {
-  AsyncIPConnection connection = ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
   if( connection == NULL ) return 0;
   
   messageLength = IPNetwork.SetMessageLength( connection->baseConnection, messageLength );
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
   
   return messageLength;
 }
 
+// Message framing of the connection (server connections pass it on to their new clients)
+void AsyncIPNetwork_SetFraming( unsigned long connectionID, uint8_t framing )
+{
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
+  if( connection == NULL ) return;
+  
+  IPNetwork.SetFraming( connection->baseConnection, framing );
+  
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                     ASYNCRONOUS UPDATE                                          /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void ReadToQueue( unsigned long connectionID )
+// Sending ownership is taken without locks. Queue writers that find it busy leave their messages to the current owner, 
+// that signals the write thread on release. Direct sends wait for it (owners only hold it for non blocking calls): 
+// spinning briefly, then yielding the processor, so that a preempted owner gets to release it
+static bool BeginSending( AsyncIPConnection connection, bool waitOwner )
 {
-  AsyncIPConnection connection = ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
-  if( connection == NULL ) return;
+  size_t spinsCount = 0;
+  while( ATOMIC_EXCHANGE( &(connection->isSending), true ) )
+  {
+    if( waitOwner ) 
+    {
+      if( ++spinsCount < SENDING_MAX_SPINS ) ATOMIC_SPIN_PAUSE();
+      else Threading.YieldThread();
+      continue;
+    }
+    ATOMIC_STORE( &(connection->hasPendingWrites), true );
+    // Paired with EndSending: either the owner sees the pending writes or this thread sees sending released
+    ATOMIC_THREAD_FENCE();
+    if( ATOMIC_LOAD( &(connection->isSending) ) ) return false;
+  }
   
-  // Do not proceed if queue is full
-  if( ThreadSafeQueues.GetItemsCount( connection->readQueue ) >= QUEUE_MAX_ITEMS ) 
+  return true;
+}
+
+static void EndSending( AsyncIPConnection connection )
+{
+  ATOMIC_STORE( &(connection->isSending), false );
+  ATOMIC_THREAD_FENCE();
+  if( ATOMIC_LOAD( &(connection->hasPendingWrites) ) )
   {
-    ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
-    return;
+    ATOMIC_STORE( &(connection->hasPendingWrites), false );
+    WakeEvents.Signal( writeEvent );
   }
+}
+
+// Returns true if the available message could not be read (full queue)
+static bool ReadToQueue( AsyncIPConnection connection )
+{
+  // Do not proceed if queue is full
+  if( RingQueues.GetItemsCount( connection->readQueue ) >= QUEUE_MAX_ITEMS ) return true;
   
   if( IPNetwork.IsDataAvailable( connection->baseConnection ) )
   {
@@ -184,28 +268,44 @@ static void ReadToQueue( unsigned long connectionID )
         if( addressString != NULL )
         {
           /*DEBUG_UPDATE*/DEBUG_PRINT( "client accepted: server: %p - client: %p - address: %s", connection, newClient, addressString );
-          ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
           unsigned long newClientID = AddAsyncConnection( newClient );
-          ThreadSafeQueues.Enqueue( connection->readQueue, &newClientID, TSQUEUE_WAIT );
-          return;
+          RingQueues.Enqueue( connection->readQueue, &newClientID, TSQUEUE_NOWAIT );
+          WakeEvents.Signal( readEvent );
         }
       }
     }
     else
     {
+      // Binary messages may start with a null byte (e.g. robots info requests)
       char* lastMessage = IPNetwork.ReceiveMessage( connection->baseConnection );
       if( lastMessage != NULL )
       {
-        if( lastMessage[ 0 ] != '\0' )
-        {
-          DEBUG_UPDATE( "message received: client %p received message: %s", connection, lastMessage );
-          ThreadSafeQueues.Enqueue( connection->readQueue, (void*) lastMessage, TSQUEUE_WAIT );
-        }
+        DEBUG_UPDATE( "message received: client %p received message: %s", connection, lastMessage );
+        RingQueues.Enqueue( connection->readQueue, (void*) lastMessage, TSQUEUE_NOWAIT );
+        WakeEvents.Signal( readEvent );
       }
     }
   }
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
+  return false;
+}
+
+static void WriteFromQueue( void* );
+
+// Called on the read thread for connections with events: accepting, reading and writing (when the socket becomes 
+// writable again) are handled in the same loop
+static bool HandleConnectionEvents( IPConnection baseConnection, uint8_t events, void* connectionID )
+{
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, (unsigned long) (uintptr_t) connectionID );
+  if( connection == NULL ) return false;
+  
+  if( events & IP_EVENT_WRITE ) WriteFromQueue( connection );
+  
+  bool isReadBlocked = ( events & IP_EVENT_READ ) ? ReadToQueue( connection ) : false;
+  
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+  
+  return isReadBlocked;
 }
 
 // Loop of message reading (storing in queue) to be called asyncronously for client/server connections
@@ -216,42 +316,101 @@ static void* AsyncReadQueues( void* args )
   /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "reading client/message queues on thread %lx", THREAD_ID );
   
   while( isNetworkRunning )
-  {    
-    // Blocking call
-    if( IPNetwork.WaitEvent( 5000 ) > 0 ) 
-      ThreadSafeMaps.RunForAllKeys( globalConnectionsList, ReadToQueue );
+  {
+    // Let pending connection closings take the lock
+    while( ATOMIC_LOAD( &closingRequestsCount ) > 0 ) Timing.Delay( 1 );
+    
+    // Blocking call. Dispatching only waits if the backend could not wait without it
+    unsigned int dispatchTimeout = IPNetwork.WaitReady( DISPATCH_TIMEOUT_MS ) ? 0 : DISPATCH_TIMEOUT_MS;
+    
+    ThreadLocks.Aquire( dispatchLock );
+    IPNetwork.DispatchEvents( dispatchTimeout );
+    ThreadLocks.Release( dispatchLock );
   }
   
   return NULL;
 }
 
-static void WriteFromQueue( unsigned long connectionID )
+// Send all queued messages of the given connection, coalesced (prefixed framing), until its socket buffer is full. 
+// Messages that did not fit are kept and sent first when the socket becomes writable again (write event) or on the next retry
+static void WriteFromQueue( void* ref_connection )
 {
-  AsyncIPConnection connection = ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
-  if( connection == NULL ) return;
+  AsyncIPConnection connection = (AsyncIPConnection) ref_connection;
+  
+  if( ATOMIC_LOAD( &(connection->hasFailed) ) ) return;
   
-  char firstMessage[ IP_MAX_MESSAGE_LENGTH ];
+  if( !connection->isWriteBlocked && RingQueues.GetItemsCount( connection->writeQueue ) == 0 ) return;
   
-  // Do not proceed if queue is empty
-  if( ThreadSafeQueues.GetItemsCount( connection->writeQueue ) == 0 )
+  if( !BeginSending( connection, false ) ) return;
+  
+  bool wasWriteBlocked = connection->isWriteBlocked;
+  connection->isWriteBlocked = false;
+  while( true )
   {
-    //DEBUG_UPDATE( "connection socket %d write cache empty", writer->baseConnection->socket->fd );
-    ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
-    return;
+    if( connection->outgoingIndex == connection->outgoingNumber )
+    {
+      connection->outgoingIndex = connection->outgoingNumber = 0;
+      while( connection->outgoingNumber < QUEUE_MAX_ITEMS && 
+             RingQueues.Dequeue( connection->writeQueue, (void*) &(connection->outgoingMessagesList[ connection->outgoingNumber ]), TSQUEUE_NOWAIT ) )
+        connection->outgoingNumber++;
+      if( connection->outgoingNumber == 0 ) break;
+    }
+    
+    IPMessagePart messagesList[ QUEUE_MAX_ITEMS ];
+    size_t messagesNumber = 0;
+    for( size_t messageIndex = connection->outgoingIndex; messageIndex < connection->outgoingNumber; messageIndex++ )
+    {
+      QueuedMessage* message = &(connection->outgoingMessagesList[ messageIndex ]);
+      messagesList[ messagesNumber++ ] = (IPMessagePart) { .data = message->data, .length = message->length };
+    }
+    
+    int sentMessagesNumber = IPNetwork.SendMessages( connection->baseConnection, messagesList, messagesNumber );
+    if( sentMessagesNumber == -1 )
+    {
+      if( wasWriteBlocked ) (void) ATOMIC_FETCH_ADD( &blockedWritesCount, -1 );
+      ATOMIC_STORE( &(connection->hasFailed), true );
+      (void) ATOMIC_FETCH_ADD( &failedConnectionsCount, 1 );
+      EndSending( connection );
+      return;
+    }
+    
+    connection->outgoingIndex += (size_t) sentMessagesNumber;
+    if( connection->outgoingIndex < connection->outgoingNumber )
+    {
+      connection->isWriteBlocked = true;
+      break;
+    }
   }
   
-  ThreadSafeQueues.Dequeue( connection->writeQueue, (void*) firstMessage, TSQUEUE_WAIT );
+  // Blocked connections are retried periodically, for backends without write events
+  if( connection->isWriteBlocked && !wasWriteBlocked ) (void) ATOMIC_FETCH_ADD( &blockedWritesCount, 1 );
+  else if( !connection->isWriteBlocked && wasWriteBlocked ) (void) ATOMIC_FETCH_ADD( &blockedWritesCount, -1 );
   
-  //DEBUG_UPDATE( "connection socket %d sending message: %s", writer->baseConnection->socket->fd, firstMessage );
+  EndSending( connection );
+}
+
+static void CollectFailedConnection( void* ref_connection )
+{
+  AsyncIPConnection connection = (AsyncIPConnection) ref_connection;
+  
+  if( failedConnectionIDsNumber >= QUEUE_MAX_ITEMS ) return;
+  
+  if( ATOMIC_LOAD( &(connection->hasFailed) ) ) failedConnectionIDsList[ failedConnectionIDsNumber++ ] = connection->id;
+}
+
+static bool RemoveConnection( unsigned long );
+
+// Failed connections are closed outside the items iteration (remaining ones go on the next call)
+static void CloseFailedConnections( void )
+{
+  failedConnectionIDsNumber = 0;
+  SnapshotMaps.RunForAllItems( globalConnectionsList, CollectFailedConnection );
   
-  if( IPNetwork.SendMessage( connection->baseConnection, firstMessage ) == -1 )
+  for( size_t failedIndex = 0; failedIndex < failedConnectionIDsNumber; failedIndex++ )
   {
-    ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
-    ThreadSafeMaps.RemoveItem( globalConnectionsList, connectionID );
-    return;
+    ERROR_PRINT( "closing connection %lu after sending failure", failedConnectionIDsList[ failedIndex ] );
+    (void) RemoveConnection( failedConnectionIDsList[ failedIndex ] );
   }
-  
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
 }
 
 // Loop of message writing (removing in order from queue) to be called asyncronously for client connections
@@ -263,9 +422,11 @@ static void* AsyncWriteQueues( void* args )
   
   while( isNetworkRunning )
   {
-    ThreadSafeMaps.RunForAllKeys( globalConnectionsList, WriteFromQueue );
+    uint64_t waitTimeout = ( ATOMIC_LOAD( &blockedWritesCount ) > 0 ) ? WRITE_RETRY_INTERVAL_NS : WRITE_IDLE_TIMEOUT_NS;
+    if( WakeEvents.Wait( writeEvent, waitTimeout ) || ATOMIC_LOAD( &blockedWritesCount ) > 0 )
+      SnapshotMaps.RunForAllItems( globalConnectionsList, WriteFromQueue );
     
-    Timing.Delay( 1 );
+    if( ATOMIC_LOAD( &failedConnectionsCount ) > 0 ) CloseFailedConnections();
   }
   
   return NULL;//(void*) 1;
@@ -283,100 +444,208 @@ char* AsyncIPNetwork_ReadMessage( unsigned long clientID )
   static char messageData[ IP_MAX_MESSAGE_LENGTH ];
   char* firstMessage = NULL;
   
-  AsyncIPConnection client = ThreadSafeMaps.AquireItem( globalConnectionsList, clientID );
+  AsyncIPConnection client = SnapshotMaps.AquireItem( globalConnectionsList, clientID );
   if( client != NULL )
   {
     //DEBUG_PRINT( "is connection %p index %lu a client: %s", client, clientID, IPNetwork.IsServer( client->baseConnection ) ? "no" : "yes" );
     if( !IPNetwork.IsServer( client->baseConnection ) )
     {
-      //DEBUG_PRINT( "messages available for connection %p index %lu: %lu", client, clientID, ThreadSafeQueues.GetItemsCount( client->readQueue ) );
-      if( ThreadSafeQueues.GetItemsCount( client->readQueue ) > 0 )
+      //DEBUG_PRINT( "messages available for connection %p index %lu: %lu", client, clientID, RingQueues.GetItemsCount( client->readQueue ) );
+      if( RingQueues.Dequeue( client->readQueue, (void*) &messageData, TSQUEUE_NOWAIT ) )
       {
-        ///*DEBUG_UPDATE*/DEBUG_PRINT( "message from connection index %lu: %s", clientID, firstMessage );
         firstMessage = (char*) &messageData;
-        ThreadSafeQueues.Dequeue( client->readQueue, firstMessage, TSQUEUE_WAIT );
+        ///*DEBUG_UPDATE*/DEBUG_PRINT( "message from connection index %lu: %s", clientID, firstMessage );
       }
     }
     else
       ERROR_PRINT( "connection index %lu is not of a client connection", clientID );
   }
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, clientID );
+  SnapshotMaps.ReleaseItem( globalConnectionsList, client );
   
   return firstMessage;
 }
 
-bool AsyncIPNetwork_WriteMessage( unsigned long connectionID, const char* message )
+// Queue message of given length (sent padded to the connection message length with fixed framing)
+// Message is copied directly into its queue slot. Returns false (message dropped) if the write queue is full
+bool AsyncIPNetwork_WriteMessage( unsigned long connectionID, const char* message, size_t messageLength )
 {
-  AsyncIPConnection connection = ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
   if( connection == NULL ) return false;
   
-  if( ThreadSafeQueues.GetItemsCount( connection->writeQueue ) >= QUEUE_MAX_ITEMS )
+  if( ATOMIC_LOAD( &(connection->hasFailed) ) )
+  {
+    SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+    return false;
+  }
+  
+  QueuedMessage* queuedMessage = (QueuedMessage*) RingQueues.ReserveItem( connection->writeQueue, TSQUEUE_NOWAIT );
+  if( queuedMessage == NULL )
+  {
     /*DEBUG_UPDATE*/DEBUG_PRINT( "connection index %lu write queue is full", connectionID );
+    SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+    return false;
+  }
   
-  ThreadSafeQueues.Enqueue( connection->writeQueue, (void*) message, TSQUEUE_NOWAIT );
+  queuedMessage->length = (uint16_t) ( ( messageLength < IP_MAX_MESSAGE_LENGTH ) ? messageLength : IP_MAX_MESSAGE_LENGTH );
+  memcpy( queuedMessage->data, message, queuedMessage->length );
+  RingQueues.CommitItem( connection->writeQueue, queuedMessage );
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+  
+  WakeEvents.Signal( writeEvent );
   
   return true;
 }
 
+// Send message parts right away, bypassing the write queue: parts data is only required to stay valid during the call.
+// Sending is serialized with the write thread, waiting for it to finish sending queued messages
+bool AsyncIPNetwork_WriteMessageParts( unsigned long connectionID, const IPMessagePart* partsList, size_t partsNumber )
+{
+  AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionID );
+  if( connection == NULL ) return false;
+  
+  (void) BeginSending( connection, true );
+  int sendResult = IPNetwork.SendMessageParts( connection->baseConnection, partsList, partsNumber );
+  EndSending( connection );
+  
+  SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+  
+  return ( sendResult == 0 );
+}
+
+// Send each message right away to the connection of same index, as with WriteMessageParts, but in a single batch
+// (coalesced system calls for clients of the same UDP server). Invalid or repeated connection indexes are skipped.
+// Returns the number of messages sent
+size_t AsyncIPNetwork_WriteMessagesBatch( const unsigned long* connectionIDsList, const IPMessage* messagesList, size_t messagesNumber )
+{
+  AsyncIPConnection batchAsyncConnectionsList[ IP_MAX_BATCH_MESSAGES ];
+  IPConnection batchConnectionsList[ IP_MAX_BATCH_MESSAGES ];
+  IPMessage batchMessagesList[ IP_MAX_BATCH_MESSAGES ];
+  
+  if( messagesNumber > IP_MAX_BATCH_MESSAGES ) messagesNumber = IP_MAX_BATCH_MESSAGES;
+  
+  // Connections (and their sending) are held until the whole batch is sent
+  size_t batchMessagesNumber = 0;
+  for( size_t messageIndex = 0; messageIndex < messagesNumber; messageIndex++ )
+  {
+    AsyncIPConnection connection = SnapshotMaps.AquireItem( globalConnectionsList, connectionIDsList[ messageIndex ] );
+    if( connection == NULL ) continue;
+    
+    bool isRepeated = false;
+    for( size_t batchIndex = 0; batchIndex < batchMessagesNumber; batchIndex++ )
+    {
+      if( batchAsyncConnectionsList[ batchIndex ] == connection ) isRepeated = true;
+    }
+    if( isRepeated ) 
+    {
+      SnapshotMaps.ReleaseItem( globalConnectionsList, connection );
+      continue;
+    }
+    
+    (void) BeginSending( connection, true );
+    
+    batchAsyncConnectionsList[ batchMessagesNumber ] = connection;
+    batchConnectionsList[ batchMessagesNumber ] = connection->baseConnection;
+    batchMessagesList[ batchMessagesNumber ] = messagesList[ messageIndex ];
+    batchMessagesNumber++;
+  }
+  
+  size_t sentMessagesNumber = IPNetwork.SendMessagesBatch( batchConnectionsList, batchMessagesList, batchMessagesNumber );
+  
+  for( size_t batchIndex = 0; batchIndex < batchMessagesNumber; batchIndex++ )
+  {
+    EndSending( batchAsyncConnectionsList[ batchIndex ] );
+    SnapshotMaps.ReleaseItem( globalConnectionsList, batchAsyncConnectionsList[ batchIndex ] );
+  }
+  
+  return sentMessagesNumber;
+}
+
 unsigned long AsyncIPNetwork_GetClient( unsigned long serverID )
 {
   unsigned long firstClient = (unsigned long) IP_CONNECTION_INVALID_ID;
 
-  AsyncIPConnection server = ThreadSafeMaps.AquireItem( globalConnectionsList, serverID );
+  AsyncIPConnection server = SnapshotMaps.AquireItem( globalConnectionsList, serverID );
   if( server != NULL )
   {
     if( IPNetwork.IsServer( server->baseConnection ) )
     {
-      if( ThreadSafeQueues.GetItemsCount( server->readQueue ) > 0 )
-      {
-        ThreadSafeQueues.Dequeue( server->readQueue, &firstClient, TSQUEUE_WAIT );
-    
+      if( RingQueues.Dequeue( server->readQueue, &firstClient, TSQUEUE_NOWAIT ) )
         /*DEBUG_UPDATE*/DEBUG_PRINT( "new client index from connection index %lu: %lu", serverID, firstClient ); 
-      }
     }
     else
       /*ERROR_EVENT*/ERROR_PRINT( "connection index %d is not a server index", serverID );
     
-    ThreadSafeMaps.ReleaseItem( globalConnectionsList, serverID );
+    SnapshotMaps.ReleaseItem( globalConnectionsList, server );
   }
   
   return firstClient; 
 }
 
+// Event to be signaled (from the reading thread) whenever data is available for ReadMessage/GetClient calls
+void AsyncIPNetwork_SetReadEvent( WakeEvent event )
+{
+  readEvent = event;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                           ENDING                                                /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Handle socket closing and structures destruction for the given index corresponding connection
-void AsyncIPNetwork_CloseConnection( unsigned long connectionID )
+// Close socket and destroy structures of the given connection (from any thread but the read one)
+static bool RemoveConnection( unsigned long connectionID )
 {
-  AsyncIPConnection connection = ThreadSafeMaps.AquireItem( globalConnectionsList, connectionID );
-  if( connection == NULL ) return;
+  (void) ATOMIC_FETCH_ADD( &closingRequestsCount, 1 );
+  ThreadLocks.Aquire( dispatchLock );
+  (void) ATOMIC_FETCH_ADD( &closingRequestsCount, -1 );
   
-  IPNetwork.CloseConnection( connection->baseConnection );
-  connection->baseConnection = NULL;
+  // Waits for other threads still using the connection
+  AsyncIPConnectionData connectionData;
+  if( !SnapshotMaps.RemoveItem( globalConnectionsList, connectionID, &connectionData ) ) 
+  {
+    ThreadLocks.Release( dispatchLock );
+    return false;
+  }
   
-  ThreadSafeQueues.Discard( connection->readQueue );
-  ThreadSafeQueues.Discard( connection->writeQueue );
+  IPNetwork.CloseConnection( connectionData.baseConnection );
   
-  ThreadSafeMaps.ReleaseItem( globalConnectionsList, connectionID );
+  if( connectionData.isWriteBlocked ) (void) ATOMIC_FETCH_ADD( &blockedWritesCount, -1 );
+  if( connectionData.hasFailed ) (void) ATOMIC_FETCH_ADD( &failedConnectionsCount, -1 );
   
-  ThreadSafeMaps.RemoveItem( globalConnectionsList, connectionID );
+  RingQueues.Discard( connectionData.readQueue );
+  RingQueues.Discard( connectionData.writeQueue );
   
-  if( ThreadSafeMaps.GetItemsCount( globalConnectionsList ) == 0 )
+  ThreadLocks.Release( dispatchLock );
+  
+  return true;
+}
+
+// Handle socket closing and structures destruction for the given index corresponding connection. Connections already
+// closed after failures are just skipped, but network threads still end along with the last connection
+void AsyncIPNetwork_CloseConnection( unsigned long connectionID )
+{
+  if( globalConnectionsList == NULL ) return;
+  
+  (void) RemoveConnection( connectionID );
+  
+  if( SnapshotMaps.GetItemsCount( globalConnectionsList ) == 0 )
   {
     isNetworkRunning = false;
+    WakeEvents.Signal( writeEvent );
     /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "waiting update threads %p and %p for exit", globalReadThread, globalWriteThread );
     (void) Threading.WaitExit( globalReadThread, 5000 );
     /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "read thread for connection id %lu returned", connectionID );     
     (void) Threading.WaitExit( globalWriteThread, 5000 );
     /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "write thread for connection id %lu returned", connectionID ); 
     
-    ThreadSafeMaps.Discard( globalConnectionsList );
+    SnapshotMaps.Discard( globalConnectionsList );
     globalConnectionsList = NULL;
+    
+    WakeEvents.Discard( writeEvent );
+    writeEvent = NULL;
+    ThreadLocks.Discard( dispatchLock );
+    dispatchLock = NULL;
   }
   
   return;
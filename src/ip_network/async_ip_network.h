@@ -9,6 +9,7 @@
 #include "namespaces.h"
 
 #include "ip_network/ip_network.h"
+#include "threads/threading.h"
 
 #define IP_CONNECTION_INVALID_ID -1
   
@@ -30,11 +31,15 @@ typedef AsyncIPConnectionData* AsyncIPConnection;
         INIT_FUNCTION( size_t, Namespace, GetActivesNumber, void ) \
         INIT_FUNCTION( size_t, Namespace, GetClientsNumber, unsigned long ) \
         INIT_FUNCTION( size_t, Namespace, SetMessageLength, unsigned long, size_t ) \
+        INIT_FUNCTION( void, Namespace, SetFraming, unsigned long, uint8_t ) \
         INIT_FUNCTION( unsigned long, Namespace, OpenConnection, uint8_t, const char*, uint16_t ) \
         INIT_FUNCTION( void, Namespace, CloseConnection, unsigned long ) \
         INIT_FUNCTION( char*, Namespace, ReadMessage, unsigned long ) \
-        INIT_FUNCTION( bool, Namespace, WriteMessage, unsigned long, const char* ) \
-        INIT_FUNCTION( unsigned long, Namespace, GetClient, unsigned long )
+        INIT_FUNCTION( bool, Namespace, WriteMessage, unsigned long, const char*, size_t ) \
+        INIT_FUNCTION( bool, Namespace, WriteMessageParts, unsigned long, const IPMessagePart*, size_t ) \
+        INIT_FUNCTION( size_t, Namespace, WriteMessagesBatch, const unsigned long*, const IPMessage*, size_t ) \
+        INIT_FUNCTION( unsigned long, Namespace, GetClient, unsigned long ) \
+        INIT_FUNCTION( void, Namespace, SetReadEvent, WakeEvent )
 
 DECLARE_NAMESPACE_INTERFACE( AsyncIPNetwork, ASYNC_IP_NETWORK_INTERFACE )
 
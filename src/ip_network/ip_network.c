@@ -25,6 +25,10 @@
 ///// as server or client, using TCP or UDP protocols                           /////
 /////////////////////////////////////////////////////////////////////////////////////
 
+#if defined( __linux__ ) && !defined( _GNU_SOURCE )
+  #define _GNU_SOURCE                                           // recvmmsg/sendmmsg
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,14 +45,20 @@
   #define SHUT_RDWR SD_BOTH
   #define close( i ) closesocket( i )
   #define poll WSAPoll
+  #define IS_WOULD_BLOCK_ERROR() ( WSAGetLastError() == WSAEWOULDBLOCK )
+  #define IS_CONNECT_PENDING_ERROR() ( WSAGetLastError() == WSAEWOULDBLOCK )
   
   typedef SOCKET Socket;
+  
+  typedef WSABUF IOBuffer;
+  #define SET_IO_BUFFER( buffer, data, length ) do { WSABUF* ref_buffer = &(buffer); ref_buffer->buf = (char*) (data); ref_buffer->len = (ULONG) (length); } while( 0 )
 #else
   #include <fcntl.h>
   #include <unistd.h>
   #include <errno.h>
   #include <sys/types.h>
   #include <sys/socket.h>
+  #include <sys/uio.h>
   #include <sys/time.h>
   #include <stropts.h>
   #include <poll.h>
@@ -60,13 +70,52 @@
   const int INVALID_SOCKET = -1;
 
   typedef int Socket;
+  
+  #define IS_WOULD_BLOCK_ERROR() ( errno == EAGAIN || errno == EWOULDBLOCK )
+  #define IS_CONNECT_PENDING_ERROR() ( errno == EINPROGRESS )
+  
+  #ifdef __linux__
+    #define IP_NETWORK_MMSG                                     // Several datagrams per system call
+  #endif
+  
+  typedef struct iovec IOBuffer;
+  #define SET_IO_BUFFER( buffer, data, length ) do { struct iovec* ref_buffer = &(buffer); ref_buffer->iov_base = (void*) (data); ref_buffer->iov_len = (length); } while( 0 )
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_DONTWAIT
+  #define MSG_DONTWAIT 0
 #endif
 
 #define PORT_LENGTH 6                                           // Maximum length of short integer string representation
   
-#ifndef IP_NETWORK_LEGACY
+// Sockets events backend: edge triggered epoll (Linux), select (legacy) or poll
+#if defined( IP_NETWORK_EPOLL )
+  #include <sys/epoll.h>
+  // Ready events are kept until handled (read/accept would block), as edge triggered epoll does not report them again
+  typedef struct { Socket fd; uint8_t readyEvents; bool isPending; struct _IPConnectionData* owner; } SocketPoller;
+  typedef SocketPoller* SocketPollerSet[ 1024 ];                // Sockets with events not handled yet
+  #define MAX_WAITED_EVENTS 64
+#elif defined( IP_NETWORK_LEGACY )
+  typedef struct { Socket fd; } SocketPoller;
+  typedef fd_set SocketPollerSet;
+  #define IP_NETWORK_SELECT
+#else
   typedef struct pollfd SocketPoller;
   typedef SocketPoller SocketPollerSet[ 1024 ];
+  #define IP_NETWORK_POLL
+#endif
+#define MAX_DISPATCHED_EVENTS 16                                // Per socket and dispatch, for fairness between connections
+#define MAX_RECEIVED_DATAGRAMS 16                               // Per UDP server socket read
+
+// Length prefix of messages with IP_FRAMING_PREFIXED (network byte order)
+#define GET_FRAME_LENGTH( header ) ( ( (size_t) ((uint8_t*) (header))[ 0 ] << 8 ) | (size_t) ((uint8_t*) (header))[ 1 ] )
+#define SET_FRAME_LENGTH( header, length ) do { ((uint8_t*) (header))[ 0 ] = (uint8_t) ( (length) >> 8 ); \
+                                                ((uint8_t*) (header))[ 1 ] = (uint8_t) ( (length) & 0xFF ); } while( 0 )
+
+#ifndef IP_NETWORK_LEGACY
   #define ADDRESS_LENGTH INET6_ADDRSTRLEN                       // Maximum length of IPv6 address (host+port) string
   typedef struct sockaddr_in6 IPAddressData;                    // IPv6 structure can store both IPv4 and IPv6 data
   #define IS_IPV6_MULTICAST_ADDRESS( address ) ( ((sockaddr_in6*) address)->sin6_addr.s6_addr[ 0 ] == 0xFF )
@@ -74,8 +123,6 @@
                                                              ((IPAddressData*) address_1)->sin6_port == ((IPAddressData*) address_2)->sin6_port && \
                                                              memcmp( ((IPAddressData*) address_1)->sin6_addr.s6_addr, ((IPAddressData*) address_2)->sin6_addr.s6_addr, 16 ) == 0 )
 #else
-  typedef struct { Socket fd; } SocketPoller;
-  typedef fd_set SocketPollerSet;
   #define ADDRESS_LENGTH INET_ADDRSTRLEN + PORT_LENGTH          // Maximum length of IPv4 address (host+port) string
   typedef struct sockaddr_in IPAddressData;                     // Legacy mode only works with IPv4 addresses
   #define IS_IPV6_MULTICAST_ADDRESS( address ) false
@@ -108,6 +155,8 @@ struct _IPConnectionData
   };
   int (*ref_SendMessage)( IPConnection, const char* );
   void (*ref_Close)( IPConnection );
+  IPEventCallback ref_EventCallback;
+  void* eventData;
   IPAddressData addressData;
   size_t messageLength;
   union {
@@ -118,8 +167,23 @@ struct _IPConnectionData
     size_t* ref_clientsCount;
     IPConnection server;
   };
+  uint8_t framing;
+  char* streamBuffer;                             // Received data not handed over yet (prefixed framing or UDP datagram)
+  size_t streamStart, streamEnd;
+  struct _DatagramsBatch* datagramsBatch;         // Datagrams read at once by UDP servers, not delivered to their clients yet
+  char* outputBuffer;                             // Rest of partially sent data (TCP), sent before anything else
+  size_t outputLength;
 };
 
+typedef struct _DatagramsBatch
+{
+  char dataList[ MAX_RECEIVED_DATAGRAMS ][ IP_MAX_DATAGRAM_LENGTH ];
+  size_t lengthsList[ MAX_RECEIVED_DATAGRAMS ];
+  struct sockaddr_storage addressesList[ MAX_RECEIVED_DATAGRAMS ];
+  size_t datagramsNumber, datagramIndex;
+}
+DatagramsBatch;
+
 DEFINE_NAMESPACE_INTERFACE( IPNetwork, IP_NETWORK_INTERFACE )
 
 
@@ -128,11 +192,21 @@ DEFINE_NAMESPACE_INTERFACE( IPNetwork, IP_NETWORK_INTERFACE )
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static SocketPollerSet polledSocketsSet;
-#ifdef IP_NETWORK_LEGACY
+#ifdef IP_NETWORK_SELECT
 static SocketPollerSet activeSocketsSet;
 #endif
 static size_t polledSocketsNumber = 0;
 
+#ifdef IP_NETWORK_EPOLL
+static int epollFD = INVALID_SOCKET;
+// Sockets with events left by the last dispatch (only accessed by the dispatching thread)
+static bool hasPendingEvents = false;
+#else
+// Connections checked for events on dispatching
+static IPConnection* eventConnectionsList = NULL;
+static size_t eventConnectionsNumber = 0;
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 /////                        FORWARD DECLARATIONS                       /////
 /////////////////////////////////////////////////////////////////////////////
@@ -140,6 +214,7 @@ static size_t polledSocketsNumber = 0;
 
 static char* ReceiveTCPMessage( IPConnection );
 static char* ReceiveUDPMessage( IPConnection );
+static char* ReceiveTCPFrames( IPConnection );
 static int SendTCPMessage( IPConnection, const char* );
 static int SendUDPMessage( IPConnection, const char* );
 static int SendMessageAll( IPConnection, const char* );
@@ -150,6 +225,12 @@ static void CloseUDPServer( IPConnection );
 static void CloseTCPClient( IPConnection );
 static void CloseUDPClient( IPConnection );
 
+// Clients accepted by UDP servers share the server socket, whose datagrams are read (and routed) by the server
+static inline bool IsUDPServerClient( IPConnection connection )
+{
+  return ( connection->ref_Close == CloseUDPClient && connection->server != NULL );
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /////                         NETWORK UTILITIES                         /////
 /////////////////////////////////////////////////////////////////////////////
@@ -210,7 +291,7 @@ bool IPNetwork_IsServer( IPConnection connection )
 /////                             INITIALIZATION                             /////
 //////////////////////////////////////////////////////////////////////////////////
 
-#ifndef IP_NETWORK_LEGACY
+#ifdef IP_NETWORK_POLL
 static int CompareSockets( const void* ref_socket_1, const void* ref_socket_2 )
 {
   return ( ((SocketPoller*) ref_socket_1)->fd - ((SocketPoller*) ref_socket_2)->fd );
@@ -223,7 +304,17 @@ static IPConnection AddConnection( Socket socketFD, IPAddress address, uint8_t t
   IPConnection connection = (IPConnection) malloc( sizeof(IPConnectionData) );
   memset( connection, 0, sizeof(IPConnectionData) );
   
-  #ifndef IP_NETWORK_LEGACY
+  #if defined( IP_NETWORK_EPOLL )
+  connection->socket = (SocketPoller*) malloc( sizeof(SocketPoller) );
+  memset( connection->socket, 0, sizeof(SocketPoller) );
+  connection->socket->fd = socketFD;
+  connection->socket->owner = connection;
+  if( epollFD == INVALID_SOCKET ) epollFD = epoll_create1( 0 );
+  struct epoll_event socketEvent = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = connection->socket };
+  // UDP clients of a server share its (already registered) socket
+  if( epoll_ctl( epollFD, EPOLL_CTL_ADD, socketFD, &socketEvent ) == SOCKET_ERROR && errno != EEXIST )
+    ERROR_PRINT( "epoll_ctl: failed registering socket %d", socketFD );
+  #elif defined( IP_NETWORK_POLL )
   SocketPoller cmpPoller = { .fd = socketFD };
   connection->socket = (SocketPoller*) bsearch( &cmpPoller, polledSocketsSet, polledSocketsNumber, sizeof(SocketPoller), CompareSockets );
   if( connection->socket == NULL )
@@ -255,6 +346,7 @@ static IPConnection AddConnection( Socket socketFD, IPAddress address, uint8_t t
     connection->ref_SendMessage = SendMessageAll;
     if( transportProtocol == IP_UDP && IS_IP_MULTICAST_ADDRESS( address ) ) connection->ref_SendMessage = SendUDPMessage;
     connection->ref_Close = ( transportProtocol == IP_TCP ) ? CloseTCPServer : CloseUDPServer;
+    if( transportProtocol == IP_UDP ) connection->datagramsBatch = (DatagramsBatch*) calloc( 1, sizeof(DatagramsBatch) );
     *(connection->ref_clientsCount) = 0;
   }
   else
@@ -264,6 +356,7 @@ static IPConnection AddConnection( Socket socketFD, IPAddress address, uint8_t t
     connection->ref_ReceiveMessage = ( transportProtocol == IP_TCP ) ? ReceiveTCPMessage : ReceiveUDPMessage;
     connection->ref_SendMessage = ( transportProtocol == IP_TCP ) ? SendTCPMessage : SendUDPMessage;
     connection->ref_Close = ( transportProtocol == IP_TCP ) ? CloseTCPClient : CloseUDPClient;
+    if( transportProtocol == IP_UDP ) connection->streamBuffer = (char*) malloc( IP_MAX_STREAM_LENGTH );
     connection->server = NULL;
   }
   
@@ -279,6 +372,8 @@ static inline void AddClient( IPConnection server, IPConnection client )
   
   client->server = server;
   
+  IPNetwork_SetFraming( client, server->framing );
+  
   size_t clientsNumber = *((size_t*) server->ref_clientsCount);
   while( clientIndex < clientsNumber )
   {
@@ -515,13 +610,27 @@ bool BindUDPServerSocket( int socketFD, IPAddress address )
 
 bool ConnectTCPClientSocket( int socketFD, IPAddress address )
 {
-  // Connect TCP client socket to given remote address
+  const int CONNECT_TIMEOUT_MS = 5000;
+  
+  // Connect TCP client socket to given remote address. Non-blocking sockets finish connecting later, so that is waited for
   size_t addressLength = ( address->sa_family == AF_INET6 ) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
   if( connect( socketFD, address, addressLength ) == SOCKET_ERROR )
   {
-    ERROR_PRINT( "connect: failed on connecting socket %d to remote address", socketFD );
-    close( socketFD );
-    return false;
+    int connectError = -1;
+    if( IS_CONNECT_PENDING_ERROR() )
+    {
+      struct pollfd connectEvent = { .fd = socketFD, .events = POLLOUT };
+      socklen_t errorLength = sizeof(connectError);
+      if( poll( &connectEvent, 1, CONNECT_TIMEOUT_MS ) <= 0 ) connectError = -1;
+      else if( getsockopt( socketFD, SOL_SOCKET, SO_ERROR, (char*) &connectError, &errorLength ) == SOCKET_ERROR ) connectError = -1;
+    }
+    
+    if( connectError != 0 )
+    {
+      ERROR_PRINT( "connect: failed on connecting socket %d to remote address (error: %d)", socketFD, connectError );
+      close( socketFD );
+      return false;
+    }
   }
   
   return true;
@@ -633,6 +742,28 @@ size_t IPNetwork_SetMessageLength( IPConnection connection, size_t messageLength
   return (size_t) connection->messageLength;
 }
 
+// Clients accepted by a server connection take its framing. Both ends of a connection are required to use the same one
+void IPNetwork_SetFraming( IPConnection connection, uint8_t framing )
+{
+  if( connection == NULL ) return;
+  
+  connection->framing = ( framing == IP_FRAMING_PREFIXED ) ? IP_FRAMING_PREFIXED : IP_FRAMING_FIXED;
+  
+  if( IPNetwork_IsServer( connection ) ) return;
+  
+  connection->streamStart = connection->streamEnd = 0;
+  
+  if( connection->ref_Close != CloseTCPClient ) return; // UDP datagrams are always buffered
+  
+  if( connection->framing == IP_FRAMING_PREFIXED )
+  {
+    if( connection->streamBuffer == NULL ) connection->streamBuffer = (char*) malloc( IP_MAX_STREAM_LENGTH );
+    connection->ref_ReceiveMessage = ReceiveTCPFrames;
+  }
+  else
+    connection->ref_ReceiveMessage = ReceiveTCPMessage;
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////////
 /////                             GENERIC COMMUNICATION                             /////
@@ -645,25 +776,339 @@ char* IPNetwork_ReceiveMessage( IPConnection connection )
   return connection->ref_ReceiveMessage( connection ); 
 }
 
+// Returns 0 on success, 1 if the socket buffer is full (message not sent) and -1 on invalid messages or connection errors
 int IPNetwork_SendMessage( IPConnection connection, const char* message ) 
 { 
   if( strlen( message ) + 1 > connection->messageLength )
   {
     ERROR_PRINT( "message too long (%lu bytes for %lu max) !", strlen( message ), connection->messageLength );
-    return 0;
+    return -1;
   }
   
   //DEBUG_PRINT( "connection socket %d sending message: %s", connection->socket->fd, message );
   
+  // Length prefixed strings are sent without padding
+  if( connection->framing == IP_FRAMING_PREFIXED )
+  {
+    IPMessagePart messagePart = { .data = message, .length = strlen( message ) + 1 };
+    return IPNetwork_SendMessageParts( connection, &messagePart, 1 );
+  }
+  
   return connection->ref_SendMessage( connection, message ); 
 }
 
+// Try to send the rest of a previous partial TCP send. Returns 1 while it does not fit the socket buffer
+static int FlushOutput( IPConnection connection )
+{
+  int bytesSent = (int) send( connection->socket->fd, connection->outputBuffer, connection->outputLength, MSG_DONTWAIT | MSG_NOSIGNAL );
+  if( bytesSent == SOCKET_ERROR )
+  {
+    if( IS_WOULD_BLOCK_ERROR() ) return 1;
+    ERROR_PRINT( "send: error writing to socket %d", connection->socket->fd );
+    return -1;
+  }
+  
+  connection->outputLength -= (size_t) bytesSent;
+  if( connection->outputLength > 0 )
+  {
+    memmove( connection->outputBuffer, connection->outputBuffer + bytesSent, connection->outputLength );
+    return 1;
+  }
+  
+  return 0;
+}
+
+// Send given buffers with a single system call, without blocking. A TCP stream is never cut in the middle of a message:
+// data left by a partial send is kept and sent before anything else (up to IP_MAX_STREAM_LENGTH bytes per call)
+static int SendBuffers( IPConnection connection, IOBuffer* buffersList, size_t buffersNumber )
+{
+  bool isUDP = ( connection->ref_SendMessage == SendUDPMessage );
+  
+  if( !isUDP && connection->outputLength > 0 )
+  {
+    int flushResult = FlushOutput( connection );
+    if( flushResult != 0 ) return flushResult;
+  }
+  
+  #ifdef WIN32
+  DWORD bytesSent = 0;
+  int sendResult = WSASendTo( connection->socket->fd, buffersList, (DWORD) buffersNumber, &bytesSent, 0, 
+                              isUDP ? (IPAddress) &(connection->addressData) : NULL, isUDP ? sizeof(IPAddressData) : 0, NULL, NULL );
+  if( sendResult != SOCKET_ERROR ) sendResult = (int) bytesSent;
+  #else
+  struct msghdr message = { .msg_iov = buffersList, .msg_iovlen = buffersNumber };
+  if( isUDP )
+  {
+    message.msg_name = &(connection->addressData);
+    message.msg_namelen = sizeof(IPAddressData);
+  }
+  int sendResult = (int) sendmsg( connection->socket->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL );
+  #endif
+  if( sendResult == SOCKET_ERROR && IS_WOULD_BLOCK_ERROR() ) return 1;
+  
+  if( sendResult == SOCKET_ERROR )
+  {
+    ERROR_PRINT( "sendmsg: error writing to socket %d", connection->socket->fd );
+    return -1;
+  }
+  
+  if( isUDP ) return 0;
+  
+  // Keep what the kernel did not take
+  size_t skippedLength = (size_t) sendResult;
+  for( size_t bufferIndex = 0; bufferIndex < buffersNumber; bufferIndex++ )
+  {
+    #ifdef WIN32
+    const char* bufferData = buffersList[ bufferIndex ].buf;
+    size_t bufferLength = (size_t) buffersList[ bufferIndex ].len;
+    #else
+    const char* bufferData = (const char*) buffersList[ bufferIndex ].iov_base;
+    size_t bufferLength = buffersList[ bufferIndex ].iov_len;
+    #endif
+    if( skippedLength >= bufferLength )
+    {
+      skippedLength -= bufferLength;
+      continue;
+    }
+    
+    if( connection->outputBuffer == NULL ) connection->outputBuffer = (char*) malloc( IP_MAX_STREAM_LENGTH );
+    memcpy( connection->outputBuffer + connection->outputLength, bufferData + skippedLength, bufferLength - skippedLength );
+    connection->outputLength += bufferLength - skippedLength;
+    skippedLength = 0;
+  }
+  
+  return 0;
+}
+
+// List the buffers of a message gathered from the given parts (padded to the connection message length, or preceded 
+// by its length). Returns the number of buffers, or 0 for invalid messages
+static size_t GetMessageBuffers( IPConnection connection, const IPMessagePart* partsList, size_t partsNumber, uint8_t* frameHeader, IOBuffer* buffersList )
+{
+  static const char MESSAGE_PADDING[ IP_MAX_MESSAGE_LENGTH ] = { 0 };
+  
+  if( partsNumber >= IP_MAX_MESSAGE_PARTS )
+  {
+    ERROR_PRINT( "too many message parts (%lu for %u max) !", partsNumber, IP_MAX_MESSAGE_PARTS - 1 );
+    return 0;
+  }
+  
+  size_t messageLength = 0;
+  for( size_t partIndex = 0; partIndex < partsNumber; partIndex++ )
+    messageLength += partsList[ partIndex ].length;
+  if( messageLength > connection->messageLength )
+  {
+    ERROR_PRINT( "message too long (%lu bytes for %lu max) !", messageLength, connection->messageLength );
+    return 0;
+  }
+  
+  // Only pointers are copied: payload is read by the kernel straight from the caller memory
+  size_t buffersNumber = 0;
+  if( connection->framing == IP_FRAMING_PREFIXED )
+  {
+    SET_FRAME_LENGTH( frameHeader, messageLength );
+    SET_IO_BUFFER( buffersList[ buffersNumber++ ], frameHeader, IP_FRAME_HEADER_LENGTH );
+  }
+  for( size_t partIndex = 0; partIndex < partsNumber; partIndex++ )
+    SET_IO_BUFFER( buffersList[ buffersNumber++ ], partsList[ partIndex ].data, partsList[ partIndex ].length );
+  if( connection->framing == IP_FRAMING_FIXED )
+    SET_IO_BUFFER( buffersList[ buffersNumber++ ], MESSAGE_PADDING, connection->messageLength - messageLength );
+  
+  return buffersNumber;
+}
+
+// Gather given parts into a single message sent with one system call. Does not block: for latest value data, 
+// a message that does not fit the socket buffer is dropped (returns 1). Invalid messages (too many parts or too long) return -1
+int IPNetwork_SendMessageParts( IPConnection connection, const IPMessagePart* partsList, size_t partsNumber )
+{
+  if( connection == NULL ) return -1;
+  
+  if( connection->ref_SendMessage == SendMessageAll )
+  {
+    size_t clientsNumber = *((size_t*) connection->ref_clientsCount);
+    for( size_t clientIndex = 0; clientIndex < clientsNumber; clientIndex++ )
+    {
+      if( connection->clientsList[ clientIndex ] != NULL )
+        IPNetwork_SendMessageParts( connection->clientsList[ clientIndex ], partsList, partsNumber );
+    }
+    return 0;
+  }
+  
+  if( connection->socket->fd == INVALID_SOCKET ) return -1;
+  
+  uint8_t frameHeader[ IP_FRAME_HEADER_LENGTH ];
+  IOBuffer buffersList[ IP_MAX_MESSAGE_PARTS + 1 ];
+  size_t buffersNumber = GetMessageBuffers( connection, partsList, partsNumber, frameHeader, buffersList );
+  if( buffersNumber == 0 ) return -1;
+  
+  return SendBuffers( connection, buffersList, buffersNumber );
+}
+
+// Send each message (gathered from its parts) to the connection of same index, as with SendMessageParts. Consecutive messages
+// to clients of the same UDP server go out together, with a single system call (Linux). Returns the number of messages sent.
+// Batch buffers are static: not to be called from more than one thread
+size_t IPNetwork_SendMessagesBatch( const IPConnection* connectionsList, const IPMessage* messagesList, size_t messagesNumber )
+{
+  #ifdef IP_NETWORK_MMSG
+  static uint8_t headersList[ IP_MAX_BATCH_MESSAGES ][ IP_FRAME_HEADER_LENGTH ];
+  static IOBuffer buffersList[ IP_MAX_BATCH_MESSAGES * ( IP_MAX_MESSAGE_PARTS + 1 ) ];
+  static struct mmsghdr datagramsList[ IP_MAX_BATCH_MESSAGES ];
+  #endif
+  
+  size_t sentMessagesNumber = 0;
+  
+  size_t messageIndex = 0;
+  while( messageIndex < messagesNumber )
+  {
+    IPConnection connection = connectionsList[ messageIndex ];
+    #ifdef IP_NETWORK_MMSG
+    if( connection != NULL && IsUDPServerClient( connection ) && connection->socket->fd != INVALID_SOCKET )
+    {
+      Socket socketFD = connection->socket->fd;
+      size_t datagramsNumber = 0, buffersNumber = 0;
+      while( messageIndex < messagesNumber && datagramsNumber < IP_MAX_BATCH_MESSAGES )
+      {
+        connection = connectionsList[ messageIndex ];
+        if( connection == NULL || !IsUDPServerClient( connection ) || connection->socket->fd != socketFD ) break;
+        
+        const IPMessage* message = &(messagesList[ messageIndex++ ]);
+        size_t messageBuffersNumber = GetMessageBuffers( connection, message->partsList, message->partsNumber, 
+                                                         headersList[ datagramsNumber ], buffersList + buffersNumber );
+        if( messageBuffersNumber == 0 ) continue;
+        
+        struct msghdr* datagramHeader = &(datagramsList[ datagramsNumber++ ].msg_hdr);
+        *datagramHeader = (struct msghdr) { .msg_iov = buffersList + buffersNumber, .msg_iovlen = messageBuffersNumber,
+                                            .msg_name = &(connection->addressData), .msg_namelen = sizeof(IPAddressData) };
+        buffersNumber += messageBuffersNumber;
+      }
+      
+      size_t datagramIndex = 0;
+      while( datagramIndex < datagramsNumber )
+      {
+        int sendResult = sendmmsg( socketFD, datagramsList + datagramIndex, datagramsNumber - datagramIndex, MSG_DONTWAIT | MSG_NOSIGNAL );
+        if( sendResult == SOCKET_ERROR )
+        {
+          if( IS_WOULD_BLOCK_ERROR() ) break; // Socket buffer full: drop the rest
+          ERROR_PRINT( "sendmmsg: error writing to socket %d", socketFD );
+          sendResult = 1;                     // Skip the failed destination
+        }
+        else sentMessagesNumber += (size_t) sendResult;
+        datagramIndex += (size_t) sendResult;
+      }
+      
+      continue;
+    }
+    #endif
+    
+    if( IPNetwork_SendMessageParts( connection, messagesList[ messageIndex ].partsList, messagesList[ messageIndex ].partsNumber ) == 0 )
+      sentMessagesNumber++;
+    messageIndex++;
+  }
+  
+  return sentMessagesNumber;
+}
+
+// Send each given part as a separate message. With prefixed framing, messages are coalesced in as few system calls 
+// (and UDP datagrams) as possible. Returns the number of messages sent (the others did not fit the socket buffer) or -1 on errors
+int IPNetwork_SendMessages( IPConnection connection, const IPMessagePart* messagesList, size_t messagesNumber )
+{
+  if( connection == NULL ) return -1;
+  
+  if( connection->ref_SendMessage == SendMessageAll )
+  {
+    size_t clientsNumber = *((size_t*) connection->ref_clientsCount);
+    for( size_t clientIndex = 0; clientIndex < clientsNumber; clientIndex++ )
+    {
+      if( connection->clientsList[ clientIndex ] != NULL )
+        IPNetwork_SendMessages( connection->clientsList[ clientIndex ], messagesList, messagesNumber );
+    }
+    return (int) messagesNumber;
+  }
+  
+  if( connection->socket->fd == INVALID_SOCKET ) return -1;
+  
+  if( connection->framing == IP_FRAMING_FIXED )
+  {
+    for( size_t messageIndex = 0; messageIndex < messagesNumber; messageIndex++ )
+    {
+      // Messages too long are dropped, as with other framings, instead of failing the connection
+      if( messagesList[ messageIndex ].length > connection->messageLength )
+      {
+        ERROR_PRINT( "message too long (%lu bytes for %lu max) !", messagesList[ messageIndex ].length, connection->messageLength );
+        continue;
+      }
+      
+      int sendResult = IPNetwork_SendMessageParts( connection, &(messagesList[ messageIndex ]), 1 );
+      if( sendResult == -1 ) return -1;
+      else if( sendResult == 1 ) return (int) messageIndex;
+    }
+    return (int) messagesNumber;
+  }
+  
+  size_t maxSendLength = ( connection->ref_SendMessage == SendUDPMessage ) ? IP_MAX_DATAGRAM_LENGTH : IP_MAX_STREAM_LENGTH;
+  
+  uint8_t headersList[ IP_MAX_MESSAGE_PARTS / 2 ][ IP_FRAME_HEADER_LENGTH ];
+  IOBuffer buffersList[ IP_MAX_MESSAGE_PARTS ];
+  
+  size_t messageIndex = 0;
+  while( messageIndex < messagesNumber )
+  {
+    size_t buffersNumber = 0, sendLength = 0, batchNumber = 0;
+    while( messageIndex + batchNumber < messagesNumber && buffersNumber + 2 <= IP_MAX_MESSAGE_PARTS )
+    {
+      const IPMessagePart* message = &(messagesList[ messageIndex + batchNumber ]);
+      if( message->length > connection->messageLength )
+      {
+        ERROR_PRINT( "message too long (%lu bytes for %lu max) !", message->length, connection->messageLength );
+        if( batchNumber > 0 ) break;
+        messageIndex++; // Dropped
+        continue;
+      }
+      
+      if( batchNumber > 0 && sendLength + IP_FRAME_HEADER_LENGTH + message->length > maxSendLength ) break;
+      
+      SET_FRAME_LENGTH( headersList[ batchNumber ], message->length );
+      SET_IO_BUFFER( buffersList[ buffersNumber++ ], headersList[ batchNumber ], IP_FRAME_HEADER_LENGTH );
+      SET_IO_BUFFER( buffersList[ buffersNumber++ ], message->data, message->length );
+      sendLength += IP_FRAME_HEADER_LENGTH + message->length;
+      batchNumber++;
+    }
+    
+    if( batchNumber == 0 ) break;
+    
+    int sendResult = SendBuffers( connection, buffersList, buffersNumber );
+    if( sendResult == -1 ) return -1;
+    else if( sendResult == 1 ) break;
+    
+    messageIndex += batchNumber;
+  }
+  
+  return (int) messageIndex;
+}
+
 IPConnection IPNetwork_AcceptClient( IPConnection connection ) { return connection->ref_AcceptClient( connection ); }
 
 // Verify available incoming messages for the given connection, preventing unnecessary blocking calls (for syncronous networking)
 int IPNetwork_WaitEvent( unsigned int milliseconds )
 {
-  #ifndef IP_NETWORK_LEGACY
+  #if defined( IP_NETWORK_EPOLL )
+  if( epollFD == INVALID_SOCKET ) return 0;
+  // Sockets with unhandled events are ready already: do not block on waiting
+  if( polledSocketsNumber > 0 && milliseconds > 1 ) milliseconds = 1;
+  struct epoll_event eventsList[ MAX_WAITED_EVENTS ];
+  int eventsNumber = epoll_wait( epollFD, eventsList, MAX_WAITED_EVENTS, (int) milliseconds );
+  if( eventsNumber == SOCKET_ERROR && errno == EINTR ) eventsNumber = 0;
+  for( int eventIndex = 0; eventIndex < eventsNumber; eventIndex++ )
+  {
+    SocketPoller* socket = (SocketPoller*) eventsList[ eventIndex ].data.ptr;
+    if( eventsList[ eventIndex ].events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) ) socket->readyEvents |= IP_EVENT_READ;
+    if( eventsList[ eventIndex ].events & EPOLLOUT ) socket->readyEvents |= IP_EVENT_WRITE;
+    if( !socket->isPending && polledSocketsNumber < sizeof(SocketPollerSet) / sizeof(SocketPoller*) )
+    {
+      socket->isPending = true;
+      polledSocketsSet[ polledSocketsNumber++ ] = socket;
+    }
+  }
+  #elif defined( IP_NETWORK_POLL )
   int eventsNumber = poll( polledSocketsSet, polledSocketsNumber, milliseconds );
   #else
   struct timeval waitTime = { .tv_sec = milliseconds / 1000, .tv_usec = ( milliseconds % 1000 ) * 1000 };
@@ -676,11 +1121,37 @@ int IPNetwork_WaitEvent( unsigned int milliseconds )
   return eventsNumber;
 }
 
+// Complete (and valid) message already received: a whole datagram or, with prefixed framing, a message read along with previous ones
+static inline bool HasBufferedMessage( IPConnection connection )
+{
+  if( connection->streamBuffer == NULL ) return false;
+  
+  size_t bufferedLength = connection->streamEnd - connection->streamStart;
+  if( connection->framing == IP_FRAMING_FIXED ) return ( bufferedLength > 0 );
+  
+  if( bufferedLength < IP_FRAME_HEADER_LENGTH ) return false;
+  
+  size_t messageLength = GET_FRAME_LENGTH( connection->streamBuffer + connection->streamStart );
+  if( messageLength > connection->messageLength ) return false;
+  
+  return ( bufferedLength >= IP_FRAME_HEADER_LENGTH + messageLength );
+}
+
 bool IPNetwork_IsDataAvailable( IPConnection connection )
 {
   if( connection == NULL ) return false;
   
-  #ifndef IP_NETWORK_LEGACY
+  if( HasBufferedMessage( connection ) ) return true;
+  
+  // Clients only receive datagrams handed over by their server connection
+  if( IsUDPServerClient( connection ) ) return false;
+  
+  DatagramsBatch* batch = connection->datagramsBatch;
+  if( batch != NULL && batch->datagramIndex < batch->datagramsNumber ) return true;
+  
+  #if defined( IP_NETWORK_EPOLL )
+  if( connection->socket->readyEvents & IP_EVENT_READ ) return true;
+  #elif defined( IP_NETWORK_POLL )
   if( connection->socket->revents & POLLRDNORM ) return true;
   else if( connection->socket->revents & POLLRDBAND ) return true;
   #else
@@ -690,6 +1161,246 @@ bool IPNetwork_IsDataAvailable( IPConnection connection )
   return false;
 }
 
+void IPNetwork_SetEventCallback( IPConnection connection, IPEventCallback ref_EventCallback, void* eventData )
+{
+  if( connection == NULL ) return;
+  
+  connection->eventData = eventData;
+  connection->ref_EventCallback = ref_EventCallback;
+  
+  #ifndef IP_NETWORK_EPOLL
+  for( size_t connectionIndex = 0; connectionIndex < eventConnectionsNumber; connectionIndex++ )
+  {
+    if( eventConnectionsList[ connectionIndex ] == connection ) return;
+  }
+  eventConnectionsList = (IPConnection*) realloc( eventConnectionsList, ( eventConnectionsNumber + 1 ) * sizeof(IPConnection) );
+  eventConnectionsList[ eventConnectionsNumber++ ] = connection;
+  #endif
+}
+
+// Read available datagrams of the given UDP server socket at once (in a single system call, on Linux)
+static bool ReceiveDatagrams( IPConnection server )
+{
+  DatagramsBatch* batch = server->datagramsBatch;
+  batch->datagramIndex = batch->datagramsNumber = 0;
+  
+  #ifdef IP_NETWORK_MMSG
+  struct mmsghdr headersList[ MAX_RECEIVED_DATAGRAMS ];
+  IOBuffer buffersList[ MAX_RECEIVED_DATAGRAMS ];
+  memset( headersList, 0, sizeof(headersList) );
+  for( size_t datagramIndex = 0; datagramIndex < MAX_RECEIVED_DATAGRAMS; datagramIndex++ )
+  {
+    SET_IO_BUFFER( buffersList[ datagramIndex ], batch->dataList[ datagramIndex ], IP_MAX_DATAGRAM_LENGTH );
+    headersList[ datagramIndex ].msg_hdr.msg_iov = &(buffersList[ datagramIndex ]);
+    headersList[ datagramIndex ].msg_hdr.msg_iovlen = 1;
+    headersList[ datagramIndex ].msg_hdr.msg_name = &(batch->addressesList[ datagramIndex ]);
+    headersList[ datagramIndex ].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  }
+  int datagramsNumber = recvmmsg( server->socket->fd, headersList, MAX_RECEIVED_DATAGRAMS, MSG_DONTWAIT, NULL );
+  for( int datagramIndex = 0; datagramIndex < datagramsNumber; datagramIndex++ )
+    batch->lengthsList[ datagramIndex ] = (size_t) headersList[ datagramIndex ].msg_len;
+  #else
+  socklen_t addressLength = sizeof(struct sockaddr_storage);
+  int datagramsNumber = recvfrom( server->socket->fd, batch->dataList[ 0 ], IP_MAX_DATAGRAM_LENGTH, MSG_DONTWAIT, 
+                                  (IPAddress) &(batch->addressesList[ 0 ]), &addressLength );
+  if( datagramsNumber != SOCKET_ERROR )
+  {
+    batch->lengthsList[ 0 ] = (size_t) datagramsNumber;
+    datagramsNumber = 1;
+  }
+  #endif
+  if( datagramsNumber == SOCKET_ERROR )
+  {
+    #ifdef IP_NETWORK_EPOLL
+    server->socket->readyEvents &= ~IP_EVENT_READ;
+    #endif
+    if( !IS_WOULD_BLOCK_ERROR() ) ERROR_PRINT( "recvmmsg: error reading from socket %d", server->socket->fd );
+    return false;
+  }
+  
+  batch->datagramsNumber = (size_t) datagramsNumber;
+  
+  return ( datagramsNumber > 0 );
+}
+
+static IPConnection FindUDPClient( IPConnection server, IPAddress address )
+{
+  size_t clientsNumber = *(server->ref_clientsCount);
+  for( size_t clientIndex = 0; clientIndex < clientsNumber; clientIndex++ )
+  {
+    IPConnection client = server->clientsList[ clientIndex ];
+    if( client == NULL ) continue;
+    if( ARE_EQUAL_IP_ADDRESSES( &(client->addressData), address ) ) return client;
+  }
+  
+  return NULL;
+}
+
+// Hand received messages over to the connection handler. Returns true if they could not be all handled
+static inline bool DispatchBufferedMessages( IPConnection connection )
+{
+  while( HasBufferedMessage( connection ) )
+  {
+    if( connection->ref_EventCallback( connection, IP_EVENT_READ, connection->eventData ) ) return true;
+  }
+  
+  return false;
+}
+
+// UDP server connections share their socket with their clients: datagrams are read in batches and each one goes to 
+// the client connection of its source address, or to the server connection (for accepting a new client) if there is none
+static bool DispatchUDPServerEvents( IPConnection server )
+{
+  DatagramsBatch* batch = server->datagramsBatch;
+  
+  #ifdef IP_NETWORK_EPOLL
+  const size_t MAX_READS_NUMBER = MAX_DISPATCHED_EVENTS;  // Edge triggered: read until there is nothing left
+  #else
+  const size_t MAX_READS_NUMBER = 1;                      // Only the first read is known not to block
+  #endif
+  
+  // Clients that could not handle all their messages on the last dispatch
+  bool hasPendingClients = false;
+  size_t clientsNumber = *(server->ref_clientsCount);
+  for( size_t clientIndex = 0; clientIndex < clientsNumber; clientIndex++ )
+  {
+    IPConnection client = server->clientsList[ clientIndex ];
+    if( client == NULL || client->ref_EventCallback == NULL ) continue;
+    if( DispatchBufferedMessages( client ) ) hasPendingClients = true;
+  }
+  if( hasPendingClients ) return true;
+  
+  size_t readsNumber = 0;
+  while( true )
+  {
+    if( batch->datagramIndex >= batch->datagramsNumber )
+    {
+      if( readsNumber++ >= MAX_READS_NUMBER ) return ( MAX_READS_NUMBER > 1 );
+      if( !ReceiveDatagrams( server ) ) return false;
+    }
+    
+    IPAddress sourceAddress = (IPAddress) &(batch->addressesList[ batch->datagramIndex ]);
+    IPConnection receiver = FindUDPClient( server, sourceAddress );
+    if( receiver == NULL && server->ref_EventCallback != NULL )
+    {
+      if( server->ref_EventCallback( server, IP_EVENT_READ, server->eventData ) ) return true;
+      receiver = FindUDPClient( server, sourceAddress );
+    }
+    
+    // Discard unhandled messages
+    if( receiver == NULL || receiver->ref_EventCallback == NULL )
+    {
+      batch->datagramIndex++;
+      continue;
+    }
+    
+    receiver->streamStart = 0;
+    receiver->streamEnd = batch->lengthsList[ batch->datagramIndex ];
+    memcpy( receiver->streamBuffer, batch->dataList[ batch->datagramIndex ], receiver->streamEnd );
+    batch->datagramIndex++;
+    
+    if( DispatchBufferedMessages( receiver ) ) return true;
+  }
+  
+  return false;
+}
+
+#ifdef IP_NETWORK_EPOLL
+// Returns true if the socket events could not be all handled (to be dispatched again)
+static bool DispatchSocketEvents( SocketPoller* socket )
+{
+  IPConnection connection = socket->owner;
+  if( connection->ref_EventCallback == NULL ) 
+  {
+    socket->readyEvents = 0;
+    return false;
+  }
+  
+  // Write readiness is only reported when it changes: sending is done by the callback, if required
+  if( socket->readyEvents & IP_EVENT_WRITE )
+  {
+    socket->readyEvents &= ~IP_EVENT_WRITE;
+    (void) connection->ref_EventCallback( connection, IP_EVENT_WRITE, connection->eventData );
+  }
+  
+  if( !( socket->readyEvents & IP_EVENT_READ ) ) return false;
+  
+  if( connection->ref_Close == CloseUDPServer ) return DispatchUDPServerEvents( connection );
+  
+  // Callback reads (or accepts) until it would block, what clears the read event
+  for( size_t eventIndex = 0; eventIndex < MAX_DISPATCHED_EVENTS; eventIndex++ )
+  {
+    if( connection->ref_EventCallback( connection, IP_EVENT_READ, connection->eventData ) ) return true;
+    if( !( socket->readyEvents & IP_EVENT_READ ) ) return false;
+  }
+  
+  return true;
+}
+#endif
+
+// Wait (up to the given time) for sockets to have events, without handling them: unlike DispatchEvents, it does not
+// access connections, so they may be opened or closed meanwhile. To be called from the dispatching thread. Returns false
+// if not supported by the polling backend (epoll only), leaving the wait to DispatchEvents
+bool IPNetwork_WaitReady( unsigned int milliseconds )
+{
+  #if defined( IP_NETWORK_EPOLL )
+  if( epollFD == INVALID_SOCKET ) return false;
+  // Events left by the last dispatch are ready already
+  if( hasPendingEvents ) return true;
+  // Epoll descriptor is readable while it has events to be waited
+  struct pollfd epollPoller = { .fd = epollFD, .events = POLLIN };
+  if( poll( &epollPoller, 1, (int) milliseconds ) == SOCKET_ERROR && errno != EINTR ) 
+    ERROR_PRINT( "poll: error waiting for events on epoll FD %d", epollFD );
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+// Wait for events and call the handlers of the connections that have them. With the epoll backend, only ready
+// connections are visited. Otherwise, every connection with a handler is checked
+int IPNetwork_DispatchEvents( unsigned int milliseconds )
+{
+  int eventsNumber = IPNetwork_WaitEvent( milliseconds );
+  
+  #ifdef IP_NETWORK_EPOLL
+  size_t socketIndex = 0;
+  while( socketIndex < polledSocketsNumber )
+  {
+    SocketPoller* socket = polledSocketsSet[ socketIndex ];
+    if( DispatchSocketEvents( socket ) ) socketIndex++;
+    else if( socketIndex < polledSocketsNumber && polledSocketsSet[ socketIndex ] == socket ) // Not removed by the callback
+    {
+      socket->isPending = false;
+      polledSocketsSet[ socketIndex ] = polledSocketsSet[ --polledSocketsNumber ];
+    }
+  }
+  hasPendingEvents = ( polledSocketsNumber > 0 );
+  #else
+  // Connections may have messages left from previous reads, even without new events
+  if( eventsNumber < 0 ) return eventsNumber;
+  
+  for( size_t connectionIndex = 0; connectionIndex < eventConnectionsNumber; connectionIndex++ )
+  {
+    IPConnection connection = eventConnectionsList[ connectionIndex ];
+    if( !IPNetwork_IsDataAvailable( connection ) ) continue;
+    
+    if( connection->ref_Close == CloseUDPServer )
+    {
+      (void) DispatchUDPServerEvents( connection );
+      continue;
+    }
+    
+    bool isPending = connection->ref_EventCallback( connection, IP_EVENT_READ, connection->eventData );
+    // Other messages coalesced in the same read
+    for( size_t eventIndex = 1; eventIndex < MAX_DISPATCHED_EVENTS && !isPending && HasBufferedMessage( connection ); eventIndex++ )
+      isPending = connection->ref_EventCallback( connection, IP_EVENT_READ, connection->eventData );
+  }
+  #endif
+  
+  return eventsNumber;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 /////                      SPECIFIC TRANSPORT/ROLE COMMUNICATION                    /////
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -704,6 +1415,14 @@ static char* ReceiveTCPMessage( IPConnection connection )
   // Blocks until there is something to be read in the socket
   bytesReceived = recv( connection->socket->fd, connection->buffer, connection->messageLength, 0 );
 
+  #ifdef IP_NETWORK_EPOLL
+  if( bytesReceived == SOCKET_ERROR && IS_WOULD_BLOCK_ERROR() )
+  {
+    connection->socket->readyEvents &= ~IP_EVENT_READ;
+    return NULL;
+  }
+  if( bytesReceived <= 0 ) connection->socket->readyEvents = 0;
+  #endif
   if( bytesReceived == SOCKET_ERROR )
   {
     ERROR_PRINT( "recv: error reading from socket %d", connection->socket->fd );
@@ -722,42 +1441,130 @@ static char* ReceiveTCPMessage( IPConnection connection )
   return connection->buffer;
 }
 
-// Send given message through the given TCP connection
+// Send given message through the given TCP connection (after the rest of any partial send)
 static int SendTCPMessage( IPConnection connection, const char* message )
 {
-  if( send( connection->socket->fd, message, connection->messageLength, 0 ) == SOCKET_ERROR )
+  IOBuffer messageBuffer;
+  SET_IO_BUFFER( messageBuffer, message, connection->messageLength );
+  
+  return SendBuffers( connection, &messageBuffer, 1 );
+}
+
+// Hand the first complete buffered message over to the connection buffer
+static char* PopMessage( IPConnection connection )
+{
+  if( !HasBufferedMessage( connection ) ) return NULL;
+  
+  char* messageData = connection->streamBuffer + connection->streamStart;
+  size_t messageLength = connection->streamEnd - connection->streamStart;
+  if( connection->framing == IP_FRAMING_PREFIXED )
   {
-    ERROR_PRINT( "send: error writing to socket %d", connection->socket->fd );
-    return -1;
+    messageLength = GET_FRAME_LENGTH( messageData );
+    messageData += IP_FRAME_HEADER_LENGTH;
   }
+  else if( messageLength > connection->messageLength ) 
+    messageLength = connection->messageLength;
+  memcpy( connection->buffer, messageData, messageLength );
   
-  return 0;
+  connection->streamStart = (size_t) ( messageData - connection->streamBuffer ) + messageLength;
+  if( connection->framing == IP_FRAMING_FIXED || connection->streamStart >= connection->streamEnd ) 
+    connection->streamStart = connection->streamEnd = 0;
+  
+  return connection->buffer;
+}
+
+// Incomplete messages are only accepted if they could fit the connection buffer once complete
+static inline bool IsValidFrame( IPConnection connection )
+{
+  if( connection->streamEnd - connection->streamStart < IP_FRAME_HEADER_LENGTH ) return true;
+  
+  return ( GET_FRAME_LENGTH( connection->streamBuffer + connection->streamStart ) <= connection->messageLength );
+}
+
+// Try to receive data from the given TCP client connection, reassembling messages split between reads (or read 
+// together). Returns the first complete message (stored on its buffer), or NULL if there is none yet
+static char* ReceiveTCPFrames( IPConnection connection )
+{
+  if( connection->socket->fd == INVALID_SOCKET ) return NULL;
+  
+  if( HasBufferedMessage( connection ) ) return PopMessage( connection );
+  
+  // Move the incomplete message to the beginning, making room for its rest
+  if( connection->streamStart > 0 )
+  {
+    connection->streamEnd -= connection->streamStart;
+    memmove( connection->streamBuffer, connection->streamBuffer + connection->streamStart, connection->streamEnd );
+    connection->streamStart = 0;
+  }
+  
+  int bytesReceived = recv( connection->socket->fd, connection->streamBuffer + connection->streamEnd, IP_MAX_STREAM_LENGTH - connection->streamEnd, 0 );
+  
+  if( bytesReceived == SOCKET_ERROR && IS_WOULD_BLOCK_ERROR() )
+  {
+    #ifdef IP_NETWORK_EPOLL
+    connection->socket->readyEvents &= ~IP_EVENT_READ;
+    #endif
+    return NULL;
+  }
+  #ifdef IP_NETWORK_EPOLL
+  if( bytesReceived <= 0 ) connection->socket->readyEvents = 0;
+  #endif
+  if( bytesReceived == SOCKET_ERROR )
+  {
+    ERROR_PRINT( "recv: error reading from socket %d", connection->socket->fd );
+    connection->socket->fd = INVALID_SOCKET;
+    return NULL;
+  }
+  else if( bytesReceived == 0 )
+  {
+    ERROR_PRINT( "recv: remote connection with socket %d closed", connection->socket->fd );
+    connection->socket->fd = INVALID_SOCKET;
+    return NULL;
+  }
+  
+  connection->streamEnd += (size_t) bytesReceived;
+  
+  // The stream can not be resynchronized after an invalid length
+  if( !IsValidFrame( connection ) )
+  {
+    ERROR_PRINT( "invalid message length received on socket %d", connection->socket->fd );
+    connection->socket->fd = INVALID_SOCKET;
+    return NULL;
+  }
+  
+  return PopMessage( connection );
 }
 
-// Try to receive incoming message from the given UDP client connection and store it on its buffer
+// Hand the next message received by the given UDP client connection over to its buffer. Clients of UDP servers get 
+// their datagrams from the server connection (see DispatchUDPServerEvents). Other ones read their own socket
 static char* ReceiveUDPMessage( IPConnection connection )
 {
   IPAddressData address = { 0 };
-  socklen_t addressLength;
-  static char* emptyMessage = "";//{ '\0' };
+  socklen_t addressLength = sizeof(IPAddressData);
   
-  // Blocks until there is something to be read in the socket
-  if( recvfrom( connection->socket->fd, connection->buffer, connection->messageLength, MSG_PEEK, (IPAddress) &address, &addressLength ) == SOCKET_ERROR )
+  if( HasBufferedMessage( connection ) ) return PopMessage( connection );
+  
+  connection->streamStart = connection->streamEnd = 0; // Incomplete or invalid rest of the last datagram
+  
+  if( connection->server != NULL ) return NULL;
+  
+  int bytesReceived = recvfrom( connection->socket->fd, connection->streamBuffer, IP_MAX_DATAGRAM_LENGTH, 0, (IPAddress) &address, &addressLength );
+  if( bytesReceived == SOCKET_ERROR )
   {
+    #ifdef IP_NETWORK_EPOLL
+    connection->socket->readyEvents &= ~IP_EVENT_READ;
+    if( IS_WOULD_BLOCK_ERROR() ) return NULL;
+    #endif
     ERROR_PRINT( "recvfrom: error reading from socket %d", connection->socket->fd );
     return NULL;
   }
 
-  // Verify if incoming message is destined to this connection (and returns the message if it is)
-  if( ARE_EQUAL_IP_ADDRESSES( &(connection->addressData), &address ) )
-  {
-    recv( connection->socket->fd, NULL, 0, 0 );
-    //DEBUG_PRINT( "socket %d received right message: %s", connection->socket->fd, connection->buffer );
-    return connection->buffer;
-  }
+  // Datagrams not destined to this connection, or without a valid message, are dropped
+  if( !ARE_EQUAL_IP_ADDRESSES( &(connection->addressData), &address ) ) return NULL;
+  
+  connection->streamEnd = (size_t) bytesReceived;
   
-  // Default return message (the received one was not destined to this connection) 
-  return emptyMessage;
+  return PopMessage( connection );
 }
 
 // Send given message through the given UDP connection
@@ -765,6 +1572,7 @@ static int SendUDPMessage( IPConnection connection, const char* message )
 {
   if( sendto( connection->socket->fd, message, connection->messageLength, 0, (IPAddress) &(connection->addressData), sizeof(IPAddressData) ) == SOCKET_ERROR )
   {
+    if( IS_WOULD_BLOCK_ERROR() ) return 1;
     ERROR_PRINT( "sendto: error writing to socket %d", connection->socket->fd );
     return -1;
   }
@@ -803,12 +1611,21 @@ static IPConnection AcceptTCPClient( IPConnection server )
 
   if( clientSocketFD == INVALID_SOCKET )
   {
+    #ifdef IP_NETWORK_EPOLL
+    server->socket->readyEvents &= ~IP_EVENT_READ;
+    if( IS_WOULD_BLOCK_ERROR() ) return NULL;
+    #endif
     ERROR_PRINT( "accept: failed accepting connection on socket %d", server->socket->fd );
     return NULL;
   }
   
   DEBUG_PRINT( "client accepted: socket fd: %d\n", clientSocketFD );
   
+  #ifdef IP_NETWORK_EPOLL
+  // Accepted sockets do not inherit non-blocking state, required for reading until there is no data left
+  if( fcntl( clientSocketFD, F_SETFL, O_NONBLOCK ) == SOCKET_ERROR ) ERROR_PRINT( "failure setting socket %d to non-blocking state", clientSocketFD );
+  #endif
+  
   client =  AddConnection( clientSocketFD, (IPAddress) &clientAddress, IP_TCP, false );
 
   AddClient( server, client );
@@ -819,30 +1636,25 @@ static IPConnection AcceptTCPClient( IPConnection server )
 // Waits for a remote connection to be added to the client list of the given UDP server connection
 static IPConnection AcceptUDPClient( IPConnection server )
 {
-  static char buffer[ IP_MAX_MESSAGE_LENGTH ];
-  static IPConnectionData dummyConnection;
-
-  struct sockaddr_storage clientAddress = { 0 };
-  socklen_t addressLength = sizeof(clientAddress);
-  if( recvfrom( server->socket->fd, buffer, IP_MAX_MESSAGE_LENGTH, MSG_PEEK, (IPAddress) &clientAddress, &addressLength ) == SOCKET_ERROR )
+  DatagramsBatch* batch = server->datagramsBatch;
+  if( batch->datagramIndex >= batch->datagramsNumber )
   {
-    ERROR_PRINT( "recvfrom: error reading from socket %d", server->socket->fd );
-    return NULL;
+    if( !ReceiveDatagrams( server ) ) return NULL;
   }
   
+  // Source of the next datagram to be delivered
+  IPAddress clientAddress = (IPAddress) &(batch->addressesList[ batch->datagramIndex ]);
+  
   // Verify if incoming message belongs to unregistered client (returns default value if not)
-  size_t clientsNumber = *(server->ref_clientsCount);
-  for( size_t clientIndex = 0; clientIndex < clientsNumber; clientIndex++ )
-  {
-    //DEBUG_PRINT( "comparing ports: %u - %u", server->clientsList[ clientIndex ]->address->sin6_port, ((struct sockaddr_in6*) &clientAddress)->sin6_port );
-    if( ARE_EQUAL_IP_ADDRESSES( &(server->clientsList[ clientIndex ]->addressData), &clientAddress ) )
-      //return &dummyConnection;
-      return NULL;
-  }
+  if( FindUDPClient( server, clientAddress ) != NULL ) return NULL;
   
   DEBUG_PRINT( "client accepted (clients count before: %lu)", *(server->ref_clientsCount) );
   
-  IPConnection client = AddConnection( server->socket->fd, (IPAddress) &clientAddress, IP_UDP, false );
+  IPConnection client = AddConnection( server->socket->fd, clientAddress, IP_UDP, false );
+  #ifdef IP_NETWORK_EPOLL
+  free( client->socket );
+  client->socket = server->socket;
+  #endif
 
   AddClient( server, client );
   
@@ -858,9 +1670,21 @@ static IPConnection AcceptUDPClient( IPConnection server )
 
 // Handle proper destruction of any given connection type
 
-static inline void RemoveSocket( Socket socketFD )
+static inline void RemoveSocket( SocketPoller* socket )
 {
-  #ifndef IP_NETWORK_LEGACY
+  Socket socketFD = socket->fd;
+  #if defined( IP_NETWORK_EPOLL )
+  epoll_ctl( epollFD, EPOLL_CTL_DEL, socketFD, NULL );
+  for( size_t socketIndex = 0; socketIndex < polledSocketsNumber; socketIndex++ )
+  {
+    if( polledSocketsSet[ socketIndex ] == socket )
+    {
+      polledSocketsSet[ socketIndex ] = polledSocketsSet[ --polledSocketsNumber ];
+      break;
+    }
+  }
+  free( socket );
+  #elif defined( IP_NETWORK_POLL )
   SocketPoller cmpPoller = { .fd = socketFD };
   SocketPoller* poller = bsearch( &cmpPoller, polledSocketsSet, polledSocketsNumber, sizeof(SocketPoller), CompareSockets );
   if( poller != NULL )
@@ -880,7 +1704,7 @@ void CloseTCPServer( IPConnection server )
 {
   DEBUG_PRINT( "closing TCP server unused socket fd: %d", server->socket->fd );
   shutdown( server->socket->fd, SHUT_RDWR );
-  RemoveSocket( server->socket->fd );
+  RemoveSocket( server->socket );
   free( server->ref_clientsCount );
   if( server->clientsList != NULL ) free( server->clientsList );
   free( server );
@@ -892,7 +1716,8 @@ void CloseUDPServer( IPConnection server )
   if( *(server->ref_clientsCount) == 0 )
   {
     DEBUG_PRINT( "closing UDP server unused socket fd: %d", server->socket->fd );
-    RemoveSocket( server->socket->fd );
+    RemoveSocket( server->socket );
+    free( server->datagramsBatch );
     free( server->ref_clientsCount );
     if( server->clientsList != NULL ) free( server->clientsList );
     free( server );
@@ -920,8 +1745,10 @@ void CloseTCPClient( IPConnection client )
   DEBUG_PRINT( "closing TCP client unused socket fd: %d", client->socket->fd );
   RemoveClient( client->server, client );
   shutdown( client->socket->fd, SHUT_RDWR );
-  RemoveSocket( client->socket->fd );
+  RemoveSocket( client->socket );
   if( client->buffer != NULL ) free( client->buffer );
+  if( client->streamBuffer != NULL ) free( client->streamBuffer );
+  if( client->outputBuffer != NULL ) free( client->outputBuffer );
   free( client );
 }
 
@@ -930,10 +1757,12 @@ void CloseUDPClient( IPConnection client )
   DEBUG_PRINT( "closing UDP client unused socket fd: %d", client->socket->fd );
   RemoveClient( client->server, client );
   
-  if( client->server == NULL ) close( client->socket->fd );
+  // Standalone clients own their (polled) socket
+  if( client->server == NULL ) RemoveSocket( client->socket );
   else if( *(client->server->ref_clientsCount) == 0 ) CloseUDPServer( client->server );
 
   if( client->buffer != NULL ) free( client->buffer );
+  if( client->streamBuffer != NULL ) free( client->streamBuffer );
   free( client );
 }
 
@@ -943,6 +1772,17 @@ void IPNetwork_CloseConnection( IPConnection connection )
   
   DEBUG_PRINT( "closing connection for socket %d", connection->socket->fd );
 
+  #ifndef IP_NETWORK_EPOLL
+  for( size_t connectionIndex = 0; connectionIndex < eventConnectionsNumber; connectionIndex++ )
+  {
+    if( eventConnectionsList[ connectionIndex ] == connection )
+    {
+      eventConnectionsList[ connectionIndex ] = eventConnectionsList[ --eventConnectionsNumber ];
+      break;
+    }
+  }
+  #endif
+  
   // Each TCP connection has its own socket, so we can close it without problem. But UDP connections
   // from the same server share the socket, so we need to wait for all of them to be stopped to close the socket
   connection->ref_Close( connection );
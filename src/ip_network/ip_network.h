@@ -18,6 +18,8 @@
 /////////////////////////////////////////////////////////////////////////
   
 #define IP_MAX_MESSAGE_LENGTH 512
+#define IP_MAX_MESSAGE_PARTS 64
+#define IP_MAX_BATCH_MESSAGES 64
 
 #define IP_SERVER 0x01
 #define IP_CLIENT 0x02
@@ -25,6 +27,18 @@
 #define IP_TCP 0x10
 #define IP_UDP 0x20
 
+#define IP_EVENT_READ 0x01
+#define IP_EVENT_WRITE 0x02
+
+// Message framing: fixed length messages (legacy clients), or messages preceded by their length (2 bytes, network order),
+// that are reassembled from partial TCP reads and may be coalesced, several per send call (or UDP datagram)
+#define IP_FRAMING_FIXED 0x00
+#define IP_FRAMING_PREFIXED 0x01
+
+#define IP_FRAME_HEADER_LENGTH 2
+#define IP_MAX_STREAM_LENGTH ( 4 * ( IP_MAX_MESSAGE_LENGTH + IP_FRAME_HEADER_LENGTH ) )   // Coalesced TCP data per send
+#define IP_MAX_DATAGRAM_LENGTH 1472                                                       // Coalesced UDP data (Ethernet MTU)
+
 
 //////////////////////////////////////////////////////////////////////////
 /////                         DATA STRUCTURES                        /////
@@ -33,6 +47,26 @@
 typedef struct _IPConnectionData IPConnectionData;
 typedef IPConnectionData* IPConnection;
 
+// Piece of a message gathered from the caller memory at sending time (no intermediate buffer)
+typedef struct _IPMessagePart
+{
+  const void* data;
+  size_t length;
+}
+IPMessagePart;
+
+// Message gathered from parts, to be sent along with others in a batch
+typedef struct _IPMessage
+{
+  const IPMessagePart* partsList;
+  size_t partsNumber;
+}
+IPMessage;
+
+// Connection events handler (read events of server connections are incoming clients). Returns true if the
+// events could not be all handled (e.g. full queue), for the connection to be dispatched again without waiting
+typedef bool (*IPEventCallback)( IPConnection, uint8_t, void* );
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                            INTERFACE                                            /////
@@ -42,14 +76,21 @@ typedef IPConnectionData* IPConnection;
         INIT_FUNCTION( char*, Namespace, GetAddress, IPConnection ) \
         INIT_FUNCTION( size_t, Namespace, GetClientsNumber, IPConnection ) \
         INIT_FUNCTION( size_t, Namespace, SetMessageLength, IPConnection, size_t ) \
+        INIT_FUNCTION( void, Namespace, SetFraming, IPConnection, uint8_t ) \
         INIT_FUNCTION( bool, Namespace, IsServer, IPConnection ) \
         INIT_FUNCTION( IPConnection, Namespace, OpenConnection, uint8_t, const char*, uint16_t ) \
         INIT_FUNCTION( void, Namespace, CloseConnection, IPConnection ) \
         INIT_FUNCTION( char*, Namespace, ReceiveMessage, IPConnection ) \
         INIT_FUNCTION( int, Namespace, SendMessage, IPConnection, const char* ) \
+        INIT_FUNCTION( int, Namespace, SendMessageParts, IPConnection, const IPMessagePart*, size_t ) \
+        INIT_FUNCTION( int, Namespace, SendMessages, IPConnection, const IPMessagePart*, size_t ) \
+        INIT_FUNCTION( size_t, Namespace, SendMessagesBatch, const IPConnection*, const IPMessage*, size_t ) \
         INIT_FUNCTION( IPConnection, Namespace, AcceptClient, IPConnection ) \
         INIT_FUNCTION( int, Namespace, WaitEvent, unsigned int ) \
-        INIT_FUNCTION( bool, Namespace, IsDataAvailable, IPConnection )
+        INIT_FUNCTION( bool, Namespace, IsDataAvailable, IPConnection ) \
+        INIT_FUNCTION( void, Namespace, SetEventCallback, IPConnection, IPEventCallback, void* ) \
+        INIT_FUNCTION( bool, Namespace, WaitReady, unsigned int ) \
+        INIT_FUNCTION( int, Namespace, DispatchEvents, unsigned int )
 
 DECLARE_NAMESPACE_INTERFACE( IPNetwork, IP_NETWORK_INTERFACE )
 
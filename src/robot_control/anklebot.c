@@ -64,7 +64,7 @@ void SetControlState( Controller ref_controller, enum ControlState controlState
   fprintf( stderr, "Setting robot control phase: %x\n", controlState );
 }
 
-void RunControlStep( Controller controller, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable )
+void RunControlStep( Controller controller, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable, double timeDelta )
 {
   const double BALL_LENGTH = 0.14;
   const double BALL_BALL_WIDTH = 0.19;
@@ -239,7 +239,7 @@ void SetControlState( Controller genericController, enum ControlState newControl
   controller->currentControlState = newControlState;
 }
 
-void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable )
+void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable, double timeDelta )
 {
   if( genericController == NULL ) return;
   
@@ -12,6 +12,6 @@
         INIT_FUNCTION( size_t, Interface, GetAxesNumber, Controller ) \
         INIT_FUNCTION( char**, Interface, GetAxisNamesList, Controller ) \
         INIT_FUNCTION( void, Interface, SetControlState, Controller, enum ControlState ) \
-        INIT_FUNCTION( void, Interface, RunControlStep, Controller, double**, double**, double**, double** )
+        INIT_FUNCTION( void, Interface, RunControlStep, Controller, double**, double**, double**, double**, double )
 
 #endif  // ROBOT_CONTROL_INTERFACE_H
@@ -88,7 +88,7 @@ void SetControlState( Controller genericController, enum ControlState controlSta
   controller->enabled = ( controlState == CONTROL_OPERATION ) ? true : false; 
 }
 
-void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable )
+void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable, double timeDelta )
 {
   if( genericController == NULL ) return;
   
@@ -220,7 +220,7 @@ char** GetAxisNamesList( Controller controller )
   return model->axisNames.data();
 }
 
-void RunControlStep( Controller controller, ControlVariables** jointMeasuresList, ControlVariables** axisMeasuresList, ControlVariables** jointSetpointsList, ControlVariables** axisSetpointsList )
+void RunControlStep( Controller controller, ControlVariables** jointMeasuresList, ControlVariables** axisMeasuresList, ControlVariables** jointSetpointsList, ControlVariables** axisSetpointsList, double timeDelta )
 {
   if( controller == NULL ) return;
   
@@ -232,6 +232,9 @@ void RunControlStep( Controller controller, ControlVariables** jointMeasuresList
     model->coordinatesList[ jointIndex ].setSpeedValue( model->state, jointMeasuresList[ jointIndex ]->velocity );
   }
   
+  // Integrate over the actual time elapsed since the last control pass
+  model->manager->setInitialTime( model->state.getTime() );
+  model->manager->setFinalTime( model->state.getTime() + timeDelta );
   model->manager->integrate( model->state );
   
   /*for( int jointIndex = 0; jointIndex < model->coordinatesList.getSize(); jointIndex++ )
@@ -123,7 +123,7 @@ void SetControlState( Controller genericController, enum ControlState controlSta
   fprintf( stderr, "Setting robot control state: %x\n", controlState );
 }
 
-void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable )
+void RunControlStep( Controller genericController, double** jointMeasuresTable, double** axisMeasuresTable, double** jointSetpointsTable, double** axisSetpointsTable, double timeDelta )
 {
   if( genericController == NULL ) return;
   
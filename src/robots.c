@@ -25,6 +25,8 @@
 #include "klib/khash.h"
 
 #include "threads/threading.h"
+#include "threads/thread_safe_data.h"
+#include "threads/atomic_operations.h"
 #include "time/timing.h"
 
 #include "debug/async_debug.h"
@@ -32,23 +34,66 @@
 
 #include "robot_control/interface.h"
 #include "robots.h"
+#include "control_executor.h"
+
+
+// Sequential mode runs sense, compute and actuate stages in order. Pipelined mode acquires measures for the next pass
+// on a separate thread while the current one computes, and writes all motors together at a fixed phase of the period
+enum RobotExecutionMode { ROBOT_EXECUTION_SEQUENTIAL, ROBOT_EXECUTION_PIPELINED, ROBOT_EXECUTION_MODES_NUMBER };
+
+// Control passes run on a dedicated thread per robot, or as tasks of the shared control executor worker pool
+enum RobotScheduler { ROBOT_SCHEDULER_THREAD, ROBOT_SCHEDULER_POOL, ROBOT_SCHEDULERS_NUMBER };
+
+// Sense thread wakes up periodically to check for control end
+#define SENSE_REQUEST_TIMEOUT_NS 100000000ULL
 
 
 /////////////////////////////////////////////////////////////////////////////////
 /////                            CONTROL DEVICE                             /////
 /////////////////////////////////////////////////////////////////////////////////
 
+// External setpoints are handed to the control thread with a version per variable, so that only
+// the ones set since the last applied update overwrite the controller values
+typedef struct _SharedSetpoints
+{
+  ControlVariablesList valuesList;
+  uint32_t versionsList[ CONTROL_VARS_NUMBER ];
+  uint32_t tag;
+}
+SharedSetpoints;
+
+typedef struct _SharedMeasures
+{
+  ControlVariablesList valuesList;
+  MeasuresStamp stamp;
+}
+SharedMeasures;
+
+// Measures/setpoints lists are owned by the control thread. Shared ones are only accessed
+// by the thread exchanging data with the robot (through Robots_ExchangeData)
 struct _JointData
 {
   Actuator actuator;
   ControlVariablesList measuresList;
   ControlVariablesList setpointsList;
+  ControlVariablesList acquiredMeasuresList;
+  uint32_t appliedVersionsList[ CONTROL_VARS_NUMBER ];
+  SharedMeasures sharedMeasures;
+  SharedSetpoints sharedSetpoints;
+  LatencyHistogram stageHistogramsList[ ROBOT_STAGES_NUMBER ];
+  bool isResetPending;                           // Error found by the sense thread, for the control thread to reset (pipelined mode)
+  ThreadLock deviceLock;                         // Serializes sensor reads and motor writes of sense and control threads (pipelined mode)
 };
 
 struct _AxisData
 {
   ControlVariablesList measuresList;
   ControlVariablesList setpointsList;
+  uint32_t appliedVersionsList[ CONTROL_VARS_NUMBER ];
+  MeasuresStamp measuresStamp;                   // Tag and actuation time of the last applied setpoints
+  bool isTagPending;                             // Tagged setpoints applied, but not written to the motors yet
+  SharedMeasures sharedMeasures;
+  SharedSetpoints sharedSetpoints;
 };
 
 struct _RobotData
@@ -56,6 +101,27 @@ struct _RobotData
   DECLARE_MODULE_INTERFACE_REF( ROBOT_CONTROL_INTERFACE );
   Controller controller;
   Thread controlThread;
+  ThreadSpec controlThreadSpec;
+  PeriodicTimer controlTimer;
+  double controlInterval;
+  enum RobotExecutionMode executionMode;
+  enum RobotScheduler scheduler;
+  int controlTaskID;
+  Timestamp lastCycleStartTime;
+  Timestamp measuresTime;                        // Sensors read time of the measures used by the current pass
+  Timestamp acquiredMeasuresTime;                // Sensors read time of the measures written by the sense thread
+  uint64_t passesCount;
+  uint64_t senseDeadline;                        // Offsets from the pass start, in nanoseconds (pipelined mode)
+  uint64_t actuatePhase;
+  Thread senseThread;
+  Semaphore senseRequest;
+  Semaphore senseDone;
+  bool isSensePending;
+  double senseTimeDelta;
+  double** jointAcquiredTable;                   // Measures written by the sense thread, copied when a pass starts
+  uint64_t senseMissesCount;
+  uint64_t actuateMissesCount;
+  LatencyHistogram stageHistogramsList[ ROBOT_STAGES_NUMBER ];
   volatile bool isControlRunning;
   enum ControlState controlState;
   Joint* jointsList;
@@ -66,17 +132,33 @@ struct _RobotData
   double** axisMeasuresTable;
   double** axisSetpointsTable;
   size_t axesNumber;
+  TripleBuffer setpointsBuffer;                  // Joints then axes SharedSetpoints blocks
+  TripleBuffer measuresBuffer;                   // Joints then axes SharedMeasures blocks
+  RobotCycleCallback cycleCallback;
+  void* cycleCallbackData;
 };
 
 KHASH_MAP_INIT_INT( RobotInt, Robot )
 khash_t( RobotInt )* robotsList = NULL;
 
+// Signaled by control passes whenever new measures are available for exchange
+static WakeEvent measuresEvent = NULL;
+
 DEFINE_NAMESPACE_INTERFACE( Robots, ROBOT_INTERFACE )
 
 
+const char* OVERRUN_POLICY_NAMES[ TIMER_OVERRUN_POLICIES_NUMBER ] = { "SKIP", "CATCH_UP" };
+const char* SCHEDULING_POLICY_NAMES[ THREAD_SCHED_POLICIES_NUMBER ] = { "DEFAULT", "FIFO", "ROUND_ROBIN" };
+const char* CONTROL_STAGE_NAMES[ ROBOT_STAGES_NUMBER ] = { "sense", "compute", "actuate", "cycle" };
+const char* EXECUTION_MODE_NAMES[ ROBOT_EXECUTION_MODES_NUMBER ] = { "SEQUENTIAL", "PIPELINED" };
+const char* SCHEDULER_NAMES[ ROBOT_SCHEDULERS_NUMBER ] = { "THREAD", "POOL" };
+
+
 static inline Robot LoadRobotData( const char* );
 static inline void UnloadRobotData( Robot );
+static void DumpControlTimes( Robot, int );
 
+static void RunControlPass( void* );
 static void* AsyncControl( void* );
 
 int Robots_Init( const char* configFileName )
@@ -116,6 +198,7 @@ void Robots_End( int robotID )
   if( robotIndex == kh_end( robotsList ) ) return;
   
   Robot robot = kh_value( robotsList, robotIndex );
+  DumpControlTimes( robot, robotID );
   UnloadRobotData( robot );
   
   kh_del( RobotInt, robotsList, robotIndex );
@@ -145,9 +228,17 @@ bool Robots_Enable( int robotID )
     //if( !Actuators.IsEnabled( robot->jointsList[ jointIndex ]->actuator ) ) return false;
   }
   
+  if( !robot->isControlRunning && robot->scheduler == ROBOT_SCHEDULER_POOL && ControlExecutor.IsRunning() )
+  {
+    robot->lastCycleStartTime = TIMESTAMP_INVALID;
+    robot->controlTaskID = ControlExecutor.AddTask( RunControlPass, robot, robot->controlInterval );
+    if( robot->controlTaskID != CONTROL_TASK_INVALID_ID ) robot->isControlRunning = true;
+    else DEBUG_PRINT( "no control executor slot for robot %p. using a dedicated thread", robot );
+  }
+  
   if( !robot->isControlRunning )
   {
-    robot->controlThread = Threading.StartThread( AsyncControl, robot, THREAD_JOINABLE );
+    robot->controlThread = Threading.StartThreadSpec( AsyncControl, robot, THREAD_JOINABLE, &(robot->controlThreadSpec) );
   
     if( robot->controlThread == THREAD_INVALID_HANDLE ) return false;
   }
@@ -162,11 +253,35 @@ bool Robots_Disable( int robotID )
   
   Robot robot = kh_value( robotsList, robotIndex );
   
-  if( robot->controlThread == THREAD_INVALID_HANDLE ) return false;
+  if( robot->controlTaskID != CONTROL_TASK_INVALID_ID )
+  {
+    ControlExecutor.RemoveTask( robot->controlTaskID );
+    robot->controlTaskID = CONTROL_TASK_INVALID_ID;
+    robot->isControlRunning = false;
+    DEBUG_PRINT( "robot %d control task removed from executor", robotID );
+  }
+  else
+  {
+    if( robot->controlThread == THREAD_INVALID_HANDLE ) return false;
+  
+    robot->isControlRunning = false;
+    Threading.WaitExit( robot->controlThread, 5000 );
+    robot->controlThread = THREAD_INVALID_HANDLE;
   
-  robot->isControlRunning = false;
-  Threading.WaitExit( robot->controlThread, 5000 );
-  robot->controlThread = THREAD_INVALID_HANDLE;
+    PeriodicTimerStats controlStats;
+    if( PeriodicTimers.GetStats( robot->controlTimer, &controlStats ) )
+    {
+      DEBUG_PRINT( "robot %d control: %lu cycles - %lu missed deadlines (worst lateness: %.3f ms) - %lu skipped cycles (overrun policy: %s)", robotID,
+                   (unsigned long) controlStats.cyclesCount, (unsigned long) controlStats.missedDeadlinesCount, controlStats.worstLatenessNanoseconds / 1000000.0,
+                   (unsigned long) controlStats.skippedCyclesCount, OVERRUN_POLICY_NAMES[ controlStats.overrunPolicy ] );
+    }
+  
+    if( robot->executionMode == ROBOT_EXECUTION_PIPELINED )
+    {
+      DEBUG_PRINT( "robot %d pipeline: %lu late acquisitions - %lu late motor writes", robotID, 
+                   (unsigned long) robot->senseMissesCount, (unsigned long) robot->actuateMissesCount );
+    }
+  }
   
   for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
     Actuators.Disable( robot->jointsList[ jointIndex ]->actuator );
@@ -259,7 +374,7 @@ double Robots_GetJointMeasure( Joint joint, enum ControlVariable variable )
   
   if( variable >= CONTROL_VARS_NUMBER ) return 0.0;
   
-  return joint->measuresList[ variable ];
+  return joint->sharedMeasures.valuesList[ variable ];
 }
 
 double Robots_GetAxisMeasure( Axis axis, enum ControlVariable variable )
@@ -268,7 +383,7 @@ double Robots_GetAxisMeasure( Axis axis, enum ControlVariable variable )
   
   if( variable >= CONTROL_VARS_NUMBER ) return 0.0;
   
-  return axis->measuresList[ variable ];
+  return axis->sharedMeasures.valuesList[ variable ];
 }
 
 double Robots_SetJointSetpoint( Joint joint, enum ControlVariable variable, double value )
@@ -277,7 +392,8 @@ double Robots_SetJointSetpoint( Joint joint, enum ControlVariable variable, doub
   
   if( variable >= CONTROL_VARS_NUMBER ) return 0.0;
   
-  joint->setpointsList[ variable ] = value;
+  joint->sharedSetpoints.valuesList[ variable ] = value;
+  joint->sharedSetpoints.versionsList[ variable ]++;
   
   return value;
 }
@@ -288,11 +404,121 @@ double Robots_SetAxisSetpoint( Axis axis, enum ControlVariable variable, double
   
   if( variable >= CONTROL_VARS_NUMBER ) return 0.0;
   
-  axis->setpointsList[ variable ] = value;
+  axis->sharedSetpoints.valuesList[ variable ] = value;
+  axis->sharedSetpoints.versionsList[ variable ]++;
   
   return value;
 }
 
+// Tag the axis setpoints set since the last data exchange. The tag is shared back with the measures once they are applied
+void Robots_SetAxisSetpointsTag( Axis axis, uint32_t tag )
+{
+  if( axis == NULL ) return;
+  
+  axis->sharedSetpoints.tag = tag;
+}
+
+// Capture and actuation times of the latest exchanged measures
+bool Robots_GetAxisMeasuresStamp( Axis axis, MeasuresStamp* ref_stamp )
+{
+  if( axis == NULL || ref_stamp == NULL ) return false;
+  
+  *ref_stamp = axis->sharedMeasures.stamp;
+  
+  return true;
+}
+
+void Robots_SetUpdateEvent( WakeEvent event )
+{
+  measuresEvent = event;
+}
+
+// May be changed while control runs: callback data must remain valid until the robot ends
+bool Robots_SetCycleCallback( int robotID, RobotCycleCallback callback, void* callbackData )
+{
+  khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
+  if( robotIndex == kh_end( robotsList ) ) return false;
+  
+  Robot robot = kh_value( robotsList, robotIndex );
+  
+  // Data is set before the callback becomes visible to the control pass
+  if( callback != NULL ) robot->cycleCallbackData = callbackData;
+  ATOMIC_STORE( &(robot->cycleCallback), callback );
+  
+  return true;
+}
+
+// Publish setpoints changed since the last call to the control thread and get its latest measures
+void Robots_ExchangeData( int robotID )
+{
+  khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
+  if( robotIndex == kh_end( robotsList ) ) return;
+  
+  Robot robot = kh_value( robotsList, robotIndex );
+  
+  SharedSetpoints* setpointsBlocksList = (SharedSetpoints*) TripleBuffers.GetWriteBuffer( robot->setpointsBuffer );
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+    setpointsBlocksList[ jointIndex ] = robot->jointsList[ jointIndex ]->sharedSetpoints;
+  for( size_t axisIndex = 0; axisIndex < robot->axesNumber; axisIndex++ )
+    setpointsBlocksList[ robot->jointsNumber + axisIndex ] = robot->axesList[ axisIndex ]->sharedSetpoints;
+  TripleBuffers.Publish( robot->setpointsBuffer );
+  
+  if( TripleBuffers.Update( robot->measuresBuffer ) )
+  {
+    SharedMeasures* measuresBlocksList = (SharedMeasures*) TripleBuffers.GetReadBuffer( robot->measuresBuffer );
+    for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+      robot->jointsList[ jointIndex ]->sharedMeasures = measuresBlocksList[ jointIndex ];
+    for( size_t axisIndex = 0; axisIndex < robot->axesNumber; axisIndex++ )
+      robot->axesList[ axisIndex ]->sharedMeasures = measuresBlocksList[ robot->jointsNumber + axisIndex ];
+  }
+}
+
+bool Robots_GetControlStats( int robotID, PeriodicTimerStats* ref_stats )
+{
+  khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
+  if( robotIndex == kh_end( robotsList ) ) return false;
+  
+  Robot robot = kh_value( robotsList, robotIndex );
+  
+  return PeriodicTimers.GetStats( robot->controlTimer, ref_stats );
+}
+
+bool Robots_GetStageStats( int robotID, enum RobotControlStage stage, LatencyStats* ref_stats )
+{
+  khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
+  if( robotIndex == kh_end( robotsList ) ) return false;
+  
+  if( stage >= ROBOT_STAGES_NUMBER ) return false;
+  
+  Robot robot = kh_value( robotsList, robotIndex );
+  
+  return LatencyHistograms.GetStats( &(robot->stageHistogramsList[ stage ]), ref_stats );
+}
+
+// Copies the stage times histogram, still being recorded by the control thread (counts may be slightly off)
+bool Robots_GetStageHistogram( int robotID, enum RobotControlStage stage, LatencyHistogram* ref_histogram )
+{
+  khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
+  if( robotIndex == kh_end( robotsList ) ) return false;
+  
+  if( stage >= ROBOT_STAGES_NUMBER || ref_histogram == NULL ) return false;
+  
+  Robot robot = kh_value( robotsList, robotIndex );
+  
+  memcpy( ref_histogram, &(robot->stageHistogramsList[ stage ]), sizeof(LatencyHistogram) );
+  
+  return true;
+}
+
+bool Robots_GetJointStageStats( Joint joint, enum RobotControlStage stage, LatencyStats* ref_stats )
+{
+  if( joint == NULL ) return false;
+  
+  if( stage >= ROBOT_STAGES_NUMBER ) return false;
+  
+  return LatencyHistograms.GetStats( &(joint->stageHistogramsList[ stage ]), ref_stats );
+}
+
 size_t Robots_GetJointsNumber( int robotID )
 {
   khint_t robotIndex = kh_get( RobotInt, robotsList, (khint_t) robotID );
@@ -317,40 +543,294 @@ size_t Robots_GetAxesNumber( int robotID )
 /////                         ASYNCRONOUS CONTROL                           /////
 /////////////////////////////////////////////////////////////////////////////////
 
-static void* AsyncControl( void* ref_robot )
+// Register time elapsed since the given stage start and return the current time, as start of the next stage
+static inline Timestamp RecordStageTime( Robot robot, enum RobotControlStage stage, Timestamp stageStartTime )
 {
-  const unsigned long CONTROL_PASS_INTERVAL_MS = (unsigned long) ( 1000 * CONTROL_PASS_INTERVAL );
+  Timestamp stageEndTime = Timing.GetExecTimeNanoseconds();
   
-  Robot robot = (Robot) ref_robot;
+  LatencyHistograms.Record( &(robot->stageHistogramsList[ stage ]), stageEndTime - stageStartTime );
   
-  unsigned long execTime, elapsedTime;
+  return stageEndTime;
+}
+
+// Oldest sensors read time among the robot joints (current time without joints)
+static Timestamp GetJointsMeasuresTime( Robot robot )
+{
+  Timestamp measuresTime = TIMESTAMP_INVALID;
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    Timestamp jointMeasuresTime = Actuators.GetMeasuresTime( robot->jointsList[ jointIndex ]->actuator );
+    if( measuresTime == TIMESTAMP_INVALID || jointMeasuresTime < measuresTime ) measuresTime = jointMeasuresTime;
+  }
   
-  robot->isControlRunning = true;
+  return ( measuresTime != TIMESTAMP_INVALID ) ? measuresTime : Timing.GetExecTimeNanoseconds();
+}
+
+// Passes return the time motors were written
+static Timestamp SequentialControlPass( Robot robot, Timestamp cycleStartTime, double timeDelta )
+{
+  Timestamp stageStartTime = cycleStartTime, jointStartTime, jointEndTime;
   
-  /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "starting to run control for robot %p on thread %lx", robot, THREAD_ID );
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    jointStartTime = Timing.GetExecTimeNanoseconds();
+    (void) Actuators.UpdateMeasures( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ], timeDelta );
+    jointEndTime = Timing.GetExecTimeNanoseconds();
+    LatencyHistograms.Record( &(robot->jointsList[ jointIndex ]->stageHistogramsList[ ROBOT_STAGE_SENSE ]), jointEndTime - jointStartTime );
+  }
+  robot->measuresTime = GetJointsMeasuresTime( robot );
+  stageStartTime = RecordStageTime( robot, ROBOT_STAGE_SENSE, stageStartTime );
+
+  robot->RunControlStep( robot->controller, robot->jointMeasuresTable, robot->axisMeasuresTable, robot->jointSetpointsTable, robot->axisSetpointsTable, timeDelta );
+  stageStartTime = RecordStageTime( robot, ROBOT_STAGE_COMPUTE, stageStartTime );
+
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    jointStartTime = Timing.GetExecTimeNanoseconds();
+    
+    if( Actuators.HasError( robot->jointsList[ jointIndex ]->actuator ) ) Actuators.Reset( robot->jointsList[ jointIndex ]->actuator );
+    
+    (void) Actuators.RunControl( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ], robot->jointSetpointsTable[ jointIndex ], timeDelta );
+    
+    jointEndTime = Timing.GetExecTimeNanoseconds();
+    LatencyHistograms.Record( &(robot->jointsList[ jointIndex ]->stageHistogramsList[ ROBOT_STAGE_ACTUATE ]), jointEndTime - jointStartTime );
+  }
+  return RecordStageTime( robot, ROBOT_STAGE_ACTUATE, stageStartTime );
+}
+
+// Acquisition thread for pipelined mode: reads sensors (and flags faulty actuators) when requested by the control pass.
+// Actuators are reset by the control thread, as it drives them meanwhile. Device plugins are not required to be
+// thread-safe, so each joint reads are done under the same lock of its motor writes
+static void* AsyncSense( void* ref_robot )
+{
+  Robot robot = (Robot) ref_robot;
+  
+  Timestamp jointStartTime, jointEndTime;
   
   while( robot->isControlRunning )
   {
-    execTime = Timing.GetExecTimeMilliseconds();
+    if( ! Semaphores.TimedDecrement( robot->senseRequest, SENSE_REQUEST_TIMEOUT_NS ) ) continue;
     
     for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
-      (void) Actuators.UpdateMeasures( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ] );
+    {
+      jointStartTime = Timing.GetExecTimeNanoseconds();
+      
+      ThreadLocks.Aquire( robot->jointsList[ jointIndex ]->deviceLock );
+      
+      if( Actuators.HasError( robot->jointsList[ jointIndex ]->actuator ) ) robot->jointsList[ jointIndex ]->isResetPending = true;
+      
+      (void) Actuators.UpdateMeasures( robot->jointsList[ jointIndex ]->actuator, robot->jointAcquiredTable[ jointIndex ], robot->senseTimeDelta );
+      
+      ThreadLocks.Release( robot->jointsList[ jointIndex ]->deviceLock );
+      
+      jointEndTime = Timing.GetExecTimeNanoseconds();
+      LatencyHistograms.Record( &(robot->jointsList[ jointIndex ]->stageHistogramsList[ ROBOT_STAGE_SENSE ]), jointEndTime - jointStartTime );
+    }
+    robot->acquiredMeasuresTime = GetJointsMeasuresTime( robot );
+    
+    Semaphores.Increment( robot->senseDone );
+  }
   
-    robot->RunControlStep( robot->controller, robot->jointMeasuresTable, robot->axisMeasuresTable, robot->jointSetpointsTable, robot->axisSetpointsTable );
+  return NULL;
+}
+
+static Timestamp PipelinedControlPass( Robot robot, Timestamp cycleStartTime, double timeDelta )
+{
+  Timestamp stageStartTime = cycleStartTime, jointStartTime, jointEndTime;
   
-    for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  // Collect measures requested on the previous pass. If they are late, compute with the previous ones
+  if( robot->isSensePending )
+  {
+    Timestamp elapsedTime = Timing.GetExecTimeNanoseconds() - cycleStartTime;
+    uint64_t senseTimeout = ( robot->senseDeadline > elapsedTime ) ? robot->senseDeadline - elapsedTime : 0;
+    if( Semaphores.TimedDecrement( robot->senseDone, senseTimeout ) )
     {
-      if( Actuators.HasError( robot->jointsList[ jointIndex ]->actuator ) ) Actuators.Reset( robot->jointsList[ jointIndex ]->actuator );
-      
-      (void) Actuators.RunControl( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ], robot->jointSetpointsTable[ jointIndex ] );
+      for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+      {
+        memcpy( robot->jointMeasuresTable[ jointIndex ], robot->jointAcquiredTable[ jointIndex ], sizeof(ControlVariablesList) );
+        // Sense thread is idle until the next request, so flagged actuators may be reset here
+        if( robot->jointsList[ jointIndex ]->isResetPending ) 
+        {
+          ThreadLocks.Aquire( robot->jointsList[ jointIndex ]->deviceLock );
+          Actuators.Reset( robot->jointsList[ jointIndex ]->actuator );
+          ThreadLocks.Release( robot->jointsList[ jointIndex ]->deviceLock );
+          robot->jointsList[ jointIndex ]->isResetPending = false;
+        }
+      }
+      robot->measuresTime = robot->acquiredMeasuresTime;
+      robot->isSensePending = false;
+    }
+    else
+      robot->senseMissesCount++;
+  }
+  
+  // Issue acquisition for the next pass, overlapping it with this pass computation
+  if( !robot->isSensePending )
+  {
+    robot->senseTimeDelta = timeDelta;
+    robot->isSensePending = true;
+    Semaphores.Increment( robot->senseRequest );
+  }
+  stageStartTime = RecordStageTime( robot, ROBOT_STAGE_SENSE, stageStartTime );
+  
+  robot->RunControlStep( robot->controller, robot->jointMeasuresTable, robot->axisMeasuresTable, robot->jointSetpointsTable, robot->axisSetpointsTable, timeDelta );
+  stageStartTime = RecordStageTime( robot, ROBOT_STAGE_COMPUTE, stageStartTime );
+  
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    jointStartTime = Timing.GetExecTimeNanoseconds();
+    (void) Actuators.ComputeControl( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ], robot->jointSetpointsTable[ jointIndex ], timeDelta );
+    jointEndTime = Timing.GetExecTimeNanoseconds();
+    LatencyHistograms.Record( &(robot->jointsList[ jointIndex ]->stageHistogramsList[ ROBOT_STAGE_ACTUATE ]), jointEndTime - jointStartTime );
+  }
+  
+  Timestamp computeEndTime = Timing.GetExecTimeNanoseconds();
+  
+  // Write all motors together at the same point of every period. The wait is left out of the stage time
+  if( ! PeriodicTimers.WaitCyclePhase( robot->controlTimer, robot->actuatePhase ) ) robot->actuateMissesCount++;
+  Timestamp flushStartTime = Timing.GetExecTimeNanoseconds();
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    // A slow read of the same joint by the sense thread delays its write, but never overlaps it
+    ThreadLocks.Aquire( robot->jointsList[ jointIndex ]->deviceLock );
+    Actuators.FlushControl( robot->jointsList[ jointIndex ]->actuator );
+    ThreadLocks.Release( robot->jointsList[ jointIndex ]->deviceLock );
+  }
+  Timestamp actuationTime = Timing.GetExecTimeNanoseconds();
+  
+  LatencyHistograms.Record( &(robot->stageHistogramsList[ ROBOT_STAGE_ACTUATE ]), ( computeEndTime - stageStartTime ) + ( actuationTime - flushStartTime ) );
+  
+  return actuationTime;
+}
+
+static inline void ApplySetpoints( ControlVariablesList setpointsList, uint32_t* appliedVersionsList, SharedSetpoints* sharedSetpoints )
+{
+  for( int variableIndex = 0; variableIndex < CONTROL_VARS_NUMBER; variableIndex++ )
+  {
+    if( sharedSetpoints->versionsList[ variableIndex ] != appliedVersionsList[ variableIndex ] )
+    {
+      setpointsList[ variableIndex ] = sharedSetpoints->valuesList[ variableIndex ];
+      appliedVersionsList[ variableIndex ] = sharedSetpoints->versionsList[ variableIndex ];
     }
+  }
+}
+
+static void ReceiveSetpoints( Robot robot )
+{
+  if( ! TripleBuffers.Update( robot->setpointsBuffer ) ) return;
+  
+  SharedSetpoints* setpointsBlocksList = (SharedSetpoints*) TripleBuffers.GetReadBuffer( robot->setpointsBuffer );
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    Joint joint = robot->jointsList[ jointIndex ];
+    ApplySetpoints( joint->setpointsList, joint->appliedVersionsList, &(setpointsBlocksList[ jointIndex ]) );
+  }
+  for( size_t axisIndex = 0; axisIndex < robot->axesNumber; axisIndex++ )
+  {
+    Axis axis = robot->axesList[ axisIndex ];
+    SharedSetpoints* axisSetpoints = &(setpointsBlocksList[ robot->jointsNumber + axisIndex ]);
+    ApplySetpoints( axis->setpointsList, axis->appliedVersionsList, axisSetpoints );
+    if( axisSetpoints->tag != axis->measuresStamp.setpointsTag )
+    {
+      axis->measuresStamp.setpointsTag = axisSetpoints->tag;
+      axis->isTagPending = true;
+    }
+  }
+}
+
+static void SendMeasures( Robot robot )
+{
+  MeasuresStamp passStamp = { .captureTime = robot->measuresTime, .sequenceNumber = robot->passesCount };
+  
+  SharedMeasures* measuresBlocksList = (SharedMeasures*) TripleBuffers.GetWriteBuffer( robot->measuresBuffer );
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    memcpy( measuresBlocksList[ jointIndex ].valuesList, robot->jointsList[ jointIndex ]->measuresList, sizeof(ControlVariablesList) );
+    measuresBlocksList[ jointIndex ].stamp = passStamp;
+  }
+  for( size_t axisIndex = 0; axisIndex < robot->axesNumber; axisIndex++ )
+  {
+    Axis axis = robot->axesList[ axisIndex ];
+    SharedMeasures* axisMeasures = &(measuresBlocksList[ robot->jointsNumber + axisIndex ]);
+    memcpy( axisMeasures->valuesList, axis->measuresList, sizeof(ControlVariablesList) );
+    axisMeasures->stamp = passStamp;
+    axisMeasures->stamp.setpointsTag = axis->measuresStamp.setpointsTag;
+    axisMeasures->stamp.actuationTime = axis->measuresStamp.actuationTime;
+  }
+  TripleBuffers.Publish( robot->measuresBuffer );
+  
+  WakeEvents.Signal( measuresEvent );
+}
+
+// Single control pass, run by the robot own control thread or by a control executor worker
+static void RunControlPass( void* ref_robot )
+{
+  Robot robot = (Robot) ref_robot;
+  
+  Timestamp cycleStartTime = Timing.GetExecTimeNanoseconds();
+  
+  ReceiveSetpoints( robot );
+  
+  // Actual time elapsed since the last pass (nominal interval on the first one)
+  double timeDelta = ( robot->lastCycleStartTime != TIMESTAMP_INVALID ) ? TIMESTAMP_TO_SECONDS( cycleStartTime - robot->lastCycleStartTime ) : robot->controlInterval;
+  robot->lastCycleStartTime = cycleStartTime;
+  
+  Timestamp actuationTime;
+  if( robot->senseThread != THREAD_INVALID_HANDLE ) actuationTime = PipelinedControlPass( robot, cycleStartTime, timeDelta );
+  else actuationTime = SequentialControlPass( robot, cycleStartTime, timeDelta );
+  robot->passesCount++;
+  
+  for( size_t axisIndex = 0; axisIndex < robot->axesNumber; axisIndex++ )
+  {
+    Axis axis = robot->axesList[ axisIndex ];
+    if( axis->isTagPending ) axis->measuresStamp.actuationTime = actuationTime;
+    axis->isTagPending = false;
+  }
+  
+  RobotCycleCallback cycleCallback = ATOMIC_LOAD( &(robot->cycleCallback) );
+  if( cycleCallback != NULL ) cycleCallback( robot->cycleCallbackData, cycleStartTime, robot->axisMeasuresTable, robot->axisSetpointsTable, robot->axesNumber );
+  
+  SendMeasures( robot );
+  
+  (void) RecordStageTime( robot, ROBOT_STAGE_CYCLE, cycleStartTime );
+}
+
+static void* AsyncControl( void* ref_robot )
+{
+  Robot robot = (Robot) ref_robot;
+  
+  robot->isControlRunning = true;
+  
+  /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "starting to run control for robot %p on thread %lx", robot, THREAD_ID );
+  
+  robot->senseThread = THREAD_INVALID_HANDLE;
+  if( robot->executionMode == ROBOT_EXECUTION_PIPELINED )
+  {
+    robot->isSensePending = false;
+    Semaphores.SetCount( robot->senseRequest, 0 );
+    Semaphores.SetCount( robot->senseDone, 0 );
+    // First pass computes with measures read synchronously
+    for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+      (void) Actuators.UpdateMeasures( robot->jointsList[ jointIndex ]->actuator, robot->jointMeasuresTable[ jointIndex ], robot->controlInterval );
+    robot->measuresTime = GetJointsMeasuresTime( robot );
+    robot->senseThread = Threading.StartThreadSpec( AsyncSense, robot, THREAD_JOINABLE, &(robot->controlThreadSpec) );
+  }
+  
+  PeriodicTimers.Start( robot->controlTimer );
+  
+  robot->lastCycleStartTime = TIMESTAMP_INVALID;
+  
+  while( robot->isControlRunning )
+  {
+    RunControlPass( robot );
     
-    elapsedTime = Timing.GetExecTimeMilliseconds() - execTime;
-    //DEBUG_PRINT( "step time for robot %p (before delay): %lu ms", robot, elapsedTime );
-    if( elapsedTime < CONTROL_PASS_INTERVAL_MS ) Timing.Delay( CONTROL_PASS_INTERVAL_MS - elapsedTime );
-    //DEBUG_PRINT( "step time for robot %p (after delay): %lu ms", robot, Timing.GetExecTimeMilliseconds() - execTime );
+    // Sleep until the next absolute deadline (no drift accumulation between cycles)
+    (void) PeriodicTimers.WaitNextCycle( robot->controlTimer );
   }
   
+  if( robot->senseThread != THREAD_INVALID_HANDLE ) Threading.WaitExit( robot->senseThread, 5000 );
+  robot->senseThread = THREAD_INVALID_HANDLE;
+  
   return NULL;
 }
 
@@ -386,12 +866,17 @@ Robot LoadRobotData( const char* configFileName )
       newRobot->jointsList = (Joint*) calloc( newRobot->jointsNumber, sizeof(Joint) );
       newRobot->jointMeasuresTable = (double**) calloc( newRobot->jointsNumber, sizeof(double*) );
       newRobot->jointSetpointsTable = (double**) calloc( newRobot->jointsNumber, sizeof(double*) );
+      newRobot->jointAcquiredTable = (double**) calloc( newRobot->jointsNumber, sizeof(double*) );
       for( size_t jointIndex = 0; jointIndex < newRobot->jointsNumber; jointIndex++ )
       {
-        newRobot->jointsList[ jointIndex ] = (Joint) malloc( sizeof(JointData) );
+        newRobot->jointsList[ jointIndex ] = (Joint) calloc( 1, sizeof(JointData) );
+        for( int stageIndex = 0; stageIndex < ROBOT_STAGES_NUMBER; stageIndex++ )
+          LatencyHistograms.Reset( &(newRobot->jointsList[ jointIndex ]->stageHistogramsList[ stageIndex ]) );
         newRobot->jointsList[ jointIndex ]->actuator = Actuators.Init( Configuration.GetIOHandler()->GetStringValue( configFileID, "", "actuators.%lu", jointIndex ) );
+        newRobot->jointsList[ jointIndex ]->deviceLock = ThreadLocks.Create();
         newRobot->jointMeasuresTable[ jointIndex ] = (double*) newRobot->jointsList[ jointIndex ]->measuresList;
         newRobot->jointSetpointsTable[ jointIndex ] = (double*) newRobot->jointsList[ jointIndex ]->setpointsList;
+        newRobot->jointAcquiredTable[ jointIndex ] = (double*) newRobot->jointsList[ jointIndex ]->acquiredMeasuresList;
         
         if( newRobot->jointsList[ jointIndex ] == NULL ) loadSuccess = false;
       }
@@ -402,7 +887,7 @@ Robot LoadRobotData( const char* configFileName )
       newRobot->axisSetpointsTable = (double**) calloc( newRobot->axesNumber, sizeof(double*) );
       for( size_t axisIndex = 0; axisIndex < newRobot->axesNumber; axisIndex++ )
       {
-        newRobot->axesList[ axisIndex ] = (Axis) malloc( sizeof(AxisData) );
+        newRobot->axesList[ axisIndex ] = (Axis) calloc( 1, sizeof(AxisData) );
         newRobot->axisMeasuresTable[ axisIndex ] = (double*) newRobot->axesList[ axisIndex ]->measuresList;
         newRobot->axisSetpointsTable[ axisIndex ] = (double*) newRobot->axesList[ axisIndex ]->setpointsList;
       }
@@ -410,6 +895,63 @@ Robot LoadRobotData( const char* configFileName )
     
     newRobot->controlState = CONTROL_OPERATION;
     
+    newRobot->setpointsBuffer = TripleBuffers.Create( ( newRobot->jointsNumber + newRobot->axesNumber ) * sizeof(SharedSetpoints) );
+    newRobot->measuresBuffer = TripleBuffers.Create( ( newRobot->jointsNumber + newRobot->axesNumber ) * sizeof(SharedMeasures) );
+    
+    for( int stageIndex = 0; stageIndex < ROBOT_STAGES_NUMBER; stageIndex++ )
+      LatencyHistograms.Reset( &(newRobot->stageHistogramsList[ stageIndex ]) );
+    
+    enum TimerOverrunPolicy overrunPolicy = TIMER_OVERRUN_SKIP;
+    char* overrunPolicyName = Configuration.GetIOHandler()->GetStringValue( configFileID, (char*) OVERRUN_POLICY_NAMES[ TIMER_OVERRUN_SKIP ], "overrun_policy" );
+    for( int overrunPolicyIndex = 0; overrunPolicyIndex < TIMER_OVERRUN_POLICIES_NUMBER; overrunPolicyIndex++ )
+    {
+      if( strcmp( overrunPolicyName, OVERRUN_POLICY_NAMES[ overrunPolicyIndex ] ) == 0 ) overrunPolicy = overrunPolicyIndex;
+    }
+    double controlRate = Configuration.GetIOHandler()->GetRealValue( configFileID, 1.0 / CONTROL_PASS_INTERVAL, "control_rate" );
+    newRobot->controlInterval = ( controlRate > 0.0 ) ? 1.0 / controlRate : CONTROL_PASS_INTERVAL;
+    DEBUG_PRINT( "robot %s control rate: %g Hz", configFileName, 1.0 / newRobot->controlInterval );
+    newRobot->controlTimer = PeriodicTimers.Create( (uint64_t) ( newRobot->controlInterval * 1000000000 ), overrunPolicy );
+    
+    char* executionModeName = Configuration.GetIOHandler()->GetStringValue( configFileID, (char*) EXECUTION_MODE_NAMES[ ROBOT_EXECUTION_SEQUENTIAL ], "execution.mode" );
+    for( int executionModeIndex = 0; executionModeIndex < ROBOT_EXECUTION_MODES_NUMBER; executionModeIndex++ )
+    {
+      if( strcmp( executionModeName, EXECUTION_MODE_NAMES[ executionModeIndex ] ) == 0 ) newRobot->executionMode = executionModeIndex;
+    }
+    // Stage deadlines are given as fractions of the control period
+    double senseDeadlineRatio = Configuration.GetIOHandler()->GetRealValue( configFileID, 0.5, "execution.sense_deadline" );
+    double actuatePhaseRatio = Configuration.GetIOHandler()->GetRealValue( configFileID, 0.9, "execution.actuate_phase" );
+    newRobot->senseDeadline = (uint64_t) ( senseDeadlineRatio * newRobot->controlInterval * 1000000000 );
+    newRobot->actuatePhase = (uint64_t) ( actuatePhaseRatio * newRobot->controlInterval * 1000000000 );
+    // Pooled control passes share the executor workers, so pipelined mode (which needs its own timer phases) is not available
+    char* schedulerName = Configuration.GetIOHandler()->GetStringValue( configFileID, (char*) SCHEDULER_NAMES[ ROBOT_SCHEDULER_THREAD ], "execution.scheduler" );
+    for( int schedulerIndex = 0; schedulerIndex < ROBOT_SCHEDULERS_NUMBER; schedulerIndex++ )
+    {
+      if( strcmp( schedulerName, SCHEDULER_NAMES[ schedulerIndex ] ) == 0 ) newRobot->scheduler = schedulerIndex;
+    }
+    if( newRobot->scheduler == ROBOT_SCHEDULER_POOL && newRobot->executionMode == ROBOT_EXECUTION_PIPELINED )
+    {
+      DEBUG_PRINT( "robot %s: pipelined execution is not available for pooled control. running sequentially", configFileName );
+      newRobot->executionMode = ROBOT_EXECUTION_SEQUENTIAL;
+    }
+    newRobot->controlTaskID = CONTROL_TASK_INVALID_ID;
+    newRobot->senseRequest = Semaphores.Create( 0, 1 );
+    newRobot->senseDone = Semaphores.Create( 0, 1 );
+    
+    char* schedulingPolicyName = Configuration.GetIOHandler()->GetStringValue( configFileID, (char*) SCHEDULING_POLICY_NAMES[ THREAD_SCHED_DEFAULT ], "control_thread.policy" );
+    for( int schedulingPolicyIndex = 0; schedulingPolicyIndex < THREAD_SCHED_POLICIES_NUMBER; schedulingPolicyIndex++ )
+    {
+      if( strcmp( schedulingPolicyName, SCHEDULING_POLICY_NAMES[ schedulingPolicyIndex ] ) == 0 ) newRobot->controlThreadSpec.schedulingPolicy = schedulingPolicyIndex;
+    }
+    newRobot->controlThreadSpec.priority = (int) Configuration.GetIOHandler()->GetIntegerValue( configFileID, 0, "control_thread.priority" );
+    newRobot->controlThreadSpec.stackSize = (size_t) Configuration.GetIOHandler()->GetIntegerValue( configFileID, 0, "control_thread.stack_size" );
+    newRobot->controlThreadSpec.useIsolatedCores = Configuration.GetIOHandler()->GetBooleanValue( configFileID, false, "control_thread.isolated_cores" );
+    size_t controlCoresNumber = Configuration.GetIOHandler()->GetListSize( configFileID, "control_thread.cpus" );
+    for( size_t coreIndex = 0; coreIndex < controlCoresNumber; coreIndex++ )
+    {
+      long coreNumber = Configuration.GetIOHandler()->GetIntegerValue( configFileID, -1, "control_thread.cpus.%lu", coreIndex );
+      if( coreNumber >= 0 && coreNumber < 64 ) newRobot->controlThreadSpec.cpuAffinityMask |= ( 1ULL << coreNumber );
+    }
+    
     Configuration.GetIOHandler()->UnloadData( configFileID );
 
     if( !loadSuccess )
@@ -437,6 +979,7 @@ void UnloadRobotData( Robot robot )
   for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
   {
     Actuators.End( robot->jointsList[ jointIndex ]->actuator );
+    ThreadLocks.Discard( robot->jointsList[ jointIndex ]->deviceLock );
     free( robot->jointsList[ jointIndex ] );
   }
   free( robot->jointsList );
@@ -447,10 +990,68 @@ void UnloadRobotData( Robot robot )
   
   free( robot->jointMeasuresTable );
   free( robot->jointSetpointsTable );
+  free( robot->jointAcquiredTable );
   free( robot->axisMeasuresTable );
   free( robot->axisSetpointsTable );
+  
+  PeriodicTimers.Discard( robot->controlTimer );
+  if( robot->senseRequest != NULL ) Semaphores.Discard( robot->senseRequest );
+  if( robot->senseDone != NULL ) Semaphores.Discard( robot->senseDone );
+  TripleBuffers.Discard( robot->setpointsBuffer );
+  TripleBuffers.Discard( robot->measuresBuffer );
     
   free( robot );
 
   DEBUG_PRINT( "robot robot %p discarded", robot );
 }
+
+static void PrintStageStats( const char* ownerName, size_t ownerIndex, const char* stageName, LatencyHistogram* histogram )
+{
+  LatencyStats stageStats;
+  if( LatencyHistograms.GetStats( histogram, &stageStats ) && stageStats.count > 0 )
+  {
+    DEBUG_PRINT( "%s %lu %s times (us): %lu samples - min: %.1f - p50: %.1f - p99: %.1f - p99.9: %.1f - max: %.1f", ownerName, ownerIndex, stageName, 
+                 (unsigned long) stageStats.count, stageStats.minValue / 1000.0, stageStats.medianValue / 1000.0, 
+                 stageStats.percentile99Value / 1000.0, stageStats.percentile999Value / 1000.0, stageStats.maxValue / 1000.0 );
+  }
+}
+
+static void LogStageHistogram( int logID, int stageIndex, long jointIndex, LatencyHistogram* histogram )
+{
+  for( size_t bucketIndex = 0; bucketIndex < LATENCY_BUCKETS_NUMBER; bucketIndex++ )
+  {
+    if( histogram->countsList[ bucketIndex ] > 0 )
+      DataLogging.RegisterValues( logID, 4, (double) stageIndex, (double) jointIndex, 
+                                            (double) LatencyHistograms.GetBucketValue( bucketIndex ), (double) histogram->countsList[ bucketIndex ] );
+  }
+}
+
+// Print control stage times summary and save non empty histogram buckets (stage, joint (-1 for whole robot), upper value in ns, count)
+static void DumpControlTimes( Robot robot, int robotID )
+{
+  static char filePath[ DATA_IO_MAX_FILE_PATH_LENGTH ];
+  
+  if( robot == NULL ) return;
+  
+  for( int stageIndex = 0; stageIndex < ROBOT_STAGES_NUMBER; stageIndex++ )
+    PrintStageStats( "robot", (size_t) robotID, CONTROL_STAGE_NAMES[ stageIndex ], &(robot->stageHistogramsList[ stageIndex ]) );
+  for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+  {
+    for( int stageIndex = 0; stageIndex < ROBOT_STAGES_NUMBER; stageIndex++ )
+      PrintStageStats( "joint", jointIndex, CONTROL_STAGE_NAMES[ stageIndex ], &(robot->jointsList[ jointIndex ]->stageHistogramsList[ stageIndex ]) );
+  }
+  
+  sprintf( filePath, "robot_%d_control_times", robotID );
+  int logID = DataLogging.InitLog( filePath, 4, 1000 );
+  if( logID == DATA_LOG_INVALID_ID ) return;
+  
+  DataLogging.SetDataPrecision( logID, 0 );
+  for( int stageIndex = 0; stageIndex < ROBOT_STAGES_NUMBER; stageIndex++ )
+  {
+    LogStageHistogram( logID, stageIndex, -1, &(robot->stageHistogramsList[ stageIndex ]) );
+    for( size_t jointIndex = 0; jointIndex < robot->jointsNumber; jointIndex++ )
+      LogStageHistogram( logID, stageIndex, (long) jointIndex, &(robot->jointsList[ jointIndex ]->stageHistogramsList[ stageIndex ]) );
+  }
+  
+  DataLogging.EndLog( logID );
+}
@@ -6,6 +6,10 @@
 #include "actuators.h"
 #include "control_definitions.h"
 
+#include "time/timing.h"
+#include "threads/threading.h"
+#include "debug/latency_histograms.h"
+
 /////////////////////////////////////////////////////////////////////////////////
 /////                               INTERFACE                               /////
 /////////////////////////////////////////////////////////////////////////////////
@@ -21,6 +25,24 @@ typedef AxisData* Axis;
 typedef struct _RobotData RobotData;
 typedef RobotData* Robot;
 
+// Timed sections of each control pass. Joints only record SENSE (measures update) and ACTUATE (control and motor write) times
+enum RobotControlStage { ROBOT_STAGE_SENSE, ROBOT_STAGE_COMPUTE, ROBOT_STAGE_ACTUATE, ROBOT_STAGE_CYCLE, ROBOT_STAGES_NUMBER };
+
+// Called at the end of every control pass, from the thread running it, with the pass start time and the
+// axes measures/setpoints tables. Must be quick and must not call other robot functions
+typedef void (*RobotCycleCallback)( void*, Timestamp, double**, double**, size_t );
+
+// Timing of the measures of an axis, shared along with them. Setpoints may be tagged by the caller (e.g. with a
+// client message sequence number), so that the time they reached the motors can be matched to their sending
+typedef struct _MeasuresStamp
+{
+  Timestamp captureTime;                         // Sensors read time (oldest of the robot joints)
+  Timestamp actuationTime;                       // Motors write time of the pass that applied the last tagged setpoints
+  uint64_t sequenceNumber;                       // Control passes count, increased along with the measures
+  uint32_t setpointsTag;                         // Tag of the last applied setpoints
+}
+MeasuresStamp;
+
 #define ROBOT_INTERFACE( namespace, INIT_FUNCTION ) \
         INIT_FUNCTION( int, namespace, Init, const char* ) \
         INIT_FUNCTION( void, namespace, End, int ) \
@@ -35,6 +57,15 @@ typedef RobotData* Robot;
         INIT_FUNCTION( double, namespace, GetAxisMeasure, Axis, enum ControlVariable ) \
         INIT_FUNCTION( double, namespace, SetJointSetpoint, Joint, enum ControlVariable, double ) \
         INIT_FUNCTION( double, namespace, SetAxisSetpoint, Axis, enum ControlVariable, double ) \
+        INIT_FUNCTION( void, namespace, SetAxisSetpointsTag, Axis, uint32_t ) \
+        INIT_FUNCTION( bool, namespace, GetAxisMeasuresStamp, Axis, MeasuresStamp* ) \
+        INIT_FUNCTION( void, namespace, ExchangeData, int ) \
+        INIT_FUNCTION( void, namespace, SetUpdateEvent, WakeEvent ) \
+        INIT_FUNCTION( bool, namespace, SetCycleCallback, int, RobotCycleCallback, void* ) \
+        INIT_FUNCTION( bool, namespace, GetControlStats, int, PeriodicTimerStats* ) \
+        INIT_FUNCTION( bool, namespace, GetStageStats, int, enum RobotControlStage, LatencyStats* ) \
+        INIT_FUNCTION( bool, namespace, GetStageHistogram, int, enum RobotControlStage, LatencyHistogram* ) \
+        INIT_FUNCTION( bool, namespace, GetJointStageStats, Joint, enum RobotControlStage, LatencyStats* ) \
         INIT_FUNCTION( size_t, namespace, GetJointsNumber, int ) \
         INIT_FUNCTION( size_t, namespace, GetAxesNumber, int )
 
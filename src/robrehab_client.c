@@ -0,0 +1,605 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (c) 2016 Leonardo José Consoni                                  //
+//                                                                            //
+//  This file is part of RobRehabSystem.                                      //
+//                                                                            //
+//  RobRehabSystem is free software: you can redistribute it and/or modify    //
+//  it under the terms of the GNU Lesser General Public License as published  //
+//  by the Free Software Foundation, either version 3 of the License, or      //
+//  (at your option) any later version.                                       //
+//                                                                            //
+//  RobRehabSystem is distributed in the hope that it will be useful,         //
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of            //
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              //
+//  GNU Lesser General Public License for more details.                       //
+//                                                                            //
+//  You should have received a copy of the GNU Lesser General Public License  //
+//  along with RobRehabSystem. If not, see <http://www.gnu.org/licenses/>.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robrehab_client.h"
+
+#include "ip_network/async_ip_network.h"
+#include "threads/threading.h"
+#include "time/timing.h"
+
+#include "shm_robot_stats.h"
+#include "axis_packets.h"
+
+#include "klib/kvec.h"
+
+#include "debug/async_debug.h"
+
+
+// Maximum wait between dispatch passes (periodic probes resolution)
+const uint64_t DISPATCH_TIMEOUT_NS = 1000000;
+
+// Setpoints message: blocks number, followed by each block axis index, mask and data
+#define SETPOINTS_BLOCK_LENGTH ( 2 + AXIS_DATA_BLOCK_SIZE )
+#define SETPOINTS_MAX_BLOCKS ( ( IP_MAX_MESSAGE_LENGTH - 1 ) / SETPOINTS_BLOCK_LENGTH )
+
+// Gain of the round trip jitter estimator (RFC 3550)
+const double JITTER_GAIN = 1.0 / 16.0;
+
+typedef struct _SetpointsStamp
+{
+  uint32_t tag;
+  Timestamp sendTime;
+}
+SetpointsStamp;
+
+struct _RobRehabConnectionData
+{
+  unsigned long eventConnectionID;
+  unsigned long axisConnectionID;
+  ThreadLock stateLock;                                          // Everything below is shared with the dispatch thread
+  RobRehabMeasuresCallback measuresCallback;
+  void* callbackData;
+  AxisPacketsCoder packetsDecoder;
+  AxisPacketsSettings packetsSettings;
+  SHMAxisBlock axesMeasuresList[ AXIS_DATA_BLOCKS_NUMBER ];
+  Timestamp measuresTimesList[ AXIS_DATA_BLOCKS_NUMBER ];       // Client reception time of each axis measures (0 for none)
+  uint8_t setpointsMessage[ IP_MAX_MESSAGE_LENGTH ];
+  size_t setpointsLength;
+  uint32_t setpointsCount;
+  SetpointsStamp setpointsStampsList[ ROBREHAB_CLIENT_TAGS_HISTORY_LENGTH ];
+  RobRehabLatencyStats latencyStats;
+  uint64_t probeIntervalNs;
+  Timestamp lastProbeTime;
+  char infoData[ IP_MAX_MESSAGE_LENGTH ];
+  size_t infoLength;
+};
+
+// Connections handled by the dispatch thread. Connect and Disconnect are expected to be called from a single thread.
+// Each dispatch pass runs on a copy of the list, holding the dispatch lock instead of the connections one
+static kvec_t( RobRehabConnection ) connectionsList;
+static ThreadLock connectionsLock = NULL;
+static ThreadLock dispatchLock = NULL;
+static Thread dispatchThread = THREAD_INVALID_HANDLE;
+static volatile bool isDispatching = false;
+// Dispatch thread wakes up on this (process private) event whenever the network read thread queues messages
+static WakeEvent globalReadEvent = NULL;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                   CONNECTION HANDLING                                           /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* AsyncDispatchMessages( void* );
+
+RobRehabConnection RobRehabClient_Connect( const char* host, uint16_t basePort )
+{
+  if( basePort == 0 ) basePort = ROBREHAB_CLIENT_DEFAULT_PORT;
+
+  if( !isDispatching ) Timing.Init();
+
+  unsigned long eventConnectionID = AsyncIPNetwork.OpenConnection( IP_CLIENT | IP_TCP, host, basePort );
+  if( eventConnectionID == (unsigned long) IP_CONNECTION_INVALID_ID ) return NULL;
+
+  unsigned long axisConnectionID = AsyncIPNetwork.OpenConnection( IP_CLIENT | IP_UDP, host, basePort + 1 );
+  if( axisConnectionID == (unsigned long) IP_CONNECTION_INVALID_ID )
+  {
+    AsyncIPNetwork.CloseConnection( eventConnectionID );
+    return NULL;
+  }
+
+  AsyncIPNetwork.SetFraming( eventConnectionID, IP_FRAMING_PREFIXED );
+  AsyncIPNetwork.SetFraming( axisConnectionID, IP_FRAMING_PREFIXED );
+
+  RobRehabConnection newConnection = (RobRehabConnection) malloc( sizeof(RobRehabConnectionData) );
+  memset( newConnection, 0, sizeof(RobRehabConnectionData) );
+
+  newConnection->eventConnectionID = eventConnectionID;
+  newConnection->axisConnectionID = axisConnectionID;
+  newConnection->stateLock = ThreadLocks.Create();
+  newConnection->latencyStats.minRoundTrip = UINT64_MAX;
+
+  if( connectionsLock == NULL )
+  {
+    connectionsLock = ThreadLocks.Create();
+    dispatchLock = ThreadLocks.Create();
+    kv_init( connectionsList );
+  }
+
+  ThreadLocks.Aquire( connectionsLock );
+  kv_push( RobRehabConnection, connectionsList, newConnection );
+  ThreadLocks.Release( connectionsLock );
+
+  if( !isDispatching )
+  {
+    globalReadEvent = WakeEvents.Create( NULL );
+    AsyncIPNetwork.SetReadEvent( globalReadEvent );
+
+    isDispatching = true;
+    dispatchThread = Threading.StartThread( AsyncDispatchMessages, NULL, THREAD_JOINABLE );
+  }
+
+  DEBUG_PRINT( "connected to %s (event: %lu, axis: %lu)", host, eventConnectionID, axisConnectionID );
+
+  return newConnection;
+}
+
+void RobRehabClient_Disconnect( RobRehabConnection connection )
+{
+  if( connection == NULL || connectionsLock == NULL ) return;
+
+  ThreadLocks.Aquire( connectionsLock );
+  size_t connectionsNumber = kv_size( connectionsList );
+  for( size_t connectionIndex = 0; connectionIndex < connectionsNumber; connectionIndex++ )
+  {
+    if( kv_A( connectionsList, connectionIndex ) != connection ) continue;
+    kv_A( connectionsList, connectionIndex ) = kv_A( connectionsList, connectionsNumber - 1 );
+    kv_size( connectionsList ) = --connectionsNumber;
+    break;
+  }
+  ThreadLocks.Release( connectionsLock );
+  
+  // Waits for the end of a dispatch pass that may still be using the connection
+  ThreadLocks.Aquire( dispatchLock );
+  ThreadLocks.Release( dispatchLock );
+
+  if( connectionsNumber == 0 && isDispatching )
+  {
+    isDispatching = false;
+    Threading.WaitExit( dispatchThread, 5000 );
+    dispatchThread = THREAD_INVALID_HANDLE;
+
+    AsyncIPNetwork.SetReadEvent( NULL );
+    WakeEvents.Discard( globalReadEvent );
+    globalReadEvent = NULL;
+  }
+
+  AsyncIPNetwork.CloseConnection( connection->eventConnectionID );
+  AsyncIPNetwork.CloseConnection( connection->axisConnectionID );
+
+  AxisPackets.DiscardCoder( connection->packetsDecoder );
+  ThreadLocks.Discard( connection->stateLock );
+
+  DEBUG_PRINT( "disconnected (event: %lu, axis: %lu)", connection->eventConnectionID, connection->axisConnectionID );
+
+  free( connection );
+}
+
+// Callbacks run on the dispatch thread, and must not disconnect
+void RobRehabClient_SetMeasuresCallback( RobRehabConnection connection, RobRehabMeasuresCallback callback, void* userData )
+{
+  if( connection == NULL ) return;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  connection->measuresCallback = callback;
+  connection->callbackData = userData;
+  ThreadLocks.Release( connection->stateLock );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    SETPOINTS SENDING                                            /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Subscriptions replace the packets decoder, as the server does with its encoder (a new one starts with a keyframe)
+bool RobRehabClient_SubscribeAxes( RobRehabConnection connection, const uint8_t* axesList, size_t axesNumber,
+                                   uint16_t fieldsMask, uint8_t quantization, float fixedResolution, uint8_t keyframeInterval )
+{
+  if( connection == NULL ) return false;
+  if( axesNumber > AXIS_PACKETS_MAX_AXES || ( axesNumber > 0 && axesList == NULL ) ) return false;
+
+  AxisPacketsSettings settings = { .fieldsMask = fieldsMask & AXIS_FIELDS_ALL, .quantization = quantization, .fixedResolution = fixedResolution,
+                                   .keyframeInterval = keyframeInterval, .axesNumber = (uint8_t) axesNumber };
+  for( size_t axisPosition = 0; axisPosition < axesNumber; axisPosition++ )
+  {
+    if( axesList[ axisPosition ] >= AXIS_DATA_BLOCKS_NUMBER ) return false;
+    settings.axesList[ axisPosition ] = axesList[ axisPosition ];
+  }
+
+  uint8_t requestData[ AXIS_PACKETS_MAX_LENGTH ];
+  size_t requestLength = AxisPackets.WriteSettings( &settings, requestData, AXIS_PACKETS_MAX_LENGTH );
+  // Validation is left to the same reader used by the server
+  if( !AxisPackets.ReadSettings( requestData, requestLength, &settings ) ) return false;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  AxisPackets.DiscardCoder( connection->packetsDecoder );
+  connection->packetsDecoder = AxisPackets.CreateCoder( &settings );
+  connection->packetsSettings = settings;
+  ThreadLocks.Release( connection->stateLock );
+
+  IPMessagePart requestPart = { .data = requestData, .length = requestLength };
+  return AsyncIPNetwork.WriteMessageParts( connection->axisConnectionID, &requestPart, 1 );
+}
+
+// Staged blocks replace previous ones of the same axis, so the latest values go on the next sending
+bool RobRehabClient_SetAxisSetpoints( RobRehabConnection connection, unsigned int axisIndex, const float* valuesList, uint8_t mask )
+{
+  if( connection == NULL || valuesList == NULL ) return false;
+  if( axisIndex >= AXIS_DATA_BLOCKS_NUMBER ) return false;
+
+  uint8_t* messageData = connection->setpointsMessage;
+
+  size_t blockOffset = 1;
+  for( uint8_t blockIndex = 0; blockIndex < messageData[ 0 ]; blockIndex++, blockOffset += SETPOINTS_BLOCK_LENGTH )
+  {
+    if( messageData[ blockOffset ] == axisIndex ) break;
+  }
+
+  if( blockOffset >= 1 + messageData[ 0 ] * SETPOINTS_BLOCK_LENGTH )
+  {
+    if( messageData[ 0 ] >= SETPOINTS_MAX_BLOCKS )
+    {
+      if( !RobRehabClient_SendSetpoints( connection ) ) return false;
+      blockOffset = 1;
+    }
+    messageData[ 0 ]++;
+  }
+
+  SHMAxisBlock setpoints = { 0 };
+  memcpy( setpoints.valuesList, valuesList, sizeof(setpoints.valuesList) );
+
+  messageData[ blockOffset ] = (uint8_t) axisIndex;
+  messageData[ blockOffset + 1 ] = mask;
+  memcpy( messageData + blockOffset + 2, &setpoints, AXIS_DATA_BLOCK_SIZE );
+
+  connection->setpointsLength = 1 + messageData[ 0 ] * SETPOINTS_BLOCK_LENGTH;
+
+  return true;
+}
+
+// All staged blocks go in a single message (applied on the same server update), tagged with the sendings count and time
+bool RobRehabClient_SendSetpoints( RobRehabConnection connection )
+{
+  if( connection == NULL ) return false;
+
+  uint8_t* messageData = connection->setpointsMessage;
+  if( messageData[ 0 ] == 0 ) return true;
+
+  // Tag 0 is left for blocks with no tagged setpoints applied
+  uint32_t setpointsTag = ( connection->setpointsCount == UINT32_MAX ) ? 1 : connection->setpointsCount + 1;
+  Timestamp sendTime = Timing.GetExecTimeNanoseconds();
+
+  for( uint8_t blockIndex = 0; blockIndex < messageData[ 0 ]; blockIndex++ )
+  {
+    uint8_t* blockData = messageData + 1 + blockIndex * SETPOINTS_BLOCK_LENGTH + 2;
+    memcpy( blockData + offsetof( SHMAxisBlock, setpointsTag ), &setpointsTag, sizeof(uint32_t) );
+    memcpy( blockData + offsetof( SHMAxisBlock, timestamp ), &sendTime, sizeof(uint64_t) );
+  }
+
+  ThreadLocks.Aquire( connection->stateLock );
+  connection->setpointsCount = setpointsTag;
+  connection->setpointsStampsList[ setpointsTag % ROBREHAB_CLIENT_TAGS_HISTORY_LENGTH ] = (SetpointsStamp) { .tag = setpointsTag, .sendTime = sendTime };
+  ThreadLocks.Release( connection->stateLock );
+
+  IPMessagePart messagePart = { .data = messageData, .length = connection->setpointsLength };
+  bool isSent = AsyncIPNetwork.WriteMessageParts( connection->axisConnectionID, &messagePart, 1 );
+
+  messageData[ 0 ] = 0;
+  connection->setpointsLength = 0;
+
+  return isSent;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    MEASURES READING                                             /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool RobRehabClient_GetAxisMeasures( RobRehabConnection connection, unsigned int axisIndex, SHMAxisBlock* ref_measures )
+{
+  if( connection == NULL || ref_measures == NULL ) return false;
+  if( axisIndex >= AXIS_DATA_BLOCKS_NUMBER ) return false;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  bool hasMeasures = ( connection->measuresTimesList[ axisIndex ] != 0 );
+  if( hasMeasures ) *ref_measures = connection->axesMeasuresList[ axisIndex ];
+  ThreadLocks.Release( connection->stateLock );
+
+  return hasMeasures;
+}
+
+// Server stamps are converted to the client clock with the offset of the fastest probe (none before the first reply)
+bool RobRehabClient_GetAxisLatencies( RobRehabConnection connection, unsigned int axisIndex, RobRehabAxisLatencies* ref_latencies )
+{
+  if( connection == NULL || ref_latencies == NULL ) return false;
+  if( axisIndex >= AXIS_DATA_BLOCKS_NUMBER ) return false;
+
+  Timestamp currentTime = Timing.GetExecTimeNanoseconds();
+
+  ThreadLocks.Aquire( connection->stateLock );
+  bool hasMeasures = ( connection->measuresTimesList[ axisIndex ] != 0 );
+  if( hasMeasures )
+  {
+    const SHMAxisBlock* measures = &(connection->axesMeasuresList[ axisIndex ]);
+    int64_t clockOffset = connection->latencyStats.clockOffset;
+
+    int64_t measuresAge = (int64_t) ( currentTime - ( measures->timestamp - clockOffset ) );
+    ref_latencies->measuresAge = ( measuresAge > 0 ) ? (uint64_t) measuresAge : 0;
+
+    ref_latencies->setpointsLatency = 0;
+    const SetpointsStamp* stamp = &(connection->setpointsStampsList[ measures->setpointsTag % ROBREHAB_CLIENT_TAGS_HISTORY_LENGTH ]);
+    if( measures->setpointsTag != 0 && stamp->tag == measures->setpointsTag && measures->actuationTime > 0 )
+    {
+      int64_t setpointsLatency = (int64_t) ( ( measures->actuationTime - clockOffset ) - stamp->sendTime );
+      if( setpointsLatency > 0 ) ref_latencies->setpointsLatency = (uint64_t) setpointsLatency;
+    }
+  }
+  ThreadLocks.Release( connection->stateLock );
+
+  return hasMeasures;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    LATENCY PROBES                                               /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool RobRehabClient_ProbeLatency( RobRehabConnection connection )
+{
+  if( connection == NULL ) return false;
+
+  uint8_t probeData[ 1 + sizeof(uint64_t) ] = { SHM_AXIS_PROBE_REQUEST };
+
+  Timestamp sendTime = Timing.GetExecTimeNanoseconds();
+  memcpy( probeData + 1, &sendTime, sizeof(uint64_t) );
+
+  ThreadLocks.Aquire( connection->stateLock );
+  connection->latencyStats.probesCount++;
+  connection->lastProbeTime = sendTime;
+  ThreadLocks.Release( connection->stateLock );
+
+  IPMessagePart probePart = { .data = probeData, .length = sizeof(probeData) };
+  return AsyncIPNetwork.WriteMessageParts( connection->axisConnectionID, &probePart, 1 );
+}
+
+void RobRehabClient_SetProbeInterval( RobRehabConnection connection, unsigned int intervalMs )
+{
+  if( connection == NULL ) return;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  connection->probeIntervalNs = (uint64_t) intervalMs * 1000000;
+  ThreadLocks.Release( connection->stateLock );
+}
+
+void RobRehabClient_GetLatencyStats( RobRehabConnection connection, RobRehabLatencyStats* ref_stats )
+{
+  if( connection == NULL || ref_stats == NULL ) return;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  *ref_stats = connection->latencyStats;
+  if( ref_stats->repliesCount == 0 ) ref_stats->minRoundTrip = 0;
+  ThreadLocks.Release( connection->stateLock );
+}
+
+// Probe reply: code, client time, server receive time and server send time. Round trip excludes the server 
+// processing time. Called with the connection state locked
+static void UpdateLatencyStats( RobRehabConnection connection, const char* replyData, Timestamp receiveTime )
+{
+  uint64_t clientTime, serverReadTime, serverSendTime;
+  memcpy( &clientTime, replyData + 1, sizeof(uint64_t) );
+  memcpy( &serverReadTime, replyData + 1 + sizeof(uint64_t), sizeof(uint64_t) );
+  memcpy( &serverSendTime, replyData + 1 + 2 * sizeof(uint64_t), sizeof(uint64_t) );
+
+  if( clientTime > receiveTime || serverReadTime > serverSendTime ) return;
+  if( receiveTime - clientTime < serverSendTime - serverReadTime ) return;
+  uint64_t roundTrip = ( receiveTime - clientTime ) - ( serverSendTime - serverReadTime );
+
+  RobRehabLatencyStats* stats = &(connection->latencyStats);
+
+  if( stats->repliesCount > 0 )
+  {
+    double roundTripDeviation = (double) roundTrip - (double) stats->lastRoundTrip;
+    if( roundTripDeviation < 0.0 ) roundTripDeviation = -roundTripDeviation;
+    stats->roundTripJitter += ( roundTripDeviation - stats->roundTripJitter ) * JITTER_GAIN;
+  }
+
+  stats->repliesCount++;
+  stats->lastRoundTrip = roundTrip;
+  stats->meanRoundTrip += ( (double) roundTrip - stats->meanRoundTrip ) / stats->repliesCount;
+  if( roundTrip > stats->maxRoundTrip ) stats->maxRoundTrip = roundTrip;
+  // Fastest probes have the most symmetric paths, for the best clock offset estimation
+  if( roundTrip <= stats->minRoundTrip )
+  {
+    stats->minRoundTrip = roundTrip;
+    stats->clockOffset = ( (int64_t) ( serverReadTime - clientTime ) + (int64_t) ( serverSendTime - receiveTime ) ) / 2;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    ROBOTS INFO                                                  /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Reply (robots info string) is available through GetInfo when received
+bool RobRehabClient_RequestInfo( RobRehabConnection connection )
+{
+  if( connection == NULL ) return false;
+
+  const uint8_t REQUEST_CODE = 0x00;
+
+  IPMessagePart requestPart = { .data = &REQUEST_CODE, .length = 1 };
+  return AsyncIPNetwork.WriteMessageParts( connection->eventConnectionID, &requestPart, 1 );
+}
+
+// Copies the last received robots info string (null terminated) and returns its length (0 if none received)
+size_t RobRehabClient_GetInfo( RobRehabConnection connection, char* buffer, size_t bufferLength )
+{
+  if( connection == NULL || buffer == NULL || bufferLength == 0 ) return 0;
+
+  ThreadLocks.Aquire( connection->stateLock );
+  size_t infoLength = ( connection->infoLength < bufferLength ) ? connection->infoLength : bufferLength - 1;
+  memcpy( buffer, connection->infoData, infoLength );
+  buffer[ infoLength ] = '\0';
+  ThreadLocks.Release( connection->stateLock );
+
+  return infoLength;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    ASYNC DISPATCHING                                            /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Full blocks messages (controlled axes): blocks number, followed by each block axis index and data. Reordered
+// updates (older control passes) are discarded. Returns the updated axes mask. Called with the connection state locked
+static uint64_t ReadBlocksMessage( RobRehabConnection connection, const char* messageData, Timestamp receiveTime )
+{
+  uint64_t updatedAxesMask = 0;
+
+  uint8_t blocksNumber = (uint8_t) messageData[ 0 ];
+  size_t blockOffset = 1;
+  for( uint8_t blockIndex = 0; blockIndex < blocksNumber; blockIndex++, blockOffset += 1 + AXIS_DATA_BLOCK_SIZE )
+  {
+    if( blockOffset + 1 + AXIS_DATA_BLOCK_SIZE > IP_MAX_MESSAGE_LENGTH ) break;
+
+    uint8_t axisIndex = (uint8_t) messageData[ blockOffset ];
+    if( axisIndex >= AXIS_DATA_BLOCKS_NUMBER ) continue;
+
+    SHMAxisBlock measures;
+    memcpy( &measures, messageData + blockOffset + 1, AXIS_DATA_BLOCK_SIZE );
+
+    SHMAxisBlock* lastMeasures = &(connection->axesMeasuresList[ axisIndex ]);
+    if( connection->measuresTimesList[ axisIndex ] != 0 && measures.sequenceNumber < lastMeasures->sequenceNumber ) continue;
+
+    *lastMeasures = measures;
+    connection->measuresTimesList[ axisIndex ] = receiveTime;
+    updatedAxesMask |= ( (uint64_t) 1 << axisIndex );
+  }
+
+  return updatedAxesMask;
+}
+
+// Decoded packets are acknowledged right away, so that the next ones may be delta encoded against them. Returns
+// the updated (subscribed) axes mask. Called with the connection state locked
+static uint64_t ReadPacketMessage( RobRehabConnection connection, const char* messageData, Timestamp receiveTime )
+{
+  if( connection->packetsDecoder == NULL ) return 0;
+
+  uint32_t frameNumber = AxisPackets.Decode( connection->packetsDecoder, (const uint8_t*) messageData, AXIS_PACKETS_MAX_LENGTH,
+                                             connection->axesMeasuresList, AXIS_DATA_BLOCKS_NUMBER );
+  if( frameNumber == 0 ) return 0;
+
+  // Little endian frame number, as in packets
+  uint8_t acknowledgeData[ 1 + sizeof(uint32_t) ] = { AXIS_PACKETS_ACKNOWLEDGE_REQUEST, (uint8_t) frameNumber, (uint8_t) ( frameNumber >> 8 ),
+                                                      (uint8_t) ( frameNumber >> 16 ), (uint8_t) ( frameNumber >> 24 ) };
+  IPMessagePart acknowledgePart = { .data = acknowledgeData, .length = sizeof(acknowledgeData) };
+  AsyncIPNetwork.WriteMessageParts( connection->axisConnectionID, &acknowledgePart, 1 );
+
+  // Keyframes hold all subscribed axes, and delta frames keep the values of their base frames
+  uint64_t updatedAxesMask = 0;
+  for( size_t axisPosition = 0; axisPosition < connection->packetsSettings.axesNumber; axisPosition++ )
+  {
+    uint8_t axisIndex = connection->packetsSettings.axesList[ axisPosition ];
+    connection->measuresTimesList[ axisIndex ] = receiveTime;
+    updatedAxesMask |= ( (uint64_t) 1 << axisIndex );
+  }
+
+  return updatedAxesMask;
+}
+
+static void DispatchConnectionMessages( RobRehabConnection connection )
+{
+  SHMAxisBlock updatedMeasuresList[ AXIS_DATA_BLOCKS_NUMBER ];
+  uint64_t updatedAxesMask = 0;
+
+  char* messageData = NULL;
+  while( (messageData = AsyncIPNetwork.ReadMessage( connection->axisConnectionID )) != NULL )
+  {
+    Timestamp receiveTime = Timing.GetExecTimeNanoseconds();
+
+    ThreadLocks.Aquire( connection->stateLock );
+    if( (uint8_t) messageData[ 0 ] == SHM_AXIS_PROBE_REQUEST ) UpdateLatencyStats( connection, messageData, receiveTime );
+    else if( (uint8_t) messageData[ 0 ] == AXIS_PACKETS_SUBSCRIBE_REQUEST ) updatedAxesMask |= ReadPacketMessage( connection, messageData, receiveTime );
+    else updatedAxesMask |= ReadBlocksMessage( connection, messageData, receiveTime );
+    ThreadLocks.Release( connection->stateLock );
+  }
+
+  while( (messageData = AsyncIPNetwork.ReadMessage( connection->eventConnectionID )) != NULL )
+  {
+    // Robots stats replies are not requested by this client
+    if( (uint8_t) messageData[ 0 ] == SHM_ROBOT_STATS_REQUEST ) continue;
+
+    ThreadLocks.Aquire( connection->stateLock );
+    connection->infoLength = strnlen( messageData, IP_MAX_MESSAGE_LENGTH - 1 );
+    memcpy( connection->infoData, messageData, connection->infoLength );
+    connection->infoData[ connection->infoLength ] = '\0';
+    ThreadLocks.Release( connection->stateLock );
+  }
+
+  ThreadLocks.Aquire( connection->stateLock );
+  RobRehabMeasuresCallback measuresCallback = connection->measuresCallback;
+  void* callbackData = connection->callbackData;
+  if( measuresCallback != NULL )
+  {
+    for( size_t axisIndex = 0; axisIndex < AXIS_DATA_BLOCKS_NUMBER; axisIndex++ )
+    {
+      if( updatedAxesMask & ( (uint64_t) 1 << axisIndex ) ) updatedMeasuresList[ axisIndex ] = connection->axesMeasuresList[ axisIndex ];
+    }
+  }
+  bool isProbeDue = ( connection->probeIntervalNs > 0 && Timing.GetExecTimeNanoseconds() - connection->lastProbeTime >= connection->probeIntervalNs );
+  ThreadLocks.Release( connection->stateLock );
+
+  // Callbacks get copies, with the state unlocked (so that they may call any other function but Disconnect)
+  if( measuresCallback != NULL )
+  {
+    for( size_t axisIndex = 0; axisIndex < AXIS_DATA_BLOCKS_NUMBER; axisIndex++ )
+    {
+      if( updatedAxesMask & ( (uint64_t) 1 << axisIndex ) ) measuresCallback( (unsigned int) axisIndex, &(updatedMeasuresList[ axisIndex ]), callbackData );
+    }
+  }
+
+  if( isProbeDue ) RobRehabClient_ProbeLatency( connection );
+}
+
+static void* AsyncDispatchMessages( void* args )
+{
+  kvec_t( RobRehabConnection ) dispatchList;
+  kv_init( dispatchList );
+
+  DEBUG_PRINT( "starting to dispatch messages on thread %lx", THREAD_ID );
+
+  while( isDispatching )
+  {
+    (void) WakeEvents.Wait( globalReadEvent, DISPATCH_TIMEOUT_NS );
+
+    // Callbacks run out of the connections lock, so that they may connect
+    ThreadLocks.Aquire( dispatchLock );
+    ThreadLocks.Aquire( connectionsLock );
+    kv_size( dispatchList ) = 0;
+    for( size_t connectionIndex = 0; connectionIndex < kv_size( connectionsList ); connectionIndex++ )
+      kv_push( RobRehabConnection, dispatchList, kv_A( connectionsList, connectionIndex ) );
+    ThreadLocks.Release( connectionsLock );
+    
+    for( size_t connectionIndex = 0; connectionIndex < kv_size( dispatchList ); connectionIndex++ )
+      DispatchConnectionMessages( kv_A( dispatchList, connectionIndex ) );
+    ThreadLocks.Release( dispatchLock );
+  }
+
+  DEBUG_PRINT( "ending messages dispatch on thread %lx", THREAD_ID );
+  
+  kv_destroy( dispatchList );
+
+  return NULL;
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+/////  Client library for RobRehab servers: queued axis setpoints and      /////
+/////  subscriptions, measures callbacks and latency statistics (C ABI)    /////
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROBREHAB_CLIENT_H
+#define ROBREHAB_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modules.h"
+
+#include "shm_axis_control.h"
+
+// Server ports are consecutive: event (TCP), axis (UDP) and joint (UDP) channels
+#define ROBREHAB_CLIENT_DEFAULT_PORT 50000
+
+// Setpoints sending times kept for matching the tags of measures blocks (actuation latency)
+#define ROBREHAB_CLIENT_TAGS_HISTORY_LENGTH 256
+
+// Connection to a server (event and axis channels). Connect blocks until the event channel is connected (up to 5 s),
+// and Disconnect until the dispatch thread is done with the connection. Other calls don't block: messages are queued
+// for the network threads, and replies are handled on a dispatch thread shared by all connections of the process
+typedef struct _RobRehabConnectionData RobRehabConnectionData;
+typedef RobRehabConnectionData* RobRehabConnection;
+
+// Called from the dispatch thread for each axis updated by a received message (full blocks or subscribed packets).
+// Callbacks may call any other function but Disconnect
+typedef void (*RobRehabMeasuresCallback)( unsigned int axisIndex, const SHMAxisBlock* measures, void* userData );
+
+// Probe replies statistics (nanoseconds). Round trips exclude the server processing time. Jitter is the smoothed mean
+// deviation between consecutive round trips (RFC 3550 estimator). Clock offset (server minus client time) comes from the
+// fastest probe so far, and is applied to measures stamps
+typedef struct _RobRehabLatencyStats
+{
+  uint64_t probesCount;
+  uint64_t repliesCount;
+  uint64_t lastRoundTrip;
+  uint64_t minRoundTrip;
+  uint64_t maxRoundTrip;
+  double meanRoundTrip;
+  double roundTripJitter;
+  int64_t clockOffset;
+}
+RobRehabLatencyStats;
+
+// Latest measures of an axis: age of its capture and setpoints sending to actuation time (client clock, 0 if unknown)
+typedef struct _RobRehabAxisLatencies
+{
+  uint64_t measuresAge;
+  uint64_t setpointsLatency;
+}
+RobRehabAxisLatencies;
+
+// Exported functions are named RobRehabClient_<Function> (e.g. RobRehabClient_Connect), for loading with ctypes.
+// SetAxisSetpoints stages a block (values and mask following SHM_AXIS_* indexes) to be sent along with the other
+// staged axes on the next SendSetpoints call (automatically sent when a message is full). SubscribeAxes follows the
+// axis packets settings (axis_packets.h), and no axes go back to full blocks of the controlled axes. Probe interval 0
+// disables periodic probes (single probes may still be sent with ProbeLatency)
+#define ROBREHAB_CLIENT_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( RobRehabConnection, Namespace, Connect, const char*, uint16_t ) \
+        INIT_FUNCTION( void, Namespace, Disconnect, RobRehabConnection ) \
+        INIT_FUNCTION( void, Namespace, SetMeasuresCallback, RobRehabConnection, RobRehabMeasuresCallback, void* ) \
+        INIT_FUNCTION( bool, Namespace, SubscribeAxes, RobRehabConnection, const uint8_t*, size_t, uint16_t, uint8_t, float, uint8_t ) \
+        INIT_FUNCTION( bool, Namespace, SetAxisSetpoints, RobRehabConnection, unsigned int, const float*, uint8_t ) \
+        INIT_FUNCTION( bool, Namespace, SendSetpoints, RobRehabConnection ) \
+        INIT_FUNCTION( bool, Namespace, GetAxisMeasures, RobRehabConnection, unsigned int, SHMAxisBlock* ) \
+        INIT_FUNCTION( bool, Namespace, GetAxisLatencies, RobRehabConnection, unsigned int, RobRehabAxisLatencies* ) \
+        INIT_FUNCTION( bool, Namespace, ProbeLatency, RobRehabConnection ) \
+        INIT_FUNCTION( void, Namespace, SetProbeInterval, RobRehabConnection, unsigned int ) \
+        INIT_FUNCTION( void, Namespace, GetLatencyStats, RobRehabConnection, RobRehabLatencyStats* ) \
+        INIT_FUNCTION( bool, Namespace, RequestInfo, RobRehabConnection ) \
+        INIT_FUNCTION( size_t, Namespace, GetInfo, RobRehabConnection, char*, size_t )
+
+#define DECLARE_CLIENT_FUNCTION( rtype, Namespace, func, ... ) C_FUNCTION __declspec(dllexport) rtype Namespace##_##func( __VA_ARGS__ );
+
+ROBREHAB_CLIENT_INTERFACE( RobRehabClient, DECLARE_CLIENT_FUNCTION )
+
+
+#endif // ROBREHAB_CLIENT_H
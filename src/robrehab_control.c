@@ -25,8 +25,11 @@
 #include "shm_robot_control.h"
 #include "shm_axis_control.h"
 #include "shm_joint_control.h"
+#include "shm_robot_stats.h"
+#include "shm_robot_samples.h"
 #include "control_definitions.h"
 #include "robots.h"
+#include "control_executor.h"
 
 #include "klib/kvec.h"
 #include "klib/khash.h"
@@ -39,7 +42,13 @@
 #include "robrehab_subsystem.h"
 
 
-const unsigned long UPDATE_INTERVAL_MS = (unsigned long) ( CONTROL_PASS_INTERVAL * 1000 );
+// Shared memory exchange interval. Robots run their control passes at their own configured rates
+const unsigned long UPDATE_INTERVAL_MS = 5;
+
+const char* UPDATE_EVENT_NAME = CONTROL_UPDATE_EVENT_NAME;
+
+// Control times summaries are recomputed and published about once per second
+#define STATS_UPDATE_INTERVAL_MS 1000
 
 
 kvec_t( int ) robotIDsList;
@@ -47,14 +56,30 @@ kvec_t( int ) robotIDsList;
 SHMController sharedRobotsInfo;
 SHMController sharedRobotAxesData;
 SHMController sharedRobotJointsData;
+SHMController sharedRobotStatsData;
+
+WakeEvent updateEvent;
+WakeEvent networkUpdateEvent;
 
 kvec_t( Axis ) axesList;
 kvec_t( Joint ) jointsList;
 
+// Every control pass axes values of a shared robot, written to its samples ring by the pass itself
+typedef struct _RobotSamplesStream
+{
+  SHMRing ring;
+  size_t firstAxisIndex;
+  uint64_t cyclesCount;
+}
+RobotSamplesStream;
+
+kvec_t( RobotSamplesStream* ) samplesStreamsList;
+
 
 DEFINE_NAMESPACE_INTERFACE( SubSystem, ROBREHAB_SUBSYSTEM_INTERFACE )
 
 void LoadSharedRobotsInfo( void );
+void LoadControlExecutor( void );
 
 
 int SubSystem_Init( const char* configType, const char* configDirectory,  const char* logDirectory )
@@ -64,9 +89,17 @@ int SubSystem_Init( const char* configType, const char* configDirectory,  const
   kv_init( axesList );
   kv_init( jointsList );
   
-  sharedRobotsInfo = SHMControl.InitData( "robots_info", SHM_CONTROL_IN );
-  sharedRobotAxesData = SHMControl.InitData( "robot_axes_data", SHM_CONTROL_IN );
-  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_IN );
+  kv_init( samplesStreamsList );
+  
+  sharedRobotsInfo = SHMControl.InitData( "robots_info", SHM_CONTROL_IN, ROBOT_INFO_BLOCKS_NUMBER, ROBOT_INFO_BLOCK_SIZE, 8 );
+  sharedRobotAxesData = SHMControl.InitData( "robot_axes_data", SHM_CONTROL_IN, AXIS_DATA_BLOCKS_NUMBER, AXIS_DATA_BLOCK_SIZE, SHM_AXIS_FLOATS_NUMBER );
+  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_IN, JOINT_DATA_BLOCKS_NUMBER, JOINT_DATA_BLOCK_SIZE, SHM_JOINT_FLOATS_NUMBER );
+  sharedRobotStatsData = SHMControl.InitData( "robot_stats_data", SHM_CONTROL_IN, ROBOT_STATS_BLOCKS_NUMBER, ROBOT_STATS_BLOCK_SIZE, 8 );
+  
+  // New robot measures wake up this process loop. New shared memory data wakes up the network one
+  updateEvent = WakeEvents.Create( UPDATE_EVENT_NAME );
+  networkUpdateEvent = WakeEvents.Create( NETWORK_UPDATE_EVENT_NAME );
+  Robots.SetUpdateEvent( updateEvent );
   
   DEBUG_PRINT( "looking for %s configuration", configType );
   if( ! Configuration.Init( configType ) )
@@ -79,6 +112,7 @@ int SubSystem_Init( const char* configType, const char* configDirectory,  const
   DataLogging.SetBaseDirectory( logDirectory );
   
   DEBUG_PRINT( "loading configuration from %s", configDirectory );
+  LoadControlExecutor();
   LoadSharedRobotsInfo();
 
   return 0;
@@ -91,10 +125,25 @@ void SubSystem_End()
   SHMControl.EndData( sharedRobotsInfo );
   SHMControl.EndData( sharedRobotAxesData );
   SHMControl.EndData( sharedRobotJointsData );
+  SHMControl.EndData( sharedRobotStatsData );
   
   for( size_t robotIndex = 0; robotIndex < kv_size( robotIDsList ); robotIndex++ )
     Robots.End( kv_A( robotIDsList, robotIndex ) );
   
+  ControlExecutor.End();
+  
+  // Only after control passes are over
+  for( size_t streamIndex = 0; streamIndex < kv_size( samplesStreamsList ); streamIndex++ )
+  {
+    SHMRings.EndRing( kv_A( samplesStreamsList, streamIndex )->ring );
+    free( kv_A( samplesStreamsList, streamIndex ) );
+  }
+  kv_destroy( samplesStreamsList );
+  
+  Robots.SetUpdateEvent( NULL );
+  WakeEvents.Discard( updateEvent );
+  WakeEvents.Discard( networkUpdateEvent );
+  
   if( kv_size( axesList ) > 0 ) kv_destroy( axesList );
   if( kv_size( jointsList ) > 0 ) kv_destroy( jointsList );
   
@@ -105,9 +154,14 @@ void SubSystem_End()
 
 void UpdateEvents()
 {
-  if( SHMControl.GetControlByte( sharedRobotsInfo, SHM_CONTROL_MASK_SIZE - 1, SHM_CONTROL_REMOVE ) ) LoadSharedRobotsInfo();
+  SHMControlLayout infoLayout = { 0 };
+  if( ! SHMControl.GetLayout( sharedRobotsInfo, &infoLayout ) ) return;
   
-  for( size_t robotIndex = 0; robotIndex < kv_size( robotIDsList ); robotIndex++ )
+  // Last control bytes are reserved (robots list requests and counts)
+  if( SHMControl.GetControlByte( sharedRobotsInfo, infoLayout.maskSize - SHM_ROBOT_INFO_LIST_REQUEST, SHM_CONTROL_REMOVE ) ) LoadSharedRobotsInfo();
+  
+  size_t robotBytesNumber = infoLayout.maskSize - SHM_ROBOT_INFO_RESERVED_NUMBER;
+  for( size_t robotIndex = 0; robotIndex < kv_size( robotIDsList ) && robotIndex < robotBytesNumber; robotIndex++ )
   {
     uint8_t robotCommand = SHMControl.GetControlByte( sharedRobotsInfo, robotIndex, SHM_CONTROL_REMOVE );
     if( robotCommand != 0x00 )
@@ -125,8 +179,8 @@ void UpdateEvents()
       else if( robotCommand == SHM_ROBOT_OPERATE ) robotState = Robots.SetControlState( robotID, CONTROL_OPERATION ) ? SHM_ROBOT_OPERATING : 0x00;
       else if( robotCommand == SHM_ROBOT_SET_USER )
       {
-        char userName[ SHM_CONTROL_MAX_DATA_SIZE ];
-        SHMControl.GetData( sharedRobotsInfo, (void*) userName, 0, SHM_CONTROL_MAX_DATA_SIZE );
+        char userName[ ROBOT_INFO_BLOCK_SIZE ] = "";
+        SHMControl.GetData( sharedRobotsInfo, (void*) userName, 0, ROBOT_INFO_BLOCK_SIZE - 1 );
         DataLogging.SetBaseDirectory( userName );
         DEBUG_PRINT( "New user name: %s", userName );
       }
@@ -136,84 +190,186 @@ void UpdateEvents()
   }
 }
 
+// Each block mask is taken before its data: data read afterwards is at least as recent as the mask
 void UpdateAxes()
 {
-  static uint8_t measureData[ SHM_CONTROL_MAX_DATA_SIZE ], setpointData[ SHM_CONTROL_MAX_DATA_SIZE ];
   static uint8_t updateCount;
   
-  SHMControl.GetData( sharedRobotAxesData, (void*) setpointData, 0, SHM_CONTROL_MAX_DATA_SIZE );
-  for( size_t axisIndex = 0; axisIndex < kv_size(axesList); axisIndex++ )
+  SHMAxisBlock setpointsBlock;
+  SHMAxisBlock measuresBlock = { .valuesList = { 0 } };
+  
+  SHMControlLayout axesLayout = { 0 };
+  SHMControl.GetLayout( sharedRobotAxesData, &axesLayout );
+  for( size_t axisIndex = 0; axisIndex < kv_size( axesList ) && axisIndex < axesLayout.blocksNumber; axisIndex++ )
   {
     Axis axis = kv_A( axesList, axisIndex );
     
     uint8_t axisMask = SHMControl.GetControlByte( sharedRobotAxesData, axisIndex, SHM_CONTROL_REMOVE );
-    //DEBUG_PRINT( "axis %lu setpoint mask: %u%u%u%u%u%u", axisIndex, SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_POSITION ), SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_VELOCITY ),
-    //                                                                SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_ACCELERATION ), SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_FORCE ),
-    //                                                                SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_STIFFNESS ), SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_DAMPING ) );
     
     DEBUG_UPDATE( "updating axis controller %lu", axisIndex );
-
-    float* controlSetpointsList = (float*) (setpointData + axisIndex * AXIS_DATA_BLOCK_SIZE);
-    //DEBUG_PRINT( "stiffness: %g - setpoint: %g", controlSetpointsList[ SHM_AXIS_STIFFNESS ], controlSetpointsList[ SHM_AXIS_POSITION ] );
-
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_POSITION ) ) Robots.SetAxisSetpoint( axis, CONTROL_POSITION, controlSetpointsList[ SHM_AXIS_POSITION ] );
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_VELOCITY ) ) Robots.SetAxisSetpoint( axis, CONTROL_VELOCITY, controlSetpointsList[ SHM_AXIS_VELOCITY ] );
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_ACCELERATION ) ) Robots.SetAxisSetpoint( axis, CONTROL_ACCELERATION, controlSetpointsList[ SHM_AXIS_ACCELERATION ] );
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_FORCE ) ) Robots.SetAxisSetpoint( axis, CONTROL_FORCE, controlSetpointsList[ SHM_AXIS_FORCE ] );
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_STIFFNESS ) ) Robots.SetAxisSetpoint( axis, CONTROL_STIFFNESS, controlSetpointsList[ SHM_AXIS_STIFFNESS ] );
-    if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_DAMPING ) ) Robots.SetAxisSetpoint( axis, CONTROL_DAMPING, controlSetpointsList[ SHM_AXIS_DAMPING ] );
     
-    float* controlMeasuresList = (float*) (measureData + axisIndex * AXIS_DATA_BLOCK_SIZE);
-      
-    //if( fabs( controlMeasuresList[ SHM_AXIS_POSITION ] - (float) axisMeasures->position ) > 0.05 )
-    //{
-      controlMeasuresList[ SHM_AXIS_POSITION ] = (float) Robots.GetAxisMeasure( axis, CONTROL_POSITION );
-      controlMeasuresList[ SHM_AXIS_VELOCITY ] = (float) Robots.GetAxisMeasure( axis, CONTROL_VELOCITY );
-      controlMeasuresList[ SHM_AXIS_ACCELERATION ] = (float) Robots.GetAxisMeasure( axis, CONTROL_ACCELERATION );
-      controlMeasuresList[ SHM_AXIS_FORCE ] = (float) Robots.GetAxisMeasure( axis, CONTROL_FORCE );
-      controlMeasuresList[ SHM_AXIS_STIFFNESS ] = (float) Robots.GetAxisMeasure( axis, CONTROL_STIFFNESS );
-      controlMeasuresList[ SHM_AXIS_DAMPING ] = (float) Robots.GetAxisMeasure( axis, CONTROL_DAMPING );
-      
-      DEBUG_PRINT( "measures: p: %.3f - v: %.3f - f: %.3f", controlMeasuresList[ SHM_AXIS_POSITION ], controlMeasuresList[ SHM_AXIS_VELOCITY ], controlMeasuresList[ SHM_AXIS_FORCE ] );
+    if( axisMask != 0x00 )
+    {
+      SHMControl.GetData( sharedRobotAxesData, (void*) &setpointsBlock, axisIndex * AXIS_DATA_BLOCK_SIZE, AXIS_DATA_BLOCK_SIZE );
       
-      SHMControl.SetControlByte( sharedRobotAxesData, axisIndex, ++updateCount );
-    //}
+      float* controlSetpointsList = setpointsBlock.valuesList;
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_POSITION ) ) Robots.SetAxisSetpoint( axis, CONTROL_POSITION, controlSetpointsList[ SHM_AXIS_POSITION ] );
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_VELOCITY ) ) Robots.SetAxisSetpoint( axis, CONTROL_VELOCITY, controlSetpointsList[ SHM_AXIS_VELOCITY ] );
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_ACCELERATION ) ) Robots.SetAxisSetpoint( axis, CONTROL_ACCELERATION, controlSetpointsList[ SHM_AXIS_ACCELERATION ] );
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_FORCE ) ) Robots.SetAxisSetpoint( axis, CONTROL_FORCE, controlSetpointsList[ SHM_AXIS_FORCE ] );
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_STIFFNESS ) ) Robots.SetAxisSetpoint( axis, CONTROL_STIFFNESS, controlSetpointsList[ SHM_AXIS_STIFFNESS ] );
+      if( SHM_CONTROL_IS_BIT_SET( axisMask, SHM_AXIS_DAMPING ) ) Robots.SetAxisSetpoint( axis, CONTROL_DAMPING, controlSetpointsList[ SHM_AXIS_DAMPING ] );
+      Robots.SetAxisSetpointsTag( axis, setpointsBlock.setpointsTag );
+    }
+    
+    float* controlMeasuresList = measuresBlock.valuesList;
+    controlMeasuresList[ SHM_AXIS_POSITION ] = (float) Robots.GetAxisMeasure( axis, CONTROL_POSITION );
+    controlMeasuresList[ SHM_AXIS_VELOCITY ] = (float) Robots.GetAxisMeasure( axis, CONTROL_VELOCITY );
+    controlMeasuresList[ SHM_AXIS_ACCELERATION ] = (float) Robots.GetAxisMeasure( axis, CONTROL_ACCELERATION );
+    controlMeasuresList[ SHM_AXIS_FORCE ] = (float) Robots.GetAxisMeasure( axis, CONTROL_FORCE );
+    controlMeasuresList[ SHM_AXIS_STIFFNESS ] = (float) Robots.GetAxisMeasure( axis, CONTROL_STIFFNESS );
+    controlMeasuresList[ SHM_AXIS_DAMPING ] = (float) Robots.GetAxisMeasure( axis, CONTROL_DAMPING );
+    
+    MeasuresStamp measuresStamp = { 0 };
+    (void) Robots.GetAxisMeasuresStamp( axis, &measuresStamp );
+    controlMeasuresList[ SHM_AXIS_TIME ] = (float) TIMESTAMP_TO_SECONDS( measuresStamp.captureTime );
+    measuresBlock.setpointsTag = measuresStamp.setpointsTag;
+    measuresBlock.timestamp = measuresStamp.captureTime;
+    measuresBlock.actuationTime = measuresStamp.actuationTime;
+    measuresBlock.sequenceNumber = measuresStamp.sequenceNumber;
+    
+    DEBUG_PRINT( "measures: p: %.3f - v: %.3f - f: %.3f", controlMeasuresList[ SHM_AXIS_POSITION ], controlMeasuresList[ SHM_AXIS_VELOCITY ], controlMeasuresList[ SHM_AXIS_FORCE ] );
+    
+    SHMControl.SetData( sharedRobotAxesData, (void*) &measuresBlock, axisIndex * AXIS_DATA_BLOCK_SIZE, AXIS_DATA_BLOCK_SIZE );
+    SHMControl.SetControlByte( sharedRobotAxesData, axisIndex, ++updateCount );
   }
-  
-  SHMControl.SetData( sharedRobotAxesData, (void*) measureData, 0, SHM_CONTROL_MAX_DATA_SIZE );
 }
 
 void UpdateJoints()
 {
-  static uint8_t measureData[ SHM_CONTROL_MAX_DATA_SIZE ], setpointData[ SHM_CONTROL_MAX_DATA_SIZE ];
   static uint8_t updateCount;
   
-  SHMControl.GetData( sharedRobotJointsData, (void*) setpointData, 0, SHM_CONTROL_MAX_DATA_SIZE );
-  for( size_t jointIndex = 0; jointIndex < kv_size( jointsList ); jointIndex++ )
+  float controlSetpointsList[ SHM_JOINT_FLOATS_NUMBER ];
+  float controlMeasuresList[ SHM_JOINT_FLOATS_NUMBER ] = { 0 };
+  
+  SHMControlLayout jointsLayout = { 0 };
+  SHMControl.GetLayout( sharedRobotJointsData, &jointsLayout );
+  for( size_t jointIndex = 0; jointIndex < kv_size( jointsList ) && jointIndex < jointsLayout.blocksNumber; jointIndex++ )
   {
     Joint joint = kv_A( jointsList, jointIndex );
     
     uint8_t jointMask = SHMControl.GetControlByte( sharedRobotJointsData, jointIndex, SHM_CONTROL_REMOVE );
+    
+    if( jointMask != 0x00 )
+    {
+      SHMControl.GetData( sharedRobotJointsData, (void*) controlSetpointsList, jointIndex * JOINT_DATA_BLOCK_SIZE, JOINT_DATA_BLOCK_SIZE );
+      
+      if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_POSITION ) ) Robots.SetJointSetpoint( joint, CONTROL_POSITION, controlSetpointsList[ SHM_JOINT_POSITION ] );
+      if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_FORCE ) ) Robots.SetJointSetpoint( joint, CONTROL_FORCE, controlSetpointsList[ SHM_JOINT_FORCE ] );
+      if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_STIFFNESS ) ) Robots.SetJointSetpoint( joint, CONTROL_STIFFNESS, controlSetpointsList[ SHM_JOINT_STIFFNESS ] );
+    }
+    
+    controlMeasuresList[ SHM_JOINT_POSITION ] = (float) Robots.GetJointMeasure( joint, CONTROL_POSITION );
+    controlMeasuresList[ SHM_JOINT_FORCE ] = (float) Robots.GetJointMeasure( joint, CONTROL_FORCE );
+    controlMeasuresList[ SHM_JOINT_STIFFNESS ] = (float) Robots.GetJointMeasure( joint, CONTROL_STIFFNESS );
+    
+    SHMControl.SetData( sharedRobotJointsData, (void*) controlMeasuresList, jointIndex * JOINT_DATA_BLOCK_SIZE, JOINT_DATA_BLOCK_SIZE );
+    SHMControl.SetControlByte( sharedRobotJointsData, jointIndex, ++updateCount );
+  }
+}
+
+static inline void CopyAxisSampleValues( float* sampleValuesList, double* valuesList )
+{
+  sampleValuesList[ SHM_AXIS_POSITION ] = (float) valuesList[ CONTROL_POSITION ];
+  sampleValuesList[ SHM_AXIS_VELOCITY ] = (float) valuesList[ CONTROL_VELOCITY ];
+  sampleValuesList[ SHM_AXIS_ACCELERATION ] = (float) valuesList[ CONTROL_ACCELERATION ];
+  sampleValuesList[ SHM_AXIS_FORCE ] = (float) valuesList[ CONTROL_FORCE ];
+  sampleValuesList[ SHM_AXIS_STIFFNESS ] = (float) valuesList[ CONTROL_STIFFNESS ];
+  sampleValuesList[ SHM_AXIS_DAMPING ] = (float) valuesList[ CONTROL_DAMPING ];
+  sampleValuesList[ SHM_AXIS_TIME ] = 0.0f;
+}
 
-    float* controlSetpointsList = (float*) (setpointData + jointIndex * JOINT_DATA_BLOCK_SIZE);
+// Robot cycle callback (runs on the robot control thread/worker)
+static void WriteAxesSamples( void* ref_stream, Timestamp cycleStartTime, double** axisMeasuresTable, double** axisSetpointsTable, size_t axesNumber )
+{
+  RobotSamplesStream* stream = (RobotSamplesStream*) ref_stream;
+  
+  SHMAxisSample sample = { .sequenceNumber = stream->cyclesCount++, .timestamp = cycleStartTime };
+  for( size_t axisIndex = 0; axisIndex < axesNumber; axisIndex++ )
+  {
+    sample.axisIndex = (uint32_t) ( stream->firstAxisIndex + axisIndex );
+    CopyAxisSampleValues( sample.measuresList, axisMeasuresTable[ axisIndex ] );
+    CopyAxisSampleValues( sample.setpointsList, axisSetpointsTable[ axisIndex ] );
+    (void) SHMRings.WriteRecord( stream->ring, &sample );
+  }
+}
+
+static inline uint32_t SaturateStatsValue( uint64_t value )
+{
+  return ( value < UINT32_MAX ) ? (uint32_t) value : UINT32_MAX;
+}
+
+// Shared stats stages are indexed with the robots control ones
+typedef char StatsStagesNumberCheck[ ( SHM_STATS_STAGES_NUMBER == ROBOT_STAGES_NUMBER ) ? 1 : -1 ];
+
+static void SetStatsSummary( uint32_t* statsList, LatencyStats* stats )
+{
+  statsList[ SHM_STATS_MEDIAN ] = SaturateStatsValue( stats->medianValue );
+  statsList[ SHM_STATS_PERCENTILE_99 ] = SaturateStatsValue( stats->percentile99Value );
+  statsList[ SHM_STATS_PERCENTILE_999 ] = SaturateStatsValue( stats->percentile999Value );
+  statsList[ SHM_STATS_MAX ] = SaturateStatsValue( stats->maxValue );
+}
+
+void UpdateStats()
+{
+  const enum RobotControlStage JOINT_STATS_STAGES[ SHM_STATS_JOINT_STAGES_NUMBER ] = { ROBOT_STAGE_SENSE, ROBOT_STAGE_ACTUATE };
+  
+  static unsigned long lastUpdateTime;
+  static uint8_t updateCount;
+  
+  unsigned long updateTime = Timing.GetExecTimeMilliseconds();
+  if( updateTime - lastUpdateTime < STATS_UPDATE_INTERVAL_MS ) return;
+  lastUpdateTime = updateTime;
+  
+  LatencyStats stageStats;
+  LatencyHistogram stageHistogram;
+  static uint32_t robotStatsList[ ROBOT_STATS_BLOCK_SIZE / sizeof(uint32_t) ];
+  uint32_t* jointStatsList = robotStatsList + ROBOT_STATS_JOINTS_OFFSET / sizeof(uint32_t);
+  uint32_t* histogramsList = robotStatsList + ROBOT_STATS_HISTOGRAMS_OFFSET / sizeof(uint32_t);
+  
+  SHMControlLayout statsLayout = { 0 };
+  SHMControl.GetLayout( sharedRobotStatsData, &statsLayout );
+  for( size_t robotIndex = 0; robotIndex < kv_size( robotIDsList ) && robotIndex < statsLayout.blocksNumber; robotIndex++ )
+  {
+    int robotID = kv_A( robotIDsList, robotIndex );
     
-    if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_POSITION ) ) Robots.SetJointSetpoint( joint, CONTROL_POSITION, controlSetpointsList[ SHM_JOINT_POSITION ] );
-    if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_FORCE ) ) Robots.SetJointSetpoint( joint, CONTROL_FORCE, controlSetpointsList[ SHM_JOINT_FORCE ] );
-    if( SHM_CONTROL_IS_BIT_SET( jointMask, SHM_JOINT_STIFFNESS ) ) Robots.SetJointSetpoint( joint, CONTROL_STIFFNESS, controlSetpointsList[ SHM_AXIS_STIFFNESS ] );
+    memset( robotStatsList, 0, ROBOT_STATS_BLOCK_SIZE );
     
-    float* controlMeasuresList = (float*) (measureData + jointIndex * JOINT_DATA_BLOCK_SIZE);
+    for( int stageIndex = 0; stageIndex < SHM_STATS_STAGES_NUMBER; stageIndex++ )
+    {
+      if( Robots.GetStageStats( robotID, (enum RobotControlStage) stageIndex, &stageStats ) ) 
+        SetStatsSummary( robotStatsList + stageIndex * SHM_STATS_VALUES_NUMBER, &stageStats );
       
-    //if( fabs( controlMeasuresList[ SHM_JOINT_POSITION ] - (float) jointMeasures->position ) > 0.05 )
-    //{
-      controlMeasuresList[ SHM_JOINT_POSITION ] = (float) Robots.GetJointMeasure( joint, CONTROL_POSITION );
-      controlMeasuresList[ SHM_JOINT_FORCE ] = (float) Robots.GetJointMeasure( joint, CONTROL_FORCE );
-      controlMeasuresList[ SHM_JOINT_STIFFNESS ] = (float) Robots.GetJointMeasure( joint, CONTROL_STIFFNESS );
-     
-      SHMControl.SetControlByte( sharedRobotJointsData, jointIndex, ++updateCount );
-    //}
+      if( ! Robots.GetStageHistogram( robotID, (enum RobotControlStage) stageIndex, &stageHistogram ) ) continue;
+      uint32_t* bucketsList = histogramsList + stageIndex * LATENCY_BUCKETS_NUMBER;
+      for( size_t bucketIndex = 0; bucketIndex < LATENCY_BUCKETS_NUMBER; bucketIndex++ )
+        bucketsList[ bucketIndex ] = SaturateStatsValue( stageHistogram.countsList[ bucketIndex ] );
+    }
+    
+    size_t jointsNumber = Robots.GetJointsNumber( robotID );
+    for( size_t jointIndex = 0; jointIndex < jointsNumber && jointIndex < SHM_STATS_JOINTS_NUMBER; jointIndex++ )
+    {
+      Joint joint = Robots.GetJoint( robotID, jointIndex );
+      for( int stageIndex = 0; stageIndex < SHM_STATS_JOINT_STAGES_NUMBER; stageIndex++ )
+      {
+        if( ! Robots.GetJointStageStats( joint, JOINT_STATS_STAGES[ stageIndex ], &stageStats ) ) continue;
+        SetStatsSummary( jointStatsList + ( jointIndex * SHM_STATS_JOINT_STAGES_NUMBER + stageIndex ) * SHM_STATS_VALUES_NUMBER, &stageStats );
+      }
+    }
+    
+    SHMControl.SetData( sharedRobotStatsData, (void*) robotStatsList, robotIndex * ROBOT_STATS_BLOCK_SIZE, ROBOT_STATS_BLOCK_SIZE );
+    SHMControl.SetControlByte( sharedRobotStatsData, robotIndex, ++updateCount );
   }
-  
-  SHMControl.SetData( sharedRobotJointsData, (void*) measureData, 0, SHM_CONTROL_MAX_DATA_SIZE );
 }
 
 void SubSystem_Update()
@@ -221,9 +377,46 @@ void SubSystem_Update()
   UpdateAxes();
   UpdateEvents();
   UpdateJoints();
+  
+  // Setpoints set above reach control threads on their next pass. Measures read here are the ones of their last pass
+  for( size_t robotIndex = 0; robotIndex < kv_size( robotIDsList ); robotIndex++ )
+    Robots.ExchangeData( kv_A( robotIDsList, robotIndex ) );
+  
+  UpdateStats();
+  
+  WakeEvents.Signal( networkUpdateEvent );
 }
 
 
+// Shared worker pool for robots configured with pooled scheduling. Not started if no workers are configured
+void LoadControlExecutor()
+{
+  int configFileID = Configuration.LoadConfigFile( "shared_robots" );
+  if( configFileID == DATA_INVALID_ID ) return;
+  
+  size_t workersNumber = (size_t) Configuration.GetIOHandler()->GetIntegerValue( configFileID, 0, "executor.workers" );
+  double tickRate = Configuration.GetIOHandler()->GetRealValue( configFileID, 1.0 / CONTROL_PASS_INTERVAL, "executor.tick_rate" );
+  
+  // Workers run with real-time FIFO scheduling when a priority is given
+  ThreadSpec workerSpec = { THREAD_SCHED_DEFAULT, 0, 0, 0, false };
+  workerSpec.priority = (int) Configuration.GetIOHandler()->GetIntegerValue( configFileID, 0, "executor.priority" );
+  if( workerSpec.priority > 0 ) workerSpec.schedulingPolicy = THREAD_SCHED_FIFO;
+  workerSpec.useIsolatedCores = Configuration.GetIOHandler()->GetBooleanValue( configFileID, false, "executor.isolated_cores" );
+  size_t workerCoresNumber = Configuration.GetIOHandler()->GetListSize( configFileID, "executor.cpus" );
+  for( size_t coreIndex = 0; coreIndex < workerCoresNumber; coreIndex++ )
+  {
+    long coreNumber = Configuration.GetIOHandler()->GetIntegerValue( configFileID, -1, "executor.cpus.%lu", coreIndex );
+    if( coreNumber >= 0 && coreNumber < 64 ) workerSpec.cpuAffinityMask |= ( 1ULL << coreNumber );
+  }
+  
+  Configuration.GetIOHandler()->UnloadData( configFileID );
+  
+  if( workersNumber > 0 && tickRate > 0.0 )
+  {
+    if( ! ControlExecutor.Init( workersNumber, 1.0 / tickRate, &workerSpec ) ) ERROR_PRINT( "failed to start control executor with %lu workers", workersNumber );
+  }
+}
+
 void LoadSharedRobotsInfo()
 {
   static uint8_t infoWriteCount;
@@ -252,6 +445,20 @@ void LoadSharedRobotsInfo()
           if( robotID != ROBOT_INVALID_ID )
           {
             Configuration.GetIOHandler()->SetStringValue( robotsConfigID, NULL, robotName, "robots" );
+            
+            char ringName[ SHARED_VARIABLE_NAME_MAX_LENGTH ];
+            sprintf( ringName, ROBOT_SAMPLES_RING_NAME, kv_size( robotIDsList ) );
+            SHMRing samplesRing = SHMRings.InitRing( ringName, ROBOT_SAMPLES_RING_SIZE, sizeof(SHMAxisSample) );
+            if( samplesRing != NULL )
+            {
+              RobotSamplesStream* samplesStream = (RobotSamplesStream*) malloc( sizeof(RobotSamplesStream) );
+              samplesStream->ring = samplesRing;
+              samplesStream->firstAxisIndex = kv_size( axesList );
+              samplesStream->cyclesCount = 0;
+              kv_push( RobotSamplesStream*, samplesStreamsList, samplesStream );
+              Robots.SetCycleCallback( robotID, WriteAxesSamples, samplesStream );
+            }
+            
             kv_push( int, robotIDsList, robotID );
 
             size_t axesNumber = Robots.GetAxesNumber( robotID );
@@ -288,9 +495,22 @@ void LoadSharedRobotsInfo()
   {
     DEBUG_PRINT( "robots info string: %s", robotsInfoString );
     
-    SHMControl.SetData( sharedRobotsInfo, (void*) robotsInfoString, 0, SHM_CONTROL_MAX_DATA_SIZE );
-    SHMControl.SetControlByte( sharedRobotsInfo, 0, ++infoWriteCount );
-    SHMControl.SetControlByte( sharedRobotsInfo, 1, (uint8_t) kv_size( robotIDsList ) );
+    // String is truncated (keeping its terminator) if longer than the channel data
+    SHMControlLayout infoLayout = { 0 };
+    SHMControl.GetLayout( sharedRobotsInfo, &infoLayout );
+    size_t infoLength = strlen( robotsInfoString ) + 1;
+    if( infoLength > infoLayout.dataSize )
+    {
+      ERROR_PRINT( "robots info string (%lu bytes) truncated to %lu bytes", infoLength, infoLayout.dataSize );
+      infoLength = infoLayout.dataSize;
+      if( infoLength > 0 ) robotsInfoString[ infoLength - 1 ] = '\0';
+    }
+    SHMControl.SetData( sharedRobotsInfo, (void*) robotsInfoString, 0, infoLength );
+    SHMControl.SetControlByte( sharedRobotsInfo, infoLayout.maskSize - SHM_ROBOT_INFO_ROBOTS_NUMBER, (uint8_t) kv_size( robotIDsList ) );
+    SHMControl.SetControlByte( sharedRobotsInfo, infoLayout.maskSize - SHM_ROBOT_INFO_AXES_NUMBER, (uint8_t) kv_size( axesList ) );
+    // Written last, as readers refresh on its change. Never 0, which stands for no info written yet
+    infoWriteCount = ( infoWriteCount == UINT8_MAX ) ? 1 : infoWriteCount + 1;
+    SHMControl.SetControlByte( sharedRobotsInfo, infoLayout.maskSize - SHM_ROBOT_INFO_WRITE_COUNT, infoWriteCount );
     
     free( robotsInfoString );
   }
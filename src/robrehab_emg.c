@@ -21,6 +21,7 @@
 
 
 #include "shm_control.h"
+#include "shm_robot_control.h"
 #include "shm_joint_control.h"
 
 //#include "optimization.h"
@@ -68,7 +69,7 @@ kvec_t( SHMJointData ) sharedJointsList;
 SHMController sharedRobotJointsInfo;
 SHMController sharedRobotJointsData;
 
-char robotJointsInfo[ SHM_CONTROL_MAX_DATA_SIZE ] = "";
+char robotJointsInfo[ ROBOT_INFO_BLOCKS_NUMBER * ROBOT_INFO_BLOCK_SIZE ] = "";
 size_t robotsNumber = 0;
       
 
@@ -82,12 +83,12 @@ int SubSystem_Init( const char* configType )
 {
   kv_init( sharedJointsList );
   
-  sharedRobotJointsInfo = SHMControl.InitData( "robot_joints_info", SHM_CONTROL_OUT );
-  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_OUT );
+  sharedRobotJointsInfo = SHMControl.InitData( "robot_joints_info", SHM_CONTROL_OUT, ROBOT_INFO_BLOCKS_NUMBER, ROBOT_INFO_BLOCK_SIZE, 8 );
+  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_OUT, JOINT_DATA_BLOCKS_NUMBER, JOINT_DATA_BLOCK_SIZE, SHM_JOINT_FLOATS_NUMBER );
   
   if( Configuration.Init( configType ) )
   {
-    SHMControl.GetData( sharedRobotJointsInfo, (void*) robotJointsInfo, 0, SHM_CONTROL_MAX_DATA_SIZE );
+    SHMControl.GetData( sharedRobotJointsInfo, (void*) robotJointsInfo, 0, sizeof(robotJointsInfo) );
     
     sprintf( robotJointsInfo, "0:simple_joint|1:angle" );
     
@@ -167,11 +168,11 @@ void SubSystem_End( void )
 
 void SubSystem_Update( void )
 {
-  static uint8_t controlData[ SHM_CONTROL_MAX_DATA_SIZE ];
+  static uint8_t controlData[ JOINT_DATA_BLOCKS_NUMBER * JOINT_DATA_BLOCK_SIZE ];
   
-  SHMControl.GetData( sharedRobotJointsData, (void*) controlData, 0, SHM_CONTROL_MAX_DATA_SIZE );
+  SHMControl.GetData( sharedRobotJointsData, (void*) controlData, 0, sizeof(controlData) );
   
-  for( size_t jointIndex = 0; jointIndex < kv_size( sharedJointsList ); jointIndex++ )
+  for( size_t jointIndex = 0; jointIndex < kv_size( sharedJointsList ) && jointIndex < JOINT_DATA_BLOCKS_NUMBER; jointIndex++ )
   {
     SHMJoint sharedJoint = &(kv_A( sharedJointsList, jointIndex ));
     
@@ -264,7 +265,7 @@ void SubSystem_Update( void )
     }
   }
   
-  SHMControl.SetData( sharedRobotJointsData, (void*) controlData, 0, SHM_CONTROL_MAX_DATA_SIZE );
+  SHMControl.SetData( sharedRobotJointsData, (void*) controlData, 0, sizeof(controlData) );
 }
 
 
@@ -21,13 +21,18 @@
 
 
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include "ip_network/async_ip_network.h"
 
 #include "shm_control.h"
+#include "shm_robot_control.h"
 #include "shm_axis_control.h"
 #include "shm_joint_control.h"
+#include "shm_robot_stats.h"
+#include "shm_robot_samples.h"
+#include "axis_packets.h"
 
 //#include "configuration.h"
 
@@ -40,20 +45,62 @@
 
 const unsigned long UPDATE_INTERVAL_MS = 5;
 
+const char* UPDATE_EVENT_NAME = NETWORK_UPDATE_EVENT_NAME;
+
+// Clients built before length prefixed messages (e.g. scripts/ReRobIPNetwork.py with LENGTH_PREFIXED_MESSAGES = False)
+// require the server to be built with NETWORK_LEGACY_FRAMING
+#ifdef NETWORK_LEGACY_FRAMING
+const uint8_t NETWORK_FRAMING = IP_FRAMING_FIXED;
+#else
+const uint8_t NETWORK_FRAMING = IP_FRAMING_PREFIXED;
+#endif
+
+// Measures of all axes are published once per update on this group, for any number of observers (setpoints still go 
+// through the unicast axis server). Define NETWORK_MULTICAST_GROUP as "" to disable publishing
+#ifndef NETWORK_MULTICAST_GROUP
+  #define NETWORK_MULTICAST_GROUP "226.1.1.1"
+#endif
+const char* MULTICAST_GROUP = NETWORK_MULTICAST_GROUP;
+const uint16_t MULTICAST_PORT = 50004;
+
 
 static unsigned long eventServerConnectionID = IP_CONNECTION_INVALID_ID;
 static unsigned long axisServerConnectionID = IP_CONNECTION_INVALID_ID;
 static unsigned long jointServerConnectionID = IP_CONNECTION_INVALID_ID;
+static unsigned long samplesServerConnectionID = IP_CONNECTION_INVALID_ID;
+static unsigned long axisPublisherConnectionID = IP_CONNECTION_INVALID_ID;
 
 static kvec_t( unsigned long ) eventClientsList;
 const size_t INFO_BLOCK_SIZE = 2;
 
+// Robots info (as last written by control) is kept for replying to requests right away. Until it is available, requesting 
+// clients wait (without blocking the update loop) for the next control write, signaled by its update count (control byte 0)
+static char cachedInfo[ IP_MAX_MESSAGE_LENGTH ];
+static size_t cachedInfoLength = 0;
+static uint8_t cachedInfoCount = 0;
+static kvec_t( unsigned long ) infoClientsList;
+
 static kvec_t( unsigned long ) axisClientsList;
+// Packets coder of each axis client (in the same order), for the ones that subscribed to compact packets
+static kvec_t( AxisPacketsCoder ) axisCodersList;
+// Axis clients that get full blocks (not subscribed to packets), gathered on every update
+static kvec_t( unsigned long ) blockClientsList;
 static kvec_t( unsigned long ) jointClientsList;
+static kvec_t( unsigned long ) samplesClientsList;
+
+// Robots samples rings, opened as shared robots are reported by control. Drained (even without clients) on every update
+static kvec_t( SHMRing ) samplesRingsList;
+static kvec_t( uint64_t ) samplesOverflowsList;
 
 SHMController sharedRobotsInfo;
 SHMController sharedRobotAxesData;
 SHMController sharedRobotJointsData;
+SHMController sharedRobotStatsData;
+
+// Received client messages wake up this process loop. Commands and setpoints written to shared memory wake up the control one
+static WakeEvent updateEvent;
+static WakeEvent controlUpdateEvent;
+static bool hasControlUpdate = false;
 
 static kvec_t( unsigned long ) axisNetworkControllersList;
 static kvec_t( unsigned long ) jointNetworkControllersList;
@@ -65,30 +112,54 @@ int SubSystem_Init( const char* configType, const char* configDirectory,  const
 {
   /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "Initializing RobRehab Network on thread %lx", THREAD_ID );
   
-  if( (eventServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_TCP, NULL, 50000 )) == IP_CONNECTION_INVALID_ID )
+  if( (eventServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_TCP, NULL, 50000 )) == (unsigned long) IP_CONNECTION_INVALID_ID )
+    return -1;
+  if( (axisServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_UDP, NULL, 50001 )) == (unsigned long) IP_CONNECTION_INVALID_ID )
     return -1;
-  if( (axisServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_UDP, NULL, 50001 )) == IP_CONNECTION_INVALID_ID )
-  //if( (axisServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_UDP, "226.1.1.1", 50001 )) == IP_CONNECTION_INVALID_ID )
+  if( (jointServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_UDP, NULL, 50002 )) == (unsigned long) IP_CONNECTION_INVALID_ID )
     return -1;
-  if( (jointServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_UDP, NULL, 50002 )) == IP_CONNECTION_INVALID_ID )
+  // Reliable (TCP) connection: samples are not resent
+  if( (samplesServerConnectionID = AsyncIPNetwork.OpenConnection( IP_SERVER | IP_TCP, NULL, 50003 )) == (unsigned long) IP_CONNECTION_INVALID_ID )
     return -1;
   
+  AsyncIPNetwork.SetFraming( eventServerConnectionID, NETWORK_FRAMING );
+  AsyncIPNetwork.SetFraming( axisServerConnectionID, NETWORK_FRAMING );
+  AsyncIPNetwork.SetFraming( jointServerConnectionID, NETWORK_FRAMING );
+  AsyncIPNetwork.SetFraming( samplesServerConnectionID, NETWORK_FRAMING );
+  
+  // Observers only subscribe to the group, so failing to publish is not critical
+  if( strlen( MULTICAST_GROUP ) > 0 )
+  {
+    if( (axisPublisherConnectionID = AsyncIPNetwork.OpenConnection( IP_CLIENT | IP_UDP, MULTICAST_GROUP, MULTICAST_PORT )) != (unsigned long) IP_CONNECTION_INVALID_ID )
+      AsyncIPNetwork.SetFraming( axisPublisherConnectionID, NETWORK_FRAMING );
+    else
+      ERROR_PRINT( "failed opening axis publisher on group %s", MULTICAST_GROUP );
+  }
+  
   /*DEBUG_EVENT( 1,*/DEBUG_PRINT( "Received server connection IDs: %lu (Info) - %lu (Data) - %lu(joint)", eventServerConnectionID, axisServerConnectionID, jointServerConnectionID );
   
   kv_init( eventClientsList );
+  kv_init( infoClientsList );
   kv_init( axisClientsList );
+  kv_init( axisCodersList );
+  kv_init( blockClientsList );
   kv_init( jointClientsList );
+  kv_init( samplesClientsList );
+  
+  kv_init( samplesRingsList );
+  kv_init( samplesOverflowsList );
   
   kv_init( axisNetworkControllersList );
   kv_init( jointNetworkControllersList );
   
-  sharedRobotsInfo = SHMControl.InitData( "robots_info", SHM_CONTROL_OUT );
-  sharedRobotAxesData = SHMControl.InitData( "robot_axes_data", SHM_CONTROL_OUT );
-  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_OUT );
+  sharedRobotsInfo = SHMControl.InitData( "robots_info", SHM_CONTROL_OUT, ROBOT_INFO_BLOCKS_NUMBER, ROBOT_INFO_BLOCK_SIZE, 8 );
+  sharedRobotAxesData = SHMControl.InitData( "robot_axes_data", SHM_CONTROL_OUT, AXIS_DATA_BLOCKS_NUMBER, AXIS_DATA_BLOCK_SIZE, SHM_AXIS_FLOATS_NUMBER );
+  sharedRobotJointsData = SHMControl.InitData( "robot_joints_data", SHM_CONTROL_OUT, JOINT_DATA_BLOCKS_NUMBER, JOINT_DATA_BLOCK_SIZE, SHM_JOINT_FLOATS_NUMBER );
+  sharedRobotStatsData = SHMControl.InitData( "robot_stats_data", SHM_CONTROL_OUT, ROBOT_STATS_BLOCKS_NUMBER, ROBOT_STATS_BLOCK_SIZE, 8 );
   
-  //char robotsInfoString[ SHM_CONTROL_MAX_DATA_SIZE ];
-  //SHMControl.GetData( sharedRobotsInfo, (void*) robotsInfoString, 0, SHM_CONTROL_MAX_DATA_SIZE );
-  //DEBUG_PRINT( "shared robots info: %s", robotsInfoString );
+  updateEvent = WakeEvents.Create( UPDATE_EVENT_NAME );
+  controlUpdateEvent = WakeEvents.Create( CONTROL_UPDATE_EVENT_NAME );
+  AsyncIPNetwork.SetReadEvent( updateEvent );
   
   /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "RobRehab Network initialized on thread %lx", THREAD_ID );
   
@@ -114,14 +185,35 @@ void SubSystem_End()
   AsyncIPNetwork.CloseConnection( jointServerConnectionID );
   /*DEBUG_EVENT( 3,*/DEBUG_PRINT( "joint server %lu closed", jointServerConnectionID );
   
+  for( size_t samplesClientIndex = 0; samplesClientIndex < kv_size( samplesClientsList ); samplesClientIndex++ )
+    AsyncIPNetwork.CloseConnection( kv_A( samplesClientsList, samplesClientIndex ) );
+  AsyncIPNetwork.CloseConnection( samplesServerConnectionID );
+  
+  AsyncIPNetwork.CloseConnection( axisPublisherConnectionID );
+  
+  for( size_t ringIndex = 0; ringIndex < kv_size( samplesRingsList ); ringIndex++ )
+    SHMRings.EndRing( kv_A( samplesRingsList, ringIndex ) );
+  kv_destroy( samplesRingsList );
+  kv_destroy( samplesOverflowsList );
+  
   SHMControl.EndData( sharedRobotsInfo );
   SHMControl.EndData( sharedRobotAxesData );
   SHMControl.EndData( sharedRobotJointsData );
+  SHMControl.EndData( sharedRobotStatsData );
+  
+  AsyncIPNetwork.SetReadEvent( NULL );
+  WakeEvents.Discard( updateEvent );
+  WakeEvents.Discard( controlUpdateEvent );
   
   kv_destroy( eventClientsList );
+  kv_destroy( infoClientsList );
   DEBUG_EVENT( 6, "info clients list %p destroyed", eventClientsList );
   kv_destroy( axisClientsList );
   DEBUG_EVENT( 7, "data clients list %p destroyed", axisClientsList );
+  for( size_t axisClientIndex = 0; axisClientIndex < kv_size( axisCodersList ); axisClientIndex++ )
+    AxisPackets.DiscardCoder( kv_A( axisCodersList, axisClientIndex ) );
+  kv_destroy( axisCodersList );
+  kv_destroy( blockClientsList );
   kv_destroy( jointClientsList );
   DEBUG_EVENT( 8, "joint clients list %p destroyed", jointClientsList );
   
@@ -132,44 +224,121 @@ void SubSystem_End()
 }
 
 static void UpdateClientEvent( unsigned long );
-static void UpdateClientAxis( unsigned long );
-static void UpdateClientJoint( unsigned long );
+static void UpdateRobotsInfo( void );
+static void UpdateClientAxis( unsigned long, AxisPacketsCoder* );
+static void SendClientsBlocks( unsigned long*, size_t, SHMController, unsigned long*, size_t, size_t );
+static void SendClientsPackets( void );
+static void UpdateSamples( void );
+static void PublishAxesMeasures( void );
 
 void SubSystem_Update()
 {
   DEBUG_UPDATE( "updating connections on thread %lx", THREAD_ID );
   
   unsigned long newEventClientID = AsyncIPNetwork.GetClient( eventServerConnectionID );
-  if( newEventClientID != IP_CONNECTION_INVALID_ID )
+  if( newEventClientID != (unsigned long) IP_CONNECTION_INVALID_ID )
   {
     /*DEBUG_EVENT( 0,*/DEBUG_PRINT( "new info client found: %lu", newEventClientID );
     kv_push( unsigned long, eventClientsList, newEventClientID );
   }
   
   unsigned long newAxisClientID = AsyncIPNetwork.GetClient( axisServerConnectionID );
-  if( newAxisClientID != IP_CONNECTION_INVALID_ID )
+  if( newAxisClientID != (unsigned long) IP_CONNECTION_INVALID_ID )
   {
     /*DEBUG_EVENT( 1,*/DEBUG_PRINT( "new data client found: %lu", newAxisClientID );
     kv_push( unsigned long, axisClientsList, newAxisClientID );
+    kv_push( AxisPacketsCoder, axisCodersList, NULL );
   }
   
   unsigned long newjointClientID = AsyncIPNetwork.GetClient( jointServerConnectionID );
-  if( newjointClientID != IP_CONNECTION_INVALID_ID )
+  if( newjointClientID != (unsigned long) IP_CONNECTION_INVALID_ID )
   {
     /*DEBUG_EVENT( 1,*/DEBUG_PRINT( "new joint client found: %lu", newjointClientID );
     kv_push( unsigned long, jointClientsList, newjointClientID );
   }
   
+  unsigned long newSamplesClientID = AsyncIPNetwork.GetClient( samplesServerConnectionID );
+  if( newSamplesClientID != (unsigned long) IP_CONNECTION_INVALID_ID )
+  {
+    DEBUG_PRINT( "new samples client found: %lu", newSamplesClientID );
+    kv_push( unsigned long, samplesClientsList, newSamplesClientID );
+  }
+  
   for( size_t clientIndex = 0; clientIndex < kv_size( eventClientsList ); clientIndex++ )
     UpdateClientEvent( kv_A( eventClientsList, clientIndex ) );
   
+  UpdateRobotsInfo();
+  
+  // Clients that subscribed to compact packets do not get full blocks
+  kv_size( blockClientsList ) = 0;
   for( size_t clientIndex = 0; clientIndex < kv_size( axisClientsList ); clientIndex++ )
-    UpdateClientAxis( kv_A( axisClientsList, clientIndex ) );
+  {
+    UpdateClientAxis( kv_A( axisClientsList, clientIndex ), &(kv_A( axisCodersList, clientIndex )) );
+    if( kv_A( axisCodersList, clientIndex ) == NULL ) kv_push( unsigned long, blockClientsList, kv_A( axisClientsList, clientIndex ) );
+  }
+  
+  SendClientsBlocks( blockClientsList.a, kv_size( blockClientsList ), sharedRobotAxesData, 
+                     axisNetworkControllersList.a, kv_size( axisNetworkControllersList ), AXIS_DATA_BLOCK_SIZE );
+  
+  SendClientsPackets();
+  
+  SendClientsBlocks( jointClientsList.a, kv_size( jointClientsList ), sharedRobotJointsData, 
+                     jointNetworkControllersList.a, kv_size( jointNetworkControllersList ), JOINT_DATA_BLOCK_SIZE );
   
-  for( size_t clientIndex = 0; clientIndex < kv_size( jointClientsList ); clientIndex++ )
-    UpdateClientJoint( kv_A( jointClientsList, clientIndex ) );
+  PublishAxesMeasures();
+  
+  UpdateSamples();
+  
+  if( hasControlUpdate ) WakeEvents.Signal( controlUpdateEvent );
+  hasControlUpdate = false;
 }
 
+// Reserved robots info control bytes (shm_robot_control.h) are indexed back from the mask end
+static uint8_t GetRobotsInfoByte( uint8_t reservedByte )
+{
+  SHMControlLayout infoLayout = { 0 };
+  if( ! SHMControl.GetLayout( sharedRobotsInfo, &infoLayout ) ) return 0;
+  
+  return SHMControl.GetControlByte( sharedRobotsInfo, infoLayout.maskSize - reservedByte, SHM_CONTROL_PEEK );
+}
+
+// Cache is refreshed whenever control writes the robots info, and pending requests are answered
+static void UpdateRobotsInfo( void )
+{
+  uint8_t infoWriteCount = GetRobotsInfoByte( SHM_ROBOT_INFO_WRITE_COUNT );
+  if( infoWriteCount != 0 && infoWriteCount != cachedInfoCount )
+  {
+    SHMControlLayout infoLayout = { 0 };
+    SHMControl.GetLayout( sharedRobotsInfo, &infoLayout );
+    
+    // String length is only known from its terminator: the whole channel data is read, and replies carry the string only
+    char* infoString = (char*) calloc( infoLayout.dataSize + 1, sizeof(char) );
+    if( infoString != NULL && SHMControl.GetData( sharedRobotsInfo, (void*) infoString, 0, infoLayout.dataSize ) )
+    {
+      size_t infoLength = strlen( infoString ) + 1;
+      if( infoLength > IP_MAX_MESSAGE_LENGTH )
+      {
+        ERROR_PRINT( "robots info string (%lu bytes) truncated to reply message length (%u bytes)", infoLength, IP_MAX_MESSAGE_LENGTH );
+        infoLength = IP_MAX_MESSAGE_LENGTH;
+        infoString[ infoLength - 1 ] = '\0';
+      }
+      memcpy( cachedInfo, infoString, infoLength );
+      cachedInfoLength = infoLength;
+      cachedInfoCount = infoWriteCount;
+      DEBUG_PRINT( "robots info updated (count: %u, %lu bytes)", infoWriteCount, infoLength );
+    }
+    free( infoString );
+  }
+  
+  if( cachedInfoLength == 0 ) return;
+  
+  for( size_t clientIndex = 0; clientIndex < kv_size( infoClientsList ); clientIndex++ )
+    AsyncIPNetwork.WriteMessage( kv_A( infoClientsList, clientIndex ), cachedInfo, cachedInfoLength );
+  kv_size( infoClientsList ) = 0;
+}
+
+// Messages: commands blocks number, followed by each block robot index and command. Blocks numbers 0x00 (robots info
+// request) and SHM_ROBOT_STATS_REQUEST are reserved, so command messages hold up to SHM_ROBOT_COMMAND_MAX_BLOCKS
 static void UpdateClientEvent( unsigned long clientID )
 {
   static char messageOut[ IP_MAX_MESSAGE_LENGTH ];
@@ -182,16 +351,49 @@ static void UpdateClientEvent( unsigned long clientID )
     
     uint8_t commandBlocksNumber = (uint8_t) *(messageIn++);
     
+    SHMControlLayout infoLayout = { 0 };
+    SHMControl.GetLayout( sharedRobotsInfo, &infoLayout );
+    
     if( commandBlocksNumber == 0x00 )
     {
+      if( cachedInfoLength > 0 ) 
+      {
+        AsyncIPNetwork.WriteMessage( clientID, cachedInfo, cachedInfoLength );
+        return;
+      }
+      
+      for( size_t clientIndex = 0; clientIndex < kv_size( infoClientsList ); clientIndex++ )
+      {
+        if( kv_A( infoClientsList, clientIndex ) == clientID ) return;
+      }
+      // Control is only asked once for all waiting clients, on its reserved control byte
+      if( kv_size( infoClientsList ) == 0 )
+      {
+        listRequestsCount = ( listRequestsCount == UINT8_MAX ) ? 1 : listRequestsCount + 1;
+        SHMControl.SetControlByte( sharedRobotsInfo, infoLayout.maskSize - SHM_ROBOT_INFO_LIST_REQUEST, listRequestsCount );
+        hasControlUpdate = true;
+      }
+      kv_push( unsigned long, infoClientsList, clientID );
+      
+      return;
+    }
+    else if( commandBlocksNumber == SHM_ROBOT_STATS_REQUEST )
+    {
+      // Reply: request code, followed by the stage times summaries of each shared robot (joints and histograms stay in shared memory)
       memset( messageOut, 0, IP_MAX_MESSAGE_LENGTH * sizeof(char) );
       
-      SHMControl.SetControlByte( sharedRobotsInfo, SHM_CONTROL_MASK_SIZE - 1, ++listRequestsCount );
+      // Only the robots whose summaries fit in the message are sent
+      SHMControlLayout statsLayout = { 0 };
+      SHMControl.GetLayout( sharedRobotStatsData, &statsLayout );
+      size_t statsBlocksNumber = ( IP_MAX_MESSAGE_LENGTH - 1 ) / ROBOT_STATS_SUMMARY_SIZE;
+      if( statsBlocksNumber > statsLayout.blocksNumber ) statsBlocksNumber = statsLayout.blocksNumber;
       
-      Timing.Delay( 100 );
+      messageOut[ 0 ] = (char) SHM_ROBOT_STATS_REQUEST;
+      for( size_t statsBlockIndex = 0; statsBlockIndex < statsBlocksNumber; statsBlockIndex++ )
+        SHMControl.GetData( sharedRobotStatsData, (void*) ( messageOut + 1 + statsBlockIndex * ROBOT_STATS_SUMMARY_SIZE ), statsBlockIndex * ROBOT_STATS_BLOCK_SIZE, ROBOT_STATS_SUMMARY_SIZE );
+      AsyncIPNetwork.WriteMessage( clientID, messageOut, 1 + statsBlocksNumber * ROBOT_STATS_SUMMARY_SIZE );
       
-      SHMControl.GetData( sharedRobotsInfo, (void*) messageOut, 0, IP_MAX_MESSAGE_LENGTH );
-      AsyncIPNetwork.WriteMessage( clientID, messageOut );
+      return;
     }
     
     for( uint8_t commandBlockIndex = 0; commandBlockIndex < commandBlocksNumber; commandBlockIndex++ )
@@ -200,87 +402,345 @@ static void UpdateClientEvent( unsigned long clientID )
       uint8_t command = (uint8_t) *(messageIn++);
       DEBUG_PRINT( "received robot %u command: %u", robotIndex, command );
       
+      // Reserved control bytes are not writable by clients
+      if( robotIndex >= infoLayout.maskSize - SHM_ROBOT_INFO_RESERVED_NUMBER ) continue;
+      
       SHMControl.SetControlByte( sharedRobotsInfo, robotIndex, command );
+      hasControlUpdate = true;
     }
   }
 }
 
-static void UpdateClientAxis( unsigned long clientID )
+// Messages: blocks number, followed by each block index and data. Blocks are gathered straight from the blocks snapshot
+// on sending (no further copies). Returns the number of message parts (0 if the client controls no blocks)
+static size_t BuildClientMessage( unsigned long clientID, const uint8_t* blocksData, unsigned long* controllersList, size_t blocksNumber, size_t blockSize,
+                                  uint8_t* headerData, IPMessagePart* partsList )
 {
-  static char messageOut[ IP_MAX_MESSAGE_LENGTH ];
+  headerData[ 0 ] = 0;
+  partsList[ 0 ] = (IPMessagePart) { .data = headerData, .length = 1 };
+  size_t partsNumber = 1, messageLength = 1;
+  for( size_t blockIndex = 0; blockIndex < blocksNumber; blockIndex++ )
+  {
+    if( controllersList[ blockIndex ] != clientID ) continue;
+    
+    if( messageLength + blockSize + 1 > IP_MAX_MESSAGE_LENGTH ) break;
+    if( partsNumber + 2 > IP_MAX_MESSAGE_PARTS - 1 ) break;
+    
+    headerData[ 0 ]++;
+    headerData[ headerData[ 0 ] ] = (uint8_t) blockIndex;
+    partsList[ partsNumber++ ] = (IPMessagePart) { .data = &(headerData[ headerData[ 0 ] ]), .length = 1 };
+    partsList[ partsNumber++ ] = (IPMessagePart) { .data = blocksData + blockIndex * blockSize, .length = blockSize };
+    messageLength += blockSize + 1;
+  }
+  
+  return ( headerData[ 0 ] > 0 ) ? partsNumber : 0;
+}
+
+// Largest shared blocks data sent to clients (axes or joints)
+#define BLOCKS_SNAPSHOT_SIZE ( ( AXIS_DATA_BLOCKS_NUMBER * AXIS_DATA_BLOCK_SIZE > JOINT_DATA_BLOCKS_NUMBER * JOINT_DATA_BLOCK_SIZE ) ? \
+                               AXIS_DATA_BLOCKS_NUMBER * AXIS_DATA_BLOCK_SIZE : JOINT_DATA_BLOCKS_NUMBER * JOINT_DATA_BLOCK_SIZE )
+
+// Messages of all clients of a server are sent in batches (a single system call for UDP clients). The control process 
+// may write shared blocks meanwhile: blocks are copied consistently once, before anything is sent, so no torn block goes out
+static void SendClientsBlocks( unsigned long* clientsList, size_t clientsNumber, SHMController sharedData, 
+                               unsigned long* controllersList, size_t blocksNumber, size_t blockSize )
+{
+  static uint8_t blocksData[ BLOCKS_SNAPSHOT_SIZE ];
+  static uint8_t headersData[ IP_MAX_BATCH_MESSAGES ][ IP_MAX_MESSAGE_PARTS / 2 ];
+  static IPMessagePart partsLists[ IP_MAX_BATCH_MESSAGES ][ IP_MAX_MESSAGE_PARTS - 1 ];
+  static IPMessage messagesList[ IP_MAX_BATCH_MESSAGES ];
+  static unsigned long messageClientsList[ IP_MAX_BATCH_MESSAGES ];
+  
+  if( clientsNumber == 0 ) return;
+  
+  if( blocksNumber * blockSize > BLOCKS_SNAPSHOT_SIZE ) blocksNumber = BLOCKS_SNAPSHOT_SIZE / blockSize;
+  if( ! SHMControl.GetData( sharedData, (void*) blocksData, 0, blocksNumber * blockSize ) ) return;
+  
+  for( size_t firstClientIndex = 0; firstClientIndex < clientsNumber; firstClientIndex += IP_MAX_BATCH_MESSAGES )
+  {
+    size_t batchClientsNumber = clientsNumber - firstClientIndex;
+    if( batchClientsNumber > IP_MAX_BATCH_MESSAGES ) batchClientsNumber = IP_MAX_BATCH_MESSAGES;
+    
+    size_t messagesNumber = 0;
+    for( size_t clientIndex = 0; clientIndex < batchClientsNumber; clientIndex++ )
+    {
+      unsigned long clientID = clientsList[ firstClientIndex + clientIndex ];
+      size_t partsNumber = BuildClientMessage( clientID, blocksData, controllersList, blocksNumber, blockSize, 
+                                               headersData[ messagesNumber ], partsLists[ messagesNumber ] );
+      if( partsNumber == 0 ) continue;
+      
+      messageClientsList[ messagesNumber ] = clientID;
+      messagesList[ messagesNumber ] = (IPMessage) { .partsList = partsLists[ messagesNumber ], .partsNumber = partsNumber };
+      messagesNumber++;
+    }
+    
+    if( messagesNumber == 0 ) continue;
+    
+    DEBUG_UPDATE( "sending blocks to %lu clients", messagesNumber );
+    AsyncIPNetwork.WriteMessagesBatch( messageClientsList, messagesList, messagesNumber );
+  }
+}
+
+// Subscribed clients get a single packet per update, encoded (for each one) from a copy of all shared axes blocks. 
+// Nothing is sent if the control process did not write measures since the last update, or if subscribed fields did not change
+static void SendClientsPackets( void )
+{
+  static SHMAxisBlock axesList[ AXIS_DATA_BLOCKS_NUMBER ];
+  static uint32_t encodedVersion = 0;
+  
+  static uint8_t packetsData[ IP_MAX_BATCH_MESSAGES ][ AXIS_PACKETS_MAX_LENGTH ];
+  static IPMessagePart partsList[ IP_MAX_BATCH_MESSAGES ];
+  static IPMessage messagesList[ IP_MAX_BATCH_MESSAGES ];
+  static unsigned long messageClientsList[ IP_MAX_BATCH_MESSAGES ];
+  
+  // Number of shared axes is published by control along with the robots list
+  size_t axesNumber = (size_t) GetRobotsInfoByte( SHM_ROBOT_INFO_AXES_NUMBER );
+  if( axesNumber > AXIS_DATA_BLOCKS_NUMBER ) axesNumber = AXIS_DATA_BLOCKS_NUMBER;
+  if( axesNumber == 0 ) return;
+  
+  uint32_t dataVersion;
+  if( SHMControl.GetDataReference( sharedRobotAxesData, 0, axesNumber * AXIS_DATA_BLOCK_SIZE, &dataVersion ) == NULL ) return;
+  if( dataVersion == encodedVersion ) return;
+  
+  bool hasCopy = false;
+  size_t messagesNumber = 0;
+  for( size_t clientIndex = 0; clientIndex < kv_size( axisClientsList ); clientIndex++ )
+  {
+    AxisPacketsCoder coder = kv_A( axisCodersList, clientIndex );
+    if( coder == NULL ) continue;
+    
+    if( !hasCopy )
+    {
+      if( !SHMControl.GetData( sharedRobotAxesData, (void*) axesList, 0, axesNumber * AXIS_DATA_BLOCK_SIZE ) ) return;
+      encodedVersion = dataVersion;
+      hasCopy = true;
+    }
+    
+    size_t packetLength = AxisPackets.Encode( coder, axesList, axesNumber, packetsData[ messagesNumber ], AXIS_PACKETS_MAX_LENGTH );
+    if( packetLength == 0 ) continue;
+    
+    partsList[ messagesNumber ] = (IPMessagePart) { .data = packetsData[ messagesNumber ], .length = packetLength };
+    messagesList[ messagesNumber ] = (IPMessage) { .partsList = &(partsList[ messagesNumber ]), .partsNumber = 1 };
+    messageClientsList[ messagesNumber ] = kv_A( axisClientsList, clientIndex );
+    
+    if( ++messagesNumber == IP_MAX_BATCH_MESSAGES )
+    {
+      AsyncIPNetwork.WriteMessagesBatch( messageClientsList, messagesList, messagesNumber );
+      messagesNumber = 0;
+    }
+  }
   
+  if( messagesNumber > 0 ) AsyncIPNetwork.WriteMessagesBatch( messageClientsList, messagesList, messagesNumber );
+}
+
+// Subscriptions replace the client coder (a new one starts with a keyframe). Subscribing to no axes goes back to full blocks
+static void UpdateClientSubscription( unsigned long clientID, const char* requestMessage, AxisPacketsCoder* ref_coder )
+{
+  AxisPacketsSettings settings;
+  if( !AxisPackets.ReadSettings( (const uint8_t*) requestMessage, IP_MAX_MESSAGE_LENGTH, &settings ) )
+  {
+    ERROR_PRINT( "invalid packets subscription from client %lu", clientID );
+    return;
+  }
+  
+  AxisPackets.DiscardCoder( *ref_coder );
+  *ref_coder = AxisPackets.CreateCoder( &settings );
+  
+  DEBUG_PRINT( "client %lu subscribed to %u axes (fields: %x, quantization: %u, keyframe interval: %u)", clientID, 
+               settings.axesNumber, settings.fieldsMask, settings.quantization, settings.keyframeInterval );
+}
+
+// Probe replies echo the client time along with the server read and send times, so that the client can estimate 
+// the round trip time and the offset between both clocks (to compare setpoints sending and actuation times)
+static void ReplyLatencyProbe( unsigned long clientID, const char* probeMessage )
+{
+  const size_t TIME_LENGTH = sizeof(uint64_t);
+  
+  uint8_t replyData[ 1 + 3 * sizeof(uint64_t) ];
+  
+  uint64_t receiveTime = Timing.GetExecTimeNanoseconds();
+  
+  replyData[ 0 ] = SHM_AXIS_PROBE_REQUEST;
+  memcpy( replyData + 1, probeMessage + 1, TIME_LENGTH );
+  memcpy( replyData + 1 + TIME_LENGTH, &receiveTime, TIME_LENGTH );
+  
+  uint64_t sendTime = Timing.GetExecTimeNanoseconds();
+  memcpy( replyData + 1 + 2 * TIME_LENGTH, &sendTime, TIME_LENGTH );
+  
+  // Sent right away, instead of waiting for the write thread
+  IPMessagePart replyPart = { .data = replyData, .length = sizeof(replyData) };
+  AsyncIPNetwork.WriteMessageParts( clientID, &replyPart, 1 );
+}
+
+static void UpdateClientAxis( unsigned long clientID, AxisPacketsCoder* ref_coder )
+{
   //DEBUG_UPDATE( "looking for messages for client %lu", clientID );
   char* messageIn = AsyncIPNetwork.ReadMessage( clientID );
+  // All queued packets acknowledgements are consumed, so that they do not hold the following messages back
+  while( messageIn != NULL && (uint8_t) messageIn[ 0 ] == AXIS_PACKETS_ACKNOWLEDGE_REQUEST )
+  {
+    // Little endian frame number, as in packets
+    const uint8_t* frameData = (const uint8_t*) ( messageIn + 1 );
+    uint32_t frameNumber = frameData[ 0 ] | ( frameData[ 1 ] << 8 ) | ( frameData[ 2 ] << 16 ) | ( (uint32_t) frameData[ 3 ] << 24 );
+    AxisPackets.Acknowledge( *ref_coder, frameNumber );
+    messageIn = AsyncIPNetwork.ReadMessage( clientID );
+  }
+  
   if( messageIn != NULL ) 
   {
     /*DEBUG_UPDATE*/DEBUG_PRINT( "received input message: %s", messageIn );
     
+    if( (uint8_t) messageIn[ 0 ] == SHM_AXIS_PROBE_REQUEST )
+    {
+      ReplyLatencyProbe( clientID, messageIn );
+      return;
+    }
+    else if( (uint8_t) messageIn[ 0 ] == AXIS_PACKETS_SUBSCRIBE_REQUEST )
+    {
+      UpdateClientSubscription( clientID, messageIn, ref_coder );
+      return;
+    }
+    
+    SHMControlLayout axesLayout = { 0 };
+    SHMControl.GetLayout( sharedRobotAxesData, &axesLayout );
+    
     uint8_t setpointBlocksNumber = (uint8_t) *(messageIn++);
     for( uint8_t setpointBlockIndex = 0; setpointBlockIndex < setpointBlocksNumber; setpointBlockIndex++ )
     {
       uint8_t axisIndex = (uint8_t) *(messageIn++);
       uint8_t axisMask = (uint8_t) *(messageIn++);
       
-      if( kv_a( unsigned long, axisNetworkControllersList, axisIndex ) == IP_CONNECTION_INVALID_ID )
+      if( axisIndex >= axesLayout.blocksNumber ) 
+      {
+        messageIn += AXIS_DATA_BLOCK_SIZE;
+        continue;
+      }
+      
+      // Axes not seen before have no controller yet
+      while( kv_size( axisNetworkControllersList ) <= axisIndex ) 
+        kv_push( unsigned long, axisNetworkControllersList, IP_CONNECTION_INVALID_ID );
+      
+      if( kv_A( axisNetworkControllersList, axisIndex ) == (unsigned long) IP_CONNECTION_INVALID_ID )
       {
         DEBUG_PRINT( "new client for axis %u: %lu", axisIndex, clientID );
         kv_A( axisNetworkControllersList, axisIndex ) = clientID;
       }
-      else if( kv_A( axisNetworkControllersList, axisIndex ) != clientID ) continue;
+      else if( kv_A( axisNetworkControllersList, axisIndex ) != clientID ) 
+      {
+        messageIn += AXIS_DATA_BLOCK_SIZE;
+        continue;
+      }
       
       DEBUG_UPDATE( "receiving axis %u setpoints (mask: %x)", axisIndex, axisMask );
-      SHMControl.SetControlByte( sharedRobotAxesData, axisIndex, axisMask );
+      // Mask goes last: control process only reads the block after seeing it
       SHMControl.SetData( sharedRobotAxesData, messageIn, axisIndex * AXIS_DATA_BLOCK_SIZE, AXIS_DATA_BLOCK_SIZE );
+      SHMControl.SetControlByte( sharedRobotAxesData, axisIndex, axisMask );
+      hasControlUpdate = true;
       
       messageIn += AXIS_DATA_BLOCK_SIZE;
     }
   }
+}
+
+// Published messages: update sequence number (4 bytes), axes number, followed by each axis index and measures. 
+// Axes that do not fit a message go in the next ones, with the same sequence number. Nothing is published 
+// if the control process did not write measures since the last update. Measures are copied (and their version 
+// checked) before publishing, so a sequence number never covers torn blocks
+static void PublishAxesMeasures( void )
+{
+  const int MAX_COPY_ATTEMPTS = 3;
+  const size_t SEQUENCE_LENGTH = sizeof(uint32_t);
+  const size_t MESSAGE_AXES_NUMBER = ( IP_MAX_MESSAGE_LENGTH - SEQUENCE_LENGTH - 1 ) / ( AXIS_DATA_BLOCK_SIZE + 1 );
+  
+  static uint32_t publishedVersion = 0;
+  static uint32_t sequenceNumber = 0;
+  
+  static uint8_t blocksData[ AXIS_DATA_BLOCKS_NUMBER * AXIS_DATA_BLOCK_SIZE ];
+  static uint8_t headerData[ sizeof(uint32_t) + 1 + AXIS_DATA_BLOCKS_NUMBER ];
+  static IPMessagePart partsList[ IP_MAX_MESSAGE_PARTS - 1 ];
+  
+  if( axisPublisherConnectionID == (unsigned long) IP_CONNECTION_INVALID_ID ) return;
   
-  memset( messageOut, 0, IP_MAX_MESSAGE_LENGTH * sizeof(char) );
-  size_t axisdataOffset = 1;
-  for( size_t axisIndex = 0; axisIndex < kv_size( axisNetworkControllersList ); axisIndex++ )
+  // Number of shared axes is published by control along with the robots list
+  size_t axesNumber = (size_t) GetRobotsInfoByte( SHM_ROBOT_INFO_AXES_NUMBER );
+  if( axesNumber > AXIS_DATA_BLOCKS_NUMBER ) axesNumber = AXIS_DATA_BLOCKS_NUMBER;
+  if( axesNumber == 0 ) return;
+  
+  bool hasCopy = false;
+  uint32_t dataVersion;
+  for( int attemptIndex = 0; attemptIndex < MAX_COPY_ATTEMPTS && ! hasCopy; attemptIndex++ )
   {
-    if( kv_A( axisNetworkControllersList, axisIndex ) == clientID )
-    {
-      messageOut[ 0 ]++;
-      messageOut[ axisdataOffset++ ] = (uint8_t) axisIndex;
+    const uint8_t* sharedBlocksData = (const uint8_t*) SHMControl.GetDataReference( sharedRobotAxesData, 0, axesNumber * AXIS_DATA_BLOCK_SIZE, &dataVersion );
+    if( sharedBlocksData == NULL ) return;
     
-      SHMControl.GetData( sharedRobotAxesData, messageOut + axisdataOffset, axisIndex * AXIS_DATA_BLOCK_SIZE, AXIS_DATA_BLOCK_SIZE );
-      axisdataOffset += AXIS_DATA_BLOCK_SIZE;
+    if( dataVersion == publishedVersion ) return;
     
-      DEBUG_PRINT( "sending measures list to axis %lu", axisIndex );
-    }
+    memcpy( blocksData, sharedBlocksData, axesNumber * AXIS_DATA_BLOCK_SIZE );
+    hasCopy = SHMControl.CheckDataVersion( sharedRobotAxesData, dataVersion );
   }
+  // Control keeps writing: measures are published on a later update
+  if( ! hasCopy ) return;
   
-  if( messageOut[ 0 ] > 0 ) 
+  publishedVersion = dataVersion;
+  sequenceNumber++;
+  
+  memcpy( headerData, &sequenceNumber, SEQUENCE_LENGTH );
+  for( size_t firstAxisIndex = 0; firstAxisIndex < axesNumber; firstAxisIndex += MESSAGE_AXES_NUMBER )
   {
-    DEBUG_UPDATE( "sending message %s to client %d (%u axes)", messageOut, clientID, messageOut[ 0 ] );
-    AsyncIPNetwork.WriteMessage( clientID, messageOut );
+    size_t messageAxesNumber = axesNumber - firstAxisIndex;
+    if( messageAxesNumber > MESSAGE_AXES_NUMBER ) messageAxesNumber = MESSAGE_AXES_NUMBER;
+    
+    headerData[ SEQUENCE_LENGTH ] = (uint8_t) messageAxesNumber;
+    partsList[ 0 ] = (IPMessagePart) { .data = headerData, .length = SEQUENCE_LENGTH + 1 };
+    size_t partsNumber = 1;
+    for( size_t axisIndex = firstAxisIndex; axisIndex < firstAxisIndex + messageAxesNumber; axisIndex++ )
+    {
+      headerData[ SEQUENCE_LENGTH + 1 + axisIndex ] = (uint8_t) axisIndex;
+      partsList[ partsNumber++ ] = (IPMessagePart) { .data = &(headerData[ SEQUENCE_LENGTH + 1 + axisIndex ]), .length = 1 };
+      partsList[ partsNumber++ ] = (IPMessagePart) { .data = blocksData + axisIndex * AXIS_DATA_BLOCK_SIZE, .length = AXIS_DATA_BLOCK_SIZE };
+    }
+    
+    AsyncIPNetwork.WriteMessageParts( axisPublisherConnectionID, partsList, partsNumber );
   }
 }
 
-
-static void UpdateClientJoint( unsigned long clientID )
+// Samples messages: records number, followed by the records (as stored in the rings). Robots rings are read
+// in batches of a message, until empty, so all samples of the last update interval are sent at once
+static void UpdateSamples( void )
 {
+  const size_t MESSAGE_SAMPLES_NUMBER = ( IP_MAX_MESSAGE_LENGTH - 1 ) / sizeof(SHMAxisSample);
+  
   static char messageOut[ IP_MAX_MESSAGE_LENGTH ];
   
-  memset( messageOut, 0, IP_MAX_MESSAGE_LENGTH * sizeof(char) );
-  size_t jointDataOffset = 1;
-  for( size_t jointIndex = 0; jointIndex < kv_size( jointNetworkControllersList ); jointIndex++ )
+  // Number of shared robots is published by control along with the robots list
+  size_t robotsNumber = (size_t) GetRobotsInfoByte( SHM_ROBOT_INFO_ROBOTS_NUMBER );
+  while( kv_size( samplesRingsList ) < robotsNumber )
   {
-    if( kv_A( jointNetworkControllersList, jointIndex ) == clientID )
-    {
-      messageOut[ 0 ]++;
-      messageOut[ jointDataOffset++ ] = (uint8_t) jointIndex;
-    
-      SHMControl.GetData( sharedRobotJointsData, messageOut + jointDataOffset, jointIndex * JOINT_DATA_BLOCK_SIZE, JOINT_DATA_BLOCK_SIZE );
-      jointDataOffset += JOINT_DATA_BLOCK_SIZE;
-    }
+    char ringName[ SHARED_VARIABLE_NAME_MAX_LENGTH ];
+    sprintf( ringName, ROBOT_SAMPLES_RING_NAME, kv_size( samplesRingsList ) );
+    SHMRing samplesRing = SHMRings.InitRing( ringName, ROBOT_SAMPLES_RING_SIZE, sizeof(SHMAxisSample) );
+    if( samplesRing == NULL ) break;
+    kv_push( SHMRing, samplesRingsList, samplesRing );
+    kv_push( uint64_t, samplesOverflowsList, 0 );
   }
   
-  if( messageOut[ 0 ] > 0 ) 
+  for( size_t ringIndex = 0; ringIndex < kv_size( samplesRingsList ); ringIndex++ )
   {
-    DEBUG_UPDATE( "sending message %s to client %d (%u joints)", messageOut, clientID, messageOut[ 0 ] );
-    AsyncIPNetwork.WriteMessage( clientID, messageOut );
+    SHMRing samplesRing = kv_A( samplesRingsList, ringIndex );
+    
+    size_t samplesNumber;
+    while( (samplesNumber = SHMRings.ReadRecords( samplesRing, messageOut + 1, MESSAGE_SAMPLES_NUMBER )) > 0 )
+    {
+      messageOut[ 0 ] = (char) samplesNumber;
+      for( size_t clientIndex = 0; clientIndex < kv_size( samplesClientsList ); clientIndex++ )
+        AsyncIPNetwork.WriteMessage( kv_A( samplesClientsList, clientIndex ), messageOut, 1 + samplesNumber * sizeof(SHMAxisSample) );
+    }
+    
+    uint64_t overflowsCount = SHMRings.GetOverflowsCount( samplesRing );
+    if( overflowsCount != kv_A( samplesOverflowsList, ringIndex ) )
+    {
+      ERROR_PRINT( "robot %lu samples ring overflowed (%lu samples lost)", ringIndex, overflowsCount - kv_A( samplesOverflowsList, ringIndex ) );
+      kv_A( samplesOverflowsList, ringIndex ) = overflowsCount;
+    }
   }
 }
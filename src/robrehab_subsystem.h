@@ -6,6 +6,12 @@
 
 extern const unsigned long UPDATE_INTERVAL_MS;
 
+// Named events that wake up each process update loop, when running event driven (UPDATE_INTERVAL_MS becomes a fallback timeout)
+#define CONTROL_UPDATE_EVENT_NAME "robrehab_control_update"
+#define NETWORK_UPDATE_EVENT_NAME "robrehab_network_update"
+
+extern const char* UPDATE_EVENT_NAME;
+
 #define ROBREHAB_SUBSYSTEM_INTERFACE( Namespace, INIT_FUNCTION ) \
         INIT_FUNCTION( int, Namespace, Init, const char*, const char*, const char* ) \
         INIT_FUNCTION( void, Namespace, End, void ) \
@@ -28,8 +28,19 @@
 #include <stdbool.h>
 #include <time.h>
 #include <signal.h>
+#include <string.h>
+
+#ifdef __unix__
+  #include <sys/mman.h>
+  #ifdef __GLIBC__
+    #include <malloc.h>
+  #endif
+#endif
 
 #include "debug/async_debug.h"
+#include "threads/threading.h"
+#include "time/timing.h"
+#include "shared_memory/shared_memory.h"
 
 #include "robrehab_subsystem.h"
 
@@ -48,11 +59,48 @@ void HandleError( int signal )
   exit( EXIT_FAILURE );
 }
 
+// Heap area touched at startup, so that later allocations reuse already mapped pages
+#define HEAP_PREFAULT_SIZE ( 32 * 1024 * 1024 )
+
+// Avoid page faults on the control path: lock current and future pages in RAM and keep freed heap memory mapped
+bool LockMemory()
+{
+#ifdef __unix__
+  if( mlockall( MCL_CURRENT | MCL_FUTURE ) == -1 )
+  {
+    ERROR_PRINT( "mlockall: failed locking process memory (flags: %x)", MCL_CURRENT | MCL_FUTURE );
+    return false;
+  }
+  
+  #ifdef __GLIBC__
+  mallopt( M_TRIM_THRESHOLD, -1 ); // Never return freed memory to the system
+  mallopt( M_MMAP_MAX, 0 );        // Serve big allocations from the (locked) heap, not from new mappings
+  #endif
+  
+  char* heapBuffer = (char*) malloc( HEAP_PREFAULT_SIZE );
+  if( heapBuffer != NULL )
+  {
+    memset( heapBuffer, 0, HEAP_PREFAULT_SIZE );
+    free( heapBuffer );
+  }
+  
+  DEBUG_PRINT( "process memory locked (%d bytes of heap pre-faulted)", HEAP_PREFAULT_SIZE );
+  
+  return true;
+#else
+  DEBUG_PRINT( "%s", "memory locking not supported on this platform" );
+  return false;
+#endif
+}
+
 /* Program entry-point */
 int main( int argc, char* argv[] )
 {
   const struct timespec UPDATE_TIMESPEC = { .tv_nsec = 1000000 * UPDATE_INTERVAL_MS };
   
+  bool isEventDriven = false;
+  uint8_t sharedMemoryOptions = 0;
+  
   time_t rawTime;
   time( &rawTime );
   DEBUG_PRINT( "starting control program at time: %s", ctime( &rawTime ) );
@@ -62,16 +110,34 @@ int main( int argc, char* argv[] )
   signal( SIGINT, HandleExit );   // Handle Keyboard Interruption (Crtl^C)
   signal( SIGSEGV, HandleError ); // Try to prevent not running termination calls on a Segmentation Fault event
   
+  for( int argIndex = 2; argIndex < argc; argIndex++ )
+  {
+    if( strcmp( argv[ argIndex ], "--lock-memory" ) == 0 ) (void) LockMemory();
+    else if( strcmp( argv[ argIndex ], "--event-driven" ) == 0 ) isEventDriven = true;
+    else if( strcmp( argv[ argIndex ], "--shm-hugepages" ) == 0 ) sharedMemoryOptions |= SHM_OPTION_HUGE_PAGES;
+    else if( strcmp( argv[ argIndex ], "--shm-prefault" ) == 0 ) sharedMemoryOptions |= SHM_OPTION_PREFAULT;
+  }
+  
+  SharedObjects.SetMappingOptions( sharedMemoryOptions );
+  // Time source is set up before any subsystem thread reads it
+  Timing.Init();
+  
   if( argc > 1 )
   {
     if( SubSystem.Init( argv[ 1 ], NULL, NULL ) != -1 )
     {
+      // Event driven loop updates as soon as there is new data, and at least once per update interval
+      WakeEvent updateEvent = isEventDriven ? WakeEvents.Create( UPDATE_EVENT_NAME ) : NULL;
+      
       while( isRunning ) // Check for program termination conditions
       {
         SubSystem.Update();
       
-        nanosleep( &UPDATE_TIMESPEC, NULL ); // Sleep to give the desired loop rate.
+        if( updateEvent != NULL ) (void) WakeEvents.Wait( updateEvent, 1000000ULL * UPDATE_INTERVAL_MS );
+        else nanosleep( &UPDATE_TIMESPEC, NULL ); // Sleep to give the desired loop rate.
       }
+      
+      WakeEvents.Discard( updateEvent );
     }
   }
   
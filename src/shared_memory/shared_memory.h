@@ -12,10 +12,16 @@
 
 #define SHARED_OBJECT_PATH_MAX_LENGTH 256
 
+// Mapping options (bitfield)
+#define SHM_OPTION_HUGE_PAGES 0x01
+#define SHM_OPTION_PREFAULT 0x02
+
 /// Functions declaration macro   
 #define SHARED_MEMORY_INTERFACE( Namespace, INIT_FUNCTION )                        \
         INIT_FUNCTION( void*, Namespace, CreateObject, const char*, size_t, uint8_t )  \
-        INIT_FUNCTION( void, Namespace, DestroyObject, void* )
+        INIT_FUNCTION( void, Namespace, DestroyObject, void* )                         \
+        INIT_FUNCTION( bool, Namespace, RemoveObject, const char* )                    \
+        INIT_FUNCTION( void, Namespace, SetMappingOptions, uint8_t )
 
 DECLARE_NAMESPACE_INTERFACE( SharedObjects, SHARED_MEMORY_INTERFACE )
 
@@ -33,4 +39,15 @@ DECLARE_NAMESPACE_INTERFACE( SharedObjects, SHARED_MEMORY_INTERFACE )
 /// Discards shared memory area and remove its pointer from the hash table                              
 /// @param sharedObject pointer to the shared memory area                                               
 
+/// @fn RemoveObject
+/// Removes the shared memory area name, so that areas created afterwards with it are new (and of the requested size).
+/// Already created areas stay valid until destroyed
+/// @param mappingName name of the shared memory area (mapped file)
+/// @return true if removed (or not existing), false if names are not removable where not supported
+
+/// @fn SetMappingOptions
+/// Sets how shared memory areas created afterwards are mapped (ignored where not supported)
+/// @param options bitfield of SHM_OPTION_HUGE_PAGES (back area with huge pages, falling back to normal ones)
+/// and SHM_OPTION_PREFAULT (populate and lock area pages on creation, avoiding page faults when accessed)
+
 #endif // SHARED_MEMORY_H
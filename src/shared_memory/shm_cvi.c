@@ -156,6 +156,18 @@ void SharedObjects_DestroyObject( void* sharedObjectData )
   }
 }
 
+// Network variables are kept by the variable engine
+bool SharedObjects_RemoveObject( const char* mappingName )
+{
+  return false;
+}
+
+// Network variables have no mapping options
+void SharedObjects_SetMappingOptions( uint8_t options )
+{
+  return;
+}
+
 
 void CVICALLBACK UpdateDataIn( void* handle, CNVData data, void* callbackData )
 {
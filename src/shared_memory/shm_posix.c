@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (c) 2016 Leonardo José Consoni                                  //
+//                                                                            //
+//  This file is part of RobRehabSystem.                                      //
+//                                                                            //
+//  RobRehabSystem is free software: you can redistribute it and/or modify    //
+//  it under the terms of the GNU Lesser General Public License as published  //
+//  by the Free Software Foundation, either version 3 of the License, or      //
+//  (at your option) any later version.                                       //
+//                                                                            //
+//  RobRehabSystem is distributed in the hope that it will be useful,         //
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of            //
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              //
+//  GNU Lesser General Public License for more details.                       //
+//                                                                            //
+//  You should have received a copy of the GNU Lesser General Public License  //
+//  along with RobRehabSystem. If not, see <http://www.gnu.org/licenses/>.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+/////   Shared memory objects based on POSIX shm_open/mmap (named objects  /////
+/////   unlinked by their last live user, optional huge pages and locking) /////
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/vfs.h>
+
+#include "klib/khash.h"
+
+#include "debug/async_debug.h"
+
+
+#include "shared_memory/shared_memory.h"
+
+// hugetlbfs mount point, for objects backed by huge pages
+#ifndef SHM_HUGE_PAGES_DIRECTORY
+  #define SHM_HUGE_PAGES_DIRECTORY "/dev/hugepages"
+#endif
+// Used if the huge pages file system does not report its page size
+#define HUGE_PAGE_DEFAULT_SIZE ( 2 * 1024 * 1024 )
+
+// Users hold a shared lock on the object file while mapping it, released by the system even if they crash. The one
+// that gets an exclusive lock on destruction is the last live user, and removes the object name
+typedef struct _SharedObjectData
+{
+  char filePath[ SHARED_OBJECT_PATH_MAX_LENGTH ];
+  int fileDescriptor;
+  bool isHugePageBacked;
+  uint8_t options;                                    // Mapping options at creation
+  void* mapping;
+  size_t mappingSize;
+}
+SharedObjectData;
+
+typedef SharedObjectData* SharedObject;
+
+/// A hash table
+/// Stores mappings of the created shared memory areas, indexed by user data address
+KHASH_MAP_INIT_INT64( SOPtr, SharedObject )
+khash_t( SOPtr )* sharedObjectsList = NULL;
+
+static uint8_t mappingOptions = 0;
+
+
+DEFINE_NAMESPACE_INTERFACE( SharedObjects, SHARED_MEMORY_INTERFACE )
+
+
+static inline void RemoveObjectFile( SharedObject object )
+{
+  if( object->isHugePageBacked ) (void) unlink( object->filePath );
+  else (void) shm_unlink( object->filePath );
+}
+
+// Opens a file on the huge pages file system (if mounted) or a regular POSIX shared memory object
+static int OpenObjectFile( SharedObject object, const char* mappingName )
+{
+  int objectFD = -1;
+
+  object->isHugePageBacked = false;
+  if( object->options & SHM_OPTION_HUGE_PAGES )
+  {
+    snprintf( object->filePath, SHARED_OBJECT_PATH_MAX_LENGTH, "%s/%s", SHM_HUGE_PAGES_DIRECTORY, mappingName );
+    objectFD = open( object->filePath, O_CREAT | O_RDWR, 0660 );
+    if( objectFD != -1 ) object->isHugePageBacked = true;
+    else DEBUG_PRINT( "huge pages not available for %s (%s). using normal pages", mappingName, strerror( errno ) );
+  }
+
+  if( objectFD == -1 )
+  {
+    snprintf( object->filePath, SHARED_OBJECT_PATH_MAX_LENGTH, "/%s", mappingName );
+    objectFD = shm_open( object->filePath, O_CREAT | O_RDWR, 0660 );
+  }
+
+  return objectFD;
+}
+
+// Checks if the opened file is still the one named by the object path (not removed by its last user meanwhile)
+static bool IsObjectFileLinked( SharedObject object, int objectFD )
+{
+  struct stat openedStatus, namedStatus;
+  if( fstat( objectFD, &openedStatus ) == -1 ) return false;
+  
+  int namedFD = object->isHugePageBacked ? open( object->filePath, O_RDONLY ) : shm_open( object->filePath, O_RDONLY, 0 );
+  if( namedFD == -1 ) return false;
+  bool isLinked = ( fstat( namedFD, &namedStatus ) == 0 && namedStatus.st_dev == openedStatus.st_dev && namedStatus.st_ino == openedStatus.st_ino );
+  close( namedFD );
+  
+  return isLinked;
+}
+
+static size_t GetObjectPageSize( SharedObject object, int objectFD )
+{
+  if( !object->isHugePageBacked ) return (size_t) sysconf( _SC_PAGESIZE );
+  
+  // Block size of hugetlbfs files is the size of its pages
+  struct statfs fileSystemStatus;
+  if( fstatfs( objectFD, &fileSystemStatus ) == -1 || fileSystemStatus.f_bsize <= 0 ) return HUGE_PAGE_DEFAULT_SIZE;
+  
+  return (size_t) fileSystemStatus.f_bsize;
+}
+
+// Releases an object file that could not be mapped, removing its name if no other user has it
+static void ReleaseObjectFile( SharedObject object, int objectFD )
+{
+  (void) flock( objectFD, LOCK_UN );
+  if( flock( objectFD, LOCK_EX | LOCK_NB ) == 0 && IsObjectFileLinked( object, objectFD ) ) RemoveObjectFile( object );
+  close( objectFD );
+}
+
+// Opens (creating it if needed), locks, sizes and maps the object file. Returns the opened file descriptor (-1 on failure)
+static int MapObjectFile( SharedObject object, const char* mappingName, size_t objectSize )
+{
+  // File may be removed by its last user between opening and locking it: it is then opened (created) again
+  int objectFD = -1;
+  while( objectFD == -1 )
+  {
+    if( (objectFD = OpenObjectFile( object, mappingName )) == -1 )
+    {
+      perror( "Failed to open shared memory object" );
+      return -1;
+    }
+    
+    if( flock( objectFD, LOCK_SH ) == -1 )
+    {
+      perror( "Failed to lock shared memory object" );
+      close( objectFD );
+      return -1;
+    }
+    
+    if( !IsObjectFileLinked( object, objectFD ) )
+    {
+      close( objectFD );
+      objectFD = -1;
+    }
+  }
+
+  DEBUG_PRINT( "opened shared memory object %s", object->filePath );
+
+  // Whole pages are mapped anyway. Rounding keeps the size equal for every process sharing the object
+  size_t pageSize = GetObjectPageSize( object, objectFD );
+  object->mappingSize = ( ( objectSize + pageSize - 1 ) / pageSize ) * pageSize;
+
+  // Objects only grow, so that a process opening it with a smaller size does not cut it for others
+  struct stat objectStatus;
+  if( fstat( objectFD, &objectStatus ) == -1 || (size_t) objectStatus.st_size < object->mappingSize )
+  {
+    if( ftruncate( objectFD, (off_t) object->mappingSize ) == -1 )
+    {
+      perror( "Failed to resize shared memory object" );
+      ReleaseObjectFile( object, objectFD );
+      return -1;
+    }
+  }
+
+  int mappingFlags = MAP_SHARED;
+#ifdef MAP_HUGETLB
+  if( object->isHugePageBacked ) mappingFlags |= MAP_HUGETLB;
+#endif
+#ifdef MAP_POPULATE
+  if( object->options & SHM_OPTION_PREFAULT ) mappingFlags |= MAP_POPULATE;
+#endif
+  object->mapping = mmap( NULL, object->mappingSize, PROT_READ | PROT_WRITE, mappingFlags, objectFD, 0 );
+  if( object->mapping == MAP_FAILED )
+  {
+    perror( "Failed to map shared memory object" );
+    ReleaseObjectFile( object, objectFD );
+    return -1;
+  }
+  
+  return objectFD;
+}
+
+void* SharedObjects_CreateObject( const char* mappingName, size_t objectSize, uint8_t flags )
+{
+  SharedObject newObject = (SharedObject) malloc( sizeof(SharedObjectData) );
+  memset( newObject, 0, sizeof(SharedObjectData) );
+  newObject->options = mappingOptions;
+
+  int objectFD = MapObjectFile( newObject, mappingName, objectSize );
+  // Huge pages are best effort: none may be reserved (or left) for the object
+  if( objectFD == -1 && newObject->isHugePageBacked )
+  {
+    DEBUG_PRINT( "huge pages mapping failed for %s. using normal pages", mappingName );
+    newObject->options &= ~SHM_OPTION_HUGE_PAGES;
+    objectFD = MapObjectFile( newObject, mappingName, objectSize );
+  }
+  if( objectFD == -1 )
+  {
+    free( newObject );
+    return (void*) -1;
+  }
+  
+  // Kept open (and locked) while mapped
+  newObject->fileDescriptor = objectFD;
+
+  // Avoid first touch page faults on the control path
+  if( newObject->options & SHM_OPTION_PREFAULT )
+  {
+    if( mlock( newObject->mapping, newObject->mappingSize ) == -1 ) perror( "Failed to lock shared memory object" );
+  }
+
+  void* newSharedObject = newObject->mapping;
+
+  DEBUG_PRINT( "Binded object address %p to shared memory object (%lu bytes)", newSharedObject, newObject->mappingSize );
+
+  if( sharedObjectsList == NULL ) sharedObjectsList = kh_init( SOPtr );
+
+  int insertionStatus;
+  khint_t newSharedObjectID = kh_put( SOPtr, sharedObjectsList, (khint64_t) (uintptr_t) newSharedObject, &insertionStatus );
+  kh_value( sharedObjectsList, newSharedObjectID ) = newObject;
+
+  return newSharedObject;
+}
+
+// The object name is removed when its last live user (in any process) destroys it. Users that ended without 
+// destroying it (e.g. crashed) do not count, as their file locks are released by the system
+void SharedObjects_DestroyObject( void* sharedObject )
+{
+  if( sharedObjectsList == NULL ) return;
+
+  khint_t sharedObjectID = kh_get( SOPtr, sharedObjectsList, (khint64_t) (uintptr_t) sharedObject );
+  if( sharedObjectID == kh_end( sharedObjectsList ) ) return;
+
+  SharedObject object = kh_value( sharedObjectsList, sharedObjectID );
+
+  if( object->options & SHM_OPTION_PREFAULT ) munlock( object->mapping, object->mappingSize );
+  munmap( object->mapping, object->mappingSize );
+  
+  // Shared lock is dropped before trying the exclusive one, so that concurrent last users do not block each other out.
+  // The name is only removed if it still refers to this file (not already recreated by a new user)
+  (void) flock( object->fileDescriptor, LOCK_UN );
+  if( flock( object->fileDescriptor, LOCK_EX | LOCK_NB ) == 0 && IsObjectFileLinked( object, object->fileDescriptor ) )
+  {
+    DEBUG_PRINT( "removing shared memory object %s", object->filePath );
+    RemoveObjectFile( object );
+  }
+  close( object->fileDescriptor );
+  
+  free( object );
+
+  kh_del( SOPtr, sharedObjectsList, sharedObjectID );
+
+  if( kh_size( sharedObjectsList ) == 0 )
+  {
+    kh_destroy( SOPtr, sharedObjectsList );
+    sharedObjectsList = NULL;
+  }
+}
+
+// Removes the name on both possible backings (huge pages file system and regular POSIX shared memory)
+bool SharedObjects_RemoveObject( const char* mappingName )
+{
+  char objectPath[ SHARED_OBJECT_PATH_MAX_LENGTH ];
+  
+  snprintf( objectPath, SHARED_OBJECT_PATH_MAX_LENGTH, "%s/%s", SHM_HUGE_PAGES_DIRECTORY, mappingName );
+  if( unlink( objectPath ) == -1 && errno != ENOENT ) return false;
+  
+  snprintf( objectPath, SHARED_OBJECT_PATH_MAX_LENGTH, "/%s", mappingName );
+  if( shm_unlink( objectPath ) == -1 && errno != ENOENT ) return false;
+  
+  DEBUG_PRINT( "removed shared memory object %s", mappingName );
+  
+  return true;
+}
+
+void SharedObjects_SetMappingOptions( uint8_t options )
+{
+  mappingOptions = options;
+}
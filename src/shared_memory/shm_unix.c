@@ -3,6 +3,7 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
+#include <errno.h>
 
 #include "klib/khash.h"
 
@@ -15,6 +16,8 @@
 KHASH_MAP_INIT_STR( SOStr, void* )
 khash_t( SOStr )* sharedObjectsList = NULL;
 
+static uint8_t mappingOptions = 0;
+
 
 DEFINE_NAMESPACE_INTERFACE( SharedObjects, SHARED_MEMORY_INTERFACE )
 
@@ -51,7 +54,16 @@ void* SharedObjects_CreateObject( const char* mappingName , size_t objectSize, u
   int accessFlags = 0;
   if( flags & SHM_READ ) accessFlags |= S_IRUSR;
   if( flags & SHM_WRITE ) accessFlags |= S_IWUSR;
-  int sharedMemoryID = shmget( sharedKey, objectSize, IPC_CREAT | /*accessFlags*/ 0660 );
+  int sharedMemoryFlags = IPC_CREAT | /*accessFlags*/ 0660;
+#ifdef SHM_HUGETLB
+  if( mappingOptions & SHM_OPTION_HUGE_PAGES ) sharedMemoryFlags |= SHM_HUGETLB;
+#endif
+  int sharedMemoryID = shmget( sharedKey, objectSize, sharedMemoryFlags );
+  if( sharedMemoryID == -1 && ( sharedMemoryFlags & ~( IPC_CREAT | 0660 ) ) )
+  {
+    perror( "Failed to create huge pages shared memory segment. using normal pages" );
+    sharedMemoryID = shmget( sharedKey, objectSize, IPC_CREAT | 0660 );
+  }
   if( sharedMemoryID == -1 )
   {
     perror( "Failed to create shared memory segment" );
@@ -70,6 +82,12 @@ void* SharedObjects_CreateObject( const char* mappingName , size_t objectSize, u
   
   DEBUG_PRINT( "Binded object address %p to shared memory area", newSharedObject );
   
+  // Avoid first touch page faults on the control path
+  if( mappingOptions & SHM_OPTION_PREFAULT )
+  {
+    if( mlock( newSharedObject, objectSize ) == -1 ) perror( "Failed to lock shared memory area" );
+  }
+  
   // 
   if( sharedObjectsList == NULL ) sharedObjectsList = kh_init( SOStr );
   
@@ -103,3 +121,33 @@ void SharedObjects_DestroyObject( void* sharedObject )
     }
   }
 }
+
+// Segment is marked for removal (freed when its last process detaches) and its key released for new segments.
+// Required before creating a bigger one, as shmget fails for sizes above the one of the existing segment
+bool SharedObjects_RemoveObject( const char* mappingName )
+{
+  char mappingFilePath[ SHARED_OBJECT_PATH_MAX_LENGTH ];
+  
+  sprintf( mappingFilePath, "/dev/shm/%s", mappingName );
+  
+  key_t sharedKey = ftok( mappingFilePath, 1 );
+  if( sharedKey == -1 ) return ( errno == ENOENT );
+  
+  int sharedMemoryID = shmget( sharedKey, 0, 0 );
+  if( sharedMemoryID == -1 ) return ( errno == ENOENT );
+  
+  if( shmctl( sharedMemoryID, IPC_RMID, NULL ) == -1 )
+  {
+    perror( "Failed to remove shared memory segment" );
+    return false;
+  }
+  
+  DEBUG_PRINT( "removed shared memory segment %d (%s)", sharedMemoryID, mappingFilePath );
+  
+  return true;
+}
+
+void SharedObjects_SetMappingOptions( uint8_t options )
+{
+  mappingOptions = options;
+}
@@ -38,6 +38,8 @@ SharedObject;
 KHASH_MAP_INIT_STR( SO, SharedObject )
 khash_t( SO )* sharedObjectsList = NULL;
 
+static uint8_t mappingOptions = 0;
+
 
 DEFINE_NAMESPACE_INTERFACE( SharedObjects, SHARED_MEMORY_INTERFACE )
 
@@ -65,6 +67,12 @@ void* SharedObjects_CreateObject( const char* mappingName, size_t objectSize, ui
   kh_value( sharedObjectsList, newSharedMemoryID ).handle = mappedFile;
   kh_value( sharedObjectsList, newSharedMemoryID ).data = MapViewOfFile( mappedFile, flags, 0, 0, 0 );
   
+  // Large pages would require SEC_LARGE_PAGES and the lock pages privilege: only locking is supported
+  if( mappingOptions & SHM_OPTION_PREFAULT )
+  {
+    if( !VirtualLock( kh_value( sharedObjectsList, newSharedMemoryID ).data, objectSize ) ) DEBUG_PRINT( "failed to lock shared memory area %s", mappingName );
+  }
+  
   return kh_value( sharedObjectsList, newSharedMemoryID ).data;
 }
 
@@ -90,3 +98,19 @@ void SharedObjects_DestroyObject( void* sharedObjectData )
     }
   }
 }
+
+// File mappings only go away when their last handle is closed: names of open ones can't be removed
+bool SharedObjects_RemoveObject( const char* mappingName )
+{
+  HANDLE mappedFile = OpenFileMapping( FILE_MAP_READ, FALSE, mappingName );
+  if( mappedFile == NULL ) return true;
+  
+  CloseHandle( mappedFile );
+  
+  return false;
+}
+
+void SharedObjects_SetMappingOptions( uint8_t options )
+{
+  mappingOptions = options;
+}
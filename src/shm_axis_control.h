@@ -1,9 +1,29 @@
 #ifndef SHM_AXIS_CONTROL_H
 #define SHM_AXIS_CONTROL_H
 
+#include <stdint.h>
+
 enum { SHM_AXIS_POSITION, SHM_AXIS_VELOCITY, SHM_AXIS_ACCELERATION, SHM_AXIS_FORCE, 
        SHM_AXIS_STIFFNESS, SHM_AXIS_DAMPING, SHM_AXIS_TIME, SHM_AXIS_FLOATS_NUMBER };
 
-#define AXIS_DATA_BLOCK_SIZE SHM_AXIS_FLOATS_NUMBER * sizeof(float)
+// Axis block, as shared and sent over the network (native byte order, no padding). Times are in nanoseconds of the 
+// monotonic clock (system wide). SHM_AXIS_TIME value holds the measures capture time in seconds, for plotting only
+typedef struct _SHMAxisBlock
+{
+  float valuesList[ SHM_AXIS_FLOATS_NUMBER ];
+  uint32_t setpointsTag;      // Setpoints: client tag (e.g. message count). Measures: tag of the last setpoints applied
+  uint64_t timestamp;         // Setpoints: client sending time (client clock). Measures: sensors capture time
+  uint64_t actuationTime;     // Measures: motors write time of the pass that applied the last tagged setpoints
+  uint64_t sequenceNumber;    // Measures: control passes count of the axis robot (reveals lost, repeated or reordered updates)
+}
+SHMAxisBlock;
+
+#define AXIS_DATA_BLOCK_SIZE sizeof(SHMAxisBlock)
+// Axes channel capacity (one block, with a mask bit per value, for each shared axis)
+#define AXIS_DATA_BLOCKS_NUMBER 64
+
+// Axis message blocks number value reserved for latency probes. Request: code and client time (8 bytes). Reply: 
+// code, client time, server receive time and server send time (8 bytes each)
+#define SHM_AXIS_PROBE_REQUEST 0xFF
 
 #endif // SHM_AXIS_CONTROL_H
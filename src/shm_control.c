@@ -26,13 +26,42 @@
 #include "debug/async_debug.h"
 
 #include "shared_memory/shared_memory.h"
+#include "threads/atomic_operations.h"
+#include "time/timing.h"
 
 #include "shm_control.h"
 
+// Shared segment: header (layout and data version), followed by mask bytes and data blocks
+#define LAYOUT_UNSET 0
+#define LAYOUT_WRITING 1
+#define LAYOUT_REPLACED 2   // Set by the owner on segments it replaces, for peers still mapping them
+#define LAYOUT_READY 0x52524354524C3031 // "RRCTRL01"
+
+// Layouts still being written after this are from processes that ended midway (stale segments)
+#define LAYOUT_WRITE_TIMEOUT_MS 1000
+
+// Segments replaced on opening: stale ones, also incompatible ones for their owner, and none once already replaced
+enum ChannelOpenModes { CHANNEL_OPEN_SHARED, CHANNEL_OPEN_OWNED, CHANNEL_OPEN_REPLACED };
+
+// Data is versioned with a sequence lock: the (single) writer makes the counter odd while copying and even when done,
+// and readers retry until they copy between two equal even counts. Mask bytes are read and written atomically
+typedef struct _ControlChannelHeader
+{
+  uint64_t layoutStatus;
+  uint32_t blocksNumber;
+  uint32_t blockSize;
+  uint32_t maskBitsNumber;
+  uint32_t dataSequence;
+}
+ControlChannelHeader;
+
 typedef struct _ControlChannelData
 {
-  uint8_t dataMask[ SHM_CONTROL_MASK_SIZE ];
-  uint8_t data[ SHM_CONTROL_MAX_DATA_SIZE ];
+  ControlChannelHeader* header;
+  uint8_t* dataMask;
+  uint8_t* data;
+  char name[ SHARED_VARIABLE_NAME_MAX_LENGTH ];
+  uint8_t flags;
 }
 ControlChannelData;
 
@@ -40,17 +69,143 @@ typedef ControlChannelData* ControlChannel;
 
 struct _SHMControlData
 {
-  ControlChannel channelIn;
-  ControlChannel channelOut;
+  ControlChannelData channelIn;
+  ControlChannelData channelOut;
+  SHMControlLayout layout;
 };
 
 
 DEFINE_NAMESPACE_INTERFACE( SHMControl, SHM_CONTROL_INTERFACE )
 
 
+static void SetLayout( SHMControlLayout* layout, size_t blocksNumber, size_t blockSize, size_t maskBitsNumber )
+{
+  layout->blocksNumber = blocksNumber;
+  layout->blockSize = blockSize;
+  layout->maskBitsNumber = maskBitsNumber;
+  layout->maskSize = blocksNumber * ( ( maskBitsNumber + 7 ) / 8 );
+  layout->dataSize = blocksNumber * blockSize;
+}
+
+static inline size_t GetChannelSize( SHMControlLayout* layout )
+{
+  return sizeof(ControlChannelHeader) + layout->maskSize + layout->dataSize;
+}
+
+// Waits for other process writing the layout. Returns the final status (still LAYOUT_WRITING on timeout)
+static uint64_t WaitLayout( uint64_t* ref_layoutStatus )
+{
+  unsigned long waitStartTime = Timing.GetExecTimeMilliseconds();
+  
+  uint64_t layoutStatus;
+  while( ( layoutStatus = ATOMIC_LOAD( ref_layoutStatus ) ) == LAYOUT_WRITING )
+  {
+    if( Timing.GetExecTimeMilliseconds() - waitStartTime > LAYOUT_WRITE_TIMEOUT_MS ) break;
+    Timing.Delay( 1 );
+  }
+  
+  return layoutStatus;
+}
+
+static inline bool IsLayoutCompatible( ControlChannelHeader* header, SHMControlLayout* layout )
+{
+  return ( header->blockSize == layout->blockSize && header->maskBitsNumber == layout->maskBitsNumber && header->blocksNumber >= layout->blocksNumber );
+}
+
+// Maps the channel segment, writing the layout if first to open it or checking (and adopting) the stored one otherwise
+static bool OpenChannel( ControlChannel channel, const char* channelName, SHMControlLayout* layout, uint8_t flags, enum ChannelOpenModes openMode )
+{
+  ControlChannelHeader* header = (ControlChannelHeader*) SharedObjects.CreateObject( channelName, GetChannelSize( layout ), flags );
+  // Existing segment may be too small for the required layout (System V ones can't grow)
+  if( header == (void*) -1 && openMode == CHANNEL_OPEN_OWNED && SharedObjects.RemoveObject( channelName ) )
+    header = (ControlChannelHeader*) SharedObjects.CreateObject( channelName, GetChannelSize( layout ), flags );
+  if( header == (void*) -1 ) return false;
+  
+  uint64_t layoutStatus = LAYOUT_UNSET;
+  if( ATOMIC_COMPARE_EXCHANGE( &(header->layoutStatus), &layoutStatus, LAYOUT_WRITING ) )
+  {
+    header->blocksNumber = (uint32_t) layout->blocksNumber;
+    header->blockSize = (uint32_t) layout->blockSize;
+    header->maskBitsNumber = (uint32_t) layout->maskBitsNumber;
+    ATOMIC_STORE( &(header->layoutStatus), LAYOUT_READY );
+    DEBUG_PRINT( "%s layout set: %u blocks of %u bytes (%u mask bits)", channelName, header->blocksNumber, header->blockSize, header->maskBitsNumber );
+  }
+  else
+  {
+    layoutStatus = WaitLayout( &(header->layoutStatus) );
+    
+    // Segment just replaced by its owner, that is about to remove its name: open the new one
+    if( layoutStatus == LAYOUT_REPLACED && openMode != CHANNEL_OPEN_REPLACED )
+    {
+      SharedObjects.DestroyObject( (void*) header );
+      Timing.Delay( 1 );
+      return OpenChannel( channel, channelName, layout, flags, CHANNEL_OPEN_REPLACED );
+    }
+    
+    bool isStale = ( layoutStatus != LAYOUT_READY );
+    if( isStale || ! IsLayoutCompatible( header, layout ) )
+    {
+      if( isStale ) ERROR_PRINT( "%s layout not written after %u ms: stale segment", channelName, LAYOUT_WRITE_TIMEOUT_MS );
+      else ERROR_PRINT( "%s layout mismatch: %u blocks of %u bytes (%u mask bits) stored, %lu blocks of %lu bytes (%lu mask bits) required", 
+                        channelName, header->blocksNumber, header->blockSize, header->maskBitsNumber, layout->blocksNumber, layout->blockSize, layout->maskBitsNumber );
+      
+      bool isReplacing = ( openMode != CHANNEL_OPEN_REPLACED && ( isStale || openMode == CHANNEL_OPEN_OWNED ) );
+      // Peers mapping a compatible layout for them find it retired on their next access, and remap the name
+      if( isReplacing && ! isStale ) ATOMIC_STORE( &(header->layoutStatus), LAYOUT_REPLACED );
+      SharedObjects.DestroyObject( (void*) header );
+      
+      if( ! isReplacing ) return false;
+      
+      DEBUG_PRINT( "replacing %s segment", channelName );
+      if( ! SharedObjects.RemoveObject( channelName ) ) return false;
+      return OpenChannel( channel, channelName, layout, flags, CHANNEL_OPEN_REPLACED );
+    }
+    
+    if( header->blocksNumber > layout->blocksNumber )
+    {
+      DEBUG_PRINT( "%s: adopting stored layout with %u blocks", channelName, header->blocksNumber );
+      SetLayout( layout, header->blocksNumber, header->blockSize, header->maskBitsNumber );
+      // Map the bigger segment before releasing the old mapping, so that it is never removed in between
+      ControlChannelHeader* oldHeader = header;
+      header = (ControlChannelHeader*) SharedObjects.CreateObject( channelName, GetChannelSize( layout ), flags );
+      SharedObjects.DestroyObject( (void*) oldHeader );
+      if( header == (void*) -1 ) return false;
+    }
+  }
+  
+  channel->header = header;
+  channel->dataMask = (uint8_t*) header + sizeof(ControlChannelHeader);
+  channel->data = channel->dataMask + layout->maskSize;
+  strncpy( channel->name, channelName, SHARED_VARIABLE_NAME_MAX_LENGTH - 1 );
+  channel->flags = flags;
+  
+  return true;
+}
+
+// Checked on every access: a segment replaced by its owner is swapped for the new one. If that can't be used,
+// the channel is closed, and accesses fail from then on
+static bool CheckChannel( ControlChannel channel, SHMControlLayout* layout )
+{
+  if( channel->header == NULL ) return false;
+  
+  if( ATOMIC_LOAD( &(channel->header->layoutStatus) ) == LAYOUT_READY ) return true;
+  
+  char channelName[ SHARED_VARIABLE_NAME_MAX_LENGTH ];
+  strcpy( channelName, channel->name );
+  DEBUG_PRINT( "%s segment replaced by its owner. remapping", channelName );
+  
+  // Controller layout is kept for bounds checking: an adopted bigger one only sets where the new data starts
+  SHMControlLayout channelLayout = *layout;
+  ControlChannelHeader* oldHeader = channel->header;
+  if( ! OpenChannel( channel, channelName, &channelLayout, channel->flags, CHANNEL_OPEN_SHARED ) ) channel->header = NULL;
+  SharedObjects.DestroyObject( (void*) oldHeader );
+  
+  return ( channel->header != NULL );
+}
+
 const char* SHARED_VARIABLE_IN_SUFFIX = "_in";
 const char* SHARED_VARIABLE_OUT_SUFFIX = "_out";
-SHMController SHMControl_InitData( const char* bufferName, enum SHMControlTypes controlType )
+SHMController SHMControl_InitData( const char* bufferName, enum SHMControlTypes controlType, size_t blocksNumber, size_t blockSize, size_t maskBitsNumber )
 {
   char channelName[ SHARED_VARIABLE_NAME_MAX_LENGTH ];
   
@@ -60,24 +215,40 @@ SHMController SHMControl_InitData( const char* bufferName, enum SHMControlTypes
     return NULL;
   }
   
+  if( blocksNumber == 0 || blockSize == 0 || maskBitsNumber == 0 )
+  {
+    DEBUG_PRINT( "invalid %s layout: %lu blocks of %lu bytes (%lu mask bits)", bufferName, blocksNumber, blockSize, maskBitsNumber );
+    return NULL;
+  }
+  
   DEBUG_PRINT( "creating control shared memory buffer %s", bufferName );
   
   SHMController newController = (SHMController) malloc( sizeof(SHMControlData) );
   memset( newController, 0, sizeof(SHMControlData) );
   
+  SetLayout( &(newController->layout), blocksNumber, blockSize, maskBitsNumber );
+  
   sprintf( channelName, "%s%s", bufferName, ( controlType == SHM_CONTROL_IN ) ? SHARED_VARIABLE_IN_SUFFIX : SHARED_VARIABLE_OUT_SUFFIX );
-  newController->channelIn = (ControlChannel) SharedObjects.CreateObject( channelName, sizeof(ControlChannelData), SHM_READ );
-  if( newController->channelIn == (void*) -1 ) return NULL;
+  // Output side owns the channels: it replaces segments left with layouts other than its own
+  enum ChannelOpenModes openMode = ( controlType == SHM_CONTROL_OUT ) ? CHANNEL_OPEN_OWNED : CHANNEL_OPEN_SHARED;
+  if( ! OpenChannel( &(newController->channelIn), channelName, &(newController->layout), SHM_READ, openMode ) )
+  {
+    free( newController );
+    return NULL;
+  }
   
+  // Both channels must have the same layout: the out one is opened with the (possibly adopted) in channel layout
   sprintf( channelName, "%s%s", bufferName, ( controlType == SHM_CONTROL_IN ) ? SHARED_VARIABLE_OUT_SUFFIX : SHARED_VARIABLE_IN_SUFFIX );
-  newController->channelOut = (ControlChannel) SharedObjects.CreateObject( channelName, sizeof(ControlChannelData), SHM_WRITE );
-  if( newController->channelOut == (void*) -1 )
+  SHMControlLayout outLayout = newController->layout;
+  if( ! OpenChannel( &(newController->channelOut), channelName, &outLayout, SHM_WRITE, openMode ) || outLayout.blocksNumber != newController->layout.blocksNumber )
   {
-    SharedObjects.DestroyObject( (void*) newController->channelOut );
+    if( newController->channelOut.header != NULL ) SharedObjects.DestroyObject( (void*) newController->channelOut.header );
+    SharedObjects.DestroyObject( (void*) newController->channelIn.header );
+    free( newController );
     return NULL;
   }
   
-  DEBUG_PRINT( "control %s configuration: %p %p", ( controlType == SHM_CONTROL_IN ) ? "IN" : "OUT", newController->channelIn, newController->channelOut );
+  DEBUG_PRINT( "control %s configuration: %p %p", ( controlType == SHM_CONTROL_IN ) ? "IN" : "OUT", newController->channelIn.header, newController->channelOut.header );
   
   return newController;
 }
@@ -88,43 +259,96 @@ void SHMControl_EndData( SHMController controller )
   
   DEBUG_PRINT( "Destroying controller %p data", controller );
 
-  SharedObjects.DestroyObject( (void*) controller->channelIn );
-  SharedObjects.DestroyObject( (void*) controller->channelOut );
+  SharedObjects.DestroyObject( (void*) controller->channelIn.header );
+  SharedObjects.DestroyObject( (void*) controller->channelOut.header );
   
   free( controller );
 }
 
+bool SHMControl_GetLayout( SHMController controller, SHMControlLayout* ref_layout )
+{
+  if( controller == NULL ) return false;
+  
+  if( ref_layout == NULL ) return false;
+  
+  *ref_layout = controller->layout;
+  
+  return true;
+}
+
 bool SHMControl_GetData( SHMController controller, void* valuesList, size_t dataOffset, size_t dataLength )
 {
   if( controller == NULL ) return false;
   
-  if( controller->channelIn == NULL ) return false;
+  if( ! CheckChannel( &(controller->channelIn), &(controller->layout) ) ) return false;
   
-  if( dataOffset + dataLength > SHM_CONTROL_MAX_DATA_SIZE ) return false;
+  if( dataOffset + dataLength > controller->layout.dataSize ) return false;
   
   if( valuesList == NULL ) return false;
   
-  //if( memcmp( valuesList, controller->channelIn->data + dataOffset, dataLength ) == 0 ) return false;
+  ControlChannel channel = &(controller->channelIn);
+  uint32_t startSequence, endSequence;
+  do
+  {
+    startSequence = ATOMIC_LOAD( &(channel->header->dataSequence) );
+    if( startSequence & 1 ) continue; // Write in progress
+    
+    memcpy( valuesList, channel->data + dataOffset, dataLength );
     
-  memcpy( valuesList, controller->channelIn->data + dataOffset, dataLength );
+    ATOMIC_THREAD_FENCE(); // Copy must complete before checking the counter again
+    endSequence = ATOMIC_LOAD( &(channel->header->dataSequence) );
+  } while( ( startSequence & 1 ) || startSequence != endSequence );
   
   return true;
 }
 
+const void* SHMControl_GetDataReference( SHMController controller, size_t dataOffset, size_t dataLength, uint32_t* ref_version )
+{
+  if( controller == NULL ) return NULL;
+  
+  if( ! CheckChannel( &(controller->channelIn), &(controller->layout) ) ) return NULL;
+  
+  if( dataOffset + dataLength > controller->layout.dataSize ) return NULL;
+  
+  if( ref_version == NULL ) return NULL;
+  
+  ControlChannel channel = &(controller->channelIn);
+  do { *ref_version = ATOMIC_LOAD( &(channel->header->dataSequence) ); } while( *ref_version & 1 ); // Write in progress
+  
+  return (const void*) ( channel->data + dataOffset );
+}
+
+bool SHMControl_CheckDataVersion( SHMController controller, uint32_t version )
+{
+  if( controller == NULL ) return false;
+  
+  if( controller->channelIn.header == NULL ) return false;
+  
+  ATOMIC_THREAD_FENCE(); // Data reads must complete before checking the counter again
+  
+  return ( ATOMIC_LOAD( &(controller->channelIn.header->dataSequence) ) == version );
+}
+
 bool SHMControl_SetData( SHMController controller, void* valuesList, size_t dataOffset, size_t dataLength )
 {
   if( controller == NULL ) return false;
   
-  if( controller->channelOut == NULL ) return false;
+  if( ! CheckChannel( &(controller->channelOut), &(controller->layout) ) ) return false;
   
-  if( dataOffset + dataLength > SHM_CONTROL_MAX_DATA_SIZE ) return false;
+  if( dataOffset + dataLength > controller->layout.dataSize ) return false;
   
   if( valuesList == NULL ) return false;
   
-  //if( memcmp( controller->channelOut->data + dataOffset, valuesList, dataLength ) == 0 ) return false;
+  ControlChannel channel = &(controller->channelOut);
+  uint32_t sequence = channel->header->dataSequence;
+  
+  ATOMIC_STORE( &(channel->header->dataSequence), sequence + 1 );
+  ATOMIC_THREAD_FENCE(); // Odd counter must be visible before any data change
+  
+  memcpy( channel->data + dataOffset, valuesList, dataLength );
+  
+  ATOMIC_STORE( &(channel->header->dataSequence), sequence + 2 );
   
-  memcpy( controller->channelOut->data + dataOffset, valuesList, dataLength );
-    
   return true;
 }
 
@@ -132,26 +356,193 @@ uint8_t SHMControl_GetControlByte( SHMController controller, size_t maskByteInde
 {
   if( controller == NULL ) return 0;
   
-  if( controller->channelIn == NULL ) return 0;
-  
-  if( maskByteIndex >= SHM_CONTROL_MASK_SIZE ) return 0;
+  if( ! CheckChannel( &(controller->channelIn), &(controller->layout) ) ) return 0;
   
-  uint8_t maskByte = controller->channelIn->dataMask[ maskByteIndex ];
+  if( maskByteIndex >= controller->layout.maskSize ) return 0;
   
-  /*if( remove )*/ controller->channelIn->dataMask[ maskByteIndex ] = 0x00;
+  // Removal takes and clears the byte in one step, so that no value written in between is lost
+  if( remove ) return (uint8_t) ATOMIC_EXCHANGE( &(controller->channelIn.dataMask[ maskByteIndex ]), 0x00 );
   
-  return maskByte;
+  return ATOMIC_LOAD( &(controller->channelIn.dataMask[ maskByteIndex ]) );
 }
 
 uint8_t SHMControl_SetControlByte( SHMController controller, size_t maskByteIndex, uint8_t maskByteValue )
 {
   if( controller == NULL ) return 0;
   
-  if( controller->channelOut == NULL ) return 0;
+  if( ! CheckChannel( &(controller->channelOut), &(controller->layout) ) ) return 0;
+  
+  if( maskByteIndex >= controller->layout.maskSize ) return 0;
+    
+  // Release store: data set before the mask byte is visible to whoever reads the byte
+  ATOMIC_STORE( &(controller->channelOut.dataMask[ maskByteIndex ]), maskByteValue );
+    
+  return maskByteValue;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/////                           RECORDS RING                            /////
+/////////////////////////////////////////////////////////////////////////////
+
+#define CACHE_LINE_SIZE 64
+
+// Producer and consumer indexes (free running, wrapped by the records mask) are kept on separate cache lines
+typedef struct _RingHeader
+{
+  uint64_t layoutStatus;
+  uint32_t recordsNumber;
+  uint32_t recordSize;
+  uint64_t overflowsCount;
+  uint8_t layoutPadding[ CACHE_LINE_SIZE - 3 * sizeof(uint64_t) ];
+  uint64_t writeIndex;
+  uint8_t writePadding[ CACHE_LINE_SIZE - sizeof(uint64_t) ];
+  uint64_t readIndex;
+  uint8_t readPadding[ CACHE_LINE_SIZE - sizeof(uint64_t) ];
+}
+RingHeader;
+
+struct _SHMRingData
+{
+  RingHeader* header;
+  uint8_t* recordsList;
+  size_t recordsMask;
+  size_t recordSize;
+};
+
+
+DEFINE_NAMESPACE_INTERFACE( SHMRings, SHM_RING_INTERFACE )
+
+
+// Maps the ring segment, writing the layout if first to open it. Stale segments are replaced once, like control channels
+static RingHeader* OpenRing( const char* ringName, size_t* ref_ringCapacity, size_t recordSize, bool isReplaced )
+{
+  RingHeader* header = (RingHeader*) SharedObjects.CreateObject( ringName, sizeof(RingHeader) + (*ref_ringCapacity) * recordSize, SHM_READ | SHM_WRITE );
+  if( header == (void*) -1 ) return NULL;
+  
+  uint64_t layoutStatus = LAYOUT_UNSET;
+  if( ATOMIC_COMPARE_EXCHANGE( &(header->layoutStatus), &layoutStatus, LAYOUT_WRITING ) )
+  {
+    header->recordsNumber = (uint32_t) (*ref_ringCapacity);
+    header->recordSize = (uint32_t) recordSize;
+    ATOMIC_STORE( &(header->layoutStatus), LAYOUT_READY );
+    return header;
+  }
+  
+  layoutStatus = WaitLayout( &(header->layoutStatus) );
   
-  if( maskByteIndex >= SHM_CONTROL_MASK_SIZE ) return 0;
+  if( layoutStatus != LAYOUT_READY )
+  {
+    ERROR_PRINT( "%s layout not written after %u ms: stale segment", ringName, LAYOUT_WRITE_TIMEOUT_MS );
+    SharedObjects.DestroyObject( (void*) header );
     
-  controller->channelOut->dataMask[ maskByteIndex ] = maskByteValue;
+    if( isReplaced ) return NULL;
     
-  return controller->channelOut->dataMask[ maskByteIndex ];
+    DEBUG_PRINT( "replacing %s segment", ringName );
+    if( ! SharedObjects.RemoveObject( ringName ) ) return NULL;
+    return OpenRing( ringName, ref_ringCapacity, recordSize, true );
+  }
+  
+  if( header->recordSize != recordSize || header->recordsNumber < (*ref_ringCapacity) )
+  {
+    ERROR_PRINT( "%s layout mismatch: %u records of %u bytes stored, %lu records of %lu bytes required", 
+                 ringName, header->recordsNumber, header->recordSize, (*ref_ringCapacity), recordSize );
+    SharedObjects.DestroyObject( (void*) header );
+    return NULL;
+  }
+  
+  if( header->recordsNumber > (*ref_ringCapacity) )
+  {
+    *ref_ringCapacity = header->recordsNumber;
+    RingHeader* oldHeader = header;
+    header = (RingHeader*) SharedObjects.CreateObject( ringName, sizeof(RingHeader) + (*ref_ringCapacity) * recordSize, SHM_READ | SHM_WRITE );
+    SharedObjects.DestroyObject( (void*) oldHeader );
+    if( header == (void*) -1 ) return NULL;
+  }
+  
+  return header;
+}
+
+SHMRing SHMRings_InitRing( const char* ringName, size_t recordsNumber, size_t recordSize )
+{
+  if( recordsNumber == 0 || recordSize == 0 ) return NULL;
+  
+  // Power of 2 capacity: indexes are wrapped with a mask
+  size_t ringCapacity = 1;
+  while( ringCapacity < recordsNumber ) ringCapacity <<= 1;
+  
+  DEBUG_PRINT( "creating records ring %s (%lu records of %lu bytes)", ringName, ringCapacity, recordSize );
+  
+  RingHeader* header = OpenRing( ringName, &ringCapacity, recordSize, false );
+  if( header == NULL ) return NULL;
+  
+  SHMRing newRing = (SHMRing) malloc( sizeof(SHMRingData) );
+  newRing->header = header;
+  newRing->recordsList = (uint8_t*) header + sizeof(RingHeader);
+  newRing->recordsMask = ringCapacity - 1;
+  newRing->recordSize = recordSize;
+  
+  return newRing;
+}
+
+void SHMRings_EndRing( SHMRing ring )
+{
+  if( ring == NULL ) return;
+  
+  SharedObjects.DestroyObject( (void*) ring->header );
+  
+  free( ring );
+}
+
+// Producer side
+bool SHMRings_WriteRecord( SHMRing ring, const void* record )
+{
+  if( ring == NULL || record == NULL ) return false;
+  
+  RingHeader* header = ring->header;
+  uint64_t writeIndex = header->writeIndex;
+  
+  if( writeIndex - ATOMIC_LOAD( &(header->readIndex) ) > ring->recordsMask )
+  {
+    (void) ATOMIC_FETCH_ADD( &(header->overflowsCount), 1 );
+    return false;
+  }
+  
+  memcpy( ring->recordsList + ( writeIndex & ring->recordsMask ) * ring->recordSize, record, ring->recordSize );
+  
+  // Release store: record is complete before the consumer sees it
+  ATOMIC_STORE( &(header->writeIndex), writeIndex + 1 );
+  
+  return true;
+}
+
+// Consumer side: takes up to the given number of records, oldest first, returning how many were taken
+size_t SHMRings_ReadRecords( SHMRing ring, void* recordsList, size_t maxRecordsNumber )
+{
+  if( ring == NULL || recordsList == NULL ) return 0;
+  
+  RingHeader* header = ring->header;
+  uint64_t readIndex = header->readIndex;
+  
+  size_t recordsNumber = (size_t) ( ATOMIC_LOAD( &(header->writeIndex) ) - readIndex );
+  if( recordsNumber > maxRecordsNumber ) recordsNumber = maxRecordsNumber;
+  
+  // Copied in up to 2 parts, when wrapping around the ring end
+  size_t firstIndex = (size_t) ( readIndex & ring->recordsMask );
+  size_t firstRecordsNumber = ring->recordsMask + 1 - firstIndex;
+  if( firstRecordsNumber > recordsNumber ) firstRecordsNumber = recordsNumber;
+  memcpy( recordsList, ring->recordsList + firstIndex * ring->recordSize, firstRecordsNumber * ring->recordSize );
+  memcpy( (uint8_t*) recordsList + firstRecordsNumber * ring->recordSize, ring->recordsList, ( recordsNumber - firstRecordsNumber ) * ring->recordSize );
+  
+  // Release store: slots are only reused by the producer after being copied
+  ATOMIC_STORE( &(header->readIndex), readIndex + recordsNumber );
+  
+  return recordsNumber;
+}
+
+uint64_t SHMRings_GetOverflowsCount( SHMRing ring )
+{
+  if( ring == NULL ) return 0;
+  
+  return ATOMIC_LOAD( &(ring->header->overflowsCount) );
 }
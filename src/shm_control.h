@@ -12,8 +12,6 @@
 
 enum SHMControlTypes { SHM_CONTROL_OUT, SHM_CONTROL_IN, SHM_CONTROL_TYPES_NUMBER };
 
-#define SHM_CONTROL_MASK_SIZE 32
-#define SHM_CONTROL_MAX_DATA_SIZE ( 8 * SHM_CONTROL_MASK_SIZE )
 #define SHARED_VARIABLE_NAME_MAX_LENGTH 128
 
 #define SHM_CONTROL_PEEK false
@@ -32,13 +30,34 @@ enum SHMControlTypes { SHM_CONTROL_OUT, SHM_CONTROL_IN, SHM_CONTROL_TYPES_NUMBER
 /////                             INTERFACE                             /////
 /////////////////////////////////////////////////////////////////////////////
 
+// Channel geometry: data is split in blocks (e.g. one per axis), each one with its own mask bits (control bytes).
+// Mask bytes are indexed globally: block N control bytes start at N * ( ( maskBitsNumber + 7 ) / 8 )
+typedef struct _SHMControlLayout
+{
+  size_t blocksNumber;
+  size_t blockSize;
+  size_t maskBitsNumber;
+  size_t maskSize;                  // Total mask bytes (derived)
+  size_t dataSize;                  // Total data bytes (derived)
+}
+SHMControlLayout;
+
 typedef struct _SHMControlData SHMControlData;
 typedef SHMControlData* SHMController;
 
+// InitData takes the channel blocks number, block size (bytes) and mask bits per block. The layout is stored in
+// the shared segment by the first process opening it. Others accept it if it holds at least their blocks number.
+// Segments left with an unfinished layout are replaced, as well as incompatible ones when opened by the output side.
+// Other processes remap a replaced segment on their next access (or stop using it if the new layout doesn't fit them).
+// GetDataReference returns a pointer to the incoming data (no copy) and its version, that CheckDataVersion
+// compares to the current one after using it: if they differ, a write overlapped and the data should be read again
 #define SHM_CONTROL_INTERFACE( Namespace, INIT_FUNCTION ) \
-        INIT_FUNCTION( SHMController, Namespace, InitData, const char*, enum SHMControlTypes ) \
+        INIT_FUNCTION( SHMController, Namespace, InitData, const char*, enum SHMControlTypes, size_t, size_t, size_t ) \
         INIT_FUNCTION( void, Namespace, EndData, SHMController ) \
+        INIT_FUNCTION( bool, Namespace, GetLayout, SHMController, SHMControlLayout* ) \
         INIT_FUNCTION( bool, Namespace, GetData, SHMController, void*, size_t, size_t ) \
+        INIT_FUNCTION( const void*, Namespace, GetDataReference, SHMController, size_t, size_t, uint32_t* ) \
+        INIT_FUNCTION( bool, Namespace, CheckDataVersion, SHMController, uint32_t ) \
         INIT_FUNCTION( bool, Namespace, SetData, SHMController, void*, size_t, size_t ) \
         INIT_FUNCTION( uint8_t, Namespace, GetControlByte, SHMController, size_t, bool ) \
         INIT_FUNCTION( uint8_t, Namespace, SetControlByte, SHMController, size_t, uint8_t )
@@ -46,4 +65,24 @@ typedef SHMControlData* SHMController;
 DECLARE_NAMESPACE_INTERFACE( SHMControl, SHM_CONTROL_INTERFACE )
 
 
+/////////////////////////////////////////////////////////////////////////////
+/////                      RECORDS RING INTERFACE                       /////
+/////////////////////////////////////////////////////////////////////////////
+
+// Single producer/single consumer queue of fixed size records, for streams where no sample may be skipped
+// or repeated (unlike control channels, that only hold the latest values). When full, new records are
+// dropped and counted as overflows. Both sides open it with the same name and record size
+typedef struct _SHMRingData SHMRingData;
+typedef SHMRingData* SHMRing;
+
+#define SHM_RING_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( SHMRing, Namespace, InitRing, const char*, size_t, size_t ) \
+        INIT_FUNCTION( void, Namespace, EndRing, SHMRing ) \
+        INIT_FUNCTION( bool, Namespace, WriteRecord, SHMRing, const void* ) \
+        INIT_FUNCTION( size_t, Namespace, ReadRecords, SHMRing, void*, size_t ) \
+        INIT_FUNCTION( uint64_t, Namespace, GetOverflowsCount, SHMRing )
+
+DECLARE_NAMESPACE_INTERFACE( SHMRings, SHM_RING_INTERFACE )
+
+
 #endif // SHM_CONTROL_H
@@ -11,4 +11,13 @@ enum { SHM_ROBOT_DISABLE = 1, SHM_ROBOT_DISABLED = SHM_ROBOT_DISABLE,
        SHM_ROBOT_SET_USER, SHM_ROBOT_SET_CONFIG,
        SHM_ROBOT_BYTE_END };
 
+// Robots info channel: one control byte per robot. Data (robots list string, user name) spans all blocks.
+// Last mask bytes are reserved, indexed back from the mask end (maskSize - byte) so that no robot index reaches them:
+// robots list requests (to control), and the info write count and robots and axes numbers (from control). Robot
+// indexes go below maskSize - SHM_ROBOT_INFO_RESERVED_NUMBER
+enum { SHM_ROBOT_INFO_LIST_REQUEST = 1, SHM_ROBOT_INFO_WRITE_COUNT, SHM_ROBOT_INFO_ROBOTS_NUMBER, SHM_ROBOT_INFO_AXES_NUMBER, 
+       SHM_ROBOT_INFO_BYTE_END, SHM_ROBOT_INFO_RESERVED_NUMBER = SHM_ROBOT_INFO_BYTE_END - 1 };
+#define ROBOT_INFO_BLOCKS_NUMBER 32
+#define ROBOT_INFO_BLOCK_SIZE 64
+
 #endif // SHM_JOINT_CONTROL_H
@@ -0,0 +1,25 @@
+#ifndef SHM_ROBOT_SAMPLES_H
+#define SHM_ROBOT_SAMPLES_H
+
+#include <stdint.h>
+
+#include "shm_axis_control.h"
+
+// Axis values of a single control pass, streamed without loss or repetition from control to network clients.
+// Values follow the axis shared data order (SHM_AXIS_* indexes)
+typedef struct _SHMAxisSample
+{
+  uint64_t sequenceNumber;                         // Streamed control passes count of the axis robot
+  uint64_t timestamp;                              // Pass start time (nanoseconds)
+  uint32_t axisIndex;                              // Shared axis index
+  float measuresList[ SHM_AXIS_FLOATS_NUMBER ];
+  float setpointsList[ SHM_AXIS_FLOATS_NUMBER ];
+}
+SHMAxisSample;
+
+// Samples ring of each shared robot (formatted with the robot index)
+#define ROBOT_SAMPLES_RING_NAME "robot_samples_%lu"
+// About 1 second of samples for a single axis robot running at 1 kHz
+#define ROBOT_SAMPLES_RING_SIZE 1024
+
+#endif // SHM_ROBOT_SAMPLES_H
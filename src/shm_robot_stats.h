@@ -0,0 +1,33 @@
+#ifndef SHM_ROBOT_STATS_H
+#define SHM_ROBOT_STATS_H
+
+#include "debug/latency_histograms.h"
+
+// Control stage times summaries (nanoseconds, saturated to 32 bits) published for each shared robot
+enum { SHM_STATS_MEDIAN, SHM_STATS_PERCENTILE_99, SHM_STATS_PERCENTILE_999, SHM_STATS_MAX, SHM_STATS_VALUES_NUMBER };
+
+// Same order as the robots control stages (sense, compute, actuate, whole cycle). Checked against them on publishing
+#define SHM_STATS_STAGES_NUMBER 4
+
+// Joints only time the sense and actuate stages. Summaries are published for the first SHM_STATS_JOINTS_NUMBER ones
+enum { SHM_STATS_JOINT_SENSE, SHM_STATS_JOINT_ACTUATE, SHM_STATS_JOINT_STAGES_NUMBER };
+#define SHM_STATS_JOINTS_NUMBER 8
+
+// Robot block: stage summaries, then joint summaries (zeroed for missing joints), then the stages histograms 
+// bucket counts (saturated to 32 bits), with the buckets of LatencyHistograms (values from GetBucketValue)
+#define ROBOT_STATS_SUMMARY_SIZE ( SHM_STATS_STAGES_NUMBER * SHM_STATS_VALUES_NUMBER * sizeof(uint32_t) )
+#define ROBOT_STATS_JOINTS_SIZE ( SHM_STATS_JOINTS_NUMBER * SHM_STATS_JOINT_STAGES_NUMBER * SHM_STATS_VALUES_NUMBER * sizeof(uint32_t) )
+#define ROBOT_STATS_HISTOGRAMS_SIZE ( SHM_STATS_STAGES_NUMBER * LATENCY_BUCKETS_NUMBER * sizeof(uint32_t) )
+
+#define ROBOT_STATS_JOINTS_OFFSET ROBOT_STATS_SUMMARY_SIZE
+#define ROBOT_STATS_HISTOGRAMS_OFFSET ( ROBOT_STATS_JOINTS_OFFSET + ROBOT_STATS_JOINTS_SIZE )
+
+#define ROBOT_STATS_BLOCK_SIZE ( ROBOT_STATS_HISTOGRAMS_OFFSET + ROBOT_STATS_HISTOGRAMS_SIZE )
+#define ROBOT_STATS_BLOCKS_NUMBER 32
+
+// Event message command blocks number value reserved for control stats requests. Command messages are therefore
+// limited to SHM_ROBOT_COMMAND_MAX_BLOCKS: a 255 blocks one is taken for a stats request
+#define SHM_ROBOT_STATS_REQUEST 0xFF
+#define SHM_ROBOT_COMMAND_MAX_BLOCKS ( SHM_ROBOT_STATS_REQUEST - 1 )
+
+#endif // SHM_ROBOT_STATS_H
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+/////   Minimal atomic operations on word sized integers and pointers,    /////
+/////   mapped to compiler intrinsics                                      /////
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ATOMIC_OPERATIONS_H
+#define ATOMIC_OPERATIONS_H
+
+#if defined( __GNUC__ )
+
+  #define ATOMIC_LOAD( ref_value ) __atomic_load_n( (ref_value), __ATOMIC_ACQUIRE )
+  #define ATOMIC_STORE( ref_value, value ) __atomic_store_n( (ref_value), (value), __ATOMIC_RELEASE )
+  #define ATOMIC_FETCH_ADD( ref_value, increment ) __atomic_fetch_add( (ref_value), (increment), __ATOMIC_ACQ_REL )
+  #define ATOMIC_EXCHANGE( ref_value, value ) __atomic_exchange_n( (ref_value), (value), __ATOMIC_ACQ_REL )
+  #define ATOMIC_COMPARE_EXCHANGE( ref_value, ref_expected, desired ) \
+          __atomic_compare_exchange_n( (ref_value), (ref_expected), (desired), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+  #define ATOMIC_THREAD_FENCE() __atomic_thread_fence( __ATOMIC_SEQ_CST )
+  // Processor hint for busy waiting loops
+  #if defined( __x86_64__ ) || defined( __i386__ )
+    #define ATOMIC_SPIN_PAUSE() __builtin_ia32_pause()
+  #elif defined( __aarch64__ ) || defined( __arm__ )
+    #define ATOMIC_SPIN_PAUSE() __asm__ __volatile__( "yield" )
+  #else
+    #define ATOMIC_SPIN_PAUSE() do {} while( 0 )
+  #endif
+
+#elif defined( _MSC_VER )
+
+  #include <Windows.h>
+  #include <intrin.h>
+
+  // x86/x64 loads and stores of aligned words already have acquire/release semantics: only prevent compiler reordering
+  #define ATOMIC_LOAD( ref_value ) ( _ReadWriteBarrier(), *(ref_value) )
+  #define ATOMIC_STORE( ref_value, value ) do { _ReadWriteBarrier(); *(ref_value) = (value); _ReadWriteBarrier(); } while( 0 )
+  // Interlocked intrinsic selected by operand size (8, 32 or 64 bits)
+  #define ATOMIC_FETCH_ADD( ref_value, increment ) \
+          ( ( sizeof(*(ref_value)) == 1 ) ? (LONG64) _InterlockedExchangeAdd8( (volatile char*) (ref_value), (char) (increment) ) : \
+            ( sizeof(*(ref_value)) == 4 ) ? (LONG64) InterlockedExchangeAdd( (volatile LONG*) (ref_value), (LONG) (increment) ) : \
+                                            InterlockedExchangeAdd64( (volatile LONG64*) (ref_value), (LONG64) (increment) ) )
+  #define ATOMIC_EXCHANGE( ref_value, value ) \
+          ( ( sizeof(*(ref_value)) == 1 ) ? (LONG64) _InterlockedExchange8( (volatile char*) (ref_value), (char) (value) ) : \
+            ( sizeof(*(ref_value)) == 4 ) ? (LONG64) InterlockedExchange( (volatile LONG*) (ref_value), (LONG) (value) ) : \
+                                            InterlockedExchange64( (volatile LONG64*) (ref_value), (LONG64) (value) ) )
+  // Compare and exchange is only used on 64 bits values
+  static __inline bool AtomicCompareExchange( volatile LONG64* ref_value, LONG64* ref_expected, LONG64 desired )
+  {
+    LONG64 previous = InterlockedCompareExchange64( ref_value, desired, *ref_expected );
+    if( previous == *ref_expected ) return true;
+    *ref_expected = previous;
+    return false;
+  }
+  #define ATOMIC_COMPARE_EXCHANGE( ref_value, ref_expected, desired ) \
+          AtomicCompareExchange( (volatile LONG64*) (ref_value), (LONG64*) (ref_expected), (LONG64) (desired) )
+  #define ATOMIC_THREAD_FENCE() MemoryBarrier()
+  #define ATOMIC_SPIN_PAUSE() YieldProcessor()
+
+#else
+  #error "atomic operations not available for this compiler"
+#endif
+
+#endif // ATOMIC_OPERATIONS_H
@@ -24,10 +24,13 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 
 #include "debug/sync_debug.h"
 
 #include "threads/threading.h"
+#include "threads/atomic_operations.h"
 
 #include "threads/thread_safe_data.h"
 
@@ -124,6 +127,215 @@ bool ThreadSafeQueues_Dequeue( ThreadSafeQueue queue, void* buffer, enum TSQueue
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                  LOCK-FREE RING QUEUE                                       /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CACHE_LINE_SIZE 64
+// Sleeps are bounded anyway, so that nobody is stuck if the queue is discarded
+const uint64_t RING_QUEUE_WAIT_TIMEOUT_NS = 100000000;
+
+// Each slot starts with its sequence number: equal to the position it may be reserved for while free, 
+// one more once committed, and the position of the next lap (plus capacity) after being released
+#define RING_SLOT_HEADER_SIZE sizeof(size_t)
+
+// Futex word (incremented on each wake) and number of sleepers
+typedef struct _RingWaitState
+{
+  uint32_t signalsCount;
+  uint32_t waitersCount;
+}
+RingWaitState;
+
+// Positions written by different threads are kept on different cache lines
+struct _RingQueueData
+{
+  enum RingQueueType type;
+  size_t capacity, itemSize, slotSize;
+  uint8_t* slotsData;
+  uint8_t configPadding[ CACHE_LINE_SIZE ];
+  size_t tail;                                      // Next position to be reserved (producers)
+  uint8_t tailPadding[ CACHE_LINE_SIZE ];
+  size_t head;                                      // Next position to be read (consumer)
+  uint8_t headPadding[ CACHE_LINE_SIZE ];
+  RingWaitState itemsWait;                          // Consumer sleeping while the queue is empty
+  RingWaitState slotsWait;                          // Producers sleeping while the queue is full
+};
+
+
+DEFINE_NAMESPACE_INTERFACE( RingQueues, RING_QUEUE_INTERFACE )
+
+
+static inline size_t* GetRingSlot( RingQueue queue, size_t position )
+{
+  return (size_t*) ( queue->slotsData + ( position & ( queue->capacity - 1 ) ) * queue->slotSize );
+}
+
+RingQueue RingQueues_Create( enum RingQueueType type, size_t maxLength, size_t itemSize )
+{
+  RingQueue queue = (RingQueue) calloc( 1, sizeof(RingQueueData) );
+  
+  queue->type = type;
+  queue->capacity = 1;
+  while( queue->capacity < maxLength ) queue->capacity *= 2;
+  queue->itemSize = itemSize;
+  // Slots (and their sequence numbers) stay word aligned
+  queue->slotSize = ( ( RING_SLOT_HEADER_SIZE + itemSize + sizeof(size_t) - 1 ) / sizeof(size_t) ) * sizeof(size_t);
+  
+  queue->slotsData = (uint8_t*) calloc( queue->capacity, queue->slotSize );
+  for( size_t position = 0; position < queue->capacity; position++ )
+    *GetRingSlot( queue, position ) = position;
+  
+  return queue;
+}
+
+void RingQueues_Discard( RingQueue queue )
+{
+  if( queue == NULL ) return;
+  
+  free( queue->slotsData );
+  free( queue );
+}
+
+// Includes reserved items not committed yet
+size_t RingQueues_GetItemsCount( RingQueue queue )
+{
+  if( queue == NULL ) return 0;
+  
+  size_t head = ATOMIC_LOAD( &(queue->head) );
+  size_t tail = ATOMIC_LOAD( &(queue->tail) );
+  
+  return ( tail > head ) ? tail - head : 0;
+}
+
+static void SleepWhile( RingWaitState* state, RingQueue queue, bool (*IsBlocked)( RingQueue ) )
+{
+  (void) ATOMIC_FETCH_ADD( &(state->waitersCount), 1 );
+  uint32_t signalsCount = ATOMIC_LOAD( &(state->signalsCount) );
+  // Registering as sleeper must be visible before checking the queue again (paired with WakeSleepers)
+  ATOMIC_THREAD_FENCE();
+  if( IsBlocked( queue ) ) WaitWords.Wait( &(state->signalsCount), signalsCount, RING_QUEUE_WAIT_TIMEOUT_NS );
+  (void) ATOMIC_FETCH_ADD( &(state->waitersCount), -1 );
+}
+
+static void WakeSleepers( RingWaitState* state )
+{
+  ATOMIC_THREAD_FENCE();
+  if( ATOMIC_LOAD( &(state->waitersCount) ) > 0 )
+  {
+    (void) ATOMIC_FETCH_ADD( &(state->signalsCount), 1 );
+    WaitWords.WakeAll( &(state->signalsCount) );
+  }
+}
+
+static bool IsRingFull( RingQueue queue )
+{
+  size_t position = ATOMIC_LOAD( &(queue->tail) );
+  
+  return ( (intptr_t) ( ATOMIC_LOAD( GetRingSlot( queue, position ) ) - position ) < 0 );
+}
+
+static bool IsRingEmpty( RingQueue queue )
+{
+  size_t position = ATOMIC_LOAD( &(queue->head) );
+  
+  return ( ATOMIC_LOAD( GetRingSlot( queue, position ) ) != position + 1 );
+}
+
+static void* TryReserveItem( RingQueue queue )
+{
+  size_t position = ATOMIC_LOAD( &(queue->tail) );
+  while( true )
+  {
+    size_t* slot = GetRingSlot( queue, position );
+    intptr_t sequenceDifference = (intptr_t) ( ATOMIC_LOAD( slot ) - position );
+    if( sequenceDifference == 0 )
+    {
+      if( queue->type == RING_QUEUE_SPSC )
+      {
+        ATOMIC_STORE( &(queue->tail), position + 1 );
+        return (uint8_t*) slot + RING_SLOT_HEADER_SIZE;
+      }
+      // On failure, position is updated to the one reserved by another producer
+      if( ATOMIC_COMPARE_EXCHANGE( &(queue->tail), &position, position + 1 ) ) return (uint8_t*) slot + RING_SLOT_HEADER_SIZE;
+    }
+    else if( sequenceDifference < 0 ) return NULL;  // Slot from the previous lap not released yet
+    else position = ATOMIC_LOAD( &(queue->tail) );
+  }
+}
+
+void* RingQueues_ReserveItem( RingQueue queue, enum TSQueueAccessMode mode )
+{
+  if( queue == NULL ) return NULL;
+  
+  void* item;
+  while( (item = TryReserveItem( queue )) == NULL && mode == TSQUEUE_WAIT )
+    SleepWhile( &(queue->slotsWait), queue, IsRingFull );
+  
+  return item;
+}
+
+void RingQueues_CommitItem( RingQueue queue, void* item )
+{
+  if( queue == NULL || item == NULL ) return;
+  
+  size_t* slot = (size_t*) ( (uint8_t*) item - RING_SLOT_HEADER_SIZE );
+  ATOMIC_STORE( slot, *slot + 1 );
+  
+  WakeSleepers( &(queue->itemsWait) );
+}
+
+// Peeked item stays valid (and in the queue) until released
+void* RingQueues_PeekItem( RingQueue queue, enum TSQueueAccessMode mode )
+{
+  if( queue == NULL ) return NULL;
+  
+  while( IsRingEmpty( queue ) )
+  {
+    if( mode == TSQUEUE_NOWAIT ) return NULL;
+    SleepWhile( &(queue->itemsWait), queue, IsRingEmpty );
+  }
+  
+  return (uint8_t*) GetRingSlot( queue, queue->head ) + RING_SLOT_HEADER_SIZE;
+}
+
+void RingQueues_ReleaseItem( RingQueue queue )
+{
+  if( queue == NULL ) return;
+  
+  size_t position = queue->head;
+  size_t* slot = GetRingSlot( queue, position );
+  if( ATOMIC_LOAD( slot ) != position + 1 ) return;
+  
+  ATOMIC_STORE( slot, position + queue->capacity );
+  ATOMIC_STORE( &(queue->head), position + 1 );
+  
+  WakeSleepers( &(queue->slotsWait) );
+}
+
+bool RingQueues_Enqueue( RingQueue queue, const void* buffer, enum TSQueueAccessMode mode )
+{
+  void* item = RingQueues_ReserveItem( queue, mode );
+  if( item == NULL ) return false;
+  
+  memcpy( item, buffer, queue->itemSize );
+  RingQueues_CommitItem( queue, item );
+  
+  return true;
+}
+
+bool RingQueues_Dequeue( RingQueue queue, void* buffer, enum TSQueueAccessMode mode )
+{
+  void* item = RingQueues_PeekItem( queue, mode );
+  if( item == NULL ) return false;
+  
+  if( buffer != NULL ) memcpy( buffer, item, queue->itemSize );
+  RingQueues_ReleaseItem( queue );
+  
+  return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                     THREAD SAFE LIST                                        /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -474,3 +686,356 @@ void ThreadSafeMaps_RunForAllKeys( ThreadSafeMap map, void (*objectOperator)( un
     ThreadLocks.Release( map->insertLock );
   }
 }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                        SNAPSHOT MAP                                         /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Published versions of the keys list. Writers fill one that is not being read and make it the current one
+#define SNAPSHOT_MAP_VERSIONS_NUMBER 4
+
+// Writers sleep on readers counts until woken by the last reader. The timeout only bounds a missed wake up
+const uint64_t SNAPSHOT_MAP_WAIT_TIMEOUT_NS = 10000000;
+
+typedef struct _SnapshotMapItem
+{
+  uint32_t readersCount;
+  uint64_t data[];                                  // Item data (8 bytes aligned)
+}
+SnapshotMapItem;
+
+typedef struct _SnapshotMapEntry
+{
+  unsigned long key;
+  SnapshotMapItem* item;
+}
+SnapshotMapEntry;
+
+typedef struct _SnapshotMapVersion
+{
+  uint32_t readersCount;
+  SnapshotMapEntry* entriesList;                    // Sorted by key (keys only increase)
+  size_t entriesNumber, entriesCapacity;
+}
+SnapshotMapVersion;
+
+struct _SnapshotMapData
+{
+  SnapshotMapVersion versionsList[ SNAPSHOT_MAP_VERSIONS_NUMBER ];
+  SnapshotMapVersion* currentVersion;
+  size_t itemSize;
+  unsigned long lastKey;
+  ThreadLock writeLock;                             // Serializes insertions and removals
+  uint32_t waitersCount;                            // Writers sleeping on readers counts
+};
+
+
+DEFINE_NAMESPACE_INTERFACE( SnapshotMaps, SNAPSHOT_MAP_INTERFACE )
+
+
+SnapshotMap SnapshotMaps_Create( size_t itemSize )
+{
+  SnapshotMap newMap = (SnapshotMap) calloc( 1, sizeof(SnapshotMapData) );
+  
+  newMap->currentVersion = &(newMap->versionsList[ 0 ]);
+  newMap->itemSize = itemSize;
+  newMap->writeLock = ThreadLocks.Create();
+  
+  return newMap;
+}
+
+void SnapshotMaps_Discard( SnapshotMap map )
+{
+  if( map == NULL ) return;
+  
+  SnapshotMapVersion* currentVersion = map->currentVersion;
+  for( size_t entryIndex = 0; entryIndex < currentVersion->entriesNumber; entryIndex++ )
+    free( currentVersion->entriesList[ entryIndex ].item );
+  
+  for( size_t versionIndex = 0; versionIndex < SNAPSHOT_MAP_VERSIONS_NUMBER; versionIndex++ )
+    free( map->versionsList[ versionIndex ].entriesList );
+  
+  ThreadLocks.Discard( map->writeLock );
+  
+  free( map );
+}
+
+// Wakes writers waiting for the readers count to reach zero, if this was the last reader
+static void ReleaseReader( SnapshotMap map, uint32_t* ref_readersCount )
+{
+  if( ATOMIC_FETCH_ADD( ref_readersCount, -1 ) > 1 ) return;
+  // Paired with WaitReaders: either the writer is seen waiting or it sees the count already changed
+  ATOMIC_THREAD_FENCE();
+  if( ATOMIC_LOAD( &(map->waitersCount) ) > 0 ) WaitWords.WakeAll( ref_readersCount );
+}
+
+static void WaitReaders( SnapshotMap map, uint32_t* ref_readersCount )
+{
+  uint32_t readersCount;
+  while( ( readersCount = ATOMIC_LOAD( ref_readersCount ) ) > 0 )
+  {
+    (void) ATOMIC_FETCH_ADD( &(map->waitersCount), 1 );
+    ATOMIC_THREAD_FENCE();
+    WaitWords.Wait( ref_readersCount, readersCount, SNAPSHOT_MAP_WAIT_TIMEOUT_NS );
+    (void) ATOMIC_FETCH_ADD( &(map->waitersCount), -1 );
+  }
+}
+
+// Counts as reader of the current version, retrying if it was replaced in the meantime
+static SnapshotMapVersion* AquireVersion( SnapshotMap map )
+{
+  while( true )
+  {
+    SnapshotMapVersion* version = ATOMIC_LOAD( &(map->currentVersion) );
+    (void) ATOMIC_FETCH_ADD( &(version->readersCount), 1 );
+    // Paired with PublishVersion: either the writer sees this reader or the reader sees the new version
+    ATOMIC_THREAD_FENCE();
+    if( ATOMIC_LOAD( &(map->currentVersion) ) == version ) return version;
+    ReleaseReader( map, &(version->readersCount) );
+  }
+}
+
+static void ReleaseVersion( SnapshotMap map, SnapshotMapVersion* version )
+{
+  ReleaseReader( map, &(version->readersCount) );
+}
+
+static void PublishVersion( SnapshotMap map, SnapshotMapVersion* version )
+{
+  ATOMIC_STORE( &(map->currentVersion), version );
+  ATOMIC_THREAD_FENCE();
+}
+
+// Version (other than the current one) without readers, to be rewritten. If all are read, waits for the least read one
+static SnapshotMapVersion* GetFreeVersion( SnapshotMap map )
+{
+  while( true )
+  {
+    SnapshotMapVersion* leastReadVersion = NULL;
+    for( size_t versionIndex = 0; versionIndex < SNAPSHOT_MAP_VERSIONS_NUMBER; versionIndex++ )
+    {
+      SnapshotMapVersion* version = &(map->versionsList[ versionIndex ]);
+      if( version == map->currentVersion ) continue;
+      uint32_t readersCount = ATOMIC_LOAD( &(version->readersCount) );
+      if( readersCount == 0 ) return version;
+      if( leastReadVersion == NULL || readersCount < ATOMIC_LOAD( &(leastReadVersion->readersCount) ) ) leastReadVersion = version;
+    }
+    WaitReaders( map, &(leastReadVersion->readersCount) );
+  }
+}
+
+static void CopyVersion( SnapshotMapVersion* version, const SnapshotMapVersion* sourceVersion, size_t requiredCapacity )
+{
+  if( version->entriesCapacity < requiredCapacity )
+  {
+    version->entriesList = (SnapshotMapEntry*) realloc( version->entriesList, requiredCapacity * sizeof(SnapshotMapEntry) );
+    version->entriesCapacity = requiredCapacity;
+  }
+  
+  if( sourceVersion->entriesNumber > 0 )
+    memcpy( version->entriesList, sourceVersion->entriesList, sourceVersion->entriesNumber * sizeof(SnapshotMapEntry) );
+  version->entriesNumber = sourceVersion->entriesNumber;
+}
+
+static SnapshotMapEntry* FindEntry( SnapshotMapVersion* version, unsigned long key )
+{
+  size_t firstIndex = 0, lastIndex = version->entriesNumber;
+  while( firstIndex < lastIndex )
+  {
+    size_t middleIndex = ( firstIndex + lastIndex ) / 2;
+    if( version->entriesList[ middleIndex ].key == key ) return &(version->entriesList[ middleIndex ]);
+    else if( version->entriesList[ middleIndex ].key < key ) firstIndex = middleIndex + 1;
+    else lastIndex = middleIndex;
+  }
+  
+  return NULL;
+}
+
+size_t SnapshotMaps_GetItemsCount( SnapshotMap map )
+{
+  if( map == NULL ) return 0;
+  
+  SnapshotMapVersion* version = AquireVersion( map );
+  size_t itemsCount = version->entriesNumber;
+  ReleaseVersion( map, version );
+  
+  return itemsCount;
+}
+
+unsigned long SnapshotMaps_AddItem( SnapshotMap map, const void* dataIn )
+{
+  SnapshotMapItem* newItem = (SnapshotMapItem*) calloc( 1, sizeof(SnapshotMapItem) + map->itemSize );
+  if( dataIn != NULL ) memcpy( newItem->data, dataIn, map->itemSize );
+  
+  ThreadLocks.Aquire( map->writeLock );
+  
+  SnapshotMapVersion* newVersion = GetFreeVersion( map );
+  CopyVersion( newVersion, map->currentVersion, map->currentVersion->entriesNumber + 1 );
+  unsigned long newKey = ++(map->lastKey);
+  newVersion->entriesList[ newVersion->entriesNumber++ ] = (SnapshotMapEntry) { .key = newKey, .item = newItem };
+  PublishVersion( map, newVersion );
+  
+  ThreadLocks.Release( map->writeLock );
+  
+  return newKey;
+}
+
+bool SnapshotMaps_RemoveItem( SnapshotMap map, unsigned long key, void* dataOut )
+{
+  if( map == NULL ) return false;
+  
+  ThreadLocks.Aquire( map->writeLock );
+  
+  SnapshotMapEntry* entry = FindEntry( map->currentVersion, key );
+  if( entry == NULL )
+  {
+    ThreadLocks.Release( map->writeLock );
+    return false;
+  }
+  
+  SnapshotMapItem* item = entry->item;
+  size_t entryIndex = (size_t) ( entry - map->currentVersion->entriesList );
+  
+  SnapshotMapVersion* newVersion = GetFreeVersion( map );
+  CopyVersion( newVersion, map->currentVersion, map->currentVersion->entriesNumber );
+  memmove( &(newVersion->entriesList[ entryIndex ]), &(newVersion->entriesList[ entryIndex + 1 ]), 
+           ( newVersion->entriesNumber - entryIndex - 1 ) * sizeof(SnapshotMapEntry) );
+  newVersion->entriesNumber--;
+  PublishVersion( map, newVersion );
+  
+  ThreadLocks.Release( map->writeLock );
+  
+  // Item is still reachable from previous versions, until their readers are done. Readers that start afterwards get 
+  // versions without it, so waiting (without blocking other insertions and removals) ends once all of those are seen idle
+  for( size_t versionIndex = 0; versionIndex < SNAPSHOT_MAP_VERSIONS_NUMBER; versionIndex++ )
+  {
+    SnapshotMapVersion* version = &(map->versionsList[ versionIndex ]);
+    if( version != newVersion ) WaitReaders( map, &(version->readersCount) );
+  }
+  
+  WaitReaders( map, &(item->readersCount) );
+  
+  if( dataOut != NULL ) memcpy( dataOut, item->data, map->itemSize );
+  free( item );
+  
+  return true;
+}
+
+void* SnapshotMaps_AquireItem( SnapshotMap map, unsigned long key )
+{
+  if( map == NULL ) return NULL;
+  
+  void* itemData = NULL;
+  
+  SnapshotMapVersion* version = AquireVersion( map );
+  SnapshotMapEntry* entry = FindEntry( version, key );
+  if( entry != NULL )
+  {
+    (void) ATOMIC_FETCH_ADD( &(entry->item->readersCount), 1 );
+    itemData = (void*) entry->item->data;
+  }
+  ReleaseVersion( map, version );
+  
+  return itemData;
+}
+
+void SnapshotMaps_ReleaseItem( SnapshotMap map, void* itemData )
+{
+  if( map == NULL || itemData == NULL ) return;
+  
+  SnapshotMapItem* item = (SnapshotMapItem*) ( (uint8_t*) itemData - offsetof( SnapshotMapItem, data ) );
+  ReleaseReader( map, &(item->readersCount) );
+}
+
+// Items removed during the iteration are only freed after it
+void SnapshotMaps_RunForAllItems( SnapshotMap map, void (*itemOperator)( void* ) )
+{
+  if( map == NULL ) return;
+  
+  SnapshotMapVersion* version = AquireVersion( map );
+  for( size_t entryIndex = 0; entryIndex < version->entriesNumber; entryIndex++ )
+    itemOperator( (void*) version->entriesList[ entryIndex ].item->data );
+  ReleaseVersion( map, version );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    WAIT-FREE TRIPLE BUFFER                                  /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Shared index is tagged when it holds a block not yet seen by the reader
+#define TRIPLE_BUFFER_INDEX_MASK 0x3
+#define TRIPLE_BUFFER_FRESH_BIT 0x4
+
+struct _TripleBufferData
+{
+  uint8_t* buffersList[ 3 ];
+  size_t writeIndex;                            // Owned by the writer
+  size_t readIndex;                             // Owned by the reader
+  size_t sharedIndex;                           // Swapped atomically by both sides
+};
+
+
+DEFINE_NAMESPACE_INTERFACE( TripleBuffers, TRIPLE_BUFFER_INTERFACE )
+
+
+TripleBuffer TripleBuffers_Create( size_t bufferSize )
+{
+  TripleBuffer buffer = (TripleBuffer) malloc( sizeof(TripleBufferData) );
+  
+  for( size_t bufferIndex = 0; bufferIndex < 3; bufferIndex++ )
+    buffer->buffersList[ bufferIndex ] = (uint8_t*) calloc( ( bufferSize > 0 ) ? bufferSize : 1, sizeof(uint8_t) );
+  
+  buffer->writeIndex = 0;
+  buffer->sharedIndex = 1;
+  buffer->readIndex = 2;
+  
+  return buffer;
+}
+
+void TripleBuffers_Discard( TripleBuffer buffer )
+{
+  if( buffer == NULL ) return;
+  
+  for( size_t bufferIndex = 0; bufferIndex < 3; bufferIndex++ )
+    free( buffer->buffersList[ bufferIndex ] );
+  
+  free( buffer );
+}
+
+void* TripleBuffers_GetWriteBuffer( TripleBuffer buffer )
+{
+  if( buffer == NULL ) return NULL;
+  
+  return (void*) buffer->buffersList[ buffer->writeIndex ];
+}
+
+// Back buffer contents are not preserved: writer should fill the whole block before publishing
+void TripleBuffers_Publish( TripleBuffer buffer )
+{
+  if( buffer == NULL ) return;
+  
+  size_t previousIndex = ATOMIC_EXCHANGE( &(buffer->sharedIndex), buffer->writeIndex | TRIPLE_BUFFER_FRESH_BIT );
+  buffer->writeIndex = previousIndex & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+// Returns true if a new block was published since the last update
+bool TripleBuffers_Update( TripleBuffer buffer )
+{
+  if( buffer == NULL ) return false;
+  
+  if( !( ATOMIC_LOAD( &(buffer->sharedIndex) ) & TRIPLE_BUFFER_FRESH_BIT ) ) return false;
+  
+  size_t previousIndex = ATOMIC_EXCHANGE( &(buffer->sharedIndex), buffer->readIndex );
+  buffer->readIndex = previousIndex & TRIPLE_BUFFER_INDEX_MASK;
+  
+  return true;
+}
+
+void* TripleBuffers_GetReadBuffer( TripleBuffer buffer )
+{
+  if( buffer == NULL ) return NULL;
+  
+  return (void*) buffer->buffersList[ buffer->readIndex ];
+}
@@ -25,6 +25,36 @@ enum TSQueueAccessMode { TSQUEUE_WAIT, TSQUEUE_NOWAIT };
 DECLARE_NAMESPACE_INTERFACE( ThreadSafeQueues, THREAD_SAFE_QUEUE_INTERFACE )
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                  LOCK-FREE RING QUEUE                                       /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Bounded queue of fixed size items (capacity rounded up to a power of 2) for a single consumer thread and a single 
+// (SPSC) or many (MPSC) producer threads. Items are written and read in place: ReserveItem returns the next free slot, 
+// made visible to the consumer by CommitItem, and PeekItem returns the oldest committed one, freed by ReleaseItem. 
+// Reservations of different producers may be committed in any order. With TSQUEUE_WAIT, producers sleep while the 
+// queue is full and the consumer while it is empty (futex based, only signaled when somebody sleeps). Otherwise, 
+// NULL is returned right away. Enqueue/Dequeue wrap both steps with copies
+
+typedef struct _RingQueueData RingQueueData;
+typedef RingQueueData* RingQueue;
+
+enum RingQueueType { RING_QUEUE_SPSC, RING_QUEUE_MPSC };
+
+#define RING_QUEUE_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( RingQueue, Namespace, Create, enum RingQueueType, size_t, size_t ) \
+        INIT_FUNCTION( void, Namespace, Discard, RingQueue ) \
+        INIT_FUNCTION( size_t, Namespace, GetItemsCount, RingQueue ) \
+        INIT_FUNCTION( void*, Namespace, ReserveItem, RingQueue, enum TSQueueAccessMode ) \
+        INIT_FUNCTION( void, Namespace, CommitItem, RingQueue, void* ) \
+        INIT_FUNCTION( void*, Namespace, PeekItem, RingQueue, enum TSQueueAccessMode ) \
+        INIT_FUNCTION( void, Namespace, ReleaseItem, RingQueue ) \
+        INIT_FUNCTION( bool, Namespace, Enqueue, RingQueue, const void*, enum TSQueueAccessMode ) \
+        INIT_FUNCTION( bool, Namespace, Dequeue, RingQueue, void*, enum TSQueueAccessMode )
+
+DECLARE_NAMESPACE_INTERFACE( RingQueues, RING_QUEUE_INTERFACE )
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                     THREAD SAFE LIST                                        /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -70,4 +100,53 @@ typedef ThreadSafeMapData* ThreadSafeMap;
 DECLARE_NAMESPACE_INTERFACE( ThreadSafeMaps, THREAD_SAFE_MAP_INTERFACE )
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                        SNAPSHOT MAP                                         /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Registry of fixed size items, identified by keys given on insertion (increasing, never reused), for lookups and 
+// iteration that never block. Adding or removing items publishes a new (copied) snapshot of the keys list, while 
+// readers keep using the one they started with. AquireItem gives shared (not exclusive) access to an item until 
+// ReleaseItem, and RunForAllItems calls the operator for each item of the current snapshot. RemoveItem waits for 
+// all readers of the item to finish before copying it out and freeing it, so it should not be called while holding 
+// the same item or from inside RunForAllItems
+
+typedef struct _SnapshotMapData SnapshotMapData;
+typedef SnapshotMapData* SnapshotMap;
+
+#define SNAPSHOT_MAP_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( SnapshotMap, Namespace, Create, size_t ) \
+        INIT_FUNCTION( void, Namespace, Discard, SnapshotMap ) \
+        INIT_FUNCTION( size_t, Namespace, GetItemsCount, SnapshotMap ) \
+        INIT_FUNCTION( unsigned long, Namespace, AddItem, SnapshotMap, const void* ) \
+        INIT_FUNCTION( bool, Namespace, RemoveItem, SnapshotMap, unsigned long, void* ) \
+        INIT_FUNCTION( void*, Namespace, AquireItem, SnapshotMap, unsigned long ) \
+        INIT_FUNCTION( void, Namespace, ReleaseItem, SnapshotMap, void* ) \
+        INIT_FUNCTION( void, Namespace, RunForAllItems, SnapshotMap, void (*)( void* ) )
+
+DECLARE_NAMESPACE_INTERFACE( SnapshotMaps, SNAPSHOT_MAP_INTERFACE )
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                    WAIT-FREE TRIPLE BUFFER                                  /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Single producer/single consumer handoff of fixed size data blocks. The writer fills its back buffer and
+// publishes it as a whole. The reader gets the latest published block (intermediate ones may be dropped).
+// Neither side ever blocks or sees a partially written block
+
+typedef struct _TripleBufferData TripleBufferData;
+typedef TripleBufferData* TripleBuffer;
+
+#define TRIPLE_BUFFER_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( TripleBuffer, Namespace, Create, size_t ) \
+        INIT_FUNCTION( void, Namespace, Discard, TripleBuffer ) \
+        INIT_FUNCTION( void*, Namespace, GetWriteBuffer, TripleBuffer ) \
+        INIT_FUNCTION( void, Namespace, Publish, TripleBuffer ) \
+        INIT_FUNCTION( bool, Namespace, Update, TripleBuffer ) \
+        INIT_FUNCTION( void*, Namespace, GetReadBuffer, TripleBuffer )
+
+DECLARE_NAMESPACE_INTERFACE( TripleBuffers, TRIPLE_BUFFER_INTERFACE )
+
+
 #endif /* THREAD_SAFE_DATA_H */
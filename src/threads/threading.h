@@ -7,6 +7,8 @@
 #define THREADING_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #include "namespaces.h"
 
@@ -27,9 +29,25 @@ enum { THREAD_DETACHED, THREAD_JOINABLE };
 typedef void* Thread;
 typedef void* (*AsyncFunction)( void* );
 
+// Scheduling classes for threads started with a specification. DEFAULT keeps the system time-sharing policy
+enum ThreadSchedulingPolicy { THREAD_SCHED_DEFAULT, THREAD_SCHED_FIFO, THREAD_SCHED_ROUND_ROBIN, THREAD_SCHED_POLICIES_NUMBER };
+
+// Real-time attributes for a new thread (zeroed fields keep system defaults)
+typedef struct _ThreadSpec
+{
+  enum ThreadSchedulingPolicy schedulingPolicy;
+  int priority;                                 // Policy dependent priority value (clamped to the system valid range)
+  uint64_t cpuAffinityMask;                     // Bit N allows running on CPU N (0 for any CPU)
+  size_t stackSize;                             // Stack size to be reserved and pre-faulted before running the thread function
+  bool useIsolatedCores;                        // Restrict affinity to the CPUs isolated from the kernel scheduler, if any
+}
+ThreadSpec;
+
 #define THREAD_INTERFACE( Namespace, INIT_FUNCTION ) \
         INIT_FUNCTION( Thread, Namespace, StartThread, AsyncFunction, void*, int ) \
+        INIT_FUNCTION( Thread, Namespace, StartThreadSpec, AsyncFunction, void*, int, const ThreadSpec* ) \
         INIT_FUNCTION( uint32_t, Namespace, WaitExit, Thread, unsigned int ) \
+        INIT_FUNCTION( void, Namespace, YieldThread, void ) \
         INIT_FUNCTION( unsigned long, Namespace, GetCurrentThreadID, void )
 
 DECLARE_NAMESPACE_INTERFACE( Threading, THREAD_INTERFACE )
@@ -65,10 +83,46 @@ typedef SemaphoreData* Semaphore;
         INIT_FUNCTION( void, Namespace, Discard, Semaphore ) \
         INIT_FUNCTION( void, Namespace, Increment, Semaphore ) \
         INIT_FUNCTION( void, Namespace, Decrement, Semaphore ) \
+        INIT_FUNCTION( bool, Namespace, TimedDecrement, Semaphore, uint64_t ) \
         INIT_FUNCTION( size_t, Namespace, GetCount, Semaphore ) \
         INIT_FUNCTION( void, Namespace, SetCount, Semaphore, size_t )
 
 DECLARE_NAMESPACE_INTERFACE( Semaphores, SEMAPHORE_INTERFACE )
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                  NAMED (INTER-PROCESS) WAKE EVENT                           /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Events opened with the same name (in any thread or process) share state. Unnamed (NULL) ones are
+// private to the process. Signals are coalesced: a waiter wakes once for all signals issued since its
+// last wait. Signaling is wait-free, and only enters the kernel when somebody is waiting
+
+typedef struct _WakeEventData WakeEventData;
+typedef WakeEventData* WakeEvent;
+
+#define WAKE_EVENT_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( WakeEvent, Namespace, Create, const char* ) \
+        INIT_FUNCTION( void, Namespace, Discard, WakeEvent ) \
+        INIT_FUNCTION( void, Namespace, Signal, WakeEvent ) \
+        INIT_FUNCTION( bool, Namespace, Wait, WakeEvent, uint64_t )
+
+DECLARE_NAMESPACE_INTERFACE( WakeEvents, WAKE_EVENT_INTERFACE )
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                     WAIT ON WORD (FUTEX)                                    /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sleeping until a 32 bits word (of the same process) changes from the expected value, or the timeout (nanoseconds) expires.
+// Wait returns right away if the word already holds another value. Waking only enters the kernel on platforms without
+// user space waiting support (sleeping is then a short polling delay)
+
+#define WAIT_WORD_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( void, Namespace, Wait, uint32_t*, uint32_t, uint64_t ) \
+        INIT_FUNCTION( void, Namespace, WakeAll, uint32_t* )
+
+DECLARE_NAMESPACE_INTERFACE( WaitWords, WAIT_WORD_INTERFACE )
+
+
 #endif /* THREADING_H */
@@ -25,17 +25,34 @@
 ///// using low level operating system native methods (Posix Version)     /////
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifndef _GNU_SOURCE
+  #define _GNU_SOURCE   // CPU affinity extensions
+#endif
+
 #include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <unistd.h>
 #include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <errno.h>
 #include <malloc.h>
+#include <alloca.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#ifdef __linux__
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+#endif
 
 #include "debug/sync_debug.h"
 
 #include "threads/threading.h"
+#include "threads/atomic_operations.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 /////                                      THREADS HANDLING                                       /////
@@ -69,6 +86,163 @@ Thread Threading_StartThread( void* (*function)( void* ), void* args, int mode )
   return (Thread) handle;
 }
 
+typedef struct _ThreadLauncher
+{
+  AsyncFunction function;
+  void* args;
+  bool prefaultStack;
+}
+ThreadLauncher;
+
+// Touch every page of the thread stack below the calling frame, so that the thread function never takes a page fault on it.
+// Space above it (static TLS and thread descriptor) is already in use, and the guard area below the bounds is left out
+static void PrefaultStack( void )
+{
+  const size_t PAGE_SIZE = (size_t) sysconf( _SC_PAGESIZE );
+  
+  pthread_attr_t attributes;
+  if( pthread_getattr_np( pthread_self(), &attributes ) != 0 ) return;
+  void* stackAddress;
+  size_t stackSize, guardSize;
+  pthread_attr_getstack( &attributes, &stackAddress, &stackSize );
+  pthread_attr_getguardsize( &attributes, &guardSize );
+  pthread_attr_destroy( &attributes );
+  
+  // Bounds may or may not include the guard area, depending on the implementation: it is skipped either way.
+  // A page is kept for this function own frame
+  uintptr_t stackBottom = (uintptr_t) stackAddress + guardSize + PAGE_SIZE;
+  uintptr_t stackCurrent = (uintptr_t) &stackBottom;
+  if( stackCurrent <= stackBottom ) return;
+  size_t prefaultSize = (size_t) ( stackCurrent - stackBottom );
+  
+  volatile uint8_t* stackArea = (volatile uint8_t*) alloca( prefaultSize );
+  for( size_t byteIndex = 0; byteIndex < prefaultSize; byteIndex += PAGE_SIZE )
+  {
+    stackArea[ byteIndex ] = 0;
+    (void) stackArea[ byteIndex ];
+  }
+}
+
+static void* LaunchThread( void* ref_launcher )
+{
+  ThreadLauncher launcher = *((ThreadLauncher*) ref_launcher);
+  free( ref_launcher );
+  
+  if( launcher.prefaultStack ) PrefaultStack();
+  
+  return launcher.function( launcher.args );
+}
+
+// Read CPUs list (e.g. "2-3,6") reserved by the isolcpus kernel parameter
+static uint64_t GetIsolatedCoresMask()
+{
+  uint64_t isolatedCoresMask = 0;
+  unsigned int firstCore, lastCore;
+  
+  FILE* isolatedCoresFile = fopen( "/sys/devices/system/cpu/isolated", "r" );
+  if( isolatedCoresFile == NULL ) return 0;
+  
+  while( fscanf( isolatedCoresFile, "%u", &firstCore ) == 1 )
+  {
+    lastCore = firstCore;
+    int separator = fgetc( isolatedCoresFile );
+    if( separator == '-' )
+    {
+      if( fscanf( isolatedCoresFile, "%u", &lastCore ) != 1 ) break;
+      separator = fgetc( isolatedCoresFile );
+    }
+    
+    for( unsigned int coreIndex = firstCore; coreIndex <= lastCore && coreIndex < 64; coreIndex++ )
+      isolatedCoresMask |= ( 1ULL << coreIndex );
+    
+    if( separator != ',' ) break;
+  }
+  
+  fclose( isolatedCoresFile );
+  
+  return isolatedCoresMask;
+}
+
+// Setup new thread with the given real-time attributes to run the given method asyncronously
+Thread Threading_StartThreadSpec( AsyncFunction function, void* args, int mode, const ThreadSpec* spec )
+{
+  if( spec == NULL ) return Threading_StartThread( function, args, mode );
+  
+  pthread_attr_t attributes;
+  pthread_attr_init( &attributes );
+  
+  ThreadLauncher* launcher = (ThreadLauncher*) malloc( sizeof(ThreadLauncher) );
+  launcher->function = function;
+  launcher->args = args;
+  launcher->prefaultStack = false;
+  
+  if( spec->stackSize > 0 )
+  {
+    size_t stackSize = ( spec->stackSize > (size_t) PTHREAD_STACK_MIN ) ? spec->stackSize : (size_t) PTHREAD_STACK_MIN;
+    pthread_attr_setstacksize( &attributes, stackSize );
+    launcher->prefaultStack = true;
+  }
+  
+  if( spec->schedulingPolicy == THREAD_SCHED_FIFO || spec->schedulingPolicy == THREAD_SCHED_ROUND_ROBIN )
+  {
+    int policy = ( spec->schedulingPolicy == THREAD_SCHED_FIFO ) ? SCHED_FIFO : SCHED_RR;
+    struct sched_param schedulingParameters = { .sched_priority = spec->priority };
+    if( schedulingParameters.sched_priority < sched_get_priority_min( policy ) ) schedulingParameters.sched_priority = sched_get_priority_min( policy );
+    if( schedulingParameters.sched_priority > sched_get_priority_max( policy ) ) schedulingParameters.sched_priority = sched_get_priority_max( policy );
+    
+    pthread_attr_setinheritsched( &attributes, PTHREAD_EXPLICIT_SCHED );
+    pthread_attr_setschedpolicy( &attributes, policy );
+    pthread_attr_setschedparam( &attributes, &schedulingParameters );
+  }
+  
+  uint64_t affinityMask = spec->cpuAffinityMask;
+  if( spec->useIsolatedCores )
+  {
+    uint64_t isolatedCoresMask = GetIsolatedCoresMask();
+    if( isolatedCoresMask == 0 ) DEBUG_PRINT( "no isolated cores available for thread function %p", function );
+    else affinityMask = ( affinityMask & isolatedCoresMask ) ? ( affinityMask & isolatedCoresMask ) : isolatedCoresMask;
+  }
+  
+  if( affinityMask != 0 )
+  {
+    cpu_set_t coresSet;
+    CPU_ZERO( &coresSet );
+    for( int coreIndex = 0; coreIndex < 64; coreIndex++ )
+    {
+      if( affinityMask & ( 1ULL << coreIndex ) ) CPU_SET( coreIndex, &coresSet );
+    }
+    pthread_attr_setaffinity_np( &attributes, sizeof(cpu_set_t), &coresSet );
+  }
+  
+  pthread_t* handle = (pthread_t*) malloc( sizeof(pthread_t) );
+  
+  int creationStatus = pthread_create( handle, &attributes, LaunchThread, launcher );
+  if( creationStatus == EPERM ) // Not allowed to use real-time policies: run anyway, with inherited scheduling
+  {
+    DEBUG_PRINT( "no permission for real-time scheduling of thread function %p. Using default policy", function );
+    pthread_attr_setinheritsched( &attributes, PTHREAD_INHERIT_SCHED );
+    creationStatus = pthread_create( handle, &attributes, LaunchThread, launcher );
+  }
+  
+  pthread_attr_destroy( &attributes );
+  
+  if( creationStatus != 0 )
+  {
+    errno = creationStatus;
+    ERROR_PRINT( "pthread_create: failed creating new thread with function %p", function );
+    free( launcher );
+    free( handle );
+    return THREAD_INVALID_HANDLE;
+  }
+  
+  DEBUG_PRINT( "created thread %p successfully (policy: %d - priority: %d - affinity: %lx - stack: %lu)", handle, 
+               spec->schedulingPolicy, spec->priority, (unsigned long) affinityMask, spec->stackSize );
+  
+  if( mode == THREAD_DETACHED ) pthread_detach( *handle );
+
+  return (Thread) handle;
+}
+
 // Waiter function to be called asyncronously
 static void* Waiter( void *args )
 {
@@ -139,6 +313,12 @@ uint32_t Threading_WaitExit( Thread handle, unsigned int milisseconds )
   return 0;
 }
 
+// Gives the processor away to other ready threads (e.g. while waiting for one of them)
+void Threading_YieldThread()
+{
+  (void) sched_yield();
+}
+
 unsigned long Threading_GetCurrentThreadID()
 {
   return (unsigned long) pthread_self();
@@ -174,6 +354,16 @@ void ThreadLocks_Release( ThreadLock lock ) { pthread_mutex_unlock( (pthread_mut
 /////                                       THREAD SEMAPHORE                                      /////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Timed waits take monotonic deadlines where supported (sem_clockwait, glibc 2.30), so that system clock steps
+// do not stretch or cut them
+#if defined( __GLIBC__ ) && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 30 ) )
+  #define SEMAPHORE_CLOCK CLOCK_MONOTONIC
+  #define SEMAPHORE_TIMED_WAIT( ref_semaphore, ref_deadline ) sem_clockwait( (ref_semaphore), CLOCK_MONOTONIC, (ref_deadline) )
+#else
+  #define SEMAPHORE_CLOCK CLOCK_REALTIME
+  #define SEMAPHORE_TIMED_WAIT( ref_semaphore, ref_deadline ) sem_timedwait( (ref_semaphore), (ref_deadline) )
+#endif
+
 struct _SemaphoreData
 {
   sem_t upCounter;
@@ -213,6 +403,29 @@ void Semaphores_Decrement( Semaphore sem )
   sem_post( &(sem->upCounter) ); 
 }
 
+// Decrement only if the count becomes positive before the given timeout (in nanoseconds)
+bool Semaphores_TimedDecrement( Semaphore sem, uint64_t timeoutNanoseconds )
+{
+  struct timespec timeoutTime;
+  
+  clock_gettime( SEMAPHORE_CLOCK, &timeoutTime );
+  timeoutTime.tv_sec += (time_t) ( timeoutNanoseconds / 1000000000 );
+  timeoutTime.tv_nsec += (long) ( timeoutNanoseconds % 1000000000 );
+  if( timeoutTime.tv_nsec >= 1000000000 )
+  {
+    timeoutTime.tv_sec++;
+    timeoutTime.tv_nsec -= 1000000000;
+  }
+  
+  while( SEMAPHORE_TIMED_WAIT( &(sem->downCounter), &timeoutTime ) == -1 )
+  {
+    if( errno != EINTR ) return false;
+  }
+  sem_post( &(sem->upCounter) );
+  
+  return true;
+}
+
 size_t Semaphores_GetCount( Semaphore sem )
 {
   int countValue;
@@ -239,3 +452,196 @@ void Semaphores_SetCount( Semaphore sem, size_t count )
     }
   }
 }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                  NAMED (INTER-PROCESS) WAKE EVENT                           /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Futex word and waiters count, on a POSIX shared memory object (so that other processes can use it)
+typedef struct _WakeEventState
+{
+  uint32_t signalsCount;
+  uint32_t waitersCount;
+}
+WakeEventState;
+
+// Named events hold a shared lock on their object while open, released by the system even if their process crashes.
+// The one that gets an exclusive lock when discarded is the last live user, and removes the object name
+struct _WakeEventData
+{
+  WakeEventState* state;
+  uint32_t lastSignalsCount;
+  char objectName[ NAME_MAX ];
+  int objectFD;                                       // -1 for unnamed events
+};
+
+DEFINE_NAMESPACE_INTERFACE( WakeEvents, WAKE_EVENT_INTERFACE )
+
+// Checks if the opened object is still the named one (not removed by its last user meanwhile)
+static bool IsEventObjectLinked( const char* objectName, int objectFD )
+{
+  struct stat openedStatus, namedStatus;
+  if( fstat( objectFD, &openedStatus ) == -1 ) return false;
+  
+  int namedFD = shm_open( objectName, O_RDONLY, 0 );
+  if( namedFD == -1 ) return false;
+  bool isLinked = ( fstat( namedFD, &namedStatus ) == 0 && namedStatus.st_dev == openedStatus.st_dev && namedStatus.st_ino == openedStatus.st_ino );
+  close( namedFD );
+  
+  return isLinked;
+}
+
+// Unnamed events are private to the process (anonymous mapping)
+WakeEvent WakeEvents_Create( const char* name )
+{
+  char objectName[ NAME_MAX ] = "";
+  int objectFD = -1;
+  if( name != NULL )
+  {
+    snprintf( objectName, NAME_MAX, "/%s", name );
+    
+    // Object may be removed by its last user between opening and locking it: it is then opened (created) again
+    bool isLinked = false;
+    while( !isLinked )
+    {
+      if( (objectFD = shm_open( objectName, O_CREAT | O_RDWR, 0660 )) == -1 )
+      {
+        perror( "shm_open: error opening wake event object" );
+        return NULL;
+      }
+      
+      if( flock( objectFD, LOCK_SH ) == -1 )
+      {
+        perror( "flock: error locking wake event object" );
+        close( objectFD );
+        return NULL;
+      }
+      
+      if( !(isLinked = IsEventObjectLinked( objectName, objectFD )) ) close( objectFD );
+    }
+    
+    // New objects are zero filled. Existing ones keep their state
+    if( ftruncate( objectFD, sizeof(WakeEventState) ) == -1 )
+    {
+      perror( "ftruncate: error resizing wake event object" );
+      close( objectFD );
+      return NULL;
+    }
+  }
+  
+  int mappingFlags = ( objectFD == -1 ) ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED;
+  void* stateMapping = mmap( NULL, sizeof(WakeEventState), PROT_READ | PROT_WRITE, mappingFlags, objectFD, 0 );
+  if( stateMapping == MAP_FAILED )
+  {
+    perror( "mmap: error mapping wake event object" );
+    if( objectFD != -1 ) close( objectFD );
+    return NULL;
+  }
+  
+  WakeEvent event = (WakeEvent) malloc( sizeof(WakeEventData) );
+  event->state = (WakeEventState*) stateMapping;
+  event->lastSignalsCount = ATOMIC_LOAD( &(event->state->signalsCount) );
+  strncpy( event->objectName, objectName, NAME_MAX );
+  event->objectFD = objectFD;
+  
+  DEBUG_PRINT( "wake event %s opened (%p)", objectName, event->state );
+  
+  return event;
+}
+
+// Shared object is only unlinked by its last user, as other processes may still be using it
+void WakeEvents_Discard( WakeEvent event )
+{
+  if( event == NULL ) return;
+  
+  munmap( (void*) event->state, sizeof(WakeEventState) );
+  
+  if( event->objectFD != -1 )
+  {
+    // Shared lock is dropped before trying the exclusive one, so that concurrent last users do not block each other out
+    (void) flock( event->objectFD, LOCK_UN );
+    if( flock( event->objectFD, LOCK_EX | LOCK_NB ) == 0 && IsEventObjectLinked( event->objectName, event->objectFD ) )
+    {
+      DEBUG_PRINT( "removing wake event %s", event->objectName );
+      (void) shm_unlink( event->objectName );
+    }
+    close( event->objectFD );
+  }
+  
+  free( event );
+}
+
+void WakeEvents_Signal( WakeEvent event )
+{
+  if( event == NULL ) return;
+  
+  (void) ATOMIC_FETCH_ADD( &(event->state->signalsCount), 1 );
+  // Counter increment must be visible before checking for waiters (paired with Wait)
+  ATOMIC_THREAD_FENCE();
+#ifdef __linux__
+  if( ATOMIC_LOAD( &(event->state->waitersCount) ) > 0 )
+    syscall( SYS_futex, &(event->state->signalsCount), FUTEX_WAKE, INT_MAX, NULL, NULL, 0 );
+#endif
+}
+
+// Returns true if signaled since the last wait, or false on timeout
+bool WakeEvents_Wait( WakeEvent event, uint64_t timeoutNs )
+{
+  const struct timespec TIMEOUT = { .tv_sec = (time_t) ( timeoutNs / 1000000000 ), .tv_nsec = (long) ( timeoutNs % 1000000000 ) };
+  
+  if( event == NULL ) 
+  {
+    nanosleep( &TIMEOUT, NULL );
+    return false;
+  }
+  
+  uint32_t signalsCount = ATOMIC_LOAD( &(event->state->signalsCount) );
+  if( signalsCount == event->lastSignalsCount )
+  {
+#ifdef __linux__
+    (void) ATOMIC_FETCH_ADD( &(event->state->waitersCount), 1 );
+    ATOMIC_THREAD_FENCE();
+    // Only sleeps if no signal arrived since the counter was read (relative timeout)
+    syscall( SYS_futex, &(event->state->signalsCount), FUTEX_WAIT, signalsCount, &TIMEOUT, NULL, 0 );
+    (void) ATOMIC_FETCH_ADD( &(event->state->waitersCount), -1 );
+#else
+    nanosleep( &TIMEOUT, NULL );
+#endif
+    signalsCount = ATOMIC_LOAD( &(event->state->signalsCount) );
+  }
+  
+  bool isSignaled = ( signalsCount != event->lastSignalsCount );
+  event->lastSignalsCount = signalsCount;
+  
+  return isSignaled;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                     WAIT ON WORD (FUTEX)                                    /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Without futexes, waiters poll the word every millisecond at most
+#define WAIT_WORD_POLLING_NS 1000000
+
+DEFINE_NAMESPACE_INTERFACE( WaitWords, WAIT_WORD_INTERFACE )
+
+void WaitWords_Wait( uint32_t* ref_word, uint32_t expectedValue, uint64_t timeoutNs )
+{
+#ifdef __linux__
+  const struct timespec TIMEOUT = { .tv_sec = (time_t) ( timeoutNs / 1000000000 ), .tv_nsec = (long) ( timeoutNs % 1000000000 ) };
+  syscall( SYS_futex, ref_word, FUTEX_WAIT_PRIVATE, expectedValue, &TIMEOUT, NULL, 0 );
+#else
+  if( timeoutNs > WAIT_WORD_POLLING_NS ) timeoutNs = WAIT_WORD_POLLING_NS;
+  const struct timespec TIMEOUT = { .tv_sec = 0, .tv_nsec = (long) timeoutNs };
+  if( ATOMIC_LOAD( ref_word ) == expectedValue ) nanosleep( &TIMEOUT, NULL );
+#endif
+}
+
+void WaitWords_WakeAll( uint32_t* ref_word )
+{
+#ifdef __linux__
+  syscall( SYS_futex, ref_word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+#endif
+}
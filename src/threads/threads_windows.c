@@ -58,6 +58,40 @@ Thread Threading_StartThread( AsyncFunction function, void* args, int mode )
   return (Thread) handle;
 }
 
+// Setup new thread with the given priority attributes to run the given method asyncronously (isolated cores hint is ignored)
+Thread Threading_StartThreadSpec( AsyncFunction function, void* args, int mode, const ThreadSpec* spec )
+{
+  static HANDLE handle;
+  static unsigned int threadID;
+  
+  if( spec == NULL ) return Threading_StartThread( function, args, mode );
+  
+  if( (handle = CreateThread( NULL, (SIZE_T) spec->stackSize, (LPTHREAD_START_ROUTINE) function, args, CREATE_SUSPENDED, &threadID )) == THREAD_INVALID_HANDLE )
+  {
+    ERROR_PRINT( "CreateThread: failed creating new thread with function %p", function );
+    return THREAD_INVALID_HANDLE;
+  }
+  
+  if( spec->schedulingPolicy == THREAD_SCHED_FIFO )
+    SetThreadPriority( handle, THREAD_PRIORITY_TIME_CRITICAL );
+  else if( spec->schedulingPolicy == THREAD_SCHED_ROUND_ROBIN )
+    SetThreadPriority( handle, THREAD_PRIORITY_HIGHEST );
+  
+  if( spec->cpuAffinityMask != 0 )
+  {
+    if( SetThreadAffinityMask( handle, (DWORD_PTR) spec->cpuAffinityMask ) == 0 )
+      ERROR_PRINT( "SetThreadAffinityMask: failed setting thread %x affinity: code: %x", handle, GetLastError() );
+  }
+  
+  ResumeThread( handle );
+  
+  DEBUG_PRINT( "created thread %x successfully", handle );
+  
+  if( mode == THREAD_DETACHED ) CloseHandle( handle );
+
+  return (Thread) handle;
+}
+
 // Wait for the thread of the given manipulator to exit and return its exiting value
 uint32_t Threading_WaitExit( Thread handle, unsigned int milliseconds )
 {
@@ -89,6 +123,12 @@ uint32_t Threading_WaitExit( Thread handle, unsigned int milliseconds )
   return exitCode;
 }
 
+// Gives the processor away to other ready threads (e.g. while waiting for one of them)
+void Threading_YieldThread()
+{
+  (void) SwitchToThread();
+}
+
 unsigned long Threading_GetCurrentThreadID()
 {
   return GetCurrentThreadId();
@@ -160,6 +200,17 @@ void Semaphores_Decrement( Semaphore sem )
   sem->count--;
 }
 
+// Decrement only if the count becomes positive before the given timeout (rounded up to milliseconds)
+bool Semaphores_TimedDecrement( Semaphore sem, uint64_t timeoutNanoseconds )
+{
+  DWORD timeoutMilliseconds = (DWORD) ( ( timeoutNanoseconds + 999999 ) / 1000000 );
+  
+  if( WaitForSingleObject( sem->counter, timeoutMilliseconds ) != WAIT_OBJECT_0 ) return false;
+  sem->count--;
+  
+  return true;
+}
+
 size_t Semaphores_GetCount( Semaphore sem )
 {
   if( sem == NULL ) return 0;
@@ -185,3 +236,78 @@ void Semaphores_SetCount( Semaphore sem, size_t count )
       Semaphores_Decrement( sem ); 
   }
 }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                  NAMED (INTER-PROCESS) WAKE EVENT                           /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Auto-reset kernel event: stays signaled (once) until a waiter returns
+struct _WakeEventData
+{
+  HANDLE event;
+};
+
+DEFINE_NAMESPACE_INTERFACE( WakeEvents, WAKE_EVENT_INTERFACE )
+
+WakeEvent WakeEvents_Create( const char* name )
+{
+  HANDLE eventHandle = CreateEventA( NULL, FALSE, FALSE, name );
+  if( eventHandle == NULL ) return NULL;
+  
+  WakeEvent event = (WakeEvent) malloc( sizeof(WakeEventData) );
+  event->event = eventHandle;
+  
+  return event;
+}
+
+void WakeEvents_Discard( WakeEvent event )
+{
+  if( event == NULL ) return;
+  
+  CloseHandle( event->event );
+  free( event );
+}
+
+void WakeEvents_Signal( WakeEvent event )
+{
+  if( event == NULL ) return;
+  
+  SetEvent( event->event );
+}
+
+// Returns true if signaled since the last wait, or false on timeout (rounded up to milliseconds)
+bool WakeEvents_Wait( WakeEvent event, uint64_t timeoutNanoseconds )
+{
+  DWORD timeoutMilliseconds = (DWORD) ( ( timeoutNanoseconds + 999999 ) / 1000000 );
+  
+  if( event == NULL )
+  {
+    Sleep( timeoutMilliseconds );
+    return false;
+  }
+  
+  return ( WaitForSingleObject( event->event, timeoutMilliseconds ) == WAIT_OBJECT_0 );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/////                                     WAIT ON WORD (FUTEX)                                    /////
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// WaitOnAddress (Windows 8 or later) requires linking with Synchronization.lib
+#pragma comment( lib, "Synchronization.lib" )
+
+DEFINE_NAMESPACE_INTERFACE( WaitWords, WAIT_WORD_INTERFACE )
+
+void WaitWords_Wait( uint32_t* ref_word, uint32_t expectedValue, uint64_t timeoutNanoseconds )
+{
+  DWORD timeoutMilliseconds = (DWORD) ( ( timeoutNanoseconds + 999999 ) / 1000000 );
+  
+  (void) WaitOnAddress( (volatile VOID*) ref_word, &expectedValue, sizeof(uint32_t), timeoutMilliseconds );
+}
+
+void WaitWords_WakeAll( uint32_t* ref_word )
+{
+  WakeByAddressAll( (PVOID) ref_word );
+}
@@ -1,18 +1,65 @@
 ///////////////////////////////////////////////////////////////////////////////
-///// Wrapper library for time measurement and thread sleeping (blocking) ///// 
+///// Wrapper library for time measurement and thread sleeping (blocking) /////
 ///// using low level operating system native methods                     /////
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef TIMING_H
 #define TIMING_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "namespaces.h"
 
+// Monotonic time in nanoseconds, with arbitrary (but process-wide) origin. Shared by logging, sensors and network packets
+typedef uint64_t Timestamp;
+
+#define TIMESTAMP_INVALID 0
+#define TIMESTAMP_TO_SECONDS( timestamp ) ( (double) (timestamp) / 1000000000.0 )
+#define TIMESTAMP_TO_MICROSECONDS( timestamp ) ( (timestamp) / 1000 )
+
+// Init sets up the time source (e.g. calibrating the time stamp counter), which otherwise happens on the first time
+// reading. It should be called on startup, before any time critical thread runs
 #define TIMING_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( void, Namespace, Init, void ) \
         INIT_FUNCTION( void, Namespace, Delay, unsigned long ) \
         INIT_FUNCTION( unsigned long, Namespace, GetExecTimeMilliseconds, void ) \
-        INIT_FUNCTION( double, Namespace, GetExecTimeSeconds, void )
+        INIT_FUNCTION( double, Namespace, GetExecTimeSeconds, void ) \
+        INIT_FUNCTION( Timestamp, Namespace, GetExecTimeNanoseconds, void )
 
 DECLARE_NAMESPACE_INTERFACE( Timing, TIMING_INTERFACE )
 
+
+///////////////////////////////////////////////////////////////////////////////
+/////                  PERIODIC (ABSOLUTE DEADLINE) TIMER                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+// What to do when a cycle ends after its deadline. SKIP drops the lost periods and
+// waits for the next deadline in the original time grid. CATCH_UP runs the next
+// cycle immediately, keeping the cycles count but shortening the following periods
+enum TimerOverrunPolicy { TIMER_OVERRUN_SKIP, TIMER_OVERRUN_CATCH_UP, TIMER_OVERRUN_POLICIES_NUMBER };
+
+typedef struct _PeriodicTimerStats
+{
+  uint64_t cyclesCount;
+  uint64_t missedDeadlinesCount;
+  uint64_t skippedCyclesCount;
+  uint64_t worstLatenessNanoseconds;
+  enum TimerOverrunPolicy overrunPolicy;
+}
+PeriodicTimerStats;
+
+typedef struct _PeriodicTimerData PeriodicTimerData;
+typedef PeriodicTimerData* PeriodicTimer;
+
+#define PERIODIC_TIMER_INTERFACE( Namespace, INIT_FUNCTION ) \
+        INIT_FUNCTION( PeriodicTimer, Namespace, Create, uint64_t, enum TimerOverrunPolicy ) \
+        INIT_FUNCTION( void, Namespace, Discard, PeriodicTimer ) \
+        INIT_FUNCTION( void, Namespace, Start, PeriodicTimer ) \
+        INIT_FUNCTION( bool, Namespace, WaitNextCycle, PeriodicTimer ) \
+        INIT_FUNCTION( bool, Namespace, WaitCyclePhase, PeriodicTimer, uint64_t ) \
+        INIT_FUNCTION( bool, Namespace, GetStats, PeriodicTimer, PeriodicTimerStats* )
+
+DECLARE_NAMESPACE_INTERFACE( PeriodicTimers, PERIODIC_TIMER_INTERFACE )
+
 #endif /* TIMING_H */
@@ -7,8 +7,17 @@
 
 #include <rtutil.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 DEFINE_NAMESPACE_INTERFACE( Timing, TIMING_INTERFACE )
 
+// No time source setup required
+void Timing_Init()
+{
+  return;
+}
+
 // Make the calling thread wait for the given time ( in milliseconds )
 inline void Timing_Delay( unsigned long milliseconds )
 {
@@ -28,3 +37,111 @@ inline double Timing_GetExecTimeSeconds()
 {
   return ( (double) GetTimeUS() ) / 1000000.0;
 }
+
+// Get system time in nanoseconds (microseconds resolution)
+inline Timestamp Timing_GetExecTimeNanoseconds()
+{
+  return (Timestamp) GetTimeUS() * 1000;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/////                  PERIODIC (ABSOLUTE DEADLINE) TIMER                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+struct _PeriodicTimerData
+{
+  unsigned long long nextDeadlineUS;
+  unsigned long long periodUS;
+  PeriodicTimerStats stats;
+};
+
+DEFINE_NAMESPACE_INTERFACE( PeriodicTimers, PERIODIC_TIMER_INTERFACE )
+
+PeriodicTimer PeriodicTimers_Create( uint64_t periodNanoseconds, enum TimerOverrunPolicy overrunPolicy )
+{
+  if( periodNanoseconds < 1000 ) return NULL;
+  
+  PeriodicTimer newTimer = (PeriodicTimer) malloc( sizeof(PeriodicTimerData) );
+  memset( newTimer, 0, sizeof(PeriodicTimerData) );
+  
+  newTimer->periodUS = (unsigned long long) ( periodNanoseconds / 1000 );
+  newTimer->stats.overrunPolicy = ( overrunPolicy < TIMER_OVERRUN_POLICIES_NUMBER ) ? overrunPolicy : TIMER_OVERRUN_SKIP;
+  
+  PeriodicTimers_Start( newTimer );
+  
+  return newTimer;
+}
+
+void PeriodicTimers_Discard( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  free( timer );
+}
+
+void PeriodicTimers_Start( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  timer->nextDeadlineUS = GetTimeUS() + timer->periodUS;
+}
+
+// Only relative microseconds sleeps are available, so the remaining time to the absolute deadline is recomputed every cycle
+bool PeriodicTimers_WaitNextCycle( PeriodicTimer timer )
+{
+  if( timer == NULL ) return false;
+  
+  timer->stats.cyclesCount++;
+  
+  unsigned long long currentTimeUS = GetTimeUS();
+  bool deadlineMissed = ( currentTimeUS > timer->nextDeadlineUS );
+  if( deadlineMissed )
+  {
+    unsigned long long latenessUS = currentTimeUS - timer->nextDeadlineUS;
+    timer->stats.missedDeadlinesCount++;
+    if( 1000 * latenessUS > timer->stats.worstLatenessNanoseconds ) timer->stats.worstLatenessNanoseconds = 1000 * latenessUS;
+    
+    if( timer->stats.overrunPolicy == TIMER_OVERRUN_CATCH_UP )
+    {
+      timer->nextDeadlineUS += timer->periodUS;
+      return false;
+    }
+    
+    unsigned long long lostPeriodsNumber = latenessUS / timer->periodUS + 1;
+    timer->stats.skippedCyclesCount += lostPeriodsNumber;
+    timer->nextDeadlineUS += lostPeriodsNumber * timer->periodUS;
+  }
+  
+  SleepUS( (unsigned int) ( timer->nextDeadlineUS - currentTimeUS ) );
+  
+  timer->nextDeadlineUS += timer->periodUS;
+  
+  return !deadlineMissed;
+}
+
+// Sleep until the given offset from the start of the current cycle (false if that point has already passed)
+bool PeriodicTimers_WaitCyclePhase( PeriodicTimer timer, uint64_t phaseNanoseconds )
+{
+  if( timer == NULL ) return false;
+  
+  unsigned long long phaseUS = (unsigned long long) ( phaseNanoseconds / 1000 );
+  if( phaseUS >= timer->periodUS ) return false;
+  
+  unsigned long long phaseTimeUS = timer->nextDeadlineUS - timer->periodUS + phaseUS;
+  unsigned long long currentTimeUS = GetTimeUS();
+  if( currentTimeUS > phaseTimeUS ) return false;
+  
+  SleepUS( (unsigned int) ( phaseTimeUS - currentTimeUS ) );
+  
+  return true;
+}
+
+bool PeriodicTimers_GetStats( PeriodicTimer timer, PeriodicTimerStats* ref_stats )
+{
+  if( timer == NULL || ref_stats == NULL ) return false;
+  
+  *ref_stats = timer->stats;
+  
+  return true;
+}
@@ -28,9 +28,26 @@
 #include "time/timing.h"
 
 #include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Read the time stamp counter directly on x86-64, unless disabled at build time
+#if defined( __x86_64__ ) && !defined( TIMING_NO_TSC )
+  #define TIMING_USE_TSC
+  #include <pthread.h>
+  #include <cpuid.h>
+  #include <x86intrin.h>
+#endif
 
 DEFINE_NAMESPACE_INTERFACE( Timing, TIMING_INTERFACE )
 
+// Time source setup (takes a full calibration interval with the time stamp counter)
+void Timing_Init()
+{
+  (void) Timing_GetExecTimeNanoseconds();
+}
+
 // Make the calling thread wait for the given time ( in milliseconds )
 void Timing_Delay( unsigned long milliseconds )
 {
@@ -46,26 +63,246 @@ void Timing_Delay( unsigned long milliseconds )
 // Get system time in milisseconds
 unsigned long Timing_GetExecTimeMilliseconds()
 {
-  struct timespec systemTime;
-    
-  //clock_getres( CLOCK_MONOTONIC, &ts );
-  //printf( "time resolution: %ld s - %ld ns\n", ts.tv_sec, ts.tv_nsec );
-  
-  clock_gettime( CLOCK_MONOTONIC, &systemTime );
-    
-  unsigned long execTime = (unsigned long) ( 1000 * systemTime.tv_sec ) + (unsigned long) ( systemTime.tv_nsec / 1000000 );
-    
-  return execTime;
+  return (unsigned long) ( Timing_GetExecTimeNanoseconds() / 1000000 );
 }
 
 // Get system time in seconds
 double Timing_GetExecTimeSeconds()
+{
+  return TIMESTAMP_TO_SECONDS( Timing_GetExecTimeNanoseconds() );
+}
+
+static inline Timestamp GetClockNanoseconds()
 {
   struct timespec systemTime;
   
   clock_gettime( CLOCK_MONOTONIC, &systemTime );
+  
+  return (Timestamp) systemTime.tv_sec * 1000000000ULL + (Timestamp) systemTime.tv_nsec;
+}
+
+#ifdef TIMING_USE_TSC
+
+#define TSC_CALIBRATION_INTERVAL_NS 20000000ULL   // Reference clock interval used to measure the counter rate
+#define TSC_RESYNC_INTERVAL_NS 1000000000ULL      // Re-anchor to the system clock periodically, bounding the rate error drift
+
+static struct 
+{
+  bool isReliable;
+  uint64_t nanosecondsPerTick;                   // 32.32 fixed point conversion factor
+  uint64_t resyncTicks;
+}
+tscClock = { .isReliable = false };
+
+// Done on Init, or on the first time reading if not initialized
+static pthread_once_t tscCalibrationControl = PTHREAD_ONCE_INIT;
+
+// Per thread anchor, avoiding any synchronization on the fast path
+static __thread uint64_t anchorTicks = 0;
+static __thread Timestamp anchorNanoseconds = 0;
+static __thread Timestamp lastNanoseconds = 0;
+
+// Read system clock between two counter reads, so that both samples refer to the same instant
+static inline Timestamp GetClockSample( uint64_t* ref_ticks )
+{
+  uint64_t ticksBefore = __rdtsc();
+  Timestamp clockNanoseconds = GetClockNanoseconds();
+  uint64_t ticksAfter = __rdtsc();
+  
+  *ref_ticks = ticksBefore + ( ticksAfter - ticksBefore ) / 2;
+  
+  return clockNanoseconds;
+}
+
+static void CalibrateTSC()
+{
+  unsigned int eax, ebx, ecx, edx;
+  
+  // Only an invariant counter (constant rate across frequency and sleep states) can be used as a clock
+  if( __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx ) == 0 || ( edx & ( 1 << 8 ) ) == 0 ) return;
+  
+  uint64_t startTicks, endTicks;
+  Timestamp startNanoseconds = GetClockSample( &startTicks );
+  
+  struct timespec calibrationTime = { .tv_sec = 0, .tv_nsec = TSC_CALIBRATION_INTERVAL_NS };
+  while( nanosleep( &calibrationTime, &calibrationTime ) == -1 && errno == EINTR );
+  
+  Timestamp endNanoseconds = GetClockSample( &endTicks );
+  if( endTicks <= startTicks || endNanoseconds <= startNanoseconds ) return;
+  
+  tscClock.nanosecondsPerTick = ( ( endNanoseconds - startNanoseconds ) << 32 ) / ( endTicks - startTicks );
+  if( tscClock.nanosecondsPerTick == 0 ) return;
+  tscClock.resyncTicks = ( TSC_RESYNC_INTERVAL_NS << 32 ) / tscClock.nanosecondsPerTick;
+  
+  tscClock.isReliable = true;
+}
+
+// Get system time in nanoseconds. Uses the calibrated time stamp counter when it is invariant, system clock otherwise
+Timestamp Timing_GetExecTimeNanoseconds()
+{
+  (void) pthread_once( &tscCalibrationControl, CalibrateTSC );
+  
+  if( !tscClock.isReliable ) return GetClockNanoseconds();
+  
+  uint64_t elapsedTicks = __rdtsc() - anchorTicks;
+  if( anchorTicks == 0 || elapsedTicks > tscClock.resyncTicks )
+  {
+    anchorNanoseconds = GetClockSample( &anchorTicks );
+    elapsedTicks = 0;
+  }
+  
+  // Elapsed ticks are bounded by the resync interval, so the fixed point product never overflows
+  Timestamp currentNanoseconds = anchorNanoseconds + ( ( elapsedTicks * tscClock.nanosecondsPerTick ) >> 32 );
+  
+  // Re-anchoring may step back by the accumulated rate error: never go backwards on the same thread
+  if( currentNanoseconds < lastNanoseconds ) currentNanoseconds = lastNanoseconds;
+  lastNanoseconds = currentNanoseconds;
+  
+  return currentNanoseconds;
+}
+
+#else
+
+// Get system time in nanoseconds
+Timestamp Timing_GetExecTimeNanoseconds()
+{
+  return GetClockNanoseconds();
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/////                  PERIODIC (ABSOLUTE DEADLINE) TIMER                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+#define NANOSECONDS_PER_SECOND 1000000000LL
+
+struct _PeriodicTimerData
+{
+  struct timespec nextDeadline;
+  uint64_t periodNanoseconds;
+  PeriodicTimerStats stats;
+};
+
+DEFINE_NAMESPACE_INTERFACE( PeriodicTimers, PERIODIC_TIMER_INTERFACE )
+
+static inline void AddNanoseconds( struct timespec* ref_time, uint64_t nanoseconds )
+{
+  ref_time->tv_sec += (time_t) ( nanoseconds / NANOSECONDS_PER_SECOND );
+  ref_time->tv_nsec += (long) ( nanoseconds % NANOSECONDS_PER_SECOND );
+  if( ref_time->tv_nsec >= NANOSECONDS_PER_SECOND )
+  {
+    ref_time->tv_sec++;
+    ref_time->tv_nsec -= NANOSECONDS_PER_SECOND;
+  }
+}
+
+static inline void SubtractNanoseconds( struct timespec* ref_time, uint64_t nanoseconds )
+{
+  ref_time->tv_sec -= (time_t) ( nanoseconds / NANOSECONDS_PER_SECOND );
+  ref_time->tv_nsec -= (long) ( nanoseconds % NANOSECONDS_PER_SECOND );
+  if( ref_time->tv_nsec < 0 )
+  {
+    ref_time->tv_sec--;
+    ref_time->tv_nsec += NANOSECONDS_PER_SECOND;
+  }
+}
+
+static inline int64_t GetDifferenceNanoseconds( const struct timespec* ref_time, const struct timespec* ref_reference )
+{
+  return (int64_t) ( ref_time->tv_sec - ref_reference->tv_sec ) * NANOSECONDS_PER_SECOND + (int64_t) ( ref_time->tv_nsec - ref_reference->tv_nsec );
+}
+
+PeriodicTimer PeriodicTimers_Create( uint64_t periodNanoseconds, enum TimerOverrunPolicy overrunPolicy )
+{
+  if( periodNanoseconds == 0 ) return NULL;
+  
+  PeriodicTimer newTimer = (PeriodicTimer) malloc( sizeof(PeriodicTimerData) );
+  memset( newTimer, 0, sizeof(PeriodicTimerData) );
+  
+  newTimer->periodNanoseconds = periodNanoseconds;
+  newTimer->stats.overrunPolicy = ( overrunPolicy < TIMER_OVERRUN_POLICIES_NUMBER ) ? overrunPolicy : TIMER_OVERRUN_SKIP;
+  
+  PeriodicTimers_Start( newTimer );
+  
+  return newTimer;
+}
+
+void PeriodicTimers_Discard( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  free( timer );
+}
+
+// Realign the time grid: first deadline is one period from now
+void PeriodicTimers_Start( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  clock_gettime( CLOCK_MONOTONIC, &(timer->nextDeadline) );
+  AddNanoseconds( &(timer->nextDeadline), timer->periodNanoseconds );
+}
+
+// Block the calling thread until the next absolute deadline. Returns false if the current cycle missed it
+bool PeriodicTimers_WaitNextCycle( PeriodicTimer timer )
+{
+  struct timespec currentTime;
+  
+  if( timer == NULL ) return false;
+  
+  timer->stats.cyclesCount++;
+  
+  clock_gettime( CLOCK_MONOTONIC, &currentTime );
+  int64_t latenessNanoseconds = GetDifferenceNanoseconds( &currentTime, &(timer->nextDeadline) );
+  if( latenessNanoseconds > 0 )
+  {
+    timer->stats.missedDeadlinesCount++;
+    if( (uint64_t) latenessNanoseconds > timer->stats.worstLatenessNanoseconds ) timer->stats.worstLatenessNanoseconds = (uint64_t) latenessNanoseconds;
     
-  double execTime = (double) systemTime.tv_sec + ((double) systemTime.tv_nsec) / 1000000000.0;
+    if( timer->stats.overrunPolicy == TIMER_OVERRUN_CATCH_UP )
+    {
+      AddNanoseconds( &(timer->nextDeadline), timer->periodNanoseconds );
+      return false;
+    }
     
-  return execTime;
+    uint64_t lostPeriodsNumber = (uint64_t) latenessNanoseconds / timer->periodNanoseconds + 1;
+    timer->stats.skippedCyclesCount += lostPeriodsNumber;
+    AddNanoseconds( &(timer->nextDeadline), lostPeriodsNumber * timer->periodNanoseconds );
+  }
+  
+  while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &(timer->nextDeadline), NULL ) == EINTR );
+  
+  AddNanoseconds( &(timer->nextDeadline), timer->periodNanoseconds );
+  
+  return ( latenessNanoseconds <= 0 );
+}
+
+// Sleep until the given offset from the start of the current cycle (false if that point has already passed)
+bool PeriodicTimers_WaitCyclePhase( PeriodicTimer timer, uint64_t phaseNanoseconds )
+{
+  struct timespec currentTime, phaseTime;
+  
+  if( timer == NULL ) return false;
+  
+  if( phaseNanoseconds >= timer->periodNanoseconds ) return false;
+  
+  phaseTime = timer->nextDeadline;
+  SubtractNanoseconds( &phaseTime, timer->periodNanoseconds - phaseNanoseconds );
+  
+  clock_gettime( CLOCK_MONOTONIC, &currentTime );
+  if( GetDifferenceNanoseconds( &currentTime, &phaseTime ) > 0 ) return false;
+  
+  while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &phaseTime, NULL ) == EINTR );
+  
+  return true;
+}
+
+bool PeriodicTimers_GetStats( PeriodicTimer timer, PeriodicTimerStats* ref_stats )
+{
+  if( timer == NULL || ref_stats == NULL ) return false;
+  
+  *ref_stats = timer->stats;
+  
+  return true;
 }
@@ -28,11 +28,19 @@
 #include "time/timing.h"
 
 #include <Windows.h>
+#include <stdlib.h>
+#include <string.h>
 
 DEFINE_NAMESPACE_INTERFACE( Timing, TIMING_INTERFACE )
 
 LARGE_INTEGER TICKS_PER_SECOND;
 
+// Performance counter frequency is queried on every use
+void Timing_Init()
+{
+  QueryPerformanceFrequency( &TICKS_PER_SECOND );
+}
+
 // Make the calling thread wait for the given time ( in milliseconds )
 void Timing_Delay( unsigned long milliseconds )
 {
@@ -68,3 +76,137 @@ double Timing_GetExecTimeSeconds()
     
     return exec_time;
 }
+
+// Get system time in nanoseconds (resolution limited by the performance counter frequency)
+Timestamp Timing_GetExecTimeNanoseconds()
+{
+    LARGE_INTEGER ticks;
+    
+    QueryPerformanceFrequency( &TICKS_PER_SECOND );
+    QueryPerformanceCounter( &ticks );
+    
+    Timestamp seconds = (Timestamp) ( ticks.QuadPart / TICKS_PER_SECOND.QuadPart );
+    Timestamp remainingTicks = (Timestamp) ( ticks.QuadPart % TICKS_PER_SECOND.QuadPart );
+    
+    return seconds * 1000000000ULL + ( remainingTicks * 1000000000ULL ) / (Timestamp) TICKS_PER_SECOND.QuadPart;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/////                  PERIODIC (ABSOLUTE DEADLINE) TIMER                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+struct _PeriodicTimerData
+{
+  LONGLONG nextDeadlineTicks;
+  LONGLONG periodTicks;
+  PeriodicTimerStats stats;
+};
+
+DEFINE_NAMESPACE_INTERFACE( PeriodicTimers, PERIODIC_TIMER_INTERFACE )
+
+PeriodicTimer PeriodicTimers_Create( uint64_t periodNanoseconds, enum TimerOverrunPolicy overrunPolicy )
+{
+  if( periodNanoseconds == 0 ) return NULL;
+  
+  PeriodicTimer newTimer = (PeriodicTimer) malloc( sizeof(PeriodicTimerData) );
+  memset( newTimer, 0, sizeof(PeriodicTimerData) );
+  
+  QueryPerformanceFrequency( &TICKS_PER_SECOND );
+  newTimer->periodTicks = (LONGLONG) ( periodNanoseconds * TICKS_PER_SECOND.QuadPart / 1000000000ULL );
+  if( newTimer->periodTicks == 0 ) newTimer->periodTicks = 1;
+  newTimer->stats.overrunPolicy = ( overrunPolicy < TIMER_OVERRUN_POLICIES_NUMBER ) ? overrunPolicy : TIMER_OVERRUN_SKIP;
+  
+  PeriodicTimers_Start( newTimer );
+  
+  return newTimer;
+}
+
+void PeriodicTimers_Discard( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  free( timer );
+}
+
+void PeriodicTimers_Start( PeriodicTimer timer )
+{
+  LARGE_INTEGER ticks;
+  
+  if( timer == NULL ) return;
+  
+  QueryPerformanceCounter( &ticks );
+  timer->nextDeadlineTicks = ticks.QuadPart + timer->periodTicks;
+}
+
+// Windows has no absolute monotonic sleep: sleep the whole milliseconds left and spin the remainder
+bool PeriodicTimers_WaitNextCycle( PeriodicTimer timer )
+{
+  LARGE_INTEGER ticks;
+  
+  if( timer == NULL ) return false;
+  
+  timer->stats.cyclesCount++;
+  
+  QueryPerformanceCounter( &ticks );
+  LONGLONG latenessTicks = ticks.QuadPart - timer->nextDeadlineTicks;
+  if( latenessTicks > 0 )
+  {
+    uint64_t latenessNanoseconds = (uint64_t) ( latenessTicks * 1000000000LL / TICKS_PER_SECOND.QuadPart );
+    timer->stats.missedDeadlinesCount++;
+    if( latenessNanoseconds > timer->stats.worstLatenessNanoseconds ) timer->stats.worstLatenessNanoseconds = latenessNanoseconds;
+    
+    if( timer->stats.overrunPolicy == TIMER_OVERRUN_CATCH_UP )
+    {
+      timer->nextDeadlineTicks += timer->periodTicks;
+      return false;
+    }
+    
+    LONGLONG lostPeriodsNumber = latenessTicks / timer->periodTicks + 1;
+    timer->stats.skippedCyclesCount += (uint64_t) lostPeriodsNumber;
+    timer->nextDeadlineTicks += lostPeriodsNumber * timer->periodTicks;
+  }
+  
+  LONGLONG remainingTicks = timer->nextDeadlineTicks - ticks.QuadPart;
+  DWORD remainingMilliseconds = (DWORD) ( 1000 * remainingTicks / TICKS_PER_SECOND.QuadPart );
+  if( remainingMilliseconds > 1 ) Sleep( remainingMilliseconds - 1 );
+  do QueryPerformanceCounter( &ticks );
+  while( ticks.QuadPart < timer->nextDeadlineTicks );
+  
+  timer->nextDeadlineTicks += timer->periodTicks;
+  
+  return ( latenessTicks <= 0 );
+}
+
+// Sleep until the given offset from the start of the current cycle (false if that point has already passed)
+bool PeriodicTimers_WaitCyclePhase( PeriodicTimer timer, uint64_t phaseNanoseconds )
+{
+  LARGE_INTEGER ticks;
+  
+  if( timer == NULL ) return false;
+  
+  LONGLONG phaseTicks = (LONGLONG) ( phaseNanoseconds * TICKS_PER_SECOND.QuadPart / 1000000000LL );
+  if( phaseTicks >= timer->periodTicks ) return false;
+  
+  LONGLONG phaseTimeTicks = timer->nextDeadlineTicks - timer->periodTicks + phaseTicks;
+  
+  QueryPerformanceCounter( &ticks );
+  if( ticks.QuadPart > phaseTimeTicks ) return false;
+  
+  LONGLONG remainingTicks = phaseTimeTicks - ticks.QuadPart;
+  DWORD remainingMilliseconds = (DWORD) ( 1000 * remainingTicks / TICKS_PER_SECOND.QuadPart );
+  if( remainingMilliseconds > 1 ) Sleep( remainingMilliseconds - 1 );
+  do QueryPerformanceCounter( &ticks );
+  while( ticks.QuadPart < phaseTimeTicks );
+  
+  return true;
+}
+
+bool PeriodicTimers_GetStats( PeriodicTimer timer, PeriodicTimerStats* ref_stats )
+{
+  if( timer == NULL || ref_stats == NULL ) return false;
+  
+  *ref_stats = timer->stats;
+  
+  return true;
+}
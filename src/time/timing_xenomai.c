@@ -30,8 +30,17 @@
 #include <native/task.h>
 #include <native/timer.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 DEFINE_NAMESPACE_INTERFACE( Timing, TIMING_INTERFACE )
 
+// No time source setup required
+void Timing_Init()
+{
+  return;
+}
+
 // Make the calling thread wait for the given time ( in milliseconds )
 void Timing_Delay( unsigned long waitMilliseconds )
 {
@@ -60,3 +69,110 @@ double Timing_GetExecTimeSeconds()
     
     return execTimeSeconds;
 }
+
+// Get system time in nanoseconds (Xenomai already reads the calibrated TSC)
+Timestamp Timing_GetExecTimeNanoseconds()
+{
+  return (Timestamp) rt_timer_tsc2ns( rt_timer_tsc() );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/////                  PERIODIC (ABSOLUTE DEADLINE) TIMER                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+struct _PeriodicTimerData
+{
+  RTIME nextDeadline;
+  RTIME period;
+  PeriodicTimerStats stats;
+};
+
+DEFINE_NAMESPACE_INTERFACE( PeriodicTimers, PERIODIC_TIMER_INTERFACE )
+
+PeriodicTimer PeriodicTimers_Create( uint64_t periodNanoseconds, enum TimerOverrunPolicy overrunPolicy )
+{
+  if( periodNanoseconds == 0 ) return NULL;
+  
+  PeriodicTimer newTimer = (PeriodicTimer) malloc( sizeof(PeriodicTimerData) );
+  memset( newTimer, 0, sizeof(PeriodicTimerData) );
+  
+  newTimer->period = (RTIME) rt_timer_ns2ticks( (SRTIME) periodNanoseconds );
+  newTimer->stats.overrunPolicy = ( overrunPolicy < TIMER_OVERRUN_POLICIES_NUMBER ) ? overrunPolicy : TIMER_OVERRUN_SKIP;
+  
+  PeriodicTimers_Start( newTimer );
+  
+  return newTimer;
+}
+
+void PeriodicTimers_Discard( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  free( timer );
+}
+
+void PeriodicTimers_Start( PeriodicTimer timer )
+{
+  if( timer == NULL ) return;
+  
+  timer->nextDeadline = rt_timer_read() + timer->period;
+}
+
+bool PeriodicTimers_WaitNextCycle( PeriodicTimer timer )
+{
+  if( timer == NULL ) return false;
+  
+  timer->stats.cyclesCount++;
+  
+  RTIME currentTime = rt_timer_read();
+  bool deadlineMissed = ( currentTime > timer->nextDeadline );
+  if( deadlineMissed )
+  {
+    RTIME lateness = currentTime - timer->nextDeadline;
+    uint64_t latenessNanoseconds = (uint64_t) rt_timer_ticks2ns( (SRTIME) lateness );
+    timer->stats.missedDeadlinesCount++;
+    if( latenessNanoseconds > timer->stats.worstLatenessNanoseconds ) timer->stats.worstLatenessNanoseconds = latenessNanoseconds;
+    
+    if( timer->stats.overrunPolicy == TIMER_OVERRUN_CATCH_UP )
+    {
+      timer->nextDeadline += timer->period;
+      return false;
+    }
+    
+    RTIME lostPeriodsNumber = lateness / timer->period + 1;
+    timer->stats.skippedCyclesCount += (uint64_t) lostPeriodsNumber;
+    timer->nextDeadline += lostPeriodsNumber * timer->period;
+  }
+  
+  rt_task_sleep_until( timer->nextDeadline );
+  
+  timer->nextDeadline += timer->period;
+  
+  return !deadlineMissed;
+}
+
+// Sleep until the given offset from the start of the current cycle (false if that point has already passed)
+bool PeriodicTimers_WaitCyclePhase( PeriodicTimer timer, uint64_t phaseNanoseconds )
+{
+  if( timer == NULL ) return false;
+  
+  RTIME phase = (RTIME) rt_timer_ns2ticks( (SRTIME) phaseNanoseconds );
+  if( phase >= timer->period ) return false;
+  
+  RTIME phaseTime = timer->nextDeadline - timer->period + phase;
+  if( rt_timer_read() > phaseTime ) return false;
+  
+  rt_task_sleep_until( phaseTime );
+  
+  return true;
+}
+
+bool PeriodicTimers_GetStats( PeriodicTimer timer, PeriodicTimerStats* ref_stats )
+{
+  if( timer == NULL || ref_stats == NULL ) return false;
+  
+  *ref_stats = timer->stats;
+  
+  return true;
+}